@@ -0,0 +1,129 @@
+#include "autocorrelation.h"
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+using namespace std;
+
+// *************************************************************
+
+
+AutoCorrelation::AutoCorrelation()
+   :  m_nvalues(0), m_values_per(1), m_mean(0.0), m_variance(0.0),
+      m_rho(1,1.0), m_window(0), m_window_found(false),
+      m_tauint(0.5), m_tauint_err(0.0)
+{}
+
+
+AutoCorrelation::AutoCorrelation(const Vector<double>& mcdata, Windowing windowing,
+                                 double factor, uint nkeep, uint values_per)
+   :  m_nvalues(mcdata.size()), m_values_per(values_per), m_window(0),
+      m_window_found(true), m_tauint(0.5), m_tauint_err(0.0)
+{
+ uint N=m_nvalues;
+ if (N<2)
+    throw(std::invalid_argument("Too few values in AutoCorrelation"));
+ if (factor<0.0)
+    throw(std::invalid_argument("Negative window factor in AutoCorrelation"));
+ if (factor==0.0) factor=getDefaultFactor(windowing);
+ m_mean=0.0;
+ for (uint i=0;i<N;i++) m_mean+=mcdata[i];
+ m_mean/=double(N);
+ vector<double> gamma;
+ calc_autocov(mcdata,m_mean,gamma);
+ m_variance=gamma[0];
+ if (m_variance<=0.0){            // constant data
+    m_rho.assign(1,1.0);
+    return;}
+
+ uint wmax=N/2;
+ double sumrho=0.5;
+ m_window_found=false;
+ for (uint w=1;w<=wmax;w++){
+    sumrho+=gamma[w]/m_variance;
+    if (windowing==Wolff){
+       if (sumrho<=0.5){
+          m_window_found=true;}
+       else{
+          double tau=factor/log((2.0*sumrho+1.0)/(2.0*sumrho-1.0));
+          m_window_found=((exp(-double(w)/tau)-tau/sqrt(double(w)*double(N)))<0.0);}}
+    else
+       m_window_found=(double(w)>=factor*sumrho);
+    if ((m_window_found)||(w==wmax)){
+       m_window=w; m_tauint=sumrho;
+       break;}}
+ m_tauint_err=m_tauint*sqrt(2.0*(2.0*double(m_window)+1.0)/double(N));
+
+ uint tkeep=(nkeep>m_window) ? nkeep : m_window;
+ if (tkeep>N-1) tkeep=N-1;
+ m_rho.resize(tkeep+1);
+ for (uint t=0;t<=tkeep;t++)
+    m_rho[t]=gamma[t]/m_variance;
+}
+
+
+double AutoCorrelation::getAutoCorrelation(uint markovtime) const
+{
+ if (markovtime>=m_rho.size())
+    throw(std::invalid_argument("Markov time too large in AutoCorrelation"));
+ return m_rho[markovtime];
+}
+
+
+double AutoCorrelation::getDefaultFactor(Windowing windowing)
+{
+ return (windowing==Wolff) ? 1.5 : 6.0;
+}
+
+
+    //  In-place radix-2 fast Fourier transform; the size of "z" must
+    //  be a power of two.  The twiddle factors are computed directly
+    //  (not by repeated multiplication) to avoid accumulating round-off.
+
+static void fft(vector<complex<double> >& z, bool inverse)
+{
+ uint n=z.size();
+ for (uint i=1,j=0;i<n;i++){
+    uint bit=n>>1;
+    for (;j&bit;bit>>=1) j^=bit;
+    j^=bit;
+    if (i<j) swap(z[i],z[j]);}
+ double sgn=(inverse) ? 1.0 : -1.0;
+ vector<complex<double> > w(n/2);
+ for (uint k=0;k<n/2;k++)
+    w[k]=polar(1.0,sgn*2.0*M_PI*double(k)/double(n));
+ for (uint len=2;len<=n;len<<=1){
+    uint half=len/2, stride=n/len;
+    for (uint start=0;start<n;start+=len){
+       for (uint k=0;k<half;k++){
+          complex<double> u=z[start+k];
+          complex<double> v=z[start+k+half]*w[k*stride];
+          z[start+k]=u+v;
+          z[start+k+half]=u-v;}}}
+}
+
+
+    //  gamma[t] for t=0..N-1, from the squared magnitude of the transform
+    //  of the data padded with zeros to at least 2N (so that the circular
+    //  correlation does not wrap around)
+
+void AutoCorrelation::calc_autocov(const Vector<double>& mcdata, double mean,
+                                   vector<double>& gamma)
+{
+ uint N=mcdata.size();
+ uint M=1;
+ while (M<2*N) M<<=1;
+ vector<complex<double> > z(M,complex<double>(0.0,0.0));
+ for (uint i=0;i<N;i++)
+    z[i]=complex<double>(mcdata[i]-mean,0.0);
+ fft(z,false);
+ for (uint k=0;k<M;k++)
+    z[k]=complex<double>(norm(z[k]),0.0);
+ fft(z,true);
+ gamma.resize(N);
+ for (uint t=0;t<N;t++)
+    gamma[t]=z[t].real()/(double(M)*double(N-t));
+}
+
+
+// *************************************************************
@@ -0,0 +1,96 @@
+#ifndef AUTOCORRELATION_H
+#define AUTOCORRELATION_H
+#include <vector>
+#include "matrix.h"
+
+// *******************************************************************
+// *                                                                 *
+// *   "AutoCorrelation" takes a Markov-chain series of Monte Carlo  *
+// *   data x(i), i=0..N-1, in "mcdata" and computes its normalized  *
+// *   autocorrelation function and integrated autocorrelation time  *
+// *                                                                 *
+// *      Gamma(t) = sum( y(i) y(i+t), i=0..N-t-1 ) / (N-t)          *
+// *      rho(t) = Gamma(t)/Gamma(0)                                 *
+// *      tauint(W) = 1/2 + sum( rho(t), t=1..W )                    *
+// *                                                                 *
+// *   where y(i)=x(i)-xbar and "xbar" is the mean.  Gamma(t) is     *
+// *   obtained for all t at once from a fast Fourier transform of   *
+// *   the zero-padded data, so the cost is O(N log N) instead of    *
+// *   O(N) per time "t".  The summation window W is chosen          *
+// *   automatically, in one of two ways:                            *
+// *                                                                 *
+// *     Wolff:  W is the first W for which                          *
+// *                 exp(-W/tau) - tau/sqrt(W*N) < 0,                *
+// *        where tau = S/ln((2 tauint(W)+1)/(2 tauint(W)-1)),       *
+// *        with factor S (default 1.5) [U. Wolff, Comput. Phys.     *
+// *        Commun. 156 (2004) 143];                                 *
+// *                                                                 *
+// *     MadrasSokal:  W is the first W for which W >= c tauint(W),  *
+// *        with factor c (default 6) [N. Madras and A. Sokal,       *
+// *        J. Stat. Phys. 50 (1988) 109].                           *
+// *                                                                 *
+// *   A "factor" of zero means the default.  The error of tauint    *
+// *   is estimated as tauint*sqrt(2(2W+1)/N).  If no window is      *
+// *   found up to N/2, then W=N/2 and "isWindowFound()" is false.   *
+// *   rho(t) is kept for t up to the larger of W and "nkeep" (and   *
+// *   less than N).  "values_per" is simply stored: it records how  *
+// *   many measurements were averaged into each data value.         *
+// *                                                                 *
+// *******************************************************************
+
+
+class AutoCorrelation
+{
+
+ public:
+
+   enum Windowing {Wolff, MadrasSokal};
+
+ private:
+
+   uint m_nvalues, m_values_per;
+   double m_mean, m_variance;
+   std::vector<double> m_rho;
+   uint m_window;
+   bool m_window_found;
+   double m_tauint, m_tauint_err;
+
+ public:
+
+   AutoCorrelation();        // no data
+
+   AutoCorrelation(const Vector<double>& mcdata, Windowing windowing=Wolff,
+                   double factor=0.0, uint nkeep=0, uint values_per=1);
+
+   uint getNumberOfValues() const {return m_nvalues;}
+
+   uint getMeasurementsPerValue() const {return m_values_per;}
+
+   double getMean() const {return m_mean;}
+
+   double getVariance() const {return m_variance;}         // Gamma(0)
+
+   uint getMaxMarkovTime() const {return m_rho.size()-1;}
+
+   double getAutoCorrelation(uint markovtime) const;       // rho(t)
+
+   uint getWindow() const {return m_window;}
+
+   bool isWindowFound() const {return m_window_found;}
+
+   double getIntegratedAutoCorrelationTime() const {return m_tauint;}
+
+   double getIntegratedAutoCorrelationTimeError() const {return m_tauint_err;}
+
+   static double getDefaultFactor(Windowing windowing);
+
+ private:
+
+   static void calc_autocov(const Vector<double>& mcdata, double mean,
+                            std::vector<double>& gamma);
+
+};
+
+
+// **************************************************************
+#endif
@@ -140,6 +140,18 @@ const Vector<unsigned int>& Bootstrapper::get_resampling_precalc(int ind)
  return m_samplings[ind];
 }
  
+    // Does not change the current resampling, so can be used by several
+    // threads at once.
+
+const Vector<unsigned int>& Bootstrapper::getPrecomputedResampling(int ind) const
+{
+ if (!m_precompute)
+    throw(std::invalid_argument("getPrecomputedResampling requires precompute mode in Bootstrapper"));
+ if ((ind<0)||(ind>=int(nsamples)))
+    throw(std::invalid_argument("Invalid sample index in Bootstrapper"));
+ return m_samplings[ind];
+}
+
 const Vector<unsigned int>& Bootstrapper::get_resampling_onfly(int ind)
 {
  if ((ind<0)||(ind>=int(nsamples)))
@@ -187,6 +187,7 @@ class Bootstrapper
     const Vector<unsigned int>& getResampling(int ind);
     const Vector<unsigned int>& getNextResampling();
     const Vector<unsigned int>& getCurrentResampling() const;
+    const Vector<unsigned int>& getPrecomputedResampling(int ind) const;  // precompute mode only
 
  private:
 
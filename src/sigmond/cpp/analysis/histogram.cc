@@ -29,9 +29,10 @@ void getOutliers(const Vector<double>& mcdata, Vector<uint>& outliers,
  uint ndata=mcdata.size();
  if (ndata<32) return;
  vector<double> temp(mcdata.c_vector());
- std::sort(temp.begin(),temp.end());
+ std::nth_element(temp.begin(),temp.begin()+3*ndata/4,temp.end());
+ double hi=temp[3*ndata/4];      // only the two quartiles are needed, not a full sort
+ std::nth_element(temp.begin(),temp.begin()+ndata/4,temp.begin()+3*ndata/4);
  double lo=temp[ndata/4]; 
- double hi=temp[3*ndata/4];
  double m=(lo+hi)/2.0;
  double v=outlier_scale*(hi-lo)/2.0;
  lo=m-v;
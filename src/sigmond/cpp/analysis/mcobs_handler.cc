@@ -1,6 +1,10 @@
 #include "mcobs_handler.h"
 #include <algorithm>
 #include <limits>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
 
 using namespace LaphEnv;
 using namespace std;
@@ -20,13 +24,22 @@ using namespace std;
 
 
 
+thread_local const MCObsHandler* MCObsHandler::t_attached=0;
+thread_local MCObsHandler::SamplingState* MCObsHandler::t_state=0;
+thread_local int MCObsHandler::t_lock_depth=0;
+
+
 MCObsHandler::MCObsHandler(MCObsGetHandler& in_handler, bool bootprecompute)  
-   : m_in_handler(in_handler), Bptr(0), 
-     m_curr_sampling_mode(in_handler.getDefaultSamplingMode()), m_curr_sampling_index(0),
-     m_curr_sampling_max(in_handler.getNumberOfDefaultResamplings()), 
-     m_curr_samples(in_handler.getSamplingInfo().isJackknifeMode() ? &m_jacksamples : &m_bootsamples),
-     m_curr_covmat_sampling_mode(in_handler.getDefaultSamplingMode())
-{
+   : m_in_handler(in_handler), Bptr(0), m_memory_limit(0.0), m_memory_used(0.0),
+     m_memory_peak(0.0), m_use_count(0), m_task_start(0), m_ndropped(0),
+     m_nspilled(0), m_nrestored(0), m_cache(0), m_shard(-1), m_batch_output(false)
+{
+ for (int store=0;store<3;++store) m_spill_map[store]=0;
+ m_main_state.m_curr_sampling_mode=in_handler.getDefaultSamplingMode();
+ m_main_state.m_curr_sampling_index=0;
+ m_main_state.m_curr_sampling_max=in_handler.getNumberOfDefaultResamplings();
+ m_main_state.m_curr_samples=in_handler.getSamplingInfo().isJackknifeMode() ? &m_jacksamples : &m_bootsamples;
+ m_main_state.m_curr_covmat_sampling_mode=in_handler.getDefaultSamplingMode();
  /*
  if (getNumberOfMeasurements()<24){
     //cout << "Number of measurements is too small"<<endl;
@@ -36,13 +49,19 @@ MCObsHandler::MCObsHandler(MCObsGetHandler& in_handler, bool bootprecompute)
     Bptr=new Bootstrapper(getNumberOfBins(),samp.getNumberOfReSamplings(getBinsInfo()),
                           samp.getRNGSeed(),samp.getSkipValue(),bootprecompute);}
  m_is_weighted=m_in_handler.getEnsembleInfo().isWeighted();
- m_is_correlated=true;
+ m_main_state.m_is_correlated=true;
+ m_main_state.m_lowrank_diag_weight=0.0;
 }
 
 
 MCObsHandler::~MCObsHandler()
 {
  if (Bptr) delete Bptr;
+ for (int store=0;store<3;++store){
+    if (m_spill_map[store]==0) continue;
+    delete m_spill_map[store];
+    std::remove((m_spill_stub+make_string(store)).c_str());}
+ delete m_cache;
 }
 
 unsigned int MCObsHandler::getNumberOfMeasurements() const
@@ -128,6 +147,7 @@ const Bootstrapper& MCObsHandler::getBootstrapper() const
 
 const Vector<uint>& MCObsHandler::getBootstrapperResampling(uint bootindex) const
 {
+ HandlerLock lock(*this);
  if (Bptr) return Bptr->getResampling(bootindex);
  cout << "Fatal error: requested reference to nonexistence Bootstrapper"<<endl;
  throw(std::invalid_argument("Nonexistent Bootstrapper"));
@@ -136,62 +156,93 @@ const Vector<uint>& MCObsHandler::getBootstrapperResampling(uint bootindex) cons
 
 void MCObsHandler::clearData()
 {
- m_obs_simple.clear();
+ HandlerLock lock(*this);
+ {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+  m_obs_simple.clear();}
+ m_residency[0].clear();
+ m_spilled[0].clear();
  clearSamplings();
+ m_memory_used=0.0;
 }
 
 
 void MCObsHandler::eraseData(const MCObsInfo& obskey)
 {
- m_obs_simple.erase(obskey);
+ HandlerLock lock(*this);
+ map<MCObsInfo,RVector>::iterator dt=m_obs_simple.find(obskey);
+ if (dt!=m_obs_simple.end()){
+    note_erase(0,obskey,dt->second.size());
+    std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+    m_obs_simple.erase(dt);}
+ m_spilled[0].erase(obskey);
  eraseSamplings(obskey);
 }
 
 
 void MCObsHandler::clearSamplings()
 {
- m_jacksamples.clear();
- m_bootsamples.clear();
+ HandlerLock lock(*this);
+ for (int store=1;store<3;++store){
+    map<MCObsInfo,pair<RVector,uint> >& samps=(store==1)?m_jacksamples:m_bootsamples;
+    for (map<MCObsInfo,pair<RVector,uint> >::const_iterator it=samps.begin();it!=samps.end();++it)
+       note_erase(store,it->first,it->second.first.size());
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+     samps.clear();}
+    m_residency[store].clear();
+    m_spilled[store].clear();}
 }
 
 void MCObsHandler::eraseSamplings(const MCObsInfo& obskey)
 {
- m_jacksamples.erase(obskey);
- m_bootsamples.erase(obskey);
+ HandlerLock lock(*this);
+ for (int store=1;store<3;++store){
+    map<MCObsInfo,pair<RVector,uint> >& samps=(store==1)?m_jacksamples:m_bootsamples;
+    map<MCObsInfo,pair<RVector,uint> >::iterator dt=samps.find(obskey);
+    if (dt!=samps.end()){
+       note_erase(store,obskey,dt->second.first.size());
+       std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+       samps.erase(dt);}
+    m_spilled[store].erase(obskey);}
 }
 
 
 void MCObsHandler::getFileMap(XMLHandler& xmlout) const
 {
+ HandlerLock lock(*this);
  m_in_handler.getFileMap(xmlout);
 }
 
 uint MCObsHandler::getBinsInMemorySize() const
 {
+ HandlerLock lock(*this);
  return m_obs_simple.size();
 }
 
 
 uint MCObsHandler::getJackknifeSamplingsInMemorySize() const
 {
+ HandlerLock lock(*this);
  return m_jacksamples.size();
 }
 
 
 uint MCObsHandler::getBootstrapSamplingsInMemorySize() const
 {
+ HandlerLock lock(*this);
  return m_bootsamples.size();
 }
 
 
 uint MCObsHandler::getCurrentModeSamplingsInMemorySize() const
 {
- return m_curr_samples->size();
+ HandlerLock lock(*this);
+ return curr_state().m_curr_samples->size();
 }
 
 
 uint MCObsHandler::getSamplingsInMemorySize(SamplingMode mode) const
 {
+ HandlerLock lock(*this);
  return (mode==Jackknife) ? m_jacksamples.size() : m_bootsamples.size();
 }
 
@@ -207,15 +258,77 @@ void MCObsHandler::assert_simple(const MCObsInfo& obskey, const string& name)
 }
 
 
+    //  Reads of data already in memory take only a shared lock on the
+    //  structure of the maps, not "m_mutex".  With a memory limit, each
+    //  access must update the residency records and spilled data may need
+    //  to be restored, so these return null and "m_mutex" is used instead.
+    //  The pointers returned stay valid after the shared lock is released
+    //  since entries that are put again are replaced in place, not erased
+    //  and inserted; an entry must not be erased while another thread uses
+    //  it (see item (17) in "mcobs_handler.h").
+
+const RVector* MCObsHandler::find_resident_bins(const MCObsInfo& obskey) const
+{
+ if (m_memory_limit>0.0) return 0;
+ std::shared_lock<std::shared_mutex> slock(m_store_mutex);
+ map<MCObsInfo,RVector>::const_iterator dt=m_obs_simple.find(obskey);
+ return (dt!=m_obs_simple.end()) ? &(dt->second) : 0;
+}
+
+
+const RVector* MCObsHandler::find_resident_samplings(const MCObsInfo& obskey, 
+                      const map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
+                      bool allow_not_all_available) const
+{
+ if (m_memory_limit>0.0) return 0;
+ std::shared_lock<std::shared_mutex> slock(m_store_mutex);
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if (dt==samp_ptr->end()) return 0;
+ if (((dt->second).second!=(dt->second).first.size())&&(!allow_not_all_available)) return 0;
+ return &((dt->second).first);
+}
+
+
+bool MCObsHandler::read_resident_sampling(const MCObsInfo& obskey, 
+                      const map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
+                      uint sampindex, double& value) const
+{
+ if (m_memory_limit>0.0) return false;
+ std::shared_lock<std::shared_mutex> slock(m_store_mutex);
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if ((dt==samp_ptr->end())||(sampindex>=(dt->second).first.size())) return false;
+ value=(dt->second).first[sampindex];
+ return !std::isnan(value);
+}
+
+
+    //  If another thread is resampling the bins of "obskey" with "m_mutex"
+    //  released, waits until it is done and returns true.  Waiting is only
+    //  possible if this thread holds "m_mutex" once; otherwise the samplings
+    //  are simply computed again.
+
+bool MCObsHandler::wait_for_fill(int store, const MCObsInfo& obskey)
+{
+ if ((t_lock_depth!=1)||(m_filling[store].count(obskey)==0)) return false;
+ m_fill_cv.wait(m_mutex);
+ return true;
+}
+
+
 const RVector& MCObsHandler::get_bins(const MCObsInfo& obskey)
 {
  assert_simple(obskey,"getBins");
+ const RVector* res=find_resident_bins(obskey);
+ if (res!=0) return *res;
+ HandlerLock lock(*this);
  map<MCObsInfo,RVector>::const_iterator dt=m_obs_simple.find(obskey);
- if (dt!=m_obs_simple.end()){ return (dt->second);}
+ if ((dt==m_obs_simple.end())&&(restore_spilled(0,obskey))) dt=m_obs_simple.find(obskey);
+ if (dt!=m_obs_simple.end()){ touch(0,obskey); return (dt->second);}
 
  if (!obskey.hasNoRelatedFlip()){
     MCObsInfo tkey(obskey.getTimeFlipped());
     map<MCObsInfo,RVector>::const_iterator dt=m_obs_simple.find(tkey);
+    if ((dt==m_obs_simple.end())&&(restore_spilled(0,tkey))) dt=m_obs_simple.find(tkey);
     if (dt!=m_obs_simple.end()){
        RVector buf(dt->second);
 #ifdef COMPLEXNUMBERS
@@ -227,6 +340,7 @@ const RVector& MCObsHandler::get_bins(const MCObsInfo& obskey)
 
  if (m_obs_simple.size()>262144){
     cout << "Data exhaustion!"<<endl;
+    std::unique_lock<std::shared_mutex> slock(m_store_mutex);
     m_obs_simple.clear();
     exit(1);}
 
@@ -236,6 +350,7 @@ const RVector& MCObsHandler::get_bins(const MCObsInfo& obskey)
     m_in_handler.getBinsComplex(obskey,bins_re,bins_im);
     pair< map<MCObsInfo,RVector>::iterator,bool> ret,ret2;
     MCObsInfo key2(obskey);
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
     if (obskey.isRealPart()){
        ret=m_obs_simple.insert(make_pair(obskey,bins_re));
        key2.setToImaginaryPart();
@@ -243,10 +358,12 @@ const RVector& MCObsHandler::get_bins(const MCObsInfo& obskey)
     else{
        ret=m_obs_simple.insert(make_pair(obskey,bins_im));
        key2.setToRealPart();
-       ret2=m_obs_simple.insert(make_pair(key2,bins_re));}
+       ret2=m_obs_simple.insert(make_pair(key2,bins_re));}}
     if ((!ret.second)||(!ret2.second)){
        //cout << "Error inserting in MCObsHandler map"<<endl;
        throw(std::invalid_argument("Insertion error: Error inserting in MCObsHandler map"));}
+    note_insert(0,key2,ret2.first->second.size(),true);
+    note_insert(0,obskey,ret.first->second.size(),true);
     return (ret.first)->second;}
 
 #else
@@ -254,10 +371,12 @@ const RVector& MCObsHandler::get_bins(const MCObsInfo& obskey)
     RVector bins;
     m_in_handler.getBins(obskey,bins);
     pair<map<MCObsInfo,RVector>::iterator,bool> ret;
-    ret=m_obs_simple.insert(make_pair(obskey,bins));
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+     ret=m_obs_simple.insert(make_pair(obskey,bins));}
     if (!ret.second){
        //cout << "Error inserting in MCObsHandler map"<<endl;
        throw(std::invalid_argument("Insertion error: Error inserting in MCObsHandler map"));}
+    note_insert(0,obskey,ret.first->second.size(),true);
     return (ret.first)->second;}
 #endif
 
@@ -286,9 +405,11 @@ void MCObsHandler::getBins(const MCObsInfo& obskey, RVector& values)
 
 bool MCObsHandler::queryBins(const MCObsInfo& obskey)
 {
+ HandlerLock lock(*this);
  if (obskey.isNonSimple()) return false;
  map<MCObsInfo,RVector>::const_iterator dt=m_obs_simple.find(obskey);
  if (dt!=m_obs_simple.end()) return true;
+ if (m_spilled[0].count(obskey)>0) return true;
  return m_in_handler.queryBins(obskey);
 }
 
@@ -296,9 +417,10 @@ bool MCObsHandler::queryBins(const MCObsInfo& obskey)
 
 bool MCObsHandler::queryBinsInMemory(const MCObsInfo& obskey)
 {
+ HandlerLock lock(*this);
  if (obskey.isNonSimple()) return false;
  map<MCObsInfo,RVector>::const_iterator dt=m_obs_simple.find(obskey);
- return (dt!=m_obs_simple.end());
+ return (dt!=m_obs_simple.end())||(m_spilled[0].count(obskey)>0);
 }
 
 
@@ -316,15 +438,26 @@ double MCObsHandler::getBin(const MCObsInfo& obskey, int bin_index)
 
 const RVector& MCObsHandler::putBins(const MCObsInfo& obskey, const RVector& values)
 {
+ HandlerLock lock(*this);
  assert_simple(obskey,"putBins");
  if (values.size()!=getNumberOfBins())
     throw(std::invalid_argument("Invalid Vector size in putBins"));
 // if (m_in_handler.queryBins(obskey))
 //    throw(std::invalid_argument("Cannot put Bins for data contained in the files"));
- m_obs_simple.erase(obskey);
+ map<MCObsInfo,RVector>::iterator dt=m_obs_simple.find(obskey);
+ m_spilled[0].erase(obskey);
+ if (dt!=m_obs_simple.end()){      // replace in place (see "find_resident_bins")
+    note_erase(0,obskey,dt->second.size());
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+     dt->second=values;}
+    note_insert(0,obskey,values.size(),false);
+    return dt->second;}
  try{
-    pair<map<MCObsInfo,RVector>::iterator,bool> flag=m_obs_simple.insert(make_pair(obskey,values));
+    pair<map<MCObsInfo,RVector>::iterator,bool> flag;
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+     flag=m_obs_simple.insert(make_pair(obskey,values));}
     if (!(flag.second)) throw(std::runtime_error("Could not putBins"));
+    note_insert(0,obskey,values.size(),false);
     return (flag.first)->second;}
  catch(std::exception& xp){
     cout << "FATAL: could not do putBins"<<endl; exit(1);}
@@ -336,22 +469,24 @@ const RVector& MCObsHandler::putBins(const MCObsInfo& obskey, const RVector& val
 
 void MCObsHandler::setToJackknifeMode()
 {
- if (m_curr_sampling_mode!=Jackknife){
-    m_curr_sampling_mode=Jackknife;
-    m_curr_samples=&m_jacksamples;
-    m_curr_sampling_index=0;
-    m_curr_sampling_max=getNumberOfBins();}
+ SamplingState& cs=curr_state();
+ if (cs.m_curr_sampling_mode!=Jackknife){
+    cs.m_curr_sampling_mode=Jackknife;
+    cs.m_curr_samples=&m_jacksamples;
+    cs.m_curr_sampling_index=0;
+    cs.m_curr_sampling_max=getNumberOfBins();}
 }
 
 
 void MCObsHandler::setToBootstrapMode()
 {
- if (m_curr_sampling_mode!=Bootstrap){
+ SamplingState& cs=curr_state();
+ if (cs.m_curr_sampling_mode!=Bootstrap){
     if (Bptr==0) throw(std::invalid_argument("Must initialize bootstrapper to go to bootstrap mode"));
-    m_curr_sampling_mode=Bootstrap;
-    m_curr_samples=&m_bootsamples;
-    m_curr_sampling_index=0;
-    m_curr_sampling_max=getNumberOfBootstrapResamplings();}
+    cs.m_curr_sampling_mode=Bootstrap;
+    cs.m_curr_samples=&m_bootsamples;
+    cs.m_curr_sampling_index=0;
+    cs.m_curr_sampling_max=getNumberOfBootstrapResamplings();}
 }
 
 
@@ -373,19 +508,19 @@ void MCObsHandler::setToDefaultSamplingMode()
 
 bool MCObsHandler::isJackknifeMode() const
 {
- return (m_curr_sampling_mode==Jackknife);
+ return (curr_state().m_curr_sampling_mode==Jackknife);
 }
 
 
 bool MCObsHandler::isBootstrapMode() const
 {
- return (m_curr_sampling_mode==Bootstrap);
+ return (curr_state().m_curr_sampling_mode==Bootstrap);
 }
 
 
 bool MCObsHandler::isDefaultSamplingMode() const
 {
- return (m_curr_sampling_mode==m_in_handler.getDefaultSamplingMode());
+ return (curr_state().m_curr_sampling_mode==m_in_handler.getDefaultSamplingMode());
 }
 
 
@@ -394,15 +529,16 @@ bool MCObsHandler::isDefaultSamplingMode() const
 
 void MCObsHandler::setCovMatToJackknifeMode()
 {
- m_curr_covmat_sampling_mode=Jackknife;
+ curr_state().m_curr_covmat_sampling_mode=Jackknife;
 }
 
 
 void MCObsHandler::setCovMatToBootstrapMode()
 {
- if (m_curr_covmat_sampling_mode!=Bootstrap){
+ SamplingState& cs=curr_state();
+ if (cs.m_curr_covmat_sampling_mode!=Bootstrap){
     if (Bptr==0) throw(std::invalid_argument("Must initialize bootstrapper to go to bootstrap mode"));
-    m_curr_covmat_sampling_mode=Bootstrap;}
+    cs.m_curr_covmat_sampling_mode=Bootstrap;}
 }
 
 
@@ -424,75 +560,92 @@ void MCObsHandler::setCovMatToDefaultSamplingMode()
 
 bool MCObsHandler::isCovMatJackknifeMode() const
 {
- return (m_curr_covmat_sampling_mode==Jackknife);
+ return (curr_state().m_curr_covmat_sampling_mode==Jackknife);
 }
 
 
 bool MCObsHandler::isCovMatBootstrapMode() const
 {
- return (m_curr_covmat_sampling_mode==Bootstrap);
+ return (curr_state().m_curr_covmat_sampling_mode==Bootstrap);
 }
 
 
 
 void MCObsHandler::setToUnCorrelated()
 {
- m_is_correlated=false;
+ curr_state().m_is_correlated=false;
+ curr_state().m_lowrank_diag_weight=0.0;
 }
 
 void MCObsHandler::setToCorrelated()
 {
- m_is_correlated=true;
+ curr_state().m_is_correlated=true;
+ curr_state().m_lowrank_diag_weight=0.0;
+}
+
+void MCObsHandler::setToLowRankCorrelated(double diag_weight)
+{
+ if (!(diag_weight>0.0))
+    throw(std::invalid_argument("Diagonal weight for low-rank covariance must be positive"));
+ curr_state().m_is_correlated=true;
+ curr_state().m_lowrank_diag_weight=diag_weight;
+}
+
+bool MCObsHandler::isLowRankCorrelated() const
+{
+ return (curr_state().m_lowrank_diag_weight>0.0);
 }
 
 bool MCObsHandler::isCorrelated() const
 {
- return m_is_correlated;
+ return curr_state().m_is_correlated;
 }
 
 bool MCObsHandler::isUnCorrelated() const
 {
- return !m_is_correlated;
+ return !curr_state().m_is_correlated;
 }
 
 
 MCObsHandler& MCObsHandler::setSamplingBegin()
 {
- m_curr_sampling_index=0;
+ curr_state().m_curr_sampling_index=0;
  return *this;
 }
 
 
 MCObsHandler& MCObsHandler::begin()
 {
- m_curr_sampling_index=0;
+ curr_state().m_curr_sampling_index=0;
  return *this;
 }
 
 
 MCObsHandler& MCObsHandler::setSamplingNext()
 {
- m_curr_sampling_index++;
+ curr_state().m_curr_sampling_index++;
  return *this;
 }
 
 
 MCObsHandler& MCObsHandler::operator++()
 {
- m_curr_sampling_index++;
+ curr_state().m_curr_sampling_index++;
  return *this;
 }
 
 
 bool MCObsHandler::isSamplingEnd() const
 {
- return (m_curr_sampling_index>m_curr_sampling_max);
+ const SamplingState& cs=curr_state();
+ return (cs.m_curr_sampling_index>cs.m_curr_sampling_max);
 }
 
 
 bool MCObsHandler::end() const
 {
- return (m_curr_sampling_index>m_curr_sampling_max);
+ const SamplingState& cs=curr_state();
+ return (cs.m_curr_sampling_index>cs.m_curr_sampling_max);
 }
 
 
@@ -502,13 +655,19 @@ bool MCObsHandler::end() const
 
 bool MCObsHandler::queryFullAndSamplings(const MCObsInfo& obskey)
 {
- map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=m_curr_samples->find(obskey);
- if (dt!=m_curr_samples->end()) 
+ map<MCObsInfo,pair<RVector,uint> > *samp_ptr=curr_state().m_curr_samples;
+ if (find_resident_samplings(obskey,samp_ptr,false)!=0) return true;
+ HandlerLock lock(*this);
+ int store=store_index(samp_ptr);
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+ if (dt!=samp_ptr->end()) 
     if ((dt->second).second==(dt->second).first.size()) return true;
  if (!obskey.hasNoRelatedFlip()){
     MCObsInfo tkey(obskey.getTimeFlipped());
-    map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=m_curr_samples->find(tkey);
-    if (dt!=m_curr_samples->end()){
+    map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(tkey);
+    if ((dt==samp_ptr->end())&&(restore_spilled(store,tkey))) dt=samp_ptr->find(tkey);
+    if (dt!=samp_ptr->end()){
        if ((dt->second).second==(dt->second).first.size()) return true;}}
  if (query_from_samplings_file(obskey)) return true;
  return query_samplings_from_bins(obskey);
@@ -525,17 +684,37 @@ bool MCObsHandler::queryFullAndSamplings(const MCObsInfo& obskey, SamplingMode m
 }
 
 
+bool MCObsHandler::queryFullAndSamplingsInMemory(const MCObsInfo& obskey)
+{
+ HandlerLock lock(*this);
+ map<MCObsInfo,pair<RVector,uint> > *samp_ptr=curr_state().m_curr_samples;
+ int store=store_index(samp_ptr);
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+ return ((dt!=samp_ptr->end())&&((dt->second).second==(dt->second).first.size()));
+}
+
+
 const RVector& MCObsHandler::get_full_and_sampling_values(const MCObsInfo& obskey, 
                       map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
                       SamplingMode mode, bool allow_not_all_available)
 {
- map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
- if (dt!=samp_ptr->end()){
-    if (((dt->second).second==(dt->second).first.size())||(allow_not_all_available))
-       return (dt->second).first;}
+ const RVector* res=find_resident_samplings(obskey,samp_ptr,allow_not_all_available);
+ if (res!=0) return *res;
+ HandlerLock lock(*this);
+ int store=store_index(samp_ptr);
+ do{
+    map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+    if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+    if (dt!=samp_ptr->end()){
+       if (((dt->second).second==(dt->second).first.size())||(allow_not_all_available)){
+          touch(store,obskey);
+          return (dt->second).first;}}}
+ while (wait_for_fill(store,obskey));
  if (!obskey.hasNoRelatedFlip()){
     MCObsInfo tkey(obskey.getTimeFlipped());
     map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(tkey);
+    if ((dt==samp_ptr->end())&&(restore_spilled(store,tkey))) dt=samp_ptr->find(tkey);
     if (dt!=samp_ptr->end()){
        if (((dt->second).second==(dt->second).first.size())||(allow_not_all_available)){
           RVector samples(dt->second.first);
@@ -545,8 +724,8 @@ const RVector& MCObsHandler::get_full_and_sampling_values(const MCObsInfo& obske
  if (mode==m_in_handler.getDefaultSamplingMode()){
     RVector samples;
     if (m_in_handler.getSamplingsMaybe(obskey,samples)){
-       return put_samplings_in_memory(obskey,samples,samp_ptr);}
-    const RVector* res=calc_corrsubvev_from_samplings(obskey,samp_ptr);
+       return put_samplings_in_memory(obskey,samples,samp_ptr,true);}
+    res=calc_corrsubvev_from_samplings(obskey,samp_ptr);
     if (res!=0){return *res;}}
  try{
     void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&)
@@ -562,11 +741,15 @@ double MCObsHandler::get_a_sampling_value(const MCObsInfo& obskey,
                         std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
                         SamplingMode mode, uint sampindex)
 {
- const RVector& samps=get_full_and_sampling_values(obskey,m_curr_samples,m_curr_sampling_mode,true);
- if (std::isnan(samps[sampindex]))
+ double value;
+ if (read_resident_sampling(obskey,samp_ptr,sampindex,value)) return value;
+ const RVector& samps=get_full_and_sampling_values(obskey,samp_ptr,mode,true);
+ {std::shared_lock<std::shared_mutex> slock(m_store_mutex);
+  value=samps[sampindex];}
+ if (std::isnan(value))
     throw(std::runtime_error(string("getSampling failed for ")+obskey.str()+string(" for index = ")
           +make_string(sampindex)));
- return samps[sampindex];
+ return value;
 }
 
 
@@ -574,12 +757,21 @@ const RVector* MCObsHandler::get_full_and_sampling_values_maybe(const MCObsInfo&
                       map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
                       SamplingMode mode)
 {
- map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
- if (dt!=samp_ptr->end()){
-    return &((dt->second).first);}
+ const RVector* res=find_resident_samplings(obskey,samp_ptr,true);
+ if (res!=0) return res;
+ HandlerLock lock(*this);
+ int store=store_index(samp_ptr);
+ do{
+    map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+    if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+    if (dt!=samp_ptr->end()){
+       touch(store,obskey);
+       return &((dt->second).first);}}
+ while (wait_for_fill(store,obskey));
  if (!obskey.hasNoRelatedFlip()){
     MCObsInfo tkey(obskey.getTimeFlipped());
     map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(tkey);
+    if ((dt==samp_ptr->end())&&(restore_spilled(store,tkey))) dt=samp_ptr->find(tkey);
     if (dt!=samp_ptr->end()){
        RVector samples(dt->second.first);
        if (obskey.isImaginaryPart()){
@@ -588,8 +780,8 @@ const RVector* MCObsHandler::get_full_and_sampling_values_maybe(const MCObsInfo&
  if (mode==m_in_handler.getDefaultSamplingMode()){
     RVector samples;
     if (m_in_handler.getSamplingsMaybe(obskey,samples)){
-       return &(put_samplings_in_memory(obskey,samples,samp_ptr));}
-    const RVector* res=calc_corrsubvev_from_samplings(obskey,samp_ptr);
+       return &(put_samplings_in_memory(obskey,samples,samp_ptr,true));}
+    res=calc_corrsubvev_from_samplings(obskey,samp_ptr);
     if (res!=0) return res;}
  try{
     void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&)
@@ -605,34 +797,65 @@ bool MCObsHandler::get_a_sampling_value_maybe(const MCObsInfo& obskey,
                         std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
                         SamplingMode mode, uint sampindex, double& result)
 {
+ if (read_resident_sampling(obskey,samp_ptr,sampindex,result)) return true;
  result=0.0;
- const RVector* samps=get_full_and_sampling_values_maybe(obskey,m_curr_samples,m_curr_sampling_mode);
+ const RVector* samps=get_full_and_sampling_values_maybe(obskey,samp_ptr,mode);
  if (samps==0) return false;
- if (std::isnan((*samps)[sampindex])) return false;
- result=(*samps)[sampindex];
+ double value;
+ {std::shared_lock<std::shared_mutex> slock(m_store_mutex);
+  value=(*samps)[sampindex];}
+ if (std::isnan(value)) return false;
+ result=value;
  return true;
 }
 
 
 const RVector& MCObsHandler::put_samplings_in_memory(const MCObsInfo& obskey,
                       const RVector& samplings,
-                      map<MCObsInfo,pair<RVector,uint> > *samp_ptr)
+                      map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
+                      bool reloadable)
 {
- samp_ptr->erase(obskey);
+ int store=store_index(samp_ptr);
+ map<MCObsInfo,pair<RVector,uint> >::iterator dt=samp_ptr->find(obskey);
+ m_spilled[store].erase(obskey);
+ if (dt!=samp_ptr->end()){      // replace in place (see "find_resident_bins")
+    note_erase(store,obskey,dt->second.first.size());
+    {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+     dt->second.first=samplings;
+     dt->second.second=samplings.size();}
+    note_insert(store,obskey,samplings.size(),reloadable);
+    return (dt->second).first;}
  pair<map<MCObsInfo,pair<RVector,uint> >::iterator,bool> ret;
- ret=samp_ptr->insert(make_pair(obskey,make_pair(samplings,samplings.size())));
+ {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+  ret=samp_ptr->insert(make_pair(obskey,make_pair(samplings,samplings.size())));}
  if (ret.second==false){
     throw(std::runtime_error("put samplings into memory failed"));}
+ note_insert(store,obskey,samplings.size(),reloadable);
  return ((ret.first)->second).first;
 }
 
 
+    //  As above, but complete samplings already in memory are kept.  Used
+    //  for samplings derived along the way, which other threads may be
+    //  reading without a lock, so that they are not rewritten.
+
+const RVector& MCObsHandler::add_samplings_to_memory(const MCObsInfo& obskey,
+                      const RVector& samplings,
+                      map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
+                      bool reloadable)
+{
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if ((dt!=samp_ptr->end())&&((dt->second).second==(dt->second).first.size())
+     &&((dt->second).first.size()==samplings.size()))
+    return (dt->second).first;
+ return put_samplings_in_memory(obskey,samplings,samp_ptr,reloadable);
+}
+
+
 const RVector& MCObsHandler::getFullAndSamplingValues(const MCObsInfo& obskey, 
                                                       SamplingMode mode)
 {
- map<MCObsInfo,pair<RVector,uint> > *samp_ptr
-     =(mode==Jackknife) ? &m_jacksamples : &m_bootsamples;
- return get_full_and_sampling_values(obskey,samp_ptr,mode);
+ return get_full_and_sampling_values(obskey,samplings_map(mode),mode);
 }
 
 
@@ -645,35 +868,83 @@ void MCObsHandler::getFullAndSamplingValues(const MCObsInfo& obskey,
 
 double MCObsHandler::getFullSampleValue(const MCObsInfo& obskey)
 {
- return get_a_sampling_value(obskey,m_curr_samples,m_curr_sampling_mode,0);
+ const SamplingState& cs=curr_state();
+ return get_a_sampling_value(obskey,cs.m_curr_samples,cs.m_curr_sampling_mode,0);
 }
 
 
 double MCObsHandler::getFullSampleValue(const MCObsInfo& obskey, SamplingMode mode)
 {
- map<MCObsInfo,pair<RVector,uint> > *samp_ptr
-     =(mode==Jackknife) ? &m_jacksamples : &m_bootsamples;
- return get_a_sampling_value(obskey,samp_ptr,mode,0);
+ return get_a_sampling_value(obskey,samplings_map(mode),mode,0);
 }
 
 
 double MCObsHandler::getCurrentSamplingValue(const MCObsInfo& obskey)
 {
- return get_a_sampling_value(obskey,m_curr_samples,m_curr_sampling_mode,m_curr_sampling_index);
+ const SamplingState& cs=curr_state();
+ return get_a_sampling_value(obskey,cs.m_curr_samples,cs.m_curr_sampling_mode,cs.m_curr_sampling_index);
 }
 
 
 bool MCObsHandler::getCurrentSamplingValueMaybe(const MCObsInfo& obskey, double& result)
 {
- return get_a_sampling_value_maybe(obskey,m_curr_samples,m_curr_sampling_mode,m_curr_sampling_index,result);
+ const SamplingState& cs=curr_state();
+ return get_a_sampling_value_maybe(obskey,cs.m_curr_samples,cs.m_curr_sampling_mode,cs.m_curr_sampling_index,result);
 }
 
 
 void MCObsHandler::putCurrentSamplingValue(const MCObsInfo& obskey, 
                                            double value, bool overwrite)
 {
- put_a_sampling_in_memory(obskey,m_curr_sampling_index,value,overwrite, 
-                          m_curr_sampling_max,m_curr_samples);
+ const SamplingState& cs=curr_state();
+ put_a_sampling_in_memory(obskey,cs.m_curr_sampling_index,value,overwrite, 
+                          cs.m_curr_sampling_max,cs.m_curr_samples);
+}
+
+
+double MCObsHandler::getSamplingValue(const MCObsInfo& obskey, SamplingMode mode,
+                                      uint sampindex)
+{
+ if (sampindex>sampling_max(mode))
+    throw(std::invalid_argument("Invalid sampling index in getSamplingValue"));
+ return get_a_sampling_value(obskey,samplings_map(mode),mode,sampindex);
+}
+
+
+bool MCObsHandler::getSamplingValueMaybe(const MCObsInfo& obskey, SamplingMode mode,
+                                         uint sampindex, double& result)
+{
+ if (sampindex>sampling_max(mode)){
+    result=0.0; return false;}
+ return get_a_sampling_value_maybe(obskey,samplings_map(mode),mode,sampindex,result);
+}
+
+
+void MCObsHandler::putSamplingValue(const MCObsInfo& obskey, SamplingMode mode,
+                                    uint sampindex, double value, bool overwrite)
+{
+ put_a_sampling_in_memory(obskey,sampindex,value,overwrite,sampling_max(mode),
+                          samplings_map(mode));
+}
+
+
+    //  Samplings that are NaN (the result of an invalid operation) are
+    //  put one at a time so that the observable is left incomplete, just
+    //  as "putSamplingValue" would leave it.
+
+void MCObsHandler::putFullAndSamplingValues(const MCObsInfo& obskey, const RVector& samples,
+                                            SamplingMode mode)
+{
+ uint sampmax=sampling_max(mode);
+ if (samples.size()!=sampmax+1)
+    throw(std::invalid_argument("Invalid Vector size in putFullAndSamplingValues"));
+ HandlerLock lock(*this);
+ for (uint k=0;k<=sampmax;++k){
+    if (std::isnan(samples[k])){
+       for (k=0;k<=sampmax;++k)
+          put_a_sampling_in_memory(obskey,k,samples[k],true,sampmax,samplings_map(mode));
+       return;}}
+ put_samplings_in_memory(obskey,samples,samplings_map(mode));
 }
 
 
@@ -682,20 +953,33 @@ void MCObsHandler::put_a_sampling_in_memory(
                         double value, bool overwrite, uint sampling_max,
                         std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr)
 {
+ HandlerLock lock(*this);
  if (sampling_index>sampling_max)
     throw(std::invalid_argument("invalid index in put_a_sampling_in_memory"));
+ int store=store_index(samp_ptr);
  map<MCObsInfo,pair<RVector,uint> >::iterator dt=samp_ptr->find(obskey);
+ if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+ m_spilled[store].erase(obskey);
  if (dt!=samp_ptr->end()){
+    if (m_memory_limit>0.0){
+       Residency& res=m_residency[store][obskey];
+       res.m_last_use=++m_use_count; res.m_reloadable=false;}
+    std::unique_lock<std::shared_mutex> slock(m_store_mutex);
     double& entry=(dt->second.first)[sampling_index];
     if (std::isnan(entry)){
        entry=value; (dt->second.second)++;}
     else if (overwrite){
        entry=value;}
     else{
-       throw(std::invalid_argument("cannot putCurrentSamplingValue since no overwrite"));}}
+       throw(std::invalid_argument("cannot putCurrentSamplingValue since no overwrite"));}
+    return;}
  RVector buffer(sampling_max+1,std::numeric_limits<double>::quiet_NaN());
  buffer[sampling_index]=value;
- samp_ptr->insert(make_pair(obskey,make_pair(buffer,1)));
+ bool inserted;
+ {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+  inserted=samp_ptr->insert(make_pair(obskey,make_pair(buffer,1))).second;}
+ if (inserted)
+    note_insert(store,obskey,buffer.size(),false);
 }
 
 
@@ -732,6 +1016,7 @@ void MCObsHandler::calc_simple_boot_samples(const RVector& bins, RVector& sampli
  uint nbins=Bptr->getNumberOfObjects();
  if (nbins!=bins.size())
     throw(std::runtime_error("Mismatch in number of bins in bootstrapper"));
+ bool precomp=Bptr->isPrecomputeMode();    // const access, safe without "m_mutex"
  samplings.resize(nsamps+1);   // 0 = full, 1..nsamps are the bootstrap samplings
  if (!m_is_weighted){
    double dm=0.0;
@@ -739,7 +1024,8 @@ void MCObsHandler::calc_simple_boot_samples(const RVector& bins, RVector& sampli
       dm+=bins[k];
    samplings[0]=dm/double(nbins);
    for (uint bootindex=0;bootindex<nsamps;bootindex++){
-      const Vector<uint>& indmap=Bptr->getResampling(bootindex);
+      const Vector<uint>& indmap=(precomp) ? Bptr->getPrecomputedResampling(bootindex)
+                                           : Bptr->getResampling(bootindex);
       dm=0.0;
       for (uint k=0;k<nbins;k++) 
          dm+=bins[indmap[k]];
@@ -753,7 +1039,8 @@ void MCObsHandler::calc_simple_boot_samples(const RVector& bins, RVector& sampli
       den+=wts[k];}
    samplings[0]=dm/den;
    for (uint bootindex=0;bootindex<nsamps;bootindex++){
-      const Vector<uint>& indmap=Bptr->getResampling(bootindex);
+      const Vector<uint>& indmap=(precomp) ? Bptr->getPrecomputedResampling(bootindex)
+                                           : Bptr->getResampling(bootindex);
       dm=den=0.0;
       for (uint k=0;k<nbins;k++){
          uint kk=indmap[k];
@@ -800,6 +1087,20 @@ void MCObsHandler::calc_corr_subvev(const RVector& corr_samples, const RVector&
 #endif
 
 
+    //  Resamples the bins of a simple observable, using the samplings
+    //  cache if one has been set.
+
+void MCObsHandler::calc_simple_samplings(const MCObsInfo& obskey, const RVector& bins,
+                      RVector& samplings, map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
+                      void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&))
+{
+ SamplingMode mode=(samp_ptr==&m_jacksamples)?Jackknife:Bootstrap;
+ if ((m_cache)&&(m_cache->get(obskey,mode,bins,samplings))) return;
+ (this->*simpcalc_ptr)(bins,samplings);
+ if (m_cache) m_cache->put(obskey,mode,bins,samplings);
+}
+
+
 const RVector& MCObsHandler::calc_samplings_from_bins(const MCObsInfo& obskey,
                       map<MCObsInfo,pair<RVector,uint> > *samp_ptr,
                       void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&))
@@ -807,8 +1108,30 @@ const RVector& MCObsHandler::calc_samplings_from_bins(const MCObsInfo& obskey,
  if (obskey.isSimple()){
     const RVector& bins=getBins(obskey);
     RVector samplings;
-    (this->*simpcalc_ptr)(bins,samplings);
-    return put_samplings_in_memory(obskey,samplings,samp_ptr);}
+    SamplingMode mode=(samp_ptr==&m_jacksamples)?Jackknife:Bootstrap;
+    if ((m_cache)&&(m_cache->get(obskey,mode,bins,samplings)))
+       return put_samplings_in_memory(obskey,samplings,samp_ptr,true);
+    if ((t_lock_depth==1)&&(m_memory_limit<=0.0)
+        &&((mode==Jackknife)||((Bptr!=0)&&(Bptr->isPrecomputeMode())))){
+       int store=store_index(samp_ptr);
+       m_filling[store].insert(obskey);
+       --t_lock_depth; m_mutex.unlock();
+       string errmsg;
+       try{
+          (this->*simpcalc_ptr)(bins,samplings);}
+       catch(const std::exception& xp){
+          errmsg=xp.what(); if (errmsg.empty()) errmsg="resampling failed";}
+       m_mutex.lock(); ++t_lock_depth;
+       m_filling[store].erase(obskey);
+       m_fill_cv.notify_all();
+       if (!errmsg.empty()) throw(std::runtime_error(errmsg));
+       map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+       if ((dt!=samp_ptr->end())&&((dt->second).second==(dt->second).first.size()))
+          return (dt->second).first;}     // put by another thread in the meantime
+    else
+       (this->*simpcalc_ptr)(bins,samplings);
+    if (m_cache) m_cache->put(obskey,mode,bins,samplings);
+    return put_samplings_in_memory(obskey,samplings,samp_ptr,true);}
  else if (obskey.isCorrelatorAtTime()){   // since nonsimple, must have vev subtraction
     bool realpart=obskey.isRealPart();
 #ifdef REALNUMBERS
@@ -821,17 +1144,17 @@ const RVector& MCObsHandler::calc_samplings_from_bins(const MCObsInfo& obskey,
     MCObsInfo corr_re_info(snk,src,tval,herm,RealPart,false);   // no vev subtraction
     const RVector& corr_re_bins=getBins(corr_re_info);
     RVector corr_re_samplings;
-    (this->*simpcalc_ptr)(corr_re_bins,corr_re_samplings);
-    put_samplings_in_memory(corr_re_info,corr_re_samplings,samp_ptr);
+    calc_simple_samplings(corr_re_info,corr_re_bins,corr_re_samplings,samp_ptr,simpcalc_ptr);
+    add_samplings_to_memory(corr_re_info,corr_re_samplings,samp_ptr,true);
     MCObsInfo src_re_info(src,RealPart);
     MCObsInfo snk_re_info(snk,RealPart);
     const RVector& src_re_bins=getBins(src_re_info);
     const RVector& snk_re_bins=getBins(snk_re_info);
     RVector src_re_samplings, snk_re_samplings;
-    (this->*simpcalc_ptr)(src_re_bins,src_re_samplings);
-    (this->*simpcalc_ptr)(snk_re_bins,snk_re_samplings);
-    put_samplings_in_memory(src_re_info,src_re_samplings,samp_ptr);
-    put_samplings_in_memory(snk_re_info,snk_re_samplings,samp_ptr);
+    calc_simple_samplings(src_re_info,src_re_bins,src_re_samplings,samp_ptr,simpcalc_ptr);
+    calc_simple_samplings(snk_re_info,snk_re_bins,snk_re_samplings,samp_ptr,simpcalc_ptr);
+    add_samplings_to_memory(src_re_info,src_re_samplings,samp_ptr,true);
+    add_samplings_to_memory(snk_re_info,snk_re_samplings,samp_ptr,true);
     RVector corrsubvev_re_samplings;
     const RVector *ci=0;
     const RVector *cr=0;
@@ -839,29 +1162,29 @@ const RVector& MCObsHandler::calc_samplings_from_bins(const MCObsInfo& obskey,
     MCObsInfo corr_im_info(snk,src,tval,herm,ImaginaryPart,false);   // no vev subtraction
     const RVector& corr_im_bins=getBins(corr_im_info);
     RVector corr_im_samplings;
-    (this->*simpcalc_ptr)(corr_im_bins,corr_im_samplings);
-    put_samplings_in_memory(corr_im_info,corr_im_samplings,samp_ptr);
+    calc_simple_samplings(corr_im_info,corr_im_bins,corr_im_samplings,samp_ptr,simpcalc_ptr);
+    add_samplings_to_memory(corr_im_info,corr_im_samplings,samp_ptr,true);
     MCObsInfo src_im_info(src,ImaginaryPart);
     MCObsInfo snk_im_info(snk,ImaginaryPart);
     const RVector& src_im_bins=getBins(src_im_info);
     const RVector& snk_im_bins=getBins(snk_im_info);
     RVector src_im_samplings, snk_im_samplings;
-    (this->*simpcalc_ptr)(src_im_bins,src_im_samplings);
-    (this->*simpcalc_ptr)(snk_im_bins,snk_im_samplings);
-    put_samplings_in_memory(src_im_info,src_im_samplings,samp_ptr);
-    put_samplings_in_memory(snk_im_info,snk_im_samplings,samp_ptr);
+    calc_simple_samplings(src_im_info,src_im_bins,src_im_samplings,samp_ptr,simpcalc_ptr);
+    calc_simple_samplings(snk_im_info,snk_im_bins,snk_im_samplings,samp_ptr,simpcalc_ptr);
+    add_samplings_to_memory(src_im_info,src_im_samplings,samp_ptr,true);
+    add_samplings_to_memory(snk_im_info,snk_im_samplings,samp_ptr,true);
     RVector corrsubvev_im_samplings;
     calc_corr_subvev(corr_re_samplings,corr_im_samplings,snk_re_samplings,
                      snk_im_samplings,src_re_samplings,src_im_samplings,
                      corrsubvev_re_samplings,corrsubvev_im_samplings);
     MCObsInfo corrsubvev_im_info(snk,src,tval,herm,ImaginaryPart,true);   // no vev subtraction
-    ci=&put_samplings_in_memory(corrsubvev_im_info,corrsubvev_im_samplings,samp_ptr);
+    ci=&add_samplings_to_memory(corrsubvev_im_info,corrsubvev_im_samplings,samp_ptr,true);
 #else
     calc_corr_subvev(corr_re_samplings,snk_re_samplings,src_re_samplings, 
                      corrsubvev_re_samplings);
 #endif
     MCObsInfo corrsubvev_re_info(snk,src,tval,herm,RealPart,true);   // no vev subtraction
-    cr=&put_samplings_in_memory(corrsubvev_re_info,corrsubvev_re_samplings,samp_ptr);
+    cr=&add_samplings_to_memory(corrsubvev_re_info,corrsubvev_re_samplings,samp_ptr,true);
     return (realpart) ? *cr : *ci;}
  else
     throw(std::invalid_argument("Unable to get all samplings in MCObsHandler"));
@@ -885,14 +1208,14 @@ const RVector* MCObsHandler::calc_corrsubvev_from_samplings(const MCObsInfo& obs
  MCObsInfo corr_re_info(snk,src,tval,herm,RealPart,false);   // no vev subtraction
  RVector corr_re_samplings;
  m_in_handler.getSamplings(corr_re_info,corr_re_samplings);
- put_samplings_in_memory(corr_re_info,corr_re_samplings,samp_ptr);
+ add_samplings_to_memory(corr_re_info,corr_re_samplings,samp_ptr,true);
  MCObsInfo src_re_info(src,RealPart);
  MCObsInfo snk_re_info(snk,RealPart);
  RVector src_re_samplings, snk_re_samplings;
  m_in_handler.getSamplings(src_re_info,src_re_samplings);
  m_in_handler.getSamplings(snk_re_info,snk_re_samplings);
- put_samplings_in_memory(src_re_info,src_re_samplings,samp_ptr);
- put_samplings_in_memory(snk_re_info,snk_re_samplings,samp_ptr);
+ add_samplings_to_memory(src_re_info,src_re_samplings,samp_ptr,true);
+ add_samplings_to_memory(snk_re_info,snk_re_samplings,samp_ptr,true);
  RVector corrsubvev_re_samplings;
  const RVector *ci=0;
  const RVector *cr=0;
@@ -900,26 +1223,26 @@ const RVector* MCObsHandler::calc_corrsubvev_from_samplings(const MCObsInfo& obs
  MCObsInfo corr_im_info(snk,src,tval,herm,ImaginaryPart,false);   // no vev subtraction
  RVector corr_im_samplings;
  m_in_handler.getSamplings(corr_im_info,corr_im_samplings);
- put_samplings_in_memory(corr_im_info,corr_im_samplings,samp_ptr);
+ add_samplings_to_memory(corr_im_info,corr_im_samplings,samp_ptr,true);
  MCObsInfo src_im_info(src,ImaginaryPart);
  MCObsInfo snk_im_info(snk,ImaginaryPart);
  RVector src_im_samplings, snk_im_samplings;
  m_in_handler.getSamplings(src_im_info,src_im_samplings);
  m_in_handler.getSamplings(snk_im_info,snk_im_samplings);
- put_samplings_in_memory(src_im_info,src_im_samplings,samp_ptr);
- put_samplings_in_memory(snk_im_info,snk_im_samplings,samp_ptr);
+ add_samplings_to_memory(src_im_info,src_im_samplings,samp_ptr,true);
+ add_samplings_to_memory(snk_im_info,snk_im_samplings,samp_ptr,true);
  RVector corrsubvev_im_samplings;
  calc_corr_subvev(corr_re_samplings,corr_im_samplings,snk_re_samplings,
                   snk_im_samplings,src_re_samplings,src_im_samplings,
                   corrsubvev_re_samplings,corrsubvev_im_samplings);
  MCObsInfo corrsubvev_im_info(snk,src,tval,herm,ImaginaryPart,true);   // no vev subtraction
- ci=&put_samplings_in_memory(corrsubvev_im_info,corrsubvev_im_samplings,samp_ptr);
+ ci=&add_samplings_to_memory(corrsubvev_im_info,corrsubvev_im_samplings,samp_ptr,true);
 #else
  calc_corr_subvev(corr_re_samplings,snk_re_samplings,src_re_samplings, 
                   corrsubvev_re_samplings);
 #endif
  MCObsInfo corrsubvev_re_info(snk,src,tval,herm,RealPart,true);   // no vev subtraction
- cr=&put_samplings_in_memory(corrsubvev_re_info,corrsubvev_re_samplings,samp_ptr);
+ cr=&add_samplings_to_memory(corrsubvev_re_info,corrsubvev_re_samplings,samp_ptr,true);
  return (realpart) ? cr : ci;}
  catch(const std::exception& xp){}
  return 0;
@@ -1082,6 +1405,133 @@ MCEstimate MCObsHandler::getBootstrapEstimate(const MCObsInfo& obskey)
 // **********************************************************************
 
 
+MCEstimate MCObsHandler::getUnstoredEstimate(const MCObsInfo& obskey, SamplingMode inmode)
+{
+ MCEstimate result(inmode);
+ RVector sampvals;
+ const RVector* samps=find_unstored_samplings(obskey,inmode,sampvals);
+ if (samps==0){
+    calc_unstored_from_bins(obskey,inmode,sampvals,(inmode==Jackknife) ? &result : 0);
+    if (inmode==Jackknife) return result;}
+ else if (inmode==Jackknife){
+    jack_analyze(*samps,result);
+    return result;}
+ else if (samps!=&sampvals){
+    sampvals=*samps;}      // sampvals will be sorted
+ boot_analyze(sampvals,result);
+ return result;
+}
+
+
+MCEstimate MCObsHandler::getUnstoredEstimate(const MCObsInfo& obskey)
+{
+ return getUnstoredEstimate(obskey,getCurrentSamplingMode());
+}
+
+
+const RVector& MCObsHandler::getUnstoredFullAndSamplingValues(const MCObsInfo& obskey,
+                                    RVector& buffer, SamplingMode mode)
+{
+ const RVector* samps=find_unstored_samplings(obskey,mode,buffer);
+ if (samps!=0) return *samps;
+ calc_unstored_from_bins(obskey,mode,buffer);
+ return buffer;
+}
+
+
+MCEstimate MCObsHandler::getEstimateFromSamplings(const RVector& samplings, SamplingMode mode)
+{
+ if (samplings.size()!=sampling_max(mode)+1)
+    throw(std::invalid_argument("Invalid Vector size in getEstimateFromSamplings"));
+ MCEstimate result(mode);
+ if (mode==Jackknife){
+    jack_analyze(samplings,result);
+    return result;}
+ RVector sampvals(samplings);     // sampvals will be sorted
+ boot_analyze(sampvals,result);
+ return result;
+}
+
+
+MCEstimate MCObsHandler::getJackknifeEstimateFromBins(const RVector& bins) const
+{
+ if (bins.size()!=getNumberOfBins())
+    throw(std::invalid_argument("Invalid Vector size in getJackknifeEstimateFromBins"));
+ MCEstimate result(Jackknife);
+ jack_analyze_bins(bins,result);
+ return result;
+}
+
+
+    //  Returns the samplings of "obskey" if they are in memory, or reads
+    //  them from a samplings file into "buffer" (without putting them in
+    //  memory).  Returns null if "obskey" is simple and its samplings must
+    //  be computed from its bins.  Samplings being computed by another
+    //  thread, time-flipped samplings, and nonsimple observables are left
+    //  to "get_full_and_sampling_values", which puts the result in memory.
+
+const RVector* MCObsHandler::find_unstored_samplings(const MCObsInfo& obskey,
+                      SamplingMode mode, RVector& buffer)
+{
+ map<MCObsInfo,pair<RVector,uint> > *samp_ptr=samplings_map(mode);
+ const RVector* res=find_resident_samplings(obskey,samp_ptr,false);
+ if (res!=0) return res;
+ HandlerLock lock(*this);
+ int store=store_index(samp_ptr);
+ map<MCObsInfo,pair<RVector,uint> >::const_iterator dt=samp_ptr->find(obskey);
+ if ((dt==samp_ptr->end())&&(restore_spilled(store,obskey))) dt=samp_ptr->find(obskey);
+ bool stored=((dt!=samp_ptr->end())&&((dt->second).second==(dt->second).first.size()));
+ if ((!stored)&&(!obskey.hasNoRelatedFlip())){
+    MCObsInfo tkey(obskey.getTimeFlipped());
+    stored=((samp_ptr->count(tkey)>0)||(m_spilled[store].count(tkey)>0));}
+ if ((stored)||(!obskey.isSimple())||(m_filling[store].count(obskey)>0))
+    return &get_full_and_sampling_values(obskey,samp_ptr,mode);
+ if ((mode==m_in_handler.getDefaultSamplingMode())
+     &&(m_in_handler.getSamplingsMaybe(obskey,buffer)))
+    return &buffer;
+ return 0;
+}
+
+
+    //  Resamples the bins of simple "obskey" into "samplings" as
+    //  "calc_samplings_from_bins" does, but without putting them in memory.
+    //  If "jackest" is given (jackknife mode only), just the estimate is
+    //  computed, with no samplings at all.
+
+void MCObsHandler::calc_unstored_from_bins(const MCObsInfo& obskey, SamplingMode mode,
+                      RVector& samplings, MCEstimate *jackest)
+{
+ void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&)
+      =(mode==Jackknife) ? &MCObsHandler::calc_simple_jack_samples
+                         : &MCObsHandler::calc_simple_boot_samples;
+ try{
+    HandlerLock lock(*this);
+    const RVector& bins=getBins(obskey);
+    if ((jackest==0)&&(m_cache)&&(m_cache->get(obskey,mode,bins,samplings))) return;
+    if ((t_lock_depth==1)&&(m_memory_limit<=0.0)
+        &&((mode==Jackknife)||((Bptr!=0)&&(Bptr->isPrecomputeMode())))){
+       --t_lock_depth; m_mutex.unlock();
+       string errmsg;
+       try{
+          if (jackest!=0) jack_analyze_bins(bins,*jackest);
+          else (this->*simpcalc_ptr)(bins,samplings);}
+       catch(const std::exception& xp){
+          errmsg=xp.what(); if (errmsg.empty()) errmsg="resampling failed";}
+       m_mutex.lock(); ++t_lock_depth;
+       if (!errmsg.empty()) throw(std::runtime_error(errmsg));}
+    else if (jackest!=0)
+       jack_analyze_bins(bins,*jackest);
+    else
+       (this->*simpcalc_ptr)(bins,samplings);
+    if ((jackest==0)&&(m_cache)) m_cache->put(obskey,mode,bins,samplings);}
+ catch(std::exception& xp){
+    throw(std::runtime_error(string("getSamplings failed: ")+xp.what()));}
+}
+
+
+// **********************************************************************
+
+
 double MCObsHandler::getCovariance(const MCObsInfo& obskey1,
                                    const MCObsInfo& obskey2, SamplingMode inmode)
 {
@@ -1097,7 +1547,7 @@ double MCObsHandler::getCovariance(const MCObsInfo& obskey1,
 double MCObsHandler::getCovariance(const MCObsInfo& obskey1,     // current sampling mode
                                    const MCObsInfo& obskey2)
 {
- return getCovariance(obskey1,obskey2,m_curr_covmat_sampling_mode);
+ return getCovariance(obskey1,obskey2,curr_state().m_curr_covmat_sampling_mode);
 }
 
 
@@ -1178,6 +1628,60 @@ double MCObsHandler::getAutoCorrelation(const MCObsInfo& obskey, uint markovtime
 }
 
 
+    //  Reading is serialized by the handler lock inside "getMeasurementData",
+    //  so each thread reads the data of its next observable, then analyzes
+    //  it while the other threads read; only one data vector per thread is
+    //  held at a time.
+
+void MCObsHandler::getAutoCorrelations(const vector<MCObsInfo>& obskeys,
+                                       vector<AutoCorrelation>& results,
+                                       AutoCorrelation::Windowing windowing,
+                                       double factor, uint nkeep, uint nthreads)
+{
+ uint nobs=obskeys.size();
+ results.assign(nobs,AutoCorrelation());
+ if (nthreads==0) nthreads=thread::hardware_concurrency();
+ if (nthreads>nobs) nthreads=nobs;
+ if (nthreads==0) nthreads=1;
+ atomic<uint> next(0);
+ mutex errmutex;
+ string errmsg;
+ auto worker=[&](){
+    uint k;
+    while ((k=next++)<nobs){
+       try{
+          RVector data;
+          uint per_value=getMeasurementData(obskeys[k],data);
+          results[k]=AutoCorrelation(data,windowing,factor,nkeep,per_value);}
+       catch(const std::exception& xp){
+          lock_guard<mutex> lock(errmutex);
+          if (errmsg.empty()) errmsg=obskeys[k].str()+string(": ")+xp.what();
+          next=nobs;}}};
+ vector<thread> workers;
+ for (uint k=1;k<nthreads;k++)
+    workers.push_back(thread(worker));
+ worker();
+ for (uint k=0;k<workers.size();k++)
+    workers[k].join();
+ if (!errmsg.empty())
+    throw(std::runtime_error(string("getAutoCorrelations failed for ")+errmsg));
+}
+
+
+    //  Unbinned data from the input files when available, otherwise the
+    //  bins (which may have been put into memory).
+
+uint MCObsHandler::getMeasurementData(const MCObsInfo& obskey, RVector& data)
+{
+ assert_simple(obskey,"getMeasurementData");
+ HandlerLock lock(*this);
+ if (m_in_handler.queryBins(obskey))
+    return m_in_handler.getMeasurementData(obskey,data);
+ data=getBins(obskey);
+ return getRebinFactor();
+}
+
+
     //  compute jackknife error using samplings (sampvals[0] contains full sample)
 
 void MCObsHandler::jack_analyze(const RVector& sampvals, MCEstimate& result)
@@ -1195,6 +1699,42 @@ void MCObsHandler::jack_analyze(const RVector& sampvals, MCEstimate& result)
  result.jackassign(sampvals[0],avg,sqrt(var));
 }
 
+    //  same result as "jack_analyze" on the samplings from
+    //  "calc_simple_jack_samples", but each jackknife sampling is
+    //  formed from the bins when needed instead of being stored
+
+void MCObsHandler::jack_analyze_bins(const RVector& bins, MCEstimate& result) const
+{
+ uint n=bins.size();
+ double full,dm=0.0,avg=0.0,var=0.0;
+ if (!m_is_weighted){
+    for (uint k=0;k<n;k++)
+       dm+=bins[k];
+    full=dm/double(n);
+    double rj=1.0/double(n-1);
+    for (uint k=0;k<n;k++)
+       avg+=(dm-bins[k])*rj;
+    avg/=double(n);
+    for (uint k=0;k<n;k++){
+       double x=(dm-bins[k])*rj-avg;
+       var+=x*x;}}
+ else{
+    const vector<double>& wts=m_in_handler.getWeights();
+    double den=0.0;
+    for (uint k=0;k<n;k++){
+       dm+=wts[k]*bins[k];
+       den+=wts[k];}
+    full=dm/den;
+    for (uint k=0;k<n;k++)
+       avg+=(dm-wts[k]*bins[k])/(den-wts[k]);
+    avg/=double(n);
+    for (uint k=0;k<n;k++){
+       double x=(dm-wts[k]*bins[k])/(den-wts[k])-avg;
+       var+=x*x;}}
+ var*=(1.0-1.0/double(n));  // jackknife
+ result.jackassign(full,avg,sqrt(var));
+}
+
     //  compute jackknife covariance using samplings 
     //  (sampvals1[0], sampvals2[0] contain full samples)
 
@@ -1277,6 +1817,312 @@ void MCObsHandler::boot_analyze(RVector& sampvals, MCEstimate& result)
  result.bootassign(sampvals[0],avg,sqrt(var),low,med,upp);
 }
 
+// *************************************************************
+
+    //  Gives the calling thread a private copy of the sampling state
+    //  of the thread that created this handler, with the sampling index
+    //  reset to the full sample.
+
+void MCObsHandler::attachThread()
+{
+ if (t_attached==this) return;
+ if (t_attached!=0)
+    throw(std::runtime_error("Thread already attached to another MCObsHandler"));
+ HandlerLock lock(*this);
+ t_state=new SamplingState(m_main_state);
+ t_state->m_curr_sampling_index=0;
+ t_attached=this;
+}
+
+
+void MCObsHandler::detachThread()
+{
+ if (t_attached!=this) return;
+ delete t_state;
+ t_state=0;
+ t_attached=0;
+}
+
+
+// *************************************************************
+
+    //  Memory budget: "m_memory_used" is always kept up to date, but the
+    //  residency records needed for eviction are kept only if a limit is set.
+
+static double entry_bytes(uint nvalues)
+{
+ return double(nvalues)*sizeof(double)+160.0;   // estimate of key and map node overhead
+}
+
+
+void MCObsHandler::setMemoryLimit(double gigabytes, const string& spill_stub)
+{
+ HandlerLock lock(*this);
+ if (gigabytes<0.0)
+    throw(std::invalid_argument("Memory limit must be nonnegative"));
+ m_memory_limit=gigabytes*1024.0*1024.0*1024.0;
+ if (m_spill_stub.empty()){
+    m_spill_stub=tidyString(spill_stub);
+    if (m_spill_stub.empty()) m_spill_stub="sigmond_spill";
+    m_spill_stub+="_"+make_string(int(getpid()))+"_";}
+ for (int store=0;store<3;++store) m_residency[store].clear();
+ if (m_memory_limit<=0.0) return;
+ Residency res; res.m_last_use=0; res.m_reloadable=false;
+ for (map<MCObsInfo,RVector>::const_iterator it=m_obs_simple.begin();it!=m_obs_simple.end();++it)
+    m_residency[0].insert(make_pair(it->first,res));
+ for (int store=1;store<3;++store){
+    const map<MCObsInfo,pair<RVector,uint> >& samps=(store==1)?m_jacksamples:m_bootsamples;
+    for (map<MCObsInfo,pair<RVector,uint> >::const_iterator it=samps.begin();it!=samps.end();++it)
+       m_residency[store].insert(make_pair(it->first,res));}
+}
+
+
+double MCObsHandler::getMemoryLimit() const
+{
+ return m_memory_limit/(1024.0*1024.0*1024.0);
+}
+
+
+void MCObsHandler::beginTask()
+{
+ HandlerLock lock(*this);
+ m_task_start=m_use_count;
+ m_ndropped=m_nspilled=m_nrestored=0;
+ if (m_cache) m_cache->flush();
+ if ((m_memory_limit>0.0)&&(m_memory_used>m_memory_limit)) evict();
+ m_memory_peak=m_memory_used;
+}
+
+
+void MCObsHandler::setSamplingsCache(const string& dirname)
+{
+ HandlerLock lock(*this);
+ SamplingsCache *cache=new SamplingsCache(dirname,m_in_handler.getBinsInfo(),
+                                          m_in_handler.getSamplingInfo());
+ delete m_cache;
+ m_cache=cache;
+}
+
+
+void MCObsHandler::getSamplingsCacheInfo(XMLHandler& xmlout) const
+{
+ HandlerLock lock(*this);
+ xmlout.set_root("SamplingsCache");
+ if (m_cache==0) return;
+ xmlout.put_child("Directory",m_cache->getDirectory());
+ xmlout.put_child("NumberOfHits",make_string(m_cache->getNumberOfHits()));
+ xmlout.put_child("NumberStored",make_string(m_cache->getNumberStored()));
+}
+
+
+    //  Called in a child process created by "fork".  The samplings cache
+    //  and its open files belong to the parent, so the child simply stops
+    //  using it (deleting it would flush the parent's files).
+
+void MCObsHandler::beginShard(uint shard)
+{
+ HandlerLock lock(*this);
+ for (int store=0;store<3;++store)
+    if (m_spill_map[store]!=0)
+       throw(std::runtime_error("Cannot begin a shard after data has been spilled to disk"));
+ m_in_handler.reopen();
+ m_cache=0;
+ m_spill_stub+="shard"+make_string(shard)+"_";
+ m_shard=shard;
+ m_shard_files.clear();
+ m_shard_paths.clear();
+}
+
+
+void MCObsHandler::getShardSamplingFiles(XMLHandler& xmlout) const
+{
+ HandlerLock lock(*this);
+ xmlout.set_root("ShardSamplingFiles");
+ for (map<string,ShardFile>::const_iterator it=m_shard_files.begin();it!=m_shard_files.end();++it){
+    XMLHandler xmlf("File");
+    xmlf.put_child("FileName",it->first);
+    xmlf.put_child("ShardFileName",it->second.m_shard_name);
+    xmlf.put_child("WriteMode",(it->second.m_wmode==Overwrite)?"overwrite"
+                   :((it->second.m_wmode==Update)?"update":"protect"));
+    xmlf.put_child("FileFormat",string(1,it->second.m_file_format));
+    xmlout.put_child(xmlf);}
+}
+
+
+void MCObsHandler::setBatchedOutput(bool batch)
+{
+ HandlerLock lock(*this);
+ m_batch_output=batch;
+ if (!batch){
+    list<string> errors;
+    m_writer.flush(errors);}
+}
+
+
+void MCObsHandler::flushOutputFiles(list<string>& errors)
+{
+ HandlerLock lock(*this);
+ m_writer.flush(errors);
+}
+
+
+void MCObsHandler::flushThreadOutputFiles(list<string>& errors)
+{
+ HandlerLock lock(*this);
+ m_writer.flushThread(errors);
+}
+
+
+    //  Used by the write routines when output is not batched: the file is
+    //  complete when the routine returns, as for a put handler.  Files
+    //  being written by other threads are left open.
+
+void MCObsHandler::flush_output(XMLHandler& xmlout)
+{
+ list<string> errors;
+ m_writer.flushThread(errors);
+ for (list<string>::const_iterator it=errors.begin();it!=errors.end();++it)
+    xmlout.put_child("Error",*it);
+}
+
+
+    //  Name of the file written by this shard in place of "filename".  A
+    //  shard file left over from an earlier run is removed the first time
+    //  it is used.
+
+string MCObsHandler::shard_file_name(const string& filename, WriteMode wmode,
+                                     char file_format)
+{
+ size_t pos=filename.find('[');
+ string path=filename.substr(0,pos);
+ string group=(pos==string::npos) ? string() : filename.substr(pos);
+ string spath=path+".shard"+make_string(m_shard);
+ if (m_shard_paths.insert(spath).second)
+    std::remove(spath.c_str());
+ string sname=spath+group;
+ if (m_shard_files.find(filename)==m_shard_files.end()){
+    ShardFile sf; sf.m_shard_name=sname; sf.m_wmode=wmode; sf.m_file_format=file_format;
+    m_shard_files.insert(make_pair(filename,sf));}
+ return sname;
+}
+
+
+void MCObsHandler::getResidencyInfo(XMLHandler& xmlout) const
+{
+ HandlerLock lock(*this);
+ const double gb=1024.0*1024.0*1024.0;
+ xmlout.set_root("MemoryResidency");
+ xmlout.put_child("MemoryLimitGB",make_string(m_memory_limit/gb));
+ xmlout.put_child("InMemoryGB",make_string(m_memory_used/gb));
+ xmlout.put_child("PeakInMemoryGB",make_string(m_memory_peak/gb));
+ xmlout.put_child("BinsInMemory",make_string(uint(m_obs_simple.size())));
+ xmlout.put_child("SamplingsInMemory",make_string(uint(m_jacksamples.size()+m_bootsamples.size())));
+ xmlout.put_child("Spilled",make_string(uint(m_spilled[0].size()+m_spilled[1].size()+m_spilled[2].size())));
+ xmlout.put_child("NumberDropped",make_string(m_ndropped));
+ xmlout.put_child("NumberSpilled",make_string(m_nspilled));
+ xmlout.put_child("NumberRestored",make_string(m_nrestored));
+}
+
+
+void MCObsHandler::note_insert(int store, const MCObsInfo& obskey, uint nvalues, bool reloadable)
+{
+ m_memory_used+=entry_bytes(nvalues);
+ if (m_memory_used>m_memory_peak) m_memory_peak=m_memory_used;
+ if (m_memory_limit<=0.0) return;
+ Residency& res=m_residency[store][obskey];
+ res.m_last_use=++m_use_count;
+ res.m_reloadable=reloadable;
+ if (m_memory_used>m_memory_limit) evict();
+}
+
+
+void MCObsHandler::note_erase(int store, const MCObsInfo& obskey, uint nvalues)
+{
+ m_memory_used-=entry_bytes(nvalues);
+ if (m_memory_used<0.0) m_memory_used=0.0;
+ m_residency[store].erase(obskey);
+}
+
+
+    //  If "obskey" was spilled, read it back into memory.  The copy in the
+    //  spill file remains valid until the entry is changed or erased.
+
+bool MCObsHandler::restore_spilled(int store, const MCObsInfo& obskey)
+{
+ if (m_spilled[store].count(obskey)==0) return false;
+ vector<double> buffer;
+ try{
+    m_spill_map[store]->get(obskey,buffer);}
+ catch(const std::exception& xp){
+    throw(std::runtime_error(string("Could not read spilled data for ")+obskey.str()
+          +string(": ")+xp.what()));}
+ RVector values(buffer);
+ uint count=0;
+ for (uint k=0;k<values.size();++k)
+    if (!std::isnan(values[k])) ++count;
+ {std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+  if (store==0)
+     m_obs_simple.insert(make_pair(obskey,values));
+  else{
+     map<MCObsInfo,pair<RVector,uint> >& samps=(store==1)?m_jacksamples:m_bootsamples;
+     samps.insert(make_pair(obskey,make_pair(values,count)));}}
+ ++m_nrestored;
+ note_insert(store,obskey,values.size(),true);
+ return true;
+}
+
+
+    //  Removes entries not accessed since "beginTask" until memory use is
+    //  below 90% of the limit (so that eviction is not triggered by every
+    //  insertion): entries that can be dropped go first, then entries that
+    //  must be written to the spill files, least recently used first.
+
+void MCObsHandler::evict()
+{
+ vector<pair<pair<bool,unsigned long>,pair<int,MCObsInfo> > > candidates;
+ for (int store=0;store<3;++store)
+    for (map<MCObsInfo,Residency>::const_iterator it=m_residency[store].begin();
+         it!=m_residency[store].end();++it){
+       if (it->second.m_last_use>m_task_start) continue;
+       bool spill=!(it->second.m_reloadable);
+       candidates.push_back(make_pair(make_pair(spill,it->second.m_last_use),
+                                      make_pair(store,it->first)));}
+ std::sort(candidates.begin(),candidates.end());
+
+ double target=0.9*m_memory_limit;
+ for (uint k=0;(k<candidates.size())&&(m_memory_used>target);++k){
+    bool spill=candidates[k].first.first;
+    int store=candidates[k].second.first;
+    const MCObsInfo& obskey=candidates[k].second.second;
+    const RVector* values=0;
+    map<MCObsInfo,pair<RVector,uint> >& samps=(store==1)?m_jacksamples:m_bootsamples;
+    map<MCObsInfo,RVector>::iterator bt;
+    map<MCObsInfo,pair<RVector,uint> >::iterator st;
+    if (store==0){
+       bt=m_obs_simple.find(obskey);
+       if (bt!=m_obs_simple.end()) values=&(bt->second);}
+    else{
+       st=samps.find(obskey);
+       if (st!=samps.end()) values=&(st->second.first);}
+    if (values==0){
+       m_residency[store].erase(obskey); continue;}
+    if (spill){
+       if (m_spill_map[store]==0){
+          m_spill_map[store]=new IOMap<MCObsInfo,vector<double> >;
+          m_spill_map[store]->openNew(m_spill_stub+make_string(store),"Sigmond--SpillFile",
+                                      "<SigmondSpillFile/>",false,'N',false,true,'F');}
+       m_spill_map[store]->put(obskey,values->c_vector());
+       m_spilled[store].insert(obskey);
+       ++m_nspilled;}
+    else
+       ++m_ndropped;
+    note_erase(store,obskey,values->size());
+    std::unique_lock<std::shared_mutex> slock(m_store_mutex);
+    if (store==0) m_obs_simple.erase(bt);
+    else samps.erase(st);}
+}
+
+
 // *************************************************************
 
 
@@ -1285,11 +2131,13 @@ void MCObsHandler::boot_analyze(RVector& sampvals, MCEstimate& result)
 void MCObsHandler::readSamplingValuesFromFile(const string& filename, 
                                               XMLHandler& xmlout)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("ReadSamplingsFromFile");
  string fname=tidyString(filename);
  if (fname.empty()){
     xmlout.put_child("Error","Empty file name");
     return;}
+ m_writer.close(filename);
  try{
     m_in_handler.connectSamplingsFile(filename);
     xmlout.put_child("Status","Success");}
@@ -1305,11 +2153,13 @@ void MCObsHandler::readSamplingValuesFromFile(const set<MCObsInfo>& obskeys,
                                               const string& filename,
                                               XMLHandler& xmlout)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("ReadSamplingsFromFile");
  string fname=tidyString(filename);
  if (fname.empty()){
     xmlout.put_child("Error","Empty file name");
     return;}
+ m_writer.close(filename);
  try{
     m_in_handler.connectSamplingsFile(filename,obskeys);
     xmlout.put_child("Status","Success");
@@ -1332,6 +2182,7 @@ void MCObsHandler::writeSamplingValuesToFile(const set<MCObsInfo>& obskeys,
                                              XMLHandler& xmlout,
                                              WriteMode wmode, char file_format)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("WriteSamplingsToFile");
  string fname=tidyString(filename);
  if (fname.empty()){
@@ -1339,8 +2190,12 @@ void MCObsHandler::writeSamplingValuesToFile(const set<MCObsInfo>& obskeys,
     return;}
  xmlout.put_child("FileName",fname);
  try{
-    SamplingsPutHandler SP(m_in_handler.getBinsInfo(),m_in_handler.getSamplingInfo(),
-                           filename,wmode, m_in_handler.useCheckSums(),file_format);
+    string outname(filename);
+    if (m_shard>=0){
+       outname=shard_file_name(fname,wmode,file_format);
+       xmlout.put_child("ShardFileName",outname);}
+    m_writer.openSamplings(outname,m_in_handler.getBinsInfo(),m_in_handler.getSamplingInfo(),
+                           wmode,m_in_handler.useCheckSums(),file_format);
     for (set<MCObsInfo>::const_iterator it=obskeys.begin();it!=obskeys.end();it++){
        XMLHandler xmlo; it->output(xmlo);
        XMLHandler xmle("Write");
@@ -1351,13 +2206,14 @@ void MCObsHandler::writeSamplingValuesToFile(const set<MCObsInfo>& obskeys,
        try{
           const RVector& buffer=getFullAndSamplingValues(*it,
                           m_in_handler.getSamplingInfo().getSamplingMode());
-          SP.putData(*it,buffer);
+          m_writer.put(outname,*it,buffer);
           xmle.put_child("Success");}
        catch(std::exception& xp){
           xmle.put_child("Error",string(xp.what()));}}
        xmlout.put_child(xmle);}}
  catch(const std::exception& errmsg){
     xmlout.put_child("Error",string(errmsg.what()));}
+ if (!m_batch_output) flush_output(xmlout);
 }
 
 // ************************************************************************
@@ -1367,11 +2223,13 @@ void MCObsHandler::writeSamplingValuesToFile(const set<MCObsInfo>& obskeys,
 
 void MCObsHandler::readBinsFromFile(const string& filename, XMLHandler& xmlout)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("ReadBinsFromFile");
  string fname=tidyString(filename);
  if (fname.empty()){
     xmlout.put_child("Error","Empty file name");
     return;}
+ m_writer.close(filename);
  try{
     m_in_handler.connectBinsFile(filename);
     xmlout.put_child("Status","Success");}
@@ -1385,11 +2243,13 @@ void MCObsHandler::readBinsFromFile(const string& filename, XMLHandler& xmlout)
 void MCObsHandler::readBinsFromFile(const set<MCObsInfo>& obskeys, 
                                     const string& filename, XMLHandler& xmlout)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("ReadBinsFromFile");
  string fname=tidyString(filename);
  if (fname.empty()){
     xmlout.put_child("Error","Empty file name");
     return;}
+ m_writer.close(filename);
  try{
     m_in_handler.connectBinsFile(filename,obskeys);
     xmlout.put_child("Status","Success");
@@ -1409,8 +2269,10 @@ void MCObsHandler::readBinsFromFile(const set<MCObsInfo>& obskeys,
 
 void MCObsHandler::writeBinsToFile(const set<MCObsInfo>& obskeys, 
                                    const string& filename,
-                                   XMLHandler& xmlout, WriteMode wmode, char file_format)
+                                   XMLHandler& xmlout, WriteMode wmode, char file_format,
+                                   bool single_precision)
 {
+ HandlerLock lock(*this);
  xmlout.set_root("WriteBinsToFile");
  string fname=tidyString(filename);
  if (fname.empty()){
@@ -1419,8 +2281,9 @@ void MCObsHandler::writeBinsToFile(const set<MCObsInfo>& obskeys,
  xmlout.put_child("FileName",fname);
  xmlout.put_child("NumberObservablesToWrite",make_string(int(obskeys.size())));
  try{
-    BinsPutHandler BP(m_in_handler.getBinsInfo(),filename, 
-                      wmode, m_in_handler.useCheckSums(),file_format);
+    m_writer.openBins(filename,m_in_handler.getBinsInfo(),wmode,
+                      m_in_handler.useCheckSums(),file_format,single_precision);
+    if (single_precision) xmlout.put_child("SinglePrecision");
     uint success=0;
     for (set<MCObsInfo>::const_iterator it=obskeys.begin();it!=obskeys.end();it++){
        XMLHandler xmlo; it->output(xmlo);
@@ -1431,7 +2294,7 @@ void MCObsHandler::writeBinsToFile(const set<MCObsInfo>& obskeys,
        else{
        try{
           const RVector& buffer=getBins(*it);
-          BP.putData(*it,buffer);
+          m_writer.put(filename,*it,buffer);
           xmle.put_child("Success"); success++;}
        catch(std::exception& xp){
           xmle.put_child("Error",string(xp.what()));}}
@@ -1439,6 +2302,7 @@ void MCObsHandler::writeBinsToFile(const set<MCObsInfo>& obskeys,
        xmlout.put_child("NumberObservablesSuccessfullyWrittenToFile",make_string(success));}
  catch(const std::exception& errmsg){
     xmlout.put_child("Error",string(errmsg.what()));}
+ if (!m_batch_output) flush_output(xmlout);
 }
 
 
@@ -2,16 +2,23 @@
 #define MC_OBS_HANDLER_H
 #include <map>
 #include <set>
+#include <list>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <utility>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include "scalar_defs.h"
 #include "matrix.h"
 #include "bootstrapper.h"
 #include "obs_get_handler.h"
 #include "mcobs_info.h"
 #include "mc_estimate.h"
+#include "autocorrelation.h"
+#include "samplings_cache.h"
+#include "obs_file_writer.h"
 
 // *********************************************************************************
 // *                                                                               *
@@ -197,6 +204,9 @@
 // *         // query if all samplings are available (include **full** estimate)   *
 // *       bool flag=MH.queryFullAndSamplings(obskey);                             *
 // *                                                                               *
+// *         // query if all samplings are already in memory (current mode)        *
+// *       bool flag=MH.queryFullAndSamplingsInMemory(obskey);                     *
+// *                                                                               *
 // *    (9) The expected value of a nonsimple observable from a particular         *
 // *    resampling or the entire ensemble must be computed outside of this         *
 // *    class, but then the result must be "put" into this class so that           *
@@ -218,12 +228,44 @@
 // *       double thiscov12=MH.getCovariance(obskey1,obskey2); //current samp mode *
 // *       double stddev=MH.getStandardDeviation(obskey);                          *
 // *                                                                               *
+// *    The correlated/uncorrelated flag tells fitting classes how to use the      *
+// *    covariances: uncorrelated fits keep only the variances, and low-rank fits  *
+// *    keep the covariance as a factor built from the centered samplings plus     *
+// *    "diag_weight" times the variances on the diagonal (see "ChiSquare").       *
+// *                                                                               *
+// *       MH.setToCorrelated();                                                   *
+// *       MH.setToUnCorrelated();                                                 *
+// *       MH.setToLowRankCorrelated(diag_weight);                                 *
+// *       MH.isCorrelated();              // true for low-rank also               *
+// *       MH.isLowRankCorrelated();                                               *
+// *       double w=MH.getLowRankDiagonalWeight();                                 *
+// *                                                                               *
 // *    (11) Autocorrelation of a simple observable for a particular               *
 // *    Markov "time" separation.                                                  *
 // *                                                                               *
 // *       uint markovtime=3;                                                      *
 // *       double autocorr=MH.getAutoCorrelation(obskey,markovtime);               *
 // *                                                                               *
+// *    The whole autocorrelation function, with the integrated autocorrelation    *
+// *    time and its automatic summation window (see "autocorrelation.h"), of      *
+// *    many simple observables is obtained at once by                             *
+// *                                                                               *
+// *       vector<MCObsInfo> obskeys; ...                                          *
+// *       vector<AutoCorrelation> results;                                        *
+// *       MH.getAutoCorrelations(obskeys,results,AutoCorrelation::Wolff,          *
+// *                              factor,nkeep,nthreads);                          *
+// *                                                                               *
+// *    The data of each observable are read in turn (see below) and analyzed      *
+// *    on "nthreads" threads (zero means the hardware concurrency).  The data     *
+// *    used are the unbinned measurements when available in the last_laph         *
+// *    files, and otherwise the bins in the bin files (as stored in the file)     *
+// *    or in memory.  These are returned by                                       *
+// *                                                                               *
+// *       RVector data;                                                           *
+// *       uint per_value=MH.getMeasurementData(obskey,data);                      *
+// *                                                                               *
+// *    where "per_value" is the number of measurements in each value.             *
+// *                                                                               *
 // *    (12) Estimates for all resamplings (excluding **full** estimates). Can be  *
 // *    used regardless of the current resampling mode.   Results are also stored  *
 // *    in memory.  Notice that to exclude the full estimate, the return type      *
@@ -338,7 +380,8 @@
 // *    header is checked for consistency and these bins are added to the          *
 // *    file, as long as the observables do not already exist in the file.         *
 // *    To enable updating observables that are already in the file, use mode      *
-// *    "Update".                                                                  *
+// *    "Update".  An optional sixth argument "true" stores the bins in single     *
+// *    precision (see "bins_handler.h"); they are read back as doubles.           *
 // *                                                                               *
 // *    To read from file and put into memory,                                     *
 // *                                                                               *
@@ -367,6 +410,190 @@
 // *         <MCSamplingInfo> ... </MCSamplingInfo>                                *
 // *       </SigmondSamplingsFile>                                                 *
 // *                                                                               *
+// *    (17) Concurrent use:  several threads may use the same handler.            *
+// *    Data already in memory is read without taking the handler's mutex: only    *
+// *    a shared lock on the structure of the maps is held during the lookup, so   *
+// *    concurrent readers do not block each other.  All other accesses (lazy      *
+// *    reads from files, computations, insertions, and erasures) are serialized   *
+// *    through a recursive mutex.  The most expensive of these, resampling the    *
+// *    bins of a simple observable, is carried out with the mutex released        *
+// *    when possible, so other threads can carry on meanwhile; a thread that      *
+// *    needs samplings that are being computed by another thread waits for        *
+// *    them instead of repeating the work.  (Reads with a memory budget set,      *
+// *    see (18), always use the mutex.)  The references returned by "getBins",    *
+// *    "getFullAndSamplingValues" and the like point into the handler's maps      *
+// *    and are read without any lock, so the serialization above does not         *
+// *    protect them: while any thread may still use the data of a key, no         *
+// *    other thread may erase it (with "eraseData", "eraseSamplings", or the      *
+// *    "clear" routines) or put new values for it.  Putting values replaces       *
+// *    the entry in place, so a reference stays valid, but a concurrent reader    *
+// *    could see a mixture of old and new values.  Tasks that run concurrently    *
+// *    must therefore not write observables that other such tasks read.           *
+// *                                                                               *
+// *    Values of given samplings can be read and stored with an explicit          *
+// *    sampling mode and index, which do not use the current sampling state       *
+// *    described below, using                                                     *
+// *                                                                               *
+// *       double value=MH.getSamplingValue(obskey,mode,index);                    *
+// *       bool flag=MH.getSamplingValueMaybe(obskey,mode,index,value);            *
+// *       MH.putSamplingValue(obskey,mode,index,value,overwrite);                 *
+// *                                                                               *
+// *    where index 0 is the full sample.  All of the samplings (full sample       *
+// *    first) of a computed observable can be stored at once, replacing any       *
+// *    values already in memory, using                                            *
+// *                                                                               *
+// *       MH.putFullAndSamplingValues(obskey,samples,mode);                       *
+// *                                                                               *
+// *    The current sampling mode and index,                                       *
+// *    the covariance sampling mode, and the correlated/uncorrelated flag form    *
+// *    the "sampling state".  The thread that creates the handler uses its own    *
+// *    state.  Any other thread that uses the current sampling state must call    *
+// *    "attachThread" before using the handler: this gives the thread a           *
+// *    private copy of the creating thread's sampling state (index reset to       *
+// *    the full sample), so that loops such as                                    *
+// *                                                                               *
+// *       for (MH.begin();!MH.end();++MH) ...                                     *
+// *                                                                               *
+// *    in different threads do not disturb each other.  "detachThread"            *
+// *    releases the private state.  A thread can be attached to only one          *
+// *    handler at a time.  References returned by "getBins" and                   *
+// *    "getFullAndSamplingValues" remain valid while other threads add data,      *
+// *    but not if another thread erases or replaces the same observable, so       *
+// *    threads must not erase data that other threads are using.                  *
+// *    "setMemoryLimit" and "setSamplingsCache" must be called while no other     *
+// *    thread is using the handler.                                               *
+// *                                                                               *
+// *       MH.attachThread();                                                      *
+// *       ...                                                                     *
+// *       MH.detachThread();                                                      *
+// *                                                                               *
+// *    (18) Memory budget:  by default, data stays in memory until erased.  A     *
+// *    limit on the memory used by the bins and samplings can be set using        *
+// *                                                                               *
+// *       double gigabytes=200.0;                                                 *
+// *       string spill_stub="/scratch/sigmond_spill";  (optional)                 *
+// *       MH.setMemoryLimit(gigabytes,spill_stub);                                *
+// *                                                                               *
+// *    When the limit is exceeded, the least recently used entries are removed    *
+// *    from memory.  Entries that can be obtained again from "m_in_handler"       *
+// *    (bins and samplings read from files, and samplings computed from such      *
+// *    bins) are simply dropped and are re-read or recomputed when next           *
+// *    needed.  Other entries (computed bins, fit results, and so on) are         *
+// *    "spilled" to scratch files, whose names start with "spill_stub", and       *
+// *    are read back into memory when next needed.  Entries that can be           *
+// *    dropped are removed before entries that must be spilled.  Since            *
+// *    references to the data can be held while a task is being carried out,      *
+// *    only entries not accessed since the last call to                           *
+// *                                                                               *
+// *       MH.beginTask();                                                         *
+// *                                                                               *
+// *    are candidates for removal, so memory use can exceed the limit during a    *
+// *    task which needs more data than fits into the budget.  "beginTask" also    *
+// *    resets the statistics returned by                                          *
+// *                                                                               *
+// *       XMLHandler xmlout;                                                      *
+// *       MH.getResidencyInfo(xmlout);                                            *
+// *                                                                               *
+// *    which give the memory in use, the peak memory use since "beginTask",       *
+// *    and the number of entries dropped, spilled and restored.  The memory       *
+// *    used by an entry is estimated as the size of its values plus a fixed       *
+// *    overhead for the key and map node.                                         *
+// *                                                                               *
+// *    (19) Samplings cache:  computing bootstrap samplings from bins can take    *
+// *    a large part of the run time.  Samplings computed from the bins of         *
+// *    simple observables can be kept on disk for later runs using                *
+// *                                                                               *
+// *       MH.setSamplingsCache(dirname);                                          *
+// *                                                                               *
+// *    Before resampling the bins of a simple observable, the cache in            *
+// *    directory "dirname" is consulted, and newly computed samplings are         *
+// *    added to it.  Cache entries are keyed by the MCObsInfo, the bins info,     *
+// *    the sampling info, and a hash of the bins, so stale entries are never      *
+// *    used (see "samplings_cache.h").  Results are identical with or without     *
+// *    the cache.  New entries are flushed to disk by "beginTask" and when the    *
+// *    handler is destroyed.  The number of cache hits and entries stored are     *
+// *    returned by                                                                *
+// *                                                                               *
+// *       MH.getSamplingsCacheInfo(xmlout);                                       *
+// *                                                                               *
+// *    (20) Sharded runs:  "sigmond_batch --shards N" carries out groups of       *
+// *    tasks in child processes created by "fork" (see "TaskHandler").  Each      *
+// *    child process must call                                                    *
+// *                                                                               *
+// *       MH.beginShard(shard);                                                   *
+// *                                                                               *
+// *    before using the handler.  This reopens the input files, since a forked    *
+// *    process shares the file offsets of its parent's open files.  The           *
+// *    samplings cache of the parent is not used by the child, and data must      *
+// *    not have been spilled before the fork.  Afterwards,                        *
+// *    "writeSamplingValuesToFile" writes to the file "name.shard<k>" instead     *
+// *    of "name" (for HDF5, the suffix goes before the "[...]" group path).       *
+// *    The shard files written, with the write mode and file format of the        *
+// *    first write to each, are returned by                                       *
+// *                                                                               *
+// *       MH.getShardSamplingFiles(xmlout);                                       *
+// *                                                                               *
+// *    so that the parent process can merge them into the requested files.        *
+// *                                                                               *
+// *    (21) Batched output:  by default, each call to "writeSamplingValuesToFile" *
+// *    and "writeBinsToFile" opens the file, writes the records, and closes the   *
+// *    file (writing its key map) before returning.  After                        *
+// *                                                                               *
+// *       MH.setBatchedOutput(true);                                              *
+// *                                                                               *
+// *    the files are kept open from one call to the next, and the records are     *
+// *    written by a background thread (see "obs_file_writer.h"), so a task        *
+// *    that adds records to the same file many times writes the key map only      *
+// *    once.  The results are the same as without batching.  The files are        *
+// *    complete only after                                                        *
+// *                                                                               *
+// *       list<string> errors;                                                    *
+// *       MH.flushOutputFiles(errors);                                            *
+// *                                                                               *
+// *    which also returns any errors in writing the records, since the            *
+// *    "Success" in the output of the write calls then means that the record      *
+// *    was accepted.  A file is flushed before it is read by                      *
+// *    "readSamplingValuesFromFile" or "readBinsFromFile".  Output files must     *
+// *    be flushed before a fork, and are flushed when the handler is destroyed.   *
+// *    When tasks run concurrently on several threads, each task finishes with    *
+// *                                                                               *
+// *       MH.flushThreadOutputFiles(errors);                                      *
+// *                                                                               *
+// *    which completes only the files opened or written by the calling thread     *
+// *    and returns only the errors of the records that thread wrote, leaving      *
+// *    the files of the other tasks open.                                         *
+// *                                                                               *
+// *    (22) Estimates without stored samplings:  "getEstimate" puts all of the    *
+// *    samplings of the observable into memory, where they stay after the task.   *
+// *    Tasks that only need the mean and error of many observables (such as plots *
+// *    of a correlator at each time) can use                                      *
+// *                                                                               *
+// *       MCEstimate est=MH.getUnstoredEstimate(obskey,mode);                     *
+// *       MCEstimate est=MH.getUnstoredEstimate(obskey);  // current samp mode    *
+// *                                                                               *
+// *    which gives the same estimate without storing anything.  Samplings already *
+// *    in memory (or in a samplings file) are used as usual, and nonsimple        *
+// *    observables not in memory are handled as "getEstimate" handles them.       *
+// *    Otherwise, the bins are resampled on the fly: jackknife moments are        *
+// *    accumulated from the bins with no sampling vector at all, and bootstrap    *
+// *    samplings go into a temporary vector (needed for the quantiles) which is   *
+// *    freed on return.  Similarly,                                               *
+// *                                                                               *
+// *       RVector buffer;                                                         *
+// *       const RVector& samps=MH.getUnstoredFullAndSamplingValues(obskey,        *
+// *                                                      buffer,mode);            *
+// *       MCEstimate est=MH.getEstimateFromSamplings(samps,mode);                 *
+// *                                                                               *
+// *    returns the samplings held in memory or else puts them into "buffer",      *
+// *    and "getEstimateFromSamplings" computes the estimate from a vector of      *
+// *    full and sampling values.  For a vector of bins that is not stored as an   *
+// *    observable (a difference of two correlators, say),                         *
+// *                                                                               *
+// *       MCEstimate est=MH.getJackknifeEstimateFromBins(bins);                   *
+// *                                                                               *
+// *    gives its jackknife estimate; it does not use the handler's data, so it    *
+// *    may be called from several threads.                                        *
+// *                                                                               *
 // *                                                                               *
 // *********************************************************************************
 
@@ -381,14 +608,74 @@ class MCObsHandler
    std::map<MCObsInfo,std::pair<RVector,uint> > m_jacksamples;   // for storing resamplings
    std::map<MCObsInfo,std::pair<RVector,uint> > m_bootsamples;   // for storing resamplings
 
-   SamplingMode m_curr_sampling_mode;   //  0 = Jackknife, 1 = Bootstrap
-   uint m_curr_sampling_index;          //  0 = full sample, 1..m_max are boot/jack samplings
-   uint m_curr_sampling_max;
-   std::map<MCObsInfo,std::pair<RVector,uint> > *m_curr_samples;
-
-   SamplingMode m_curr_covmat_sampling_mode;   // current mode to use when computing covariances
+   struct SamplingState
+   {
+      SamplingMode m_curr_sampling_mode;   //  0 = Jackknife, 1 = Bootstrap
+      uint m_curr_sampling_index;          //  0 = full sample, 1..m_max are boot/jack samplings
+      uint m_curr_sampling_max;
+      std::map<MCObsInfo,std::pair<RVector,uint> > *m_curr_samples;
+      SamplingMode m_curr_covmat_sampling_mode;   // current mode to use when computing covariances
+      bool m_is_correlated;
+      double m_lowrank_diag_weight;       // > 0 for low-rank-plus-diagonal covariances
+   };
+
+   SamplingState m_main_state;          // state of the creating thread
    bool m_is_weighted;
-   bool m_is_correlated;
+
+   mutable std::recursive_mutex m_mutex;        // serializes lazy fills and all writes
+   mutable std::shared_mutex m_store_mutex;     // guards the structure of the data maps
+   std::set<MCObsInfo> m_filling[3];            // samplings being computed outside "m_mutex"
+   std::condition_variable_any m_fill_cv;
+
+       // memory budget (see (18) above); index 0 = bins, 1 = jackknife, 2 = bootstrap
+   struct Residency
+   {
+      unsigned long m_last_use;      // value of "m_use_count" at last access
+      bool m_reloadable;             // can be dropped rather than spilled
+   };
+
+   std::map<MCObsInfo,Residency> m_residency[3];   // maintained only if limit set
+   std::set<MCObsInfo> m_spilled[3];               // valid copy in spill file
+   IOMap<MCObsInfo,std::vector<double> > *m_spill_map[3];
+   std::string m_spill_stub;
+   double m_memory_limit;           // in bytes, zero means no limit
+   double m_memory_used;
+   double m_memory_peak;
+   unsigned long m_use_count;
+   unsigned long m_task_start;      // "m_use_count" when "beginTask" last called
+   uint m_ndropped, m_nspilled, m_nrestored;
+
+   SamplingsCache* m_cache;         // on-disk cache of samplings from bins, or null
+
+       // sharded runs (see (20) above)
+   struct ShardFile
+   {
+      std::string m_shard_name;      // file actually written
+      WriteMode m_wmode;             // mode of the first write
+      char m_file_format;
+   };
+
+   int m_shard;                                      // shard index, or -1
+   std::map<std::string,ShardFile> m_shard_files;    // keyed by requested file name
+   std::set<std::string> m_shard_paths;              // shard files started so far
+
+       // batched output (see (21) above)
+   ObsFileWriter m_writer;
+   bool m_batch_output;
+
+       // sampling state of an attached thread, and the handler it belongs to
+   static thread_local const MCObsHandler* t_attached;
+   static thread_local SamplingState* t_state;
+   static thread_local int t_lock_depth;       // depth of "m_mutex" locks held by this thread
+
+       // recursive lock on "m_mutex" that keeps track of "t_lock_depth"
+   class HandlerLock
+   {
+      std::recursive_mutex& m_mx;
+    public:
+      HandlerLock(const MCObsHandler& moh) : m_mx(moh.m_mutex) {m_mx.lock(); ++t_lock_depth;}
+      ~HandlerLock() {--t_lock_depth; m_mx.unlock();}
+   };
 
             // prevent copying
 #ifndef NO_CXX11
@@ -444,7 +731,7 @@ class MCObsHandler
 
    uint getSamplingsInMemorySize(SamplingMode mode) const;
 
-   void setCurrentSamplingIndex(uint index) {m_curr_sampling_index = index;};
+   void setCurrentSamplingIndex(uint index) {curr_state().m_curr_sampling_index = index;};
 
    const Bootstrapper& getBootstrapper() const;
 
@@ -485,7 +772,7 @@ class MCObsHandler
 
    bool isDefaultSamplingMode() const;
 
-   SamplingMode getCurrentSamplingMode() const {return m_curr_sampling_mode;}
+   SamplingMode getCurrentSamplingMode() const {return curr_state().m_curr_sampling_mode;}
  
 
    MCObsHandler& setSamplingBegin();
@@ -513,7 +800,7 @@ class MCObsHandler
 
    bool isCovMatBootstrapMode() const;
 
-   SamplingMode getCovMatCurrentSamplingMode() const {return m_curr_covmat_sampling_mode;}
+   SamplingMode getCovMatCurrentSamplingMode() const {return curr_state().m_curr_covmat_sampling_mode;}
 
    void setToUnCorrelated();
 
@@ -523,11 +810,19 @@ class MCObsHandler
 
    bool isUnCorrelated() const;
 
+   void setToLowRankCorrelated(double diag_weight);
+
+   bool isLowRankCorrelated() const;
+
+   double getLowRankDiagonalWeight() const {return curr_state().m_lowrank_diag_weight;}
+
 
    bool queryFullAndSamplings(const MCObsInfo& obskey);
 
    bool queryFullAndSamplings(const MCObsInfo& obskey, SamplingMode mode);
 
+   bool queryFullAndSamplingsInMemory(const MCObsInfo& obskey);
+
    const RVector& getFullAndSamplingValues(const MCObsInfo& obskey, SamplingMode mode);
 
    void getFullAndSamplingValues(const MCObsInfo& obskey, 
@@ -544,6 +839,20 @@ class MCObsHandler
    void putCurrentSamplingValue(const MCObsInfo& obskey, 
                                 double value, bool overwrite=true);
 
+             // explicit sampling index, independent of the current sampling
+             // mode and index (0 = full sample)
+
+   double getSamplingValue(const MCObsInfo& obskey, SamplingMode mode, uint sampindex);
+
+   bool getSamplingValueMaybe(const MCObsInfo& obskey, SamplingMode mode, uint sampindex,
+                              double& result);
+
+   void putSamplingValue(const MCObsInfo& obskey, SamplingMode mode, uint sampindex,
+                         double value, bool overwrite=true);
+
+   void putFullAndSamplingValues(const MCObsInfo& obskey, const RVector& samples,
+                                 SamplingMode mode);
+
 
    RVector getJackknifeSamplingValues(const MCObsInfo& obskey);
 
@@ -569,6 +878,20 @@ class MCObsHandler
    MCEstimate getBootstrapEstimate(const MCObsInfo& obskey);
 
 
+             // estimates without stored samplings (see (22) above)
+
+   MCEstimate getUnstoredEstimate(const MCObsInfo& obskey, SamplingMode inmode);
+
+   MCEstimate getUnstoredEstimate(const MCObsInfo& obskey);   // current sampling mode
+
+   const RVector& getUnstoredFullAndSamplingValues(const MCObsInfo& obskey,
+                                                   RVector& buffer, SamplingMode mode);
+
+   MCEstimate getEstimateFromSamplings(const RVector& samplings, SamplingMode mode);
+
+   MCEstimate getJackknifeEstimateFromBins(const RVector& bins) const;
+
+
 
    double getCovariance(const MCObsInfo& obskey1,
                         const MCObsInfo& obskey2, SamplingMode inmode);
@@ -583,6 +906,60 @@ class MCObsHandler
 
    double getAutoCorrelation(const MCObsInfo& obskey, uint markovtime);
 
+   void getAutoCorrelations(const std::vector<MCObsInfo>& obskeys,
+                            std::vector<AutoCorrelation>& results,
+                            AutoCorrelation::Windowing windowing=AutoCorrelation::Wolff,
+                            double factor=0.0, uint nkeep=0, uint nthreads=0);
+
+   uint getMeasurementData(const MCObsInfo& obskey, RVector& data);
+
+
+
+             // give the calling thread its own sampling state (see (17) above)
+
+   void attachThread();
+
+   void detachThread();
+
+
+             // memory budget (see (18) above)
+
+   void setMemoryLimit(double gigabytes, const std::string& spill_stub="");
+
+   double getMemoryLimit() const;    // in GB, zero means no limit
+
+   void beginTask();
+
+   void getResidencyInfo(XMLHandler& xmlout) const;
+
+
+             // on-disk samplings cache (see (19) above)
+
+   void setSamplingsCache(const std::string& dirname);
+
+   bool hasSamplingsCache() const {return m_cache!=0;}
+
+   void getSamplingsCacheInfo(XMLHandler& xmlout) const;
+
+
+             // sharded runs (see (20) above)
+
+   void beginShard(uint shard);
+
+   bool isShard() const {return m_shard>=0;}
+
+   void getShardSamplingFiles(XMLHandler& xmlout) const;
+
+
+             // batched output (see (21) above)
+
+   void setBatchedOutput(bool batch);
+
+   bool isBatchedOutput() const {return m_batch_output;}
+
+   void flushOutputFiles(std::list<std::string>& errors);
+
+   void flushThreadOutputFiles(std::list<std::string>& errors);
 
 
              // read all samplings from file and put into memory (second version
@@ -619,13 +996,38 @@ class MCObsHandler
    void writeBinsToFile(const std::set<MCObsInfo>& obskeys, 
                         const std::string& filename,
                         XMLHandler& xmlout, WriteMode = Protect,
-                        char file_format='D');  // default file format
+                        char file_format='D',   // default file format
+                        bool single_precision=false);
 
 
  private:
 
+   SamplingState& curr_state()
+    {return (t_attached==this) ? *t_state : m_main_state;}
+
+   const SamplingState& curr_state() const
+    {return (t_attached==this) ? *t_state : m_main_state;}
+
    void assert_simple(const MCObsInfo& obskey, const std::string& name);
 
+   std::map<MCObsInfo,std::pair<RVector,uint> >* samplings_map(SamplingMode mode)
+    {return (mode==Jackknife) ? &m_jacksamples : &m_bootsamples;}
+
+   uint sampling_max(SamplingMode mode) const
+    {return (mode==Jackknife) ? getNumberOfBins() : getNumberOfBootstrapResamplings();}
+
+   const RVector* find_resident_bins(const MCObsInfo& obskey) const;
+
+   const RVector* find_resident_samplings(const MCObsInfo& obskey, 
+                        const std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
+                        bool allow_not_all_available) const;
+
+   bool read_resident_sampling(const MCObsInfo& obskey, 
+                        const std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
+                        uint sampindex, double& value) const;
+
+   bool wait_for_fill(int store, const MCObsInfo& obskey);
+
    const RVector& get_bins(const MCObsInfo& obskey);
 
    const RVector& get_full_and_sampling_values(const MCObsInfo& obskey, 
@@ -646,12 +1048,37 @@ class MCObsHandler
 
    const RVector& put_samplings_in_memory(const MCObsInfo& obskey,
                         const RVector& samplings,
-                        std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr);
+                        std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
+                        bool reloadable=false);
+
+   const RVector& add_samplings_to_memory(const MCObsInfo& obskey,
+                        const RVector& samplings,
+                        std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
+                        bool reloadable=false);
 
    void put_a_sampling_in_memory(const MCObsInfo& obskey, uint sampling_index,
                         double value, bool overwrite, uint sampling_max,
                         std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr);
 
+   int store_index(const std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr) const
+    {return (samp_ptr==&m_jacksamples) ? 1 : 2;}
+
+   void note_insert(int store, const MCObsInfo& obskey, uint nvalues, bool reloadable);
+
+   void note_erase(int store, const MCObsInfo& obskey, uint nvalues);
+
+   void touch(int store, const MCObsInfo& obskey)
+    {if (m_memory_limit>0.0) m_residency[store][obskey].m_last_use=++m_use_count;}
+
+   bool restore_spilled(int store, const MCObsInfo& obskey);
+
+   std::string shard_file_name(const std::string& filename, WriteMode wmode,
+                               char file_format);
+
+   void flush_output(XMLHandler& xmlout);
+
+   void evict();
+
    void calc_simple_jack_samples(const RVector& bins, RVector& samplings);
 
    void calc_simple_boot_samples(const RVector& bins, RVector& samplings);
@@ -670,9 +1097,21 @@ class MCObsHandler
                       std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
                       void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&));
 
+   void calc_simple_samplings(const MCObsInfo& obskey, const RVector& bins, RVector& samplings,
+                      std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr,
+                      void (MCObsHandler::*simpcalc_ptr)(const RVector&,RVector&));
+
    const RVector* calc_corrsubvev_from_samplings(const MCObsInfo& obskey,
                       std::map<MCObsInfo,std::pair<RVector,uint> > *samp_ptr);
 
+   const RVector* find_unstored_samplings(const MCObsInfo& obskey, SamplingMode mode,
+                                          RVector& buffer);
+
+   void calc_unstored_from_bins(const MCObsInfo& obskey, SamplingMode mode,
+                                RVector& samplings, MCEstimate *jackest=0);
+
+   void jack_analyze_bins(const RVector& bins, MCEstimate& result) const;
+
    bool query_samplings_from_bins(const MCObsInfo& obskey);
 
    bool query_from_samplings_file(const MCObsInfo& obskey);
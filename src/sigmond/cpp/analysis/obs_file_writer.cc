@@ -0,0 +1,248 @@
+#include "obs_file_writer.h"
+#include <stdexcept>
+
+using namespace std;
+
+// ***************************************************************************
+
+
+ObsFileWriter::~ObsFileWriter()
+{
+ list<string> errors;
+ try{
+    flush(errors);}
+ catch(const std::exception& xp){}
+}
+
+
+void ObsFileWriter::openSamplings(const string& filename, const MCBinsInfo& bins_info,
+                                  const MCSamplingInfo& sampling_info, WriteMode wmode,
+                                  bool use_checksums, char file_format)
+{
+ Sink *open=reuse(filename,false,false,wmode,use_checksums,file_format,bins_info,
+                  sampling_info);
+ if (open){
+    open->m_users.insert(this_thread::get_id());
+    return;}
+ Sink *sink=new Sink(bins_info,sampling_info);
+ try{
+    sink->m_sput=new SamplingsPutHandler(bins_info,sampling_info,filename,wmode,
+                                         use_checksums,file_format);}
+ catch(const std::exception& xp){
+    delete sink; throw;}
+ sink->m_bins=false;
+ sink->m_single=false;
+ sink->m_overwrites=(wmode!=Protect);
+ sink->m_checksums=use_checksums;
+ sink->m_file_format=file_format;
+ sink->m_nvalues=sampling_info.getNumberOfReSamplings(bins_info)+1;
+ sink->m_users.insert(this_thread::get_id());
+ m_sinks.insert(make_pair(filename,sink));
+}
+
+
+void ObsFileWriter::openBins(const string& filename, const MCBinsInfo& bins_info,
+                             WriteMode wmode, bool use_checksums, char file_format,
+                             bool single_precision)
+{
+ Sink *open=reuse(filename,true,single_precision,wmode,use_checksums,file_format,
+                  bins_info,MCSamplingInfo());
+ if (open){
+    open->m_users.insert(this_thread::get_id());
+    return;}
+ Sink *sink=new Sink(bins_info,MCSamplingInfo());
+ try{
+    sink->m_bput=new BinsPutHandler(bins_info,filename,wmode,use_checksums,
+                                    file_format,single_precision);}
+ catch(const std::exception& xp){
+    delete sink; throw;}
+ sink->m_bins=true;
+ sink->m_single=single_precision;
+ sink->m_overwrites=(wmode!=Protect);
+ sink->m_checksums=use_checksums;
+ sink->m_file_format=file_format;
+ sink->m_nvalues=bins_info.getNumberOfBins();
+ sink->m_users.insert(this_thread::get_id());
+ m_sinks.insert(make_pair(filename,sink));
+}
+
+
+    //  Returns the open sink for "filename" if it can take these writes;
+    //  otherwise closes it (if open) and returns null.  "Overwrite" always
+    //  starts the file again.  Only one group of an HDF5 file is kept open
+    //  at a time.
+
+ObsFileWriter::Sink* ObsFileWriter::reuse(const string& filename, bool bins, bool single,
+                                          WriteMode wmode, bool use_checksums,
+                                          char file_format, const MCBinsInfo& bins_info,
+                                          const MCSamplingInfo& sampling_info)
+{
+ string path=file_path(filename);
+ map<string,Sink*>::iterator it=m_sinks.begin();
+ while (it!=m_sinks.end()){
+    map<string,Sink*>::iterator jt=it++;
+    if ((jt->first!=filename)&&(file_path(jt->first)==path)) close_sink(jt);}
+ it=m_sinks.find(filename);
+ if (it==m_sinks.end()) return 0;
+ Sink *sink=it->second;
+ if ((wmode!=Overwrite)&&(sink->m_overwrites==(wmode==Update))
+     &&(sink->m_bins==bins)&&(sink->m_single==single)
+     &&(sink->m_checksums==use_checksums)&&(sink->m_file_format==file_format)
+     &&(sink->m_bins_info==bins_info)
+     &&((bins)||(sink->m_samp_info==sampling_info)))
+    return sink;
+ close_sink(it);
+ return 0;
+}
+
+
+    //  The checks made by the put handlers are done here, before queueing,
+    //  so that they are reported to the caller.
+
+void ObsFileWriter::put(const string& filename, const MCObsInfo& obskey, const RVector& data)
+{
+ map<string,Sink*>::iterator it=m_sinks.find(filename);
+ if (it==m_sinks.end())
+    throw(std::invalid_argument(string("File ")+filename+" not open in ObsFileWriter::put"));
+ Sink *sink=it->second;
+ if (sink->m_bins){
+    if (data.size()!=sink->m_nvalues)
+       throw(std::runtime_error("Wrong number of bins in BinsPutHandler::putData"));
+    if (!obskey.isSimple())
+       throw(std::runtime_error("Only simple observable allowed for BinsPutHandler::putData"));}
+ else if (data.size()!=sink->m_nvalues)
+    throw(std::runtime_error("Wrong number of Samplings in SamplingsPutHandler::putData"));
+ if (!sink->m_overwrites){
+    bool infile;
+    {lock_guard<mutex> iolock(m_io_mutex);
+     infile=(sink->m_bins) ? sink->m_bput->queryData(obskey) : sink->m_sput->queryData(obskey);}
+    if ((infile)||(!sink->m_queued.insert(obskey).second))
+       throw(std::runtime_error(string("putData failed: record already in file ")
+                                +filename+" and no overwrite"));}
+
+ sink->m_users.insert(this_thread::get_id());
+ unique_lock<mutex> lock(m_mutex);
+ m_space.wait(lock,[this]{return (m_queued_bytes<max_queued_bytes)||(m_queue.empty());});
+ Record rec;
+ rec.m_filename=filename;
+ rec.m_sink=sink;
+ rec.m_obskey=obskey;
+ rec.m_user=this_thread::get_id();
+ m_queue.push_back(rec);
+ m_queue.back().m_data=data;
+ m_queued_bytes+=data.size()*sizeof(double);
+ ++sink->m_npending;
+ if (!m_thread.joinable()){
+    m_stop=false;
+    m_thread=thread(&ObsFileWriter::run_writer,this);}
+ m_work.notify_one();
+}
+
+
+    //  Closes all files with the same path as "filename" (an HDF5 file can
+    //  be open with several groups).
+
+void ObsFileWriter::close(const string& filename)
+{
+ string path=file_path(filename);
+ map<string,Sink*>::iterator it=m_sinks.begin();
+ while (it!=m_sinks.end()){
+    map<string,Sink*>::iterator jt=it++;
+    if (file_path(jt->first)==path) close_sink(jt);}
+}
+
+
+void ObsFileWriter::flush(list<string>& errors)
+{
+ while (!m_sinks.empty())
+    close_sink(m_sinks.begin());
+ stop_writer();
+ lock_guard<mutex> lock(m_mutex);
+ for (list<pair<thread::id,string> >::const_iterator et=m_errors.begin();
+      et!=m_errors.end();++et)
+    errors.push_back(et->second);
+ m_errors.clear();
+}
+
+
+    //  A file used by other threads as well is closed too (its records so
+    //  far are written); their next write reopens it.  The errors of the
+    //  records put by other threads are kept for them.
+
+void ObsFileWriter::flushThread(list<string>& errors)
+{
+ thread::id self=this_thread::get_id();
+ map<string,Sink*>::iterator it=m_sinks.begin();
+ while (it!=m_sinks.end()){
+    map<string,Sink*>::iterator jt=it++;
+    if (jt->second->m_users.count(self)>0) close_sink(jt);}
+ if (m_sinks.empty()) stop_writer();
+ lock_guard<mutex> lock(m_mutex);
+ list<pair<thread::id,string> >::iterator et=m_errors.begin();
+ while (et!=m_errors.end()){
+    if (et->first==self){
+       errors.push_back(et->second);
+       et=m_errors.erase(et);}
+    else ++et;}
+}
+
+
+void ObsFileWriter::stop_writer()
+{
+ {lock_guard<mutex> lock(m_mutex);
+  m_stop=true;}
+ m_work.notify_all();
+ if (m_thread.joinable()) m_thread.join();
+}
+
+
+string ObsFileWriter::file_path(const string& filename)
+{
+ return tidyString(filename.substr(0,filename.find('[')));
+}
+
+
+    //  Waits until the records queued for this file are written, then
+    //  deletes its put handler, which writes the key map and closes the file.
+
+void ObsFileWriter::close_sink(map<string,Sink*>::iterator it)
+{
+ Sink *sink=it->second;
+ {unique_lock<mutex> lock(m_mutex);
+  m_done.wait(lock,[sink]{return sink->m_npending==0;});}
+ m_sinks.erase(it);
+ delete sink;
+}
+
+
+    //  Takes all of the queued records at once and writes them in order
+    //  while "put" goes on queueing.
+
+void ObsFileWriter::run_writer()
+{
+ unique_lock<mutex> lock(m_mutex);
+ while (true){
+    m_work.wait(lock,[this]{return (!m_queue.empty())||m_stop;});
+    if (m_queue.empty()) return;
+    deque<Record> batch;
+    batch.swap(m_queue);
+    m_queued_bytes=0;
+    m_space.notify_all();
+    lock.unlock();
+    list<pair<thread::id,string> > errors;
+    {lock_guard<mutex> iolock(m_io_mutex);
+     for (deque<Record>::iterator rt=batch.begin();rt!=batch.end();++rt){
+        try{
+           if (rt->m_sink->m_bins) rt->m_sink->m_bput->putData(rt->m_obskey,rt->m_data);
+           else rt->m_sink->m_sput->putData(rt->m_obskey,rt->m_data);}
+        catch(const std::exception& xp){
+           errors.push_back(make_pair(rt->m_user,rt->m_filename+": "+xp.what()));}}}
+    lock.lock();
+    for (deque<Record>::iterator rt=batch.begin();rt!=batch.end();++rt)
+       --rt->m_sink->m_npending;
+    m_errors.splice(m_errors.end(),errors);
+    m_done.notify_all();}
+}
+
+
+// ***************************************************************************
@@ -0,0 +1,158 @@
+#ifndef OBS_FILE_WRITER_H
+#define OBS_FILE_WRITER_H
+
+#include <map>
+#include <set>
+#include <list>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "matrix.h"
+#include "mcobs_info.h"
+#include "bins_info.h"
+#include "sampling_info.h"
+#include "bins_handler.h"
+#include "samplings_handler.h"
+
+// ***************************************************************************
+// *                                                                         *
+// *  "ObsFileWriter" writes bins and samplings records to files that stay   *
+// *  open from one write to the next, so that a task which adds records to  *
+// *  the same file many times (such as one write per level) does not        *
+// *  reopen the file and rewrite its key map (or HDF5 index) each time.     *
+// *  The records are copied and queued, and a background thread writes      *
+// *  them in batches while the caller goes on computing.                    *
+// *                                                                         *
+// *     ObsFileWriter writer;                                               *
+// *     writer.openSamplings(filename,bins_info,sampling_info,wmode,        *
+// *                          use_checksums,file_format);                    *
+// *     writer.put(filename,obskey,samplings);                              *
+// *     ...                                                                 *
+// *     list<string> errors;                                                *
+// *     writer.flush(errors);                                               *
+// *                                                                         *
+// *  "openBins" is similar, with an extra single-precision flag.  An open   *
+// *  call for a file that is already open keeps using it if the mode is     *
+// *  "Update" (or "Protect") and the file was opened allowing (or not       *
+// *  allowing) records to be overwritten, with the same format and info;    *
+// *  otherwise the queued records are written, the file is closed, and it   *
+// *  is opened again exactly as a new put handler would open it, so the     *
+// *  results are the same as opening a handler for each write.  Opening     *
+// *  errors, wrong record sizes, and records already in a file that does    *
+// *  not allow overwrites are reported by exceptions from "open..." and     *
+// *  "put".  Errors in the background writes are kept until "flush", which  *
+// *  returns them.  "close" writes the queued records of a file and closes  *
+// *  it (all groups, for HDF5); "flush" does this for all files and stops   *
+// *  the thread, and must be called before the program forks.  When         *
+// *  several tasks write at once, each on its own thread, a task finishes   *
+// *  with "flushThread", which closes only the files opened or written by   *
+// *  the calling thread and returns only the errors of the records it put,  *
+// *  so files other tasks are still writing stay open.  The destructor      *
+// *  flushes but discards any errors.  The calls must be serialized by the  *
+// *  caller.  The HDF5 calls of the background thread and of any other      *
+// *  thread are serialized by IOHDF5Handler, since the HDF5 library is not  *
+// *  thread safe.                                                           *
+// *                                                                         *
+// ***************************************************************************
+
+
+class ObsFileWriter
+{
+
+   struct Sink
+   {
+      bool m_bins;                   // bins file, otherwise samplings file
+      bool m_single;                 // single-precision bins
+      bool m_overwrites;             // records can be overwritten
+      bool m_checksums;
+      char m_file_format;
+      MCBinsInfo m_bins_info;
+      MCSamplingInfo m_samp_info;
+      uint m_nvalues;                // size of each record
+      BinsPutHandler *m_bput;
+      SamplingsPutHandler *m_sput;
+      std::set<MCObsInfo> m_queued;  // keys queued (files without overwrites)
+      uint m_npending;               // records queued or being written
+      std::set<std::thread::id> m_users;   // threads that opened or wrote it
+
+      Sink(const MCBinsInfo& binfo, const MCSamplingInfo& sinfo)
+         : m_bins_info(binfo), m_samp_info(sinfo), m_bput(0), m_sput(0),
+           m_npending(0) {}
+      ~Sink() {delete m_bput; delete m_sput;}
+   };
+
+   struct Record
+   {
+      std::string m_filename;
+      Sink *m_sink;
+      MCObsInfo m_obskey;
+      RVector m_data;
+      std::thread::id m_user;
+   };
+
+   std::map<std::string,Sink*> m_sinks;
+   std::mutex m_mutex;              // guards the queue, the counts and the errors
+   std::mutex m_io_mutex;           // held while records are written
+   std::condition_variable m_work, m_space, m_done;
+   std::deque<Record> m_queue;
+   size_t m_queued_bytes;
+   std::list<std::pair<std::thread::id,std::string> > m_errors;
+   std::thread m_thread;
+   bool m_stop;
+
+   static const size_t max_queued_bytes=268435456;   // "put" waits beyond this
+
+#ifndef NO_CXX11
+   ObsFileWriter(const ObsFileWriter&) = delete;
+   ObsFileWriter& operator=(const ObsFileWriter&) = delete;
+#else
+   ObsFileWriter(const ObsFileWriter&);
+   ObsFileWriter& operator=(const ObsFileWriter&);
+#endif
+
+ public:
+
+   ObsFileWriter() : m_queued_bytes(0), m_stop(false) {}
+
+   ~ObsFileWriter();
+
+   void openSamplings(const std::string& filename, const MCBinsInfo& bins_info,
+                      const MCSamplingInfo& sampling_info, WriteMode wmode,
+                      bool use_checksums, char file_format);
+
+   void openBins(const std::string& filename, const MCBinsInfo& bins_info,
+                 WriteMode wmode, bool use_checksums, char file_format,
+                 bool single_precision);
+
+   void put(const std::string& filename, const MCObsInfo& obskey, const RVector& data);
+
+   bool isOpen(const std::string& filename) const
+    {return m_sinks.find(filename)!=m_sinks.end();}
+
+   void close(const std::string& filename);
+
+   void flush(std::list<std::string>& errors);
+
+   void flushThread(std::list<std::string>& errors);
+
+ private:
+
+   Sink* reuse(const std::string& filename, bool bins, bool single, WriteMode wmode,
+               bool use_checksums, char file_format, const MCBinsInfo& bins_info,
+               const MCSamplingInfo& sampling_info);
+
+   void close_sink(std::map<std::string,Sink*>::iterator it);
+
+   void stop_writer();
+
+   static std::string file_path(const std::string& filename);
+
+   void run_writer();
+
+};
+
+
+// ***************************************************************************
+#endif
@@ -0,0 +1,168 @@
+#include "samplings_cache.h"
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+
+using namespace std;
+
+// *************************************************************************
+
+
+SamplingsCache::SamplingsCache(const string& dirname, const MCBinsInfo& bins_info,
+                               const MCSamplingInfo& sampling_info)
+          : m_dirname(tidyString(dirname)), m_nhits(0), m_nstored(0)
+{
+ if (m_dirname.empty())
+    throw(std::invalid_argument("Empty directory name for samplings cache"));
+ struct stat sb;
+ if (stat(m_dirname.c_str(),&sb)!=0){
+    if (mkdir(m_dirname.c_str(),0755)!=0)
+       throw(std::invalid_argument(string("Could not create samplings cache directory ")+m_dirname));}
+ else if (!S_ISDIR(sb.st_mode))
+    throw(std::invalid_argument(string("Samplings cache ")+m_dirname+" is not a directory"));
+
+ XMLHandler xmlb, xmlj, xmls;
+ bins_info.output(xmlb);
+ MCSamplingInfo jackinfo;
+ jackinfo.output(xmlj);
+ sampling_info.output(xmls);
+ m_context[0]="<SigmondSamplingsCache>"+xmlb.str()+xmlj.str()+"</SigmondSamplingsCache>";
+ m_context[1]="<SigmondSamplingsCache>"+xmlb.str()+xmls.str()+"</SigmondSamplingsCache>";
+ for (int k=0;k<2;++k){
+    m_iom[k]=0;
+    m_failed[k]=false;
+    m_dirty[k]=false;}
+ if ((!sampling_info.isBootstrapMode())||(sampling_info.getRNGSeed()==0))
+    m_failed[1]=true;
+}
+
+
+SamplingsCache::~SamplingsCache()
+{
+ flush();
+ for (int k=0;k<2;++k)
+    delete m_iom[k];
+}
+
+
+    //  The file map of an IOMap file is only written when the file is
+    //  flushed, so a job killed after a "put" would leave a file that
+    //  cannot be opened.  A marker file exists while there are unflushed
+    //  puts; a cache file with a marker is discarded when opened.
+
+void SamplingsCache::flush()
+{
+ for (int k=0;k<2;++k){
+    if ((m_iom[k]==0)||(!m_dirty[k])) continue;
+    m_iom[k]->flush();
+    std::remove((m_filename[k]+".dirty").c_str());
+    m_dirty[k]=false;}
+}
+
+
+    //  FNV-1a hash
+
+unsigned long long SamplingsCache::hash(const char* data, size_t nbytes,
+                                        unsigned long long seed)
+{
+ unsigned long long h=seed;
+ for (size_t k=0;k<nbytes;++k){
+    h^=(unsigned char)(data[k]);
+    h*=1099511628211ULL;}
+ return h;
+}
+
+
+unsigned long long SamplingsCache::hash_bins(const RVector& bins)
+{
+ unsigned long long h=14695981039346656037ULL;
+ for (uint k=0;k<bins.size();++k){
+    double value=bins[k];
+    h=hash((const char*)&value,sizeof(double),h);}
+ return h;
+}
+
+
+    //  Files are opened when first needed.  If the file cannot be opened,
+    //  or its header does not match (a hash collision in the file name),
+    //  caching is turned off for that mode.
+
+bool SamplingsCache::open(int index)
+{
+ if (m_iom[index]) return true;
+ if (m_failed[index]) return false;
+ const string& context=m_context[index];
+ ostringstream fname;
+ fname << m_dirname << "/samplings_" << hex << setw(16) << setfill('0')
+       << hash(context.data(),context.length()) << ".cache";
+ m_filename[index]=fname.str();
+ string marker(m_filename[index]+".dirty");
+ struct stat sb;
+ if (stat(marker.c_str(),&sb)==0){
+    std::remove(m_filename[index].c_str());
+    std::remove(marker.c_str());}
+ IOMap<MCObsInfo,vector<double> > *iom=new IOMap<MCObsInfo,vector<double> >;
+ try{
+    string header(context);
+    iom->openUpdate(m_filename[index],"Sigmond--SamplingsCache",header,'N',false,true,'F');
+    if (header!=context)
+       throw(std::runtime_error("Samplings cache file header mismatch"));}
+ catch(const std::exception& xp){
+    delete iom;
+    m_failed[index]=true;
+    return false;}
+ m_iom[index]=iom;
+ return true;
+}
+
+
+    //  Stored values are the two 32-bit halves of the bins hash followed
+    //  by the samplings.
+
+bool SamplingsCache::get(const MCObsInfo& obskey, SamplingMode mode, const RVector& bins,
+                         RVector& samplings)
+{
+ int index=(mode==Jackknife)?0:1;
+ if (!open(index)) return false;
+ vector<double> buffer;
+ try{
+    if (!m_iom[index]->get_maybe(obskey,buffer)) return false;}
+ catch(const std::exception& xp){
+    return false;}
+ if (buffer.size()<3) return false;
+ unsigned long long h=hash_bins(bins);
+ if ((buffer[0]!=double(h & 0xFFFFFFFFULL))||(buffer[1]!=double(h>>32)))
+    return false;
+ samplings.resize(uint(buffer.size()-2));
+ for (uint k=0;k<samplings.size();++k)
+    samplings[k]=buffer[k+2];
+ ++m_nhits;
+ return true;
+}
+
+
+void SamplingsCache::put(const MCObsInfo& obskey, SamplingMode mode, const RVector& bins,
+                         const RVector& samplings)
+{
+ int index=(mode==Jackknife)?0:1;
+ if (!open(index)) return;
+ unsigned long long h=hash_bins(bins);
+ vector<double> buffer(samplings.size()+2);
+ buffer[0]=double(h & 0xFFFFFFFFULL);
+ buffer[1]=double(h>>32);
+ for (uint k=0;k<samplings.size();++k)
+    buffer[k+2]=samplings[k];
+ if (!m_dirty[index]){
+    ofstream marker((m_filename[index]+".dirty").c_str());
+    m_dirty[index]=true;}
+ try{
+    m_iom[index]->put(obskey,buffer);
+    ++m_nstored;}
+ catch(const std::exception& xp){}     // caching is not essential
+}
+
+
+// *************************************************************************
@@ -0,0 +1,97 @@
+#ifndef SAMPLINGS_CACHE_H
+#define SAMPLINGS_CACHE_H
+
+#include <string>
+#include <vector>
+#include "matrix.h"
+#include "mcobs_info.h"
+#include "bins_info.h"
+#include "sampling_info.h"
+#include "io_map.h"
+
+// ***************************************************************************
+// *                                                                         *
+// *  "SamplingsCache" keeps the jackknife and bootstrap samplings computed  *
+// *  from bins in files on disk, so that later runs on the same data do     *
+// *  not need to resample again.  An entry is found by its "MCObsInfo" key, *
+// *  but is used only if a hash of the bins from which it was computed      *
+// *  matches the current bins, so an entry is never used for data that has  *
+// *  changed.  Each combination of "MCBinsInfo" (ensemble, rebinning,       *
+// *  omissions) and sampling mode (including the bootstrap parameters) has  *
+// *  its own file in the cache directory, whose name contains a hash of     *
+// *  this information; the information itself is stored in the file header  *
+// *  and checked when the file is opened.                                   *
+// *                                                                         *
+// *     SamplingsCache cache(dirname,bins_info,sampling_info);              *
+// *     RVector samplings;                                                  *
+// *     if (!cache.get(obskey,Bootstrap,bins,samplings)){                   *
+// *        ... compute samplings from bins ...                              *
+// *        cache.put(obskey,Bootstrap,bins,samplings);}                     *
+// *                                                                         *
+// *  Bootstrap samplings are not cached if the bootstrap seed is zero,      *
+// *  since the seed is then taken from the time.  The directory is created  *
+// *  if it does not exist.  New entries are safely on disk only after       *
+// *  "flush" is called (or the cache is destroyed); a file left unflushed   *
+// *  by a job that was killed is discarded.  The files are not locked, so   *
+// *  the same cache directory should not be used by jobs running at the     *
+// *  same time.                                                             *
+// *                                                                         *
+// ***************************************************************************
+
+
+class SamplingsCache
+{
+
+   std::string m_dirname;
+   std::string m_context[2];      // header information: 0 = jackknife, 1 = bootstrap
+   std::string m_filename[2];
+   IOMap<MCObsInfo,std::vector<double> > *m_iom[2];
+   bool m_failed[2];
+   bool m_dirty[2];               // puts since the last flush
+   uint m_nhits, m_nstored;
+
+#ifndef NO_CXX11
+   SamplingsCache() = delete;
+   SamplingsCache(const SamplingsCache&) = delete;
+   SamplingsCache& operator=(const SamplingsCache&) = delete;
+#else
+   SamplingsCache();
+   SamplingsCache(const SamplingsCache&);
+   SamplingsCache& operator=(const SamplingsCache&);
+#endif
+
+ public:
+
+   SamplingsCache(const std::string& dirname, const MCBinsInfo& bins_info,
+                  const MCSamplingInfo& sampling_info);
+
+   ~SamplingsCache();
+
+   bool get(const MCObsInfo& obskey, SamplingMode mode, const RVector& bins,
+            RVector& samplings);
+
+   void put(const MCObsInfo& obskey, SamplingMode mode, const RVector& bins,
+            const RVector& samplings);
+
+   void flush();
+
+   const std::string& getDirectory() const {return m_dirname;}
+
+   uint getNumberOfHits() const {return m_nhits;}
+
+   uint getNumberStored() const {return m_nstored;}
+
+   static unsigned long long hash(const char* data, size_t nbytes,
+                                  unsigned long long seed=14695981039346656037ULL);
+
+ private:
+
+   bool open(int index);
+
+   static unsigned long long hash_bins(const RVector& bins);
+
+};
+
+
+// ***************************************************************************
+#endif
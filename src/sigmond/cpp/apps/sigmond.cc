@@ -1,5 +1,6 @@
 #include "task_handler.h"
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 #include <vector>
 #include <map>
@@ -14,7 +15,9 @@ using namespace std;
 // *                                                                            *
 // *   Program takes a single argument that is the name of the input file.      *
 // *   Input file must contain a single XML document with root tag named        *
-// *   <SigMonD>.  The input XML must have the form below:                      *
+// *   <SigMonD>.  The input file name can be preceded by "--shards N" to       *
+// *   carry out the tasks in up to N child processes (see (i) below).          *
+// *   The input XML must have the form below:                                  *
 // *                                                                            *
 // *    <SigMonD>                                                               *
 // *                                                                            *
@@ -135,6 +138,13 @@ using namespace std;
 // *   The <Action> tag must be a string in the "m_task_map".  The remaining    *
 // *   XML depends on the action being taken.                                   *
 // *                                                                            *
+// *   (i) With "--shards N", tasks are assigned to up to N processes by        *
+// *   their <ShardKey> tags: all tasks with the same key are done by the       *
+// *   same process.  Tasks before the first task with a <ShardKey> are         *
+// *   done before the processes are started, so the data they read is          *
+// *   shared.  The logs and samplings files of the processes are merged        *
+// *   at the end, then later tasks without a key are done once by the          *
+// *   main process.  See "TaskHandler" in "task_handler.h" for details.        *
 // *                                                                            *
 // ******************************************************************************
 
@@ -144,11 +154,13 @@ void show_help() {
     
     cout << "USAGE:" << endl;
     cout << "  sigmond_batch <input_file.xml>" << endl;
+    cout << "  sigmond_batch --shards N <input_file.xml>" << endl;
     cout << "  sigmond_batch -h|--help" << endl << endl;
     
     cout << "DESCRIPTION:" << endl;
     cout << "  Main driver program to run SigMonD in batch mode." << endl;
-    cout << "  Program takes a single argument that is the name of the input file." << endl;
+    cout << "  Program takes a single argument that is the name of the input file," << endl;
+    cout << "  optionally preceded by \"--shards N\"." << endl;
     cout << "  Input file must contain a single XML document with root tag named <SigMonD>." << endl << endl;
     
     cout << "INPUT XML FORMAT:" << endl;
@@ -257,12 +269,22 @@ void show_help() {
     cout << "  Each <Task> tag must begin with an <Action> tag. The <Action> tag must be a string" << endl;
     cout << "  in the \"m_task_map\". The remaining XML depends on the action being taken." << endl << endl;
     
+    cout << "SHARDED RUNS:" << endl;
+    cout << "  With \"--shards N\", the tasks are carried out in up to N child processes." << endl;
+    cout << "  Tasks are assigned to the processes by their <ShardKey> tags: all tasks with" << endl;
+    cout << "  the same key are done by the same process. Tasks before the first task with a" << endl;
+    cout << "  <ShardKey> are done before the processes are started, so the data they read is" << endl;
+    cout << "  shared. The logs and samplings files of the processes are merged at the end," << endl;
+    cout << "  then later tasks without a key are done once by the main process." << endl << endl;
+
     cout << "OPTIONS:" << endl;
-    cout << "  -h, --help    Show this help message and exit" << endl << endl;
+    cout << "  -h, --help    Show this help message and exit" << endl;
+    cout << "  --shards N    Carry out the tasks in up to N child processes" << endl << endl;
     
     cout << "EXAMPLES:" << endl;
     cout << "  sigmond_batch analysis_input.xml" << endl;
-    cout << "  sigmond_batch /path/to/input/file.xml" << endl << endl;
+    cout << "  sigmond_batch /path/to/input/file.xml" << endl;
+    cout << "  sigmond_batch --shards 8 analysis_input.xml" << endl << endl;
 }
 
 
@@ -283,6 +305,15 @@ int main(int argc, const char* argv[])
     show_help();
     return 0;}
 
+ uint nshards=0;
+ if ((tokens.size()==3)&&(tokens[0]=="--shards")){
+    int n=atoi(tokens[1].c_str());
+    if (n<1){
+       cout << "Error: --shards requires a positive number of shards"<<endl;
+       return 1;}
+    nshards=n;
+    tokens.erase(tokens.begin(),tokens.begin()+2);}
+
  if (tokens.size()!=1){
     cout << "Error: batch mode requires a file name as the only argument"<<endl;
     cout << "Use 'sigmond_batch --help' for usage information."<<endl;
@@ -298,8 +329,11 @@ int main(int argc, const char* argv[])
         // set up the task handler
     TaskHandler tasker(xmltask);
 
-        // do the tasks in sequence
-    tasker.do_batch_tasks(xmltask);
+        // do the tasks in sequence, or in shards
+    if (nshards>0)
+       tasker.do_sharded_tasks(xmltask,nshards);
+    else
+       tasker.do_batch_tasks(xmltask);
     }
  catch(const std::exception& msg){
     cout << "Error: "<<msg.what()<<endl;
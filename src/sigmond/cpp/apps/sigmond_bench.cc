@@ -0,0 +1,721 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <set>
+#include <list>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <sys/stat.h>
+#include "xml_handler.h"
+#include "io_map.h"
+#include "mcobs_info.h"
+#include "matrix.h"
+#include "bootstrapper.h"
+#include "ensemble_info.h"
+#include "bins_info.h"
+#include "sampling_info.h"
+#include "bins_handler.h"
+#include "obs_get_handler.h"
+#include "mcobs_handler.h"
+#include "task_utils.h"
+#include "minimizer.h"
+#include "chisq_tcorr.h"
+#include "chisq_fit.h"
+#include "chisq_varpro.h"
+
+using namespace std;
+
+// ******************************************************************************
+// *                                                                            *
+// *   "sigmond_bench" times the hot paths of SigMonD on synthetic data, so     *
+// *   that performance can be tracked between releases.  No input files are   *
+// *   needed: a synthetic ensemble of correlated, exponentially decaying       *
+// *   correlators is generated from a fixed seed and written into a bins       *
+// *   file in a scratch directory, which is removed afterwards.                *
+// *                                                                            *
+// *   Each benchmark is run in several repeats, each long enough to be timed   *
+// *   reliably; the minimum and median times per iteration over the repeats    *
+// *   are reported.  Results are written as JSON, one benchmark per line:      *
+// *                                                                            *
+// *     {                                                                      *
+// *      "program": "sigmond_bench",                                           *
+// *      "quick": false,                                                       *
+// *      "benchmarks": [                                                       *
+// *       {"name": "bootstrapper_generate", "iterations": 40,                  *
+// *        "seconds_min": 1.2e-03, "seconds_median": 1.3e-03},                *
+// *       ...                                                                  *
+// *      ]                                                                     *
+// *     }                                                                      *
+// *                                                                            *
+// *   With "--compare baseline.json", the median times are compared with       *
+// *   those in a file written earlier by this program; any benchmark slower    *
+// *   than the baseline by more than the tolerance (default 10%) is reported   *
+// *   and the exit status is 1.                                                *
+// *                                                                            *
+// *   Micro-benchmarks:  bootstrap resampling generation, jackknife and        *
+// *   bootstrap samplings from bins, covariances, eigensolvers (with and       *
+// *   without a metric), matrix rotations, one chi-square minimization for     *
+// *   each available method, IOMap put/get in fstream and HDF5 formats, and    *
+// *   parsing of (and tag lookups in) a large generated task input XML.        *
+// *   Macro-benchmark:  a complete correlated fit over all resamplings.        *
+// *                                                                            *
+// ******************************************************************************
+
+
+void print_help()
+{
+ cout << endl;
+ cout << " \"sigmond_bench\" runs micro- and macro-benchmarks of sigmond"<<endl;
+ cout << "   hot paths on synthetic data and writes the timings as JSON."<<endl<<endl;
+ cout << " Usage:  sigmond_bench [options]"<<endl;
+ cout << " Options: -h, --help               display this help and exit"<<endl;
+ cout << "          -l, --list               list the benchmark names and exit"<<endl;
+ cout << "          -q, --quick              shorter runs (less reproducible)"<<endl;
+ cout << "          -f, --filter <str>       run only benchmarks whose names contain str"<<endl;
+ cout << "          -o, --output <file>      write the JSON results to file (default: stdout)"<<endl;
+ cout << "          -c, --compare <file>     compare with baseline JSON results in file"<<endl;
+ cout << "          -t, --tolerance <frac>   allowed slowdown in compare mode (default 0.10)"<<endl;
+ cout << "          -d, --dir <dir>          scratch directory (default: sigmond_bench_tmp)"<<endl;
+ cout << endl;
+}
+
+
+// ******************************************************************************
+
+
+struct BenchResult
+{
+ string name;
+ uint iterations;         // per repeat
+ double seconds_min;      // per iteration
+ double seconds_median;   // per iteration
+};
+
+
+class BenchRunner
+{
+   double m_repeat_time;    // target seconds per repeat
+   uint m_nrepeats;
+   string m_filter;
+   bool m_list_only;
+   vector<BenchResult> m_results;
+
+ public:
+
+   BenchRunner(bool quick, const string& filter, bool list_only)
+      : m_repeat_time(quick ? 0.05 : 0.25), m_nrepeats(quick ? 3 : 7),
+        m_filter(filter), m_list_only(list_only) {}
+
+   bool selected(const string& name) const
+    {return (m_filter.empty())||(name.find(m_filter)!=string::npos);}
+
+   const vector<BenchResult>& getResults() const {return m_results;}
+
+         //  "setup" is called (untimed) before every iteration
+
+   void run(const string& name, const function<void()>& body,
+            const function<void()>& setup=function<void()>());
+
+};
+
+
+void BenchRunner::run(const string& name, const function<void()>& body,
+                      const function<void()>& setup)
+{
+ if (!selected(name)) return;
+ if (m_list_only){
+    cout << name << endl;
+    return;}
+ typedef chrono::steady_clock Clock;
+ auto once=[&]()->double{
+    if (setup) setup();
+    Clock::time_point start=Clock::now();
+    body();
+    return chrono::duration<double>(Clock::now()-start).count();};
+
+    //  warm up and calibrate the number of iterations per repeat
+
+ double t1=once();
+ uint niters=1;
+ if (t1<m_repeat_time){
+    double tsum=t1;
+    uint ncal=1;
+    while ((tsum<0.2*m_repeat_time)&&(ncal<1000000)){
+       tsum+=once();
+       ++ncal;}
+    niters=uint(std::max(1.0,m_repeat_time/(tsum/double(ncal))));}
+
+ vector<double> pertime(m_nrepeats);
+ for (uint r=0;r<m_nrepeats;++r){
+    double tsum=0.0;
+    for (uint k=0;k<niters;++k)
+       tsum+=once();
+    pertime[r]=tsum/double(niters);}
+ sort(pertime.begin(),pertime.end());
+ BenchResult res;
+ res.name=name;
+ res.iterations=niters;
+ res.seconds_min=pertime.front();
+ res.seconds_median=pertime[m_nrepeats/2];
+ m_results.push_back(res);
+ cerr << setw(36) << left << name << right << "  " << scientific << setprecision(3)
+      << res.seconds_median << " s" << endl;
+}
+
+
+// ******************************************************************************
+
+
+void write_json(ostream& out, const vector<BenchResult>& results, bool quick)
+{
+ out << "{" << endl;
+ out << " \"program\": \"sigmond_bench\"," << endl;
+ out << " \"quick\": " << (quick ? "true" : "false") << "," << endl;
+ out << " \"benchmarks\": [" << endl;
+ out << scientific << setprecision(6);
+ for (uint k=0;k<results.size();++k){
+    const BenchResult& r=results[k];
+    out << "  {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+        << ", \"seconds_min\": " << r.seconds_min
+        << ", \"seconds_median\": " << r.seconds_median << "}"
+        << ((k+1<results.size()) ? "," : "") << endl;}
+ out << " ]" << endl;
+ out << "}" << endl;
+}
+
+
+    //  Reads a file written by "write_json" (one benchmark per line)
+
+bool read_json_value(const string& line, const string& field, string& value)
+{
+ string tag="\""+field+"\":";
+ size_t pos=line.find(tag);
+ if (pos==string::npos) return false;
+ pos+=tag.length();
+ while ((pos<line.length())&&(line[pos]==' ')) ++pos;
+ if ((pos<line.length())&&(line[pos]=='"')){
+    size_t end=line.find('"',pos+1);
+    if (end==string::npos) return false;
+    value=line.substr(pos+1,end-pos-1);}
+ else{
+    size_t end=line.find_first_of(",}",pos);
+    value=tidyString(line.substr(pos,end-pos));}
+ return true;
+}
+
+
+map<string,double> read_baseline(const string& filename)
+{
+ ifstream in(filename.c_str());
+ if (!in)
+    throw(std::invalid_argument(string("Could not open baseline file ")+filename));
+ map<string,double> baseline;
+ string line;
+ while (getline(in,line)){
+    string name,secs;
+    if ((read_json_value(line,"name",name))&&(read_json_value(line,"seconds_median",secs)))
+       baseline[name]=atof(secs.c_str());}
+ if (baseline.empty())
+    throw(std::invalid_argument(string("No benchmark results found in ")+filename));
+ return baseline;
+}
+
+
+bool compare_with_baseline(const vector<BenchResult>& results,
+                           const map<string,double>& baseline, double tolerance)
+{
+ bool ok=true;
+ cerr << endl << setw(36) << left << "benchmark" << right << setw(14) << "baseline"
+      << setw(14) << "current" << setw(10) << "ratio" << endl;
+ for (uint k=0;k<results.size();++k){
+    const BenchResult& r=results[k];
+    map<string,double>::const_iterator it=baseline.find(r.name);
+    cerr << setw(36) << left << r.name << right;
+    if (it==baseline.end()){
+       cerr << setw(14) << "-" << setw(14) << scientific << setprecision(3)
+            << r.seconds_median << setw(10) << "new" << endl;
+       continue;}
+    double ratio=r.seconds_median/it->second;
+    bool slower=(ratio>1.0+tolerance);
+    if (slower) ok=false;
+    cerr << setw(14) << scientific << setprecision(3) << it->second
+         << setw(14) << r.seconds_median << setw(10) << fixed << setprecision(3) << ratio
+         << (slower ? "  SLOWER" : "") << endl;}
+ return ok;
+}
+
+
+// ******************************************************************************
+// *                                                                            *
+// *   Synthetic ensemble:  "ncorr" diagonal correlators of GIOperators, each   *
+// *   with two exponentials plus multiplicative noise that is correlated in    *
+// *   time, so covariance matrices and fits behave as for real data.           *
+// *                                                                            *
+// ******************************************************************************
+
+
+class SyntheticEnsemble
+{
+   string m_dir;
+   string m_binsfile;
+   MCBinsInfo *m_bins_info;
+   MCSamplingInfo *m_samp_info;
+   MCObsGetHandler *m_get;
+   MCObsHandler *m_obs;
+   vector<std::string> m_opstrs;
+   vector<OperatorInfo> m_ops;
+
+ public:
+
+   static const uint nmeas=400;
+   static const uint nboot=256;
+   static const uint ntime=32;
+   static const uint ncorr=4;
+
+   SyntheticEnsemble(const string& dir);
+
+   ~SyntheticEnsemble();
+
+   MCObsHandler& getHandler() {return *m_obs;}
+
+   const std::string& getOperatorString(uint k) const {return m_opstrs.at(k);}
+
+   MCObsInfo getObsInfo(uint corr, uint t) const
+    {return MCObsInfo(CorrelatorAtTimeInfo(m_ops[corr],m_ops[corr],t,true,false),RealPart);}
+
+   const string& getDirectory() const {return m_dir;}
+
+};
+
+
+SyntheticEnsemble::SyntheticEnsemble(const string& dir)
+           : m_dir(dir), m_bins_info(0), m_samp_info(0), m_get(0), m_obs(0)
+{
+ struct stat sb;
+ if ((stat(m_dir.c_str(),&sb)!=0)&&(mkdir(m_dir.c_str(),0755)!=0))
+    throw(std::invalid_argument(string("Could not create scratch directory ")+m_dir));
+ m_binsfile=m_dir+"/synthetic_bins";
+ MCEnsembleInfo ens("sigmond_bench",nmeas,1,16,16,16,64);
+ m_bins_info=new MCBinsInfo(ens);
+ m_samp_info=new MCSamplingInfo(nboot,6754,0);
+ for (uint c=0;c<ncorr;++c){
+    m_opstrs.push_back(string("isosinglet S=0 P=(0,0,0) A1gp ROT ")+make_string(c));
+    m_ops.push_back(OperatorInfo(m_opstrs.back(),OperatorInfo::GenIrrep));}
+
+ mt19937 rng(20230117);
+ normal_distribution<double> gauss(0.0,1.0);
+ {BinsPutHandler BP(*m_bins_info,m_binsfile,Overwrite,false,'F');
+ for (uint c=0;c<ncorr;++c){
+    double E0=0.20+0.05*c, E1=0.70+0.05*c;
+    double A0=1.0, A1=0.6;
+    double sigma=0.02, rho=0.85;
+    vector<Vector<double> > bins(ntime,Vector<double>(nmeas));
+    for (uint m=0;m<nmeas;++m){
+       double z=gauss(rng);
+       for (uint t=0;t<ntime;++t){
+          if (t>0) z=rho*z+sqrt(1.0-rho*rho)*gauss(rng);
+          double corr=A0*exp(-E0*t)+A1*exp(-E1*t);
+          bins[t][m]=corr*(1.0+sigma*exp(0.05*t)*z);}}
+    for (uint t=0;t<ntime;++t)
+       BP.putData(getObsInfo(c,t),bins[t]);}}
+
+ XMLHandler xmlo;
+ xmlo.set_from_string(string("<MCObservables><BinData><FileName>")+m_binsfile
+                      +"</FileName></BinData></MCObservables>");
+ m_get=new MCObsGetHandler(xmlo,*m_bins_info,*m_samp_info);
+ m_obs=new MCObsHandler(*m_get,true);
+}
+
+
+SyntheticEnsemble::~SyntheticEnsemble()
+{
+ delete m_obs;
+ delete m_get;
+ delete m_samp_info;
+ delete m_bins_info;
+ std::remove(m_binsfile.c_str());
+}
+
+
+// ******************************************************************************
+
+
+void make_corr_matrices(uint n, ComplexHermitianMatrix& C0, ComplexHermitianMatrix& CD)
+{
+ mt19937 rng(4711+n);
+ normal_distribution<double> gauss(0.0,1.0);
+ CMatrix Z(n,n);
+ for (uint i=0;i<n;++i)
+ for (uint j=0;j<n;++j)
+    Z(i,j)=complex<double>(gauss(rng),0.1*gauss(rng));
+ C0.resize(n);
+ CD.resize(n);
+ for (uint i=0;i<n;++i)
+ for (uint j=i;j<n;++j){
+    complex<double> s0(0.0,0.0), sD(0.0,0.0);
+    for (uint k=0;k<n;++k){
+       double En=0.2+0.15*k;
+       complex<double> zz=Z(i,k)*conj(Z(j,k));
+       s0+=zz*exp(-En*4.0);
+       sD+=zz*exp(-En*8.0);}
+    C0.put(i,j,s0);
+    CD.put(i,j,sD);}
+}
+
+
+void make_spd_matrix(uint n, RealSymmetricMatrix& A)
+{
+ mt19937 rng(1234+n);
+ normal_distribution<double> gauss(0.0,1.0);
+ RMatrix X(n,n);
+ for (uint i=0;i<n;++i)
+ for (uint j=0;j<n;++j)
+    X(i,j)=gauss(rng);
+ A.resize(n);
+ for (uint i=0;i<n;++i)
+ for (uint j=0;j<=i;++j){
+    double s=(i==j)?double(n):0.0;
+    for (uint k=0;k<n;++k)
+       s+=X(i,k)*X(j,k);
+    A(j,i)=s;}
+}
+
+
+void bench_resampling(BenchRunner& B)
+{
+ B.run("bootstrapper_generate",[](){
+    Bootstrapper boot(SyntheticEnsemble::nmeas,1024,6754,0,false);
+    for (uint k=0;k<1024;++k)
+       boot.getNextResampling();});
+ B.run("bootstrapper_precompute",[](){
+    Bootstrapper boot(SyntheticEnsemble::nmeas,1024,6754,0,true);});
+}
+
+
+void bench_samplings(BenchRunner& B, SyntheticEnsemble& S)
+{
+ MCObsHandler& OH=S.getHandler();
+ vector<MCObsInfo> keys;
+ for (uint c=0;c<SyntheticEnsemble::ncorr;++c)
+ for (uint t=0;t<SyntheticEnsemble::ntime;++t)
+    keys.push_back(S.getObsInfo(c,t));
+ for (uint k=0;k<keys.size();++k)
+    OH.getBins(keys[k]);        // bins read once, as in a real run
+
+ auto erase=[&](){
+    for (uint k=0;k<keys.size();++k)
+       OH.eraseSamplings(keys[k]);};
+ B.run("samplings_jackknife",[&](){
+    for (uint k=0;k<keys.size();++k)
+       OH.getFullAndSamplingValues(keys[k],Jackknife);},erase);
+ B.run("samplings_bootstrap",[&](){
+    for (uint k=0;k<keys.size();++k)
+       OH.getFullAndSamplingValues(keys[k],Bootstrap);},erase);
+
+ for (uint k=0;k<keys.size();++k){
+    OH.getFullAndSamplingValues(keys[k],Jackknife);
+    OH.getFullAndSamplingValues(keys[k],Bootstrap);}
+ uint nt=SyntheticEnsemble::ntime;
+ double sink=0.0;
+ B.run("covariance_jackknife",[&](){
+    for (uint i=0;i<nt;++i)
+    for (uint j=0;j<=i;++j)
+       sink+=OH.getCovariance(keys[i],keys[j],Jackknife);});
+ B.run("covariance_bootstrap",[&](){
+    for (uint i=0;i<nt;++i)
+    for (uint j=0;j<=i;++j)
+       sink+=OH.getCovariance(keys[i],keys[j],Bootstrap);});
+ if (sink==0.123456789) cerr << sink << endl;   // keep the work
+}
+
+
+void bench_eigensolvers(BenchRunner& B)
+{
+ RealSymmetricMatrix A64;
+ make_spd_matrix(64,A64);
+ ComplexHermitianMatrix C0, CD;
+ make_corr_matrices(12,C0,CD);
+ Diagonalizer DG;
+ B.run("diagonalizer_real_64",[&](){
+    RVector eigvals;
+    RMatrix eigvecs;
+    DG.getEigenvectors(A64,eigvals,eigvecs);});
+ B.run("diagonalizer_herm_12",[&](){
+    RVector eigvals;
+    CMatrix eigvecs;
+    DG.getEigenvectors(CD,eigvals,eigvecs);});
+ B.run("diagonalizer_metric_herm_12",[&](){
+    HermDiagonalizerWithMetric DM(1e-12);
+    DM.setExceptionsOff();
+    DM.setMetric(C0);
+    DM.setMatrix(CD);
+    CMatrix eigvecs;
+    DM.getEigenvectors(eigvecs);});
+
+ HermDiagonalizerWithMetric DM(1e-12);
+ DM.setMetric(C0);
+ DM.setMatrix(CD);
+ CMatrix R;
+ DM.getEigenvectors(R);
+ ComplexHermitianMatrix Ar;
+ B.run("matrix_rotation_herm_12",[&](){
+    for (uint k=0;k<64;++k){
+       Ar=CD;
+       doMatrixRotation(Ar,R);}});
+}
+
+
+void bench_minimizers(BenchRunner& B, SyntheticEnsemble& S)
+{
+ MCObsHandler& OH=S.getHandler();
+ OH.setToBootstrapMode();
+ OH.setCovMatToBootstrapMode();
+ OH.setToCorrelated();
+ OH.begin();
+ string fitxml=string("<TemporalCorrelatorFit><GIOperatorString>")
+      +S.getOperatorString(0)
+      +"</GIOperatorString><MinimumTimeSeparation>3</MinimumTimeSeparation>"
+      +"<MaximumTimeSeparation>24</MaximumTimeSeparation><Model>"
+      +"<Type>TimeForwardTwoExponential</Type>"
+      +"<FirstEnergy><Name>bench_E0</Name><IDIndex>0</IDIndex></FirstEnergy>"
+      +"<FirstAmplitude><Name>bench_A0</Name><IDIndex>0</IDIndex></FirstAmplitude>"
+      +"<SqrtGapToSecondEnergy><Name>bench_gap</Name><IDIndex>0</IDIndex></SqrtGapToSecondEnergy>"
+      +"<SecondAmplitudeRatio><Name>bench_A1</Name><IDIndex>0</IDIndex></SecondAmplitudeRatio>"
+      +"</Model>";
+ XMLHandler xmlf;
+ xmlf.set_from_string(fitxml+"</TemporalCorrelatorFit>");
+ RealTemporalCorrelatorFit RTC(xmlf,OH,0);
+ RTC.setObsMeanCov();
+ vector<double> start(RTC.getNumberOfParams());
+ RTC.guessInitialFitParamValues(start);
+
+ vector<pair<string,char> > methods;
+ methods.push_back(make_pair(string("minimizer_lmder"),'L'));
+ methods.push_back(make_pair(string("minimizer_nl2sol"),'N'));
+#ifndef NO_MINUIT
+ methods.push_back(make_pair(string("minimizer_minuit2"),'M'));
+#endif
+ for (uint m=0;m<methods.size();++m){
+    ChiSquareMinimizerInfo info(methods[m].second);
+    ChiSquareMinimizer CSM(RTC,info);
+    B.run(methods[m].first,[&](){
+       double chisq;
+       vector<double> params;
+       CSM.findMinimum(start,chisq,params);});}
+
+    //  the same fit by variable projection over the two energy parameters
+
+ XMLHandler xmlvp;
+ xmlvp.set_from_string(fitxml+"<VariableProjection/></TemporalCorrelatorFit>");
+ RealTemporalCorrelatorFit RTCvp(xmlvp,OH,0);
+ VarProChiSquare VP(RTCvp);
+ VP.setObsMeanCov();
+ vector<double> vpstart(VP.getNumberOfParams());
+ VP.guessInitialFitParamValues(vpstart);
+ for (uint m=0;m<methods.size();++m){
+    ChiSquareMinimizerInfo info(methods[m].second);
+    ChiSquareMinimizer CSM(VP,info);
+    B.run(methods[m].first+"_varpro",[&](){
+       double chisq;
+       vector<double> params;
+       CSM.findMinimum(vpstart,chisq,params);});}
+
+    //  macro-benchmark: full fit over all resamplings as in a DoFit task
+
+ const vector<MCObsInfo>& pinfos=RTC.getFitParamInfos();
+ B.run("fit_all_resamplings_lmder",[&](){
+    ChiSquareMinimizerInfo info('L');
+    double chisq_dof,qual;
+    vector<MCEstimate> bestfit;
+    XMLHandler xmlout("Fit");
+    doChiSquareFitting(RTC,info,chisq_dof,qual,bestfit,xmlout);},
+    [&](){
+    for (uint p=0;p<pinfos.size();++p)
+       OH.eraseSamplings(pinfos[p]);});
+
+ B.run("fit_all_resamplings_lmder_varpro",[&](){
+    ChiSquareMinimizerInfo info('L');
+    double chisq_dof,qual;
+    vector<MCEstimate> bestfit;
+    XMLHandler xmlout("Fit");
+    doChiSquareFitting(RTCvp,info,chisq_dof,qual,bestfit,xmlout);},
+    [&](){
+    for (uint p=0;p<pinfos.size();++p)
+       OH.eraseSamplings(pinfos[p]);});
+}
+
+
+void bench_iomap(BenchRunner& B, const string& dir)
+{
+ const uint nrec=256, nval=1024;
+ vector<MCObsInfo> keys;
+ for (uint k=0;k<nrec;++k)
+    keys.push_back(MCObsInfo(string("bench_record"),k));
+ vector<double> data(nval);
+ for (uint k=0;k<nval;++k)
+    data[k]=sin(0.1*k);
+
+ const char formats[2]={'F','H'};
+ const char* fnames[2]={"fstream","hdf5"};
+ for (int f=0;f<2;++f){
+    string fname=dir+"/iomap_"+fnames[f];
+    string fullname=(formats[f]=='H')?fname+"[/bench]":fname;
+    auto write_all=[&](){
+       IOMap<MCObsInfo,vector<double> > iom;
+       iom.openNew(fullname,"Sigmond--Bench","<Bench/>",false,'N',false,true,formats[f]);
+       for (uint k=0;k<nrec;++k)
+          iom.put(keys[k],data);};
+    auto remove_file=[&](){ std::remove(fname.c_str());};
+    B.run(string("iomap_put_")+fnames[f],write_all,remove_file);
+    if (!B.selected(string("iomap_get_")+fnames[f])) continue;
+    remove_file();
+    write_all();
+    B.run(string("iomap_get_")+fnames[f],[&](){
+       IOMap<MCObsInfo,vector<double> > iom;
+       iom.openReadOnly(fullname,"Sigmond--Bench");
+       vector<double> buffer;
+       for (uint k=0;k<nrec;++k)
+          iom.get(keys[k],buffer);});
+    remove_file();}
+}
+
+
+    //  A generated task input of the size written by analysis scripts:
+    //  a long list of operators and a long <TaskSequence>.
+
+string make_task_input(uint nops, uint ntasks)
+{
+ ostringstream oss;
+ oss << "<SigMonD>\n <Initialize>\n  <ProjectName>bench</ProjectName>\n";
+ oss << "  <!-- operators for all irreps -->\n  <MCObservables>\n   <BLCorrelatorData>\n";
+ for (uint k=0;k<nops;++k)
+    oss << "    <GIOperatorString>isosinglet P=(0,0,"<<k%4<<") A1gp_"<<k/4
+        <<" SS_"<<k%7<<"</GIOperatorString>\n";
+ oss << "   </BLCorrelatorData>\n  </MCObservables>\n </Initialize>\n";
+ oss << " <TaskSequence>\n  <NumberOfThreads>4</NumberOfThreads>\n";
+ for (uint k=0;k<ntasks;++k){
+    oss << "  <Task>\n   <Action>DoFit</Action>\n   <Type>TemporalCorrelator</Type>\n";
+    oss << "   <MinimizerInfo><Method>LMDer</Method></MinimizerInfo>\n";
+    oss << "   <TemporalCorrelatorFit>\n    <Operator>\n";
+    oss << "     <GIOperatorString>isosinglet P=(0,0,"<<k%4<<") A1gp_"<<k%50
+        <<" SS_"<<k%7<<"</GIOperatorString>\n    </Operator>\n";
+    oss << "    <MinimumTimeSeparation>"<<3+k%5<<"</MinimumTimeSeparation>\n";
+    oss << "    <MaximumTimeSeparation>"<<20+k%9<<"</MaximumTimeSeparation>\n";
+    oss << "    <Model><Type>TimeForwardTwoExponential</Type>\n";
+    oss << "     <FirstEnergy><Name>E</Name><IDIndex>"<<k<<"</IDIndex></FirstEnergy>\n";
+    oss << "     <FirstAmplitude><Name>A</Name><IDIndex>"<<k<<"</IDIndex></FirstAmplitude>\n";
+    oss << "    </Model>\n   </TemporalCorrelatorFit>\n  </Task>\n";}
+ oss << " </TaskSequence>\n</SigMonD>\n";
+ return oss.str();
+}
+
+
+void bench_xml(BenchRunner& B)
+{
+ string input(make_task_input(4000,4000));
+ B.run("xml_parse",[&](){
+    XMLHandler xmlin;
+    xmlin.set_from_string(input);});
+
+    //  the lookups done while setting up and dispatching the tasks
+
+ XMLHandler xmlin;
+ xmlin.set_from_string(input);
+ uint sink=0;
+ B.run("xml_lookup",[&](){
+    XMLHandler xmlt(xmlin,"TaskSequence");
+    uint nthreads=1;
+    xmlreadifchild(xmlt,"NumberOfThreads",nthreads);
+    XMLHandler xmlo(xmlin,"BLCorrelatorData");
+    sink+=xmlo.count_among_children("GIOperatorString");
+    list<XMLHandler> tasks=xmlt.find_among_children("Task");
+    for (list<XMLHandler>::iterator it=tasks.begin();it!=tasks.end();++it){
+       string action, key;
+       xmlreadchild(*it,"Action",action);
+       xmlreadifchild(*it,"ShardKey",key);
+       XMLHandler xmlf(*it,"TemporalCorrelatorFit");
+       uint tmin=0;
+       xmlread(xmlf,"MinimumTimeSeparation",tmin,"bench");
+       sink+=tmin+xmlf.count_among_children("Operator");}});
+ if (sink==1) cerr << sink << endl;   // keep the work
+}
+
+
+// ******************************************************************************
+
+
+int main(int argc, const char* argv[])
+{
+ vector<string> tokens(argc-1);
+ for (int k=1;k<argc;++k)
+    tokens[k-1]=string(argv[k]);
+
+ bool quick=false, list_only=false;
+ string filter, outfile, comparefile, dir("sigmond_bench_tmp");
+ double tolerance=0.10;
+ for (uint k=0;k<tokens.size();++k){
+    const string& tk=tokens[k];
+    bool hasval=(k+1<tokens.size());
+    if ((tk=="-h")||(tk=="--help")){
+       print_help();
+       return 0;}
+    else if ((tk=="-l")||(tk=="--list")) list_only=true;
+    else if ((tk=="-q")||(tk=="--quick")) quick=true;
+    else if (((tk=="-f")||(tk=="--filter"))&&(hasval)) filter=tokens[++k];
+    else if (((tk=="-o")||(tk=="--output"))&&(hasval)) outfile=tokens[++k];
+    else if (((tk=="-c")||(tk=="--compare"))&&(hasval)) comparefile=tokens[++k];
+    else if (((tk=="-d")||(tk=="--dir"))&&(hasval)) dir=tokens[++k];
+    else if (((tk=="-t")||(tk=="--tolerance"))&&(hasval)){
+       tolerance=atof(tokens[++k].c_str());
+       if (!(tolerance>=0.0)){
+          cerr << "invalid tolerance "<<tokens[k]<<endl;
+          return 1;}}
+    else{
+       cerr << "invalid argument "<<tk<<endl;
+       print_help();
+       return 1;}}
+
+ BenchRunner B(quick,filter,list_only);
+ try{
+    map<string,double> baseline;
+    if ((!comparefile.empty())&&(!list_only))
+       baseline=read_baseline(comparefile);
+
+    bench_resampling(B);
+    bench_eigensolvers(B);
+    bench_xml(B);
+    {SyntheticEnsemble S(dir);      // cheap to set up, even if not used
+    bench_samplings(B,S);
+    bench_minimizers(B,S);
+    bench_iomap(B,S.getDirectory());}
+    rmdir(dir.c_str());
+    if (list_only) return 0;
+
+    if (outfile.empty())
+       write_json(cout,B.getResults(),quick);
+    else{
+       ofstream out(outfile.c_str());
+       if (!out)
+          throw(std::invalid_argument(string("Could not open output file ")+outfile));
+       write_json(out,B.getResults(),quick);}
+
+    if (!comparefile.empty())
+       return compare_with_baseline(B.getResults(),baseline,tolerance) ? 0 : 1;}
+ catch(const std::exception& xp){
+    cerr << "sigmond_bench error: "<<xp.what()<<endl;
+    rmdir(dir.c_str());
+    return 1;}
+ return 0;
+}
+
+// ******************************************************************************
@@ -57,6 +57,11 @@ void printData(const vector<double>& data, char ftype)
     cout << "["<<k<<"] = "<<data[k] << endl;}
 }
 
+void printData(const vector<float>& data, char ftype)
+{
+ printData(vector<double>(data.begin(),data.end()),ftype);
+}
+
 void printData(const Array<double>& data, char ftype)
 {
  cout.precision(15);
@@ -245,6 +250,8 @@ int main(int argc, const char* argv[])
  IOMap<MCObsInfo,vector<double> > iom;
  string sID("Sigmond--SamplingsFile");
  string bID("Sigmond--BinsFile");
+ IOMap<MCObsInfo,vector<float> > iomf;
+ string bfID("Sigmond--BinsFile-Float");
  IOMap<UIntKey,Array<std::complex<double> > > iopc;
  string spIDc("Sigmond--SinglePivotFile-CN");
 // string rpIDc("Sigmond--RollingPivotFile-CN");
@@ -261,6 +268,10 @@ int main(int argc, const char* argv[])
     iom.openReadOnly(filename,bID);
     cout <<endl<< "This is a Sigmond bins file"<<iom.get_format()<<endl;
     squery_outputter(iom,'B',header,numrec,keys,csum,endian,values,keyxmls);}
+ else if (ID==bfID){
+    iomf.openReadOnly(filename,bfID);
+    cout <<endl<< "This is a Sigmond single-precision bins file"<<iomf.get_format()<<endl;
+    squery_outputter(iomf,'B',header,numrec,keys,csum,endian,values,keyxmls);}
  else if (ID==spIDr){
     iopr.openReadOnly(filename,spIDr);
     cout <<endl<< "This is a Sigmond single pivot file with real numbers"<<iopr.get_format()<<endl;
@@ -0,0 +1,540 @@
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <set>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sys/stat.h>
+#include "xml_handler.h"
+#include "ensemble_info.h"
+#include "bins_info.h"
+#include "bins_handler.h"
+#include "correlator_matrix_info.h"
+#include "mcobs_info.h"
+
+using namespace std;
+
+// ******************************************************************************
+// *                                                                            *
+// *   "sigmond_synth" writes a synthetic bins file for a correlator matrix     *
+// *   with a known spectrum.  It is meant for scale and load testing: the      *
+// *   files are shaped like production data (many operators, time slices       *
+// *   and configurations) but are produced directly in the binary format       *
+// *   read by "BinsGetHandler", in either fstream or HDF5 format.              *
+// *                                                                            *
+// *   Program takes a single argument that is the name of the input file,      *
+// *   which must contain a single XML document of the form:                    *
+// *                                                                            *
+// *    <SigMonDSynth>                                                          *
+// *       <Ensemble>                                                           *
+// *          <Id>synth_A</Id>                                                  *
+// *          <NMeas>2000</NMeas>                                               *
+// *          <NStreams>1</NStreams>       (optional: default 1)                *
+// *          <NSpace>32</NSpace>                                               *
+// *          <NTime>64</NTime>                                                 *
+// *          <CLSWeights>                 (optional)                           *
+// *             <Spread>0.05</Spread>                                          *
+// *             <KnownEnsemblesFile>synth_ens.xml</KnownEnsemblesFile>         *
+// *          </CLSWeights>                                                     *
+// *       </Ensemble>                                                          *
+// *       <TweakEnsemble>                 (optional)                           *
+// *          <Rebin>2</Rebin>                                                  *
+// *          <Omissions>2 7 11</Omissions>                                     *
+// *       </TweakEnsemble>                                                     *
+// *       <CorrelatorMatrixInfo> ... </CorrelatorMatrixInfo>                   *
+// *       <MinTimeSep>0</MinTimeSep>      (optional: default 0)                *
+// *       <MaxTimeSep>31</MaxTimeSep>     (optional: default NTime/2)          *
+// *       <Spectrum>                                                           *
+// *          <Energies>0.2 0.35 0.5</Energies>                                 *
+// *          <Overlaps>...</Overlaps>     (optional)                           *
+// *       </Spectrum>                                                          *
+// *       <Noise>                         (optional)                           *
+// *          <Relative>0.02</Relative>                                         *
+// *          <Growth>0.03</Growth>                                             *
+// *          <TimeCorrelation>0.8</TimeCorrelation>                            *
+// *          <AutoCorrelation>0.3</AutoCorrelation>                            *
+// *          <ElementFraction>0.2</ElementFraction>                            *
+// *          <Seed>1234</Seed>                                                 *
+// *       </Noise>                                                             *
+// *       <FileName>synth.h5[/bins]</FileName>  (HDF5 needs a root path)       *
+// *       <FileFormat>hdf5</FileFormat>   (or fstr: default if absent)         *
+// *       <WriteMode>overwrite</WriteMode> (optional: protect, update)         *
+// *       <SinglePrecision/>              (optional)                           *
+// *       <UseCheckSums/>                 (optional)                           *
+// *       <FlushEvery>64</FlushEvery>     (optional)                           *
+// *    </SigMonDSynth>                                                         *
+// *                                                                            *
+// *   The correlators of the operators O_a are given by                        *
+// *                                                                            *
+// *      C_ab(t) = sum_n  Z_an Z_bn exp(-E_n t) (1 + s(t) eta_n(t))            *
+// *                  + f s(t) sqrt(S_aa(t) S_bb(t)) eps_ab(t),                 *
+// *                                                                            *
+// *   where S_ab(t) is the noiseless part, s(t) = Relative*exp(Growth*t) and   *
+// *   f is the <ElementFraction>.  The level noise eta_n(t) is shared by all   *
+// *   elements of the matrix, so the elements are correlated with each         *
+// *   other, and eps_ab(t) is independent noise for each element.  Both are    *
+// *   unit Gaussian processes with correlation <TimeCorrelation> between       *
+// *   adjacent time slices and <AutoCorrelation> between successive            *
+// *   measurements in the same Markov-chain stream (first-order                *
+// *   autoregressive in each direction).  Off-diagonal elements also get an    *
+// *   imaginary part consisting of element noise only.                         *
+// *                                                                            *
+// *   The overlaps Z_an are given in <Overlaps> as NOps x NLevels values in    *
+// *   row-major order, with operators in the order of the correlator matrix.   *
+// *   If absent, random overlaps with each operator dominated by one level     *
+// *   are drawn from the seed.                                                 *
+// *                                                                            *
+// *   With <CLSWeights>, log-normal weights with the given spread about 1      *
+// *   are drawn, and a known-ensembles file containing this ensemble and its   *
+// *   weights is written (the same file must then be given in the              *
+// *   <KnownEnsemblesFile> tag of SigMonD).  Without it, the ensemble id       *
+// *   has the "id|nmeas|nstreams|nx|ny|nz|nt" form and no file is needed.      *
+// *   Omitted measurements are dropped and the remaining measurements are      *
+// *   (weight) averaged into bins exactly as "MCObsGetHandler" does, so the    *
+// *   file must be read with the same <TweakEnsemble> settings.                *
+// *                                                                            *
+// *   Data are streamed to disk one matrix element at a time.  Memory use is   *
+// *   dominated by the shared level noise, NLevels x NTimes x NMeas doubles,   *
+// *   and the file map is flushed every <FlushEvery> elements.  Each element   *
+// *   uses its own random number stream derived from the seed, so the output   *
+// *   does not depend on the order in which elements are generated.            *
+// *                                                                            *
+// ******************************************************************************
+
+
+void print_help()
+{
+ cout << endl;
+ cout << " \"sigmond_synth\" writes a synthetic bins file for a correlator"<<endl;
+ cout << "   matrix with a known multi-exponential spectrum, for scale and"<<endl;
+ cout << "   load testing."<<endl<<endl;
+ cout << " Usage:  sigmond_synth input.xml"<<endl;
+ cout << "         sigmond_synth -h, --help"<<endl<<endl;
+ cout << " The input file should have the format"<<endl;
+ cout << "   <SigMonDSynth>"<<endl;
+ cout << "      <Ensemble>"<<endl;
+ cout << "         <Id>synth_A</Id>"<<endl;
+ cout << "         <NMeas>2000</NMeas>"<<endl;
+ cout << "         <NStreams>1</NStreams>   (optional)"<<endl;
+ cout << "         <NSpace>32</NSpace>"<<endl;
+ cout << "         <NTime>64</NTime>"<<endl;
+ cout << "         <CLSWeights>  (optional)"<<endl;
+ cout << "            <Spread>0.05</Spread>"<<endl;
+ cout << "            <KnownEnsemblesFile>synth_ens.xml</KnownEnsemblesFile>"<<endl;
+ cout << "         </CLSWeights>"<<endl;
+ cout << "      </Ensemble>"<<endl;
+ cout << "      <TweakEnsemble><Rebin>2</Rebin><Omissions>2 7</Omissions></TweakEnsemble> (optional)"<<endl;
+ cout << "      <CorrelatorMatrixInfo> ... </CorrelatorMatrixInfo>"<<endl;
+ cout << "      <MinTimeSep>0</MinTimeSep>  <MaxTimeSep>31</MaxTimeSep>  (optional)"<<endl;
+ cout << "      <Spectrum>"<<endl;
+ cout << "         <Energies>0.2 0.35 0.5</Energies>"<<endl;
+ cout << "         <Overlaps>...</Overlaps>  (optional: NOps x NLevels, row-major)"<<endl;
+ cout << "      </Spectrum>"<<endl;
+ cout << "      <Noise>  (optional)"<<endl;
+ cout << "         <Relative>0.02</Relative>  <Growth>0.03</Growth>"<<endl;
+ cout << "         <TimeCorrelation>0.8</TimeCorrelation>"<<endl;
+ cout << "         <AutoCorrelation>0.3</AutoCorrelation>"<<endl;
+ cout << "         <ElementFraction>0.2</ElementFraction>  <Seed>1234</Seed>"<<endl;
+ cout << "      </Noise>"<<endl;
+ cout << "      <FileName>synth.h5[/bins]</FileName>  (HDF5 needs a root path)"<<endl;
+ cout << "      <FileFormat>fstr</FileFormat>  (or hdf5: default if absent)"<<endl;
+ cout << "      <WriteMode>overwrite</WriteMode>  (optional: protect, update)"<<endl;
+ cout << "      <SinglePrecision/>  <UseCheckSums/>  (optional)"<<endl;
+ cout << "      <FlushEvery>64</FlushEvery>  (optional)"<<endl;
+ cout << "   </SigMonDSynth>"<<endl;
+ cout << endl;
+}
+
+
+// ******************************************************************************
+
+
+class SyntheticEnsembleWriter
+{
+
+   MCBinsInfo *m_bins_info;
+   CorrelatorMatrixInfo *m_cormat;
+   vector<OperatorInfo> m_ops;
+   uint m_nmeas, m_tmin, m_tmax;
+   vector<double> m_energies;
+   vector<double> m_overlaps;          // nops x nlevels
+   double m_relative, m_growth, m_rho_t, m_rho_m, m_elemfrac;
+   unsigned long m_seed;
+   vector<double> m_weights;           // original measurements, empty if unweighted
+   vector<bool> m_stream_start;
+   vector<double> m_level_noise;       // nlevels x ntimes x nmeas
+   string m_filename;
+   char m_file_format;
+   WriteMode m_wmode;
+   bool m_single, m_checksums;
+   uint m_flush_every;
+
+#ifndef NO_CXX11
+   SyntheticEnsembleWriter() = delete;
+   SyntheticEnsembleWriter(const SyntheticEnsembleWriter&) = delete;
+   SyntheticEnsembleWriter& operator=(const SyntheticEnsembleWriter&) = delete;
+#else
+   SyntheticEnsembleWriter();
+   SyntheticEnsembleWriter(const SyntheticEnsembleWriter&);
+   SyntheticEnsembleWriter& operator=(const SyntheticEnsembleWriter&);
+#endif
+
+ public:
+
+   SyntheticEnsembleWriter(XMLHandler& xmlin);
+
+   ~SyntheticEnsembleWriter();
+
+   void write();
+
+ private:
+
+   void setup_ensemble(XMLHandler& xmlin);
+
+   void write_known_ensembles_file(const string& ensfile, const string& id, uint nstreams,
+                                   uint nspace, uint ntime);
+
+   void ar_noise(mt19937_64& rng, double* out);
+
+   void make_bins(const double* meas, Vector<double>& bins) const;
+
+   uint ntimes() const {return m_tmax-m_tmin+1;}
+
+   uint nlevels() const {return m_energies.size();}
+
+};
+
+
+SyntheticEnsembleWriter::SyntheticEnsembleWriter(XMLHandler& xmlin)
+          : m_bins_info(0), m_cormat(0)
+{
+ XMLHandler xmls(xmlin,"SigMonDSynth");
+
+ m_relative=0.02; m_growth=0.03; m_rho_t=0.8; m_rho_m=0.3; m_elemfrac=0.2;
+ m_seed=1234;
+ if (xmls.count_among_children("Noise")==1){
+    XMLHandler xmln(xmls,"Noise");
+    xmlreadifchild(xmln,"Relative",m_relative);
+    xmlreadifchild(xmln,"Growth",m_growth);
+    xmlreadifchild(xmln,"TimeCorrelation",m_rho_t);
+    xmlreadifchild(xmln,"AutoCorrelation",m_rho_m);
+    xmlreadifchild(xmln,"ElementFraction",m_elemfrac);
+    xmlreadifchild(xmln,"Seed",m_seed);}
+ if ((m_relative<0.0)||(m_elemfrac<0.0))
+    throw(std::invalid_argument("<Relative> and <ElementFraction> must not be negative"));
+ if ((m_rho_t<0.0)||(m_rho_t>=1.0)||(m_rho_m<0.0)||(m_rho_m>=1.0))
+    throw(std::invalid_argument("<TimeCorrelation> and <AutoCorrelation> must be in [0,1)"));
+
+ setup_ensemble(xmls);
+
+ XMLHandler xmlc(xmls,"CorrelatorMatrixInfo");
+ m_cormat=new CorrelatorMatrixInfo(xmlc);
+ if (m_cormat->subtractVEV())
+    throw(std::invalid_argument("VEV subtraction not supported in sigmond_synth"));
+ const set<OperatorInfo>& ops=m_cormat->getOperators();
+ m_ops.assign(ops.begin(),ops.end());
+
+ uint nt=m_bins_info->getLatticeTimeExtent();
+ m_tmin=0; m_tmax=nt/2;
+ xmlreadifchild(xmls,"MinTimeSep",m_tmin);
+ xmlreadifchild(xmls,"MaxTimeSep",m_tmax);
+ if ((m_tmax<m_tmin)||(m_tmax>=nt))
+    throw(std::invalid_argument("Invalid <MinTimeSep>/<MaxTimeSep> in sigmond_synth"));
+
+ XMLHandler xmlsp(xmls,"Spectrum");
+ xmlreadchild(xmlsp,"Energies",m_energies);
+ if (m_energies.empty())
+    throw(std::invalid_argument("<Energies> must not be empty"));
+ uint nops=m_ops.size();
+ if (xmlsp.count_among_children("Overlaps")==1){
+    xmlreadchild(xmlsp,"Overlaps",m_overlaps);
+    if (m_overlaps.size()!=nops*nlevels())
+       throw(std::invalid_argument("<Overlaps> must have NOps x NLevels values"));}
+ else{
+    mt19937_64 rng(m_seed);
+    normal_distribution<double> gauss(0.0,1.0);
+    m_overlaps.resize(nops*nlevels());
+    for (uint a=0;a<nops;++a)
+    for (uint n=0;n<nlevels();++n)
+       m_overlaps[a*nlevels()+n]=(n==(a%nlevels()))?1.0:0.3*gauss(rng);}
+
+ xmlreadchild(xmls,"FileName",m_filename);
+ string fformat("default");
+ xmlreadifchild(xmls,"FileFormat",fformat);
+ if (fformat=="fstr") m_file_format='F';
+ else if (fformat=="hdf5") m_file_format='H';
+ else if (fformat=="default") m_file_format='D';
+ else throw(std::invalid_argument("<FileFormat> must be fstr or hdf5 or default in sigmond_synth"));
+ m_wmode=Protect;
+ string fmode;
+ if (xmlreadifchild(xmls,"WriteMode",fmode)){
+    fmode=tidyString(fmode);
+    if (fmode=="overwrite") m_wmode=Overwrite;
+    else if (fmode=="update") m_wmode=Update;
+    else if (fmode!="protect")
+       throw(std::invalid_argument("<WriteMode> must be protect, update or overwrite"));}
+ m_single=(xmls.count_among_children("SinglePrecision")>0);
+ m_checksums=(xmls.count_among_children("UseCheckSums")>0);
+ m_flush_every=64;
+ xmlreadifchild(xmls,"FlushEvery",m_flush_every);
+ if (m_flush_every==0) m_flush_every=1;
+}
+
+
+SyntheticEnsembleWriter::~SyntheticEnsembleWriter()
+{
+ delete m_cormat;
+ delete m_bins_info;
+}
+
+
+void SyntheticEnsembleWriter::setup_ensemble(XMLHandler& xmls)
+{
+ XMLHandler xmle(xmls,"Ensemble");
+ string id;
+ uint nstreams=1, nspace, ntime;
+ xmlreadchild(xmle,"Id",id);
+ xmlreadchild(xmle,"NMeas",m_nmeas);
+ xmlreadifchild(xmle,"NStreams",nstreams);
+ xmlreadchild(xmle,"NSpace",nspace);
+ xmlreadchild(xmle,"NTime",ntime);
+ id=tidyString(id);
+ if ((id.empty())||(id.find('|')!=string::npos))
+    throw(std::invalid_argument("Ensemble <Id> must be non-empty with no '|'"));
+ if ((m_nmeas<2)||(nstreams==0)||(nstreams>m_nmeas)||(ntime==0))
+    throw(std::invalid_argument("Invalid ensemble sizes in sigmond_synth"));
+
+ m_stream_start.assign(m_nmeas,false);
+ for (uint s=0;s<nstreams;++s)
+    m_stream_start[(s*m_nmeas)/nstreams]=true;
+
+ MCEnsembleInfo *ens=0;
+ if (xmle.count_among_children("CLSWeights")==1){
+    XMLHandler xmlw(xmle,"CLSWeights");
+    double spread;
+    string ensfile;
+    xmlreadchild(xmlw,"Spread",spread);
+    xmlreadchild(xmlw,"KnownEnsemblesFile",ensfile);
+    if (spread<0.0)
+       throw(std::invalid_argument("<Spread> must not be negative"));
+    mt19937_64 rng(m_seed+1);
+    normal_distribution<double> gauss(0.0,1.0);
+    m_weights.resize(m_nmeas);
+    for (uint m=0;m<m_nmeas;++m)
+       m_weights[m]=exp(spread*gauss(rng)-0.5*spread*spread);
+    ensfile=tidyString(ensfile);
+    write_known_ensembles_file(ensfile,id,nstreams,nspace,ntime);
+    ens=new MCEnsembleInfo(id,ensfile);}
+ else
+    ens=new MCEnsembleInfo(id,m_nmeas,nstreams,nspace,nspace,nspace,ntime);
+
+ m_bins_info=new MCBinsInfo(*ens);
+ delete ens;
+ if (xmls.count_among_children("TweakEnsemble")==1){
+    XMLHandler xmlt(xmls,"TweakEnsemble");
+    uint rebin=1;
+    if (xmlreadifchild(xmlt,"Rebin",rebin))
+       m_bins_info->setRebin(rebin);
+    vector<int> omit;
+    if (xmlreadifchild(xmlt,"Omissions",omit))
+       m_bins_info->addOmissions(set<int>(omit.begin(),omit.end()));}
+ if (m_bins_info->getNumberOfBins()<2)
+    throw(std::invalid_argument("Fewer than two bins after omissions and rebinning"));
+}
+
+
+    //  The file is rewritten from scratch with this one ensemble, so that
+    //  "MCEnsembleInfo" finds the id and its weights.
+
+void SyntheticEnsembleWriter::write_known_ensembles_file(const string& ensfile, const string& id,
+                                                         uint nstreams, uint nspace, uint ntime)
+{
+ if (ensfile.empty())
+    throw(std::invalid_argument("Empty <KnownEnsemblesFile> name"));
+ ofstream fout(ensfile.c_str());
+ if (!fout)
+    throw(std::invalid_argument(string("Could not write known ensembles file ")+ensfile));
+ fout << "<KnownEnsembles>"<<endl;
+ fout << "  <Infos>"<<endl;
+ fout << "    <EnsembleInfo>"<<endl;
+ fout << "      <Id>"<<id<<"</Id>"<<endl;
+ fout << "      <NStreams>"<<nstreams<<"</NStreams>"<<endl;
+ fout << "      <NMeas>"<<m_nmeas<<"</NMeas>"<<endl;
+ fout << "      <NSpace>"<<nspace<<"</NSpace>"<<endl;
+ fout << "      <NTime>"<<ntime<<"</NTime>"<<endl;
+ fout << "      <Weighted/>"<<endl;
+ fout << "    </EnsembleInfo>"<<endl;
+ fout << "  </Infos>"<<endl;
+ fout << "  <CLSEnsembleWeights>"<<endl;
+ fout << "    <Ensemble>"<<endl;
+ fout << "      <Id>"<<id<<"</Id>"<<endl;
+ fout << "      <Weights>";
+ fout.precision(15);
+ for (uint m=0;m<m_nmeas;++m)
+    fout << " "<<m_weights[m];
+ fout << " </Weights>"<<endl;
+ fout << "    </Ensemble>"<<endl;
+ fout << "  </CLSEnsembleWeights>"<<endl;
+ fout << "</KnownEnsembles>"<<endl;
+}
+
+
+    //  Unit-variance Gaussian noise out[t*nmeas+m], first-order autoregressive
+    //  in t (within a measurement) and in m (within a stream).
+
+void SyntheticEnsembleWriter::ar_noise(mt19937_64& rng, double* out)
+{
+ normal_distribution<double> gauss(0.0,1.0);
+ double ct=sqrt(1.0-m_rho_t*m_rho_t);
+ double cm=sqrt(1.0-m_rho_m*m_rho_m);
+ uint nt=ntimes();
+ for (uint m=0;m<m_nmeas;++m){
+    double xi=0.0;
+    for (uint t=0;t<nt;++t){
+       xi=(t==0)?gauss(rng):m_rho_t*xi+ct*gauss(rng);
+       double* v=out+size_t(t)*m_nmeas+m;
+       *v=(m_stream_start[m])?xi:m_rho_m*(*(v-1))+cm*xi;}}
+}
+
+
+    //  Same ordering as MCObsGetHandler::read_bl_data: skip omissions,
+    //  then (weighted) average consecutive groups of "rebin" measurements.
+
+void SyntheticEnsembleWriter::make_bins(const double* meas, Vector<double>& bins) const
+{
+ uint nbins=m_bins_info->getNumberOfBins();
+ uint rebin=m_bins_info->getRebinFactor();
+ const set<unsigned int>& omit=m_bins_info->getOmissions();
+ bool weighted=!m_weights.empty();
+ set<unsigned int>::const_iterator om=omit.begin();
+ uint count=0;
+ while ((om!=omit.end())&&(count==*om)){om++; ++count;}
+ for (uint k=0;k<nbins;++k){
+    double num=0.0, den=0.0;
+    for (uint j=0;j<rebin;++j){
+       double w=(weighted)?m_weights[count]:1.0;
+       num+=w*meas[count];
+       den+=w;
+       ++count; while ((om!=omit.end())&&(count==*om)){om++; ++count;}}
+    bins[k]=num/den;}
+}
+
+
+void SyntheticEnsembleWriter::write()
+{
+ uint nops=m_ops.size();
+ uint nlev=nlevels();
+ uint nt=ntimes();
+ bool herm=m_cormat->isHermitian();
+ size_t nmt=size_t(nt)*m_nmeas;
+
+ uint nelems=0, nrecords=0;
+ for (uint a=0;a<nops;++a)
+ for (uint b=(herm?a:0);b<nops;++b){
+    ++nelems;
+    nrecords+=((a==b)?1:2)*nt;}
+ double nbytes=double(nrecords)*double(m_bins_info->getNumberOfBins())*(m_single?4.0:8.0);
+ cout << "Synthetic ensemble "<<m_bins_info->getMCEnsembleInfo().getId()<<endl;
+ cout << "  "<<nops<<" operators, "<<nlev<<" levels, times "<<m_tmin<<".."<<m_tmax
+      <<", "<<m_nmeas<<" measurements, "<<m_bins_info->getNumberOfBins()<<" bins"<<endl;
+ cout << "  "<<nelems<<" matrix elements, "<<nrecords<<" records, about "
+      <<fixed<<setprecision(1)<<nbytes/1048576.0<<" MB of data"<<endl;
+ cout << "  level noise buffer "<<double(nlev)*double(nmt)*8.0/1048576.0<<" MB"<<endl;
+
+ m_level_noise.resize(size_t(nlev)*nmt);
+ for (uint n=0;n<nlev;++n){
+    mt19937_64 rng(m_seed+1000003ULL*(n+2));
+    ar_noise(rng,&m_level_noise[size_t(n)*nmt]);}
+
+ BinsPutHandler BP(*m_bins_info,m_filename,m_wmode,m_checksums,m_file_format,m_single);
+
+ vector<double> sig(size_t(nops)*nt);     // noiseless diagonal correlators
+ for (uint a=0;a<nops;++a)
+ for (uint t=0;t<nt;++t){
+    double s=0.0;
+    for (uint n=0;n<nlev;++n){
+       double z=m_overlaps[a*nlev+n];
+       s+=z*z*exp(-m_energies[n]*double(t+m_tmin));}
+    sig[a*nt+t]=s;}
+
+ vector<double> re(nmt), eps(nmt), eps_im;
+ vector<double> amp(nlev), scale(nt);
+ for (uint t=0;t<nt;++t)
+    scale[t]=m_relative*exp(m_growth*double(t+m_tmin));
+ Vector<double> bins(m_bins_info->getNumberOfBins());
+ uint elem=0;
+ for (uint a=0;a<nops;++a)
+ for (uint b=(herm?a:0);b<nops;++b,++elem){
+    mt19937_64 rng(m_seed^(0x9E3779B97F4A7C15ULL*(elem+1)));
+    ar_noise(rng,eps.data());
+    bool offdiag=(a!=b);
+    if (offdiag){
+       eps_im.resize(nmt);
+       ar_noise(rng,eps_im.data());}
+    for (uint t=0;t<nt;++t){
+       double tt=double(t+m_tmin);
+       double S=0.0;
+       for (uint n=0;n<nlev;++n){
+          amp[n]=m_overlaps[a*nlev+n]*m_overlaps[b*nlev+n]*exp(-m_energies[n]*tt);
+          S+=amp[n];}
+       double enoise=m_elemfrac*scale[t]*sqrt(sig[a*nt+t]*sig[b*nt+t]);
+       double* r=&re[size_t(t)*m_nmeas];
+       const double* e=&eps[size_t(t)*m_nmeas];
+       for (uint m=0;m<m_nmeas;++m)
+          r[m]=S+enoise*e[m];
+       for (uint n=0;n<nlev;++n){
+          double c=amp[n]*scale[t];
+          const double* eta=&m_level_noise[size_t(n)*nmt+size_t(t)*m_nmeas];
+          for (uint m=0;m<m_nmeas;++m)
+             r[m]+=c*eta[m];}
+       CorrelatorAtTimeInfo corrt(m_ops[a],m_ops[b],t+m_tmin,herm,false);
+       make_bins(r,bins);
+       BP.putData(MCObsInfo(corrt,RealPart),bins);
+       if (offdiag){
+          const double* ei=&eps_im[size_t(t)*m_nmeas];
+          for (uint m=0;m<m_nmeas;++m)
+             r[m]=enoise*ei[m];
+          make_bins(r,bins);
+          BP.putData(MCObsInfo(corrt,ImaginaryPart),bins);}}
+    if (((elem+1)%m_flush_every)==0){
+       BP.flush();
+       cout << "  "<<elem+1<<" of "<<nelems<<" elements written"<<endl;}}
+ BP.close();
+ cout << "Synthetic bins written to "<<m_filename<<endl;
+}
+
+
+// ******************************************************************************
+
+
+int main(int argc, const char* argv[])
+{
+ vector<string> tokens(argc-1);
+ for (int k=1;k<argc;++k){
+    tokens[k-1]=string(argv[k]);}
+
+ if ((tokens.size()==1)&&((tokens[0]=="-h")||(tokens[0]=="--help"))){
+    print_help();
+    return 0;}
+
+ if (tokens.size()!=1){
+    cout << "Error: sigmond_synth requires an input file name as the only argument"<<endl;
+    cout << "Use 'sigmond_synth --help' for usage information."<<endl;
+    return 1;}
+
+ try{
+    XMLHandler xmlin;
+    xmlin.set_exceptions_on();
+    xmlin.set_from_file(tokens[0]);
+    SyntheticEnsembleWriter synth(xmlin);
+    synth.write();}
+ catch(const std::exception& msg){
+    cout << "Error: "<<msg.what()<<endl;
+    return 1;}
+
+ return 0;
+}
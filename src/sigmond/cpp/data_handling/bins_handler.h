@@ -59,6 +59,18 @@
  // *   "Overwrite" mode AND the size of the data to be put does not exceed the     *
  // *   size of the data already in the file for that key.                          *
  // *                                                                               *
+ // *   Bins can be stored in files in single precision, which halves the file      *
+ // *   size and the I/O time.  The "put" handler writes single-precision files     *
+ // *   if its "single_precision" argument is true.  Such files have the file ID    *
+ // *   "Sigmond--BinsFile-Float" instead of "Sigmond--BinsFile", but the same      *
+ // *   header.  The "get" handler reads both kinds of files, determining the       *
+ // *   precision of each file from its ID, and always returns double-precision     *
+ // *   values, so all subsequent computations are done in double precision.        *
+ // *   Records cannot be added to an existing file of a different precision.       *
+ // *   Only the files are in single precision: the values returned, and the        *
+ // *   bins held by MCObsHandler, are always double precision, so memory use       *
+ // *   is not reduced.                                                             *
+ // *                                                                               *
  // *********************************************************************************
 
 
@@ -75,58 +87,75 @@ class BinsGetHandler
 
     MCBinsInfo m_bins_info;
     DataGetHandlerMF<BinsGetHandler,MCObsInfo,std::vector<double> > *m_get;
+    DataGetHandlerMF<BinsGetHandler,MCObsInfo,std::vector<float> > *m_getf;   // single precision
 
  public:
 
     BinsGetHandler(const MCBinsInfo& binfo, const std::set<std::string>& file_names, 
                    bool use_checksums=false)
-           : m_bins_info(binfo), m_get(0)     // sets m_bins_info temporarily
-     {m_get=new DataGetHandlerMF<BinsGetHandler,MCObsInfo,std::vector<double> >(*this,
-            file_names,std::string("Sigmond--BinsFile"),use_checksums);}
+           : m_bins_info(binfo), m_get(0), m_getf(0)     // sets m_bins_info temporarily
+     {std::set<std::string> dfiles, ffiles;
+      for (std::set<std::string>::const_iterator it=file_names.begin();it!=file_names.end();++it)
+         if (isSinglePrecisionFile(*it)) ffiles.insert(*it); else dfiles.insert(*it);
+      m_get=new DataGetHandlerMF<BinsGetHandler,MCObsInfo,std::vector<double> >(*this,
+            dfiles,std::string("Sigmond--BinsFile"),use_checksums);
+      try{
+         m_getf=new DataGetHandlerMF<BinsGetHandler,MCObsInfo,std::vector<float> >(*this,
+               ffiles,std::string("Sigmond--BinsFile-Float"),use_checksums);
+         check_no_common_keys();}
+      catch(const std::exception& xp){
+         delete m_get; delete m_getf; throw;}}
 
     void addFile(const std::string& file_name)
-     {m_get->addFile(file_name);}
+     {if (isSinglePrecisionFile(file_name)) m_getf->addFile(file_name);
+      else m_get->addFile(file_name);
+      check_no_common_keys(file_name);}
 
     bool addFile(const std::string& file_name, const std::set<MCObsInfo>& keys_to_keep)
-     {return m_get->addFile(file_name,keys_to_keep);}
+     {bool flag=(isSinglePrecisionFile(file_name)) ? m_getf->addFile(file_name,keys_to_keep)
+                                                   : m_get->addFile(file_name,keys_to_keep);
+      check_no_common_keys(file_name);
+      return flag;}
 
     void removeFile(const std::string& file_name)
-     {m_get->removeFile(file_name);}
+     {m_get->removeFile(file_name); m_getf->removeFile(file_name);}
 
     void clear()
-     {m_get->clear();}
+     {m_get->clear(); m_getf->clear();}
  
     void close()
-     {m_get->close();}
+     {m_get->close(); m_getf->close();}
  
-    ~BinsGetHandler() {delete m_get;}
+    ~BinsGetHandler() {delete m_get; delete m_getf;}
 
     MCBinsInfo getBinsInfo() const
      {return m_bins_info;}
  
     bool keepKeys(const std::set<MCObsInfo>& keys_to_keep) 
-     {return m_get->keepKeys(keys_to_keep);}
+     {m_get->keepKeys(keys_to_keep); m_getf->keepKeys(keys_to_keep);
+      return (size()==keys_to_keep.size());}
 
 
     bool queryData(const MCObsInfo& rkey) const
-     {return m_get->queryData(rkey);}
+     {return (m_get->queryData(rkey))||(m_getf->queryData(rkey));}
 
     void getData(const MCObsInfo& rkey, Vector<double>& result) const
-     {std::vector<double> buffer; m_get->getData(rkey,buffer);
+     {std::vector<double> buffer; 
+      if (!get_buffer(rkey,buffer)) m_get->getData(rkey,buffer);   // throws
       result=Vector<double>(buffer);}
 
     bool getDataMaybe(const MCObsInfo& rkey, Vector<double>& result) const
      {result.clear(); std::vector<double> buffer; 
-      bool info=m_get->getDataMaybe(rkey,buffer);
+      bool info=get_buffer(rkey,buffer);
       if (info) result=Vector<double>(buffer);
       return info;}
 
           // sym averages with Herm transpose if isHermitianCorrelatorAtTime
 
     bool querySymData(const MCObsInfo& rkey) const
-     {if ((rkey.isImagDiagOfHermCorr())||(m_get->queryData(rkey))) return true;
+     {if ((rkey.isImagDiagOfHermCorr())||(queryData(rkey))) return true;
       if (!(rkey.isHermitianCorrelatorAtTime())) return false;
-      return m_get->queryData(rkey.getTimeFlipped());}
+      return queryData(rkey.getTimeFlipped());}
 
     void getSymData(const MCObsInfo& rkey, Vector<double>& result) const
      {bool info=getSymDataMaybe(rkey,result);
@@ -138,14 +167,14 @@ class BinsGetHandler
       result.clear();
       if (rkey.hasNoRelatedFlip()){
          std::vector<double> buffer; 
-         bool info=m_get->getDataMaybe(rkey,buffer);
+         bool info=get_buffer(rkey,buffer);
          if (info) result=Vector<double>(buffer);
          return info;}
       std::vector<double> buffer;
-      bool info1=m_get->getDataMaybe(rkey,buffer);
+      bool info1=get_buffer(rkey,buffer);
       if (info1) result=Vector<double>(buffer);
       Vector<double> res2;
-      bool info2=m_get->getDataMaybe(rkey.getTimeFlipped(),buffer);
+      bool info2=get_buffer(rkey.getTimeFlipped(),buffer);
       if (info2){
          res2=Vector<double>(buffer);
          if (rkey.isImaginaryPart()) res2*=-1.0;}
@@ -156,19 +185,39 @@ class BinsGetHandler
 
 
     std::set<MCObsInfo> getKeys() const
-     {return m_get->getKeys();}
+     {std::set<MCObsInfo> keys(m_get->getKeys());
+      std::set<MCObsInfo> fkeys(m_getf->getKeys());
+      keys.insert(fkeys.begin(),fkeys.end());
+      return keys;}
 
     void outputKeys(XMLHandler& xmlout) const
-     {m_get->outputKeys(xmlout);}
+     {m_get->outputKeys(xmlout);
+      XMLHandler xmlf; m_getf->outputKeys(xmlf);
+      std::list<XMLHandler> xmlk=xmlf.find_among_children("Key");
+      for (std::list<XMLHandler>::iterator it=xmlk.begin();it!=xmlk.end();++it)
+         xmlout.put_child(*it);}
     
     void getFileMap(XMLHandler& xmlout) const
-     {m_get->getFileMap(xmlout);}
+     {m_get->getFileMap(xmlout);
+      XMLHandler xmlf; m_getf->getFileMap(xmlf);
+      std::list<XMLHandler> xmle=xmlf.find_among_children("Entry");
+      for (std::list<XMLHandler>::iterator it=xmle.begin();it!=xmle.end();++it)
+         xmlout.put_child(*it);}
 
     std::set<std::string> getFileNames() const
-     {return m_get->getFileNames();}
+     {std::set<std::string> fnames(m_get->getFileNames());
+      std::set<std::string> ffnames(m_getf->getFileNames());
+      fnames.insert(ffnames.begin(),ffnames.end());
+      return fnames;}
 
     unsigned int size() const 
-     {return m_get->size();}
+     {return m_get->size()+m_getf->size();}
+
+        // true if the file has the ID of a single-precision bins file
+
+    static bool isSinglePrecisionFile(const std::string& file_name)
+     {std::string ID;
+      return (IOMapPeekID(ID,tidyString(file_name)))&&(tidyString(ID)=="Sigmond--BinsFile-Float");}
 
 
         // check that BinsInfo in header is consistent with
@@ -188,6 +237,28 @@ class BinsGetHandler
     BinsGetHandler();
     BinsGetHandler(const BinsGetHandler& in);
     BinsGetHandler& operator=(const BinsGetHandler& in);
+
+ private:
+
+    bool get_buffer(const MCObsInfo& rkey, std::vector<double>& buffer) const
+     {if (m_get->getDataMaybe(rkey,buffer)) return true;
+      std::vector<float> fbuffer;
+      if (!m_getf->getDataMaybe(rkey,fbuffer)) return false;
+      buffer.assign(fbuffer.begin(),fbuffer.end());
+      return true;}
+
+        // keys must not appear in both a double and a single-precision file
+
+    void check_no_common_keys(const std::string& file_name="")
+     {if ((m_get->size()==0)||(m_getf->size()==0)) return;
+      std::set<MCObsInfo> dkeys(m_get->getKeys()), fkeys(m_getf->getKeys());
+      std::set<MCObsInfo>::const_iterator it=dkeys.begin();
+      for (;it!=dkeys.end();++it){
+         if (fkeys.count(*it)==0) continue;
+         if (!file_name.empty()){
+            m_get->removeFile(file_name); m_getf->removeFile(file_name);}
+         throw(std::runtime_error(std::string("Fatal error: duplicate keys in double and ")
+                +std::string("single-precision bins files in BinsGetHandler")));}}
 };
 
 
@@ -203,16 +274,31 @@ class BinsPutHandler
 
     MCBinsInfo m_bins_info;
     DataPutHandlerSF<BinsPutHandler,MCObsInfo,std::vector<double> > *m_put;
+    DataPutHandlerSF<BinsPutHandler,MCObsInfo,std::vector<float> > *m_putf;  // single precision
 
  public:
 
     BinsPutHandler(const MCBinsInfo& binfo, const std::string& file_name, 
-                   WriteMode wmode=Protect, bool use_checksums=false, char file_format='D')
-           : m_bins_info(binfo), m_put(0)
-     {m_put=new DataPutHandlerSF<BinsPutHandler,MCObsInfo,std::vector<double> >(*this,
-            file_name,std::string("Sigmond--BinsFile"),wmode,use_checksums,file_format);}
+                   WriteMode wmode=Protect, bool use_checksums=false, char file_format='D',
+                   bool single_precision=false)
+           : m_bins_info(binfo), m_put(0), m_putf(0)
+     {if (wmode!=Overwrite){
+         std::string ID;
+         if ((IOMapPeekID(ID,tidyString(file_name)))
+            &&((tidyString(ID)=="Sigmond--BinsFile-Float")!=single_precision))
+            throw(std::invalid_argument(std::string("Bins file ")+file_name
+                  +std::string(" exists with a different precision")));}
+      if (single_precision)
+         m_putf=new DataPutHandlerSF<BinsPutHandler,MCObsInfo,std::vector<float> >(*this,
+               file_name,std::string("Sigmond--BinsFile-Float"),wmode,use_checksums,file_format);
+      else
+         m_put=new DataPutHandlerSF<BinsPutHandler,MCObsInfo,std::vector<double> >(*this,
+               file_name,std::string("Sigmond--BinsFile"),wmode,use_checksums,file_format);}
+
+    ~BinsPutHandler() {delete m_put; delete m_putf;}
 
-    ~BinsPutHandler() {delete m_put;}
+    bool isSinglePrecision() const
+     {return (m_putf!=0);}
 
     void putData(const MCObsInfo& rkey, const Vector<double>& data)
      {if (data.size()!=m_bins_info.getNumberOfBins())
@@ -220,19 +306,24 @@ class BinsPutHandler
       if (!rkey.isSimple())
          throw(std::runtime_error("Only simple observable allowed for BinsPutHandler::putData"));
       try{
-         m_put->putData(rkey,data.c_vector());}
+         if (m_putf){
+            const std::vector<double>& dvals=data.c_vector();
+            std::vector<float> fvals(dvals.begin(),dvals.end());
+            m_putf->putData(rkey,fvals);}
+         else
+            m_put->putData(rkey,data.c_vector());}
       catch(std::exception& xp){
          throw(std::runtime_error(std::string("putData failed: permission problem or record already in file and no overwrite -- ")
            +xp.what()));}}
 
     void flush()
-     {m_put->flush();}
+     {if (m_putf) m_putf->flush(); else m_put->flush();}
   
     void close()
-     {m_put->close();}
+     {if (m_putf) m_putf->close(); else m_put->close();}
  
     bool queryData(const MCObsInfo& rkey)  // already exists?
-     {return m_put->queryData(rkey);}
+     {return (m_putf) ? m_putf->queryData(rkey) : m_put->queryData(rkey);}
 
 
     bool checkHeader(XMLHandler& xmlin)
@@ -2,6 +2,11 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <cstring>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BYTEHANDLER_X86
+#endif
 
 /*
 Copyright (C) 1995-1996 Jean-loup Gailly and Mark Adler
@@ -55,6 +60,9 @@ Comments) 1950 to 1952 in the files ftp://ds.internic.net/rfc/rfc1950.txt
   The table is simply the CRC of all possible eight bit values.  This is all
   the information needed to generate CRC's on data a byte at a time for all
   combinations of CRC register values and incoming bytes.
+
+  Table k (k=1..15) holds the CRC of each byte followed by k zero bytes, so
+  16 bytes can be processed with 16 independent table lookups ("slicing").
 */
 
 using namespace std;
@@ -114,8 +122,20 @@ ByteHandler::ByteHandler()
     0xbdbdf21cL, 0xcabac28aL, 0x53b39330L, 0x24b4a3a6L, 0xbad03605L,
     0xcdd70693L, 0x54de5729L, 0x23d967bfL, 0xb3667a2eL, 0xc4614ab8L,
     0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
-    0x2d02ef8dL })
-  {}
+    0x2d02ef8dL }),  use_clmul(false), swap_level(0)
+{
+ crc_table.resize(16*256);
+ for (int n=0;n<256;++n){
+    n_uint32_t c=crc_table[n];
+    for (int k=1;k<16;++k){
+       c=crc_table[c & 0xff] ^ (c >> 8);
+       crc_table[256*k+n]=c;}}
+#ifdef BYTEHANDLER_X86
+ use_clmul=__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+ if (__builtin_cpu_supports("avx2")) swap_level=2;
+ else if (__builtin_cpu_supports("ssse3")) swap_level=1;
+#endif
+}
 
           // Is the native byte order big endian?
 
@@ -130,144 +150,111 @@ bool ByteHandler::big_endian()
 }
 
 
+#ifdef BYTEHANDLER_X86
+
+    //  Byte-shuffle kernels for 4- and 8-byte words: reverse the bytes of
+    //  each word in 16-byte (SSSE3) or 32-byte (AVX2) blocks of "in",
+    //  storing into "out" (which may equal "in").  Return the number of
+    //  bytes done; the caller swaps the remaining words.
+
+__attribute__((target("ssse3")))
+static size_t swap_ssse3(const char *in, char *out, size_t nbytes, size_t size)
+{
+ const __m128i shuf=(size==4)
+     ? _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12)
+     : _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+ size_t k=0;
+ for (;k+16<=nbytes;k+=16)
+    _mm_storeu_si128((__m128i*)(out+k),
+          _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in+k)),shuf));
+ return k;
+}
+
+__attribute__((target("avx2")))
+static size_t swap_avx2(const char *in, char *out, size_t nbytes, size_t size)
+{
+ const __m256i shuf=(size==4)
+     ? _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                        3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12)
+     : _mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+                        7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+ size_t k=0;
+ for (;k+64<=nbytes;k+=64){
+    __m256i a=_mm256_loadu_si256((const __m256i*)(in+k));
+    __m256i b=_mm256_loadu_si256((const __m256i*)(in+k+32));
+    _mm256_storeu_si256((__m256i*)(out+k),_mm256_shuffle_epi8(a,shuf));
+    _mm256_storeu_si256((__m256i*)(out+k+32),_mm256_shuffle_epi8(b,shuf));}
+ for (;k+32<=nbytes;k+=32)
+    _mm256_storeu_si256((__m256i*)(out+k),
+          _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in+k)),shuf));
+ return k;
+}
+
+#endif
+
+
       // Byte-swap an array of data each of size nmemb
   
 void ByteHandler::byte_swap(void *ptr, size_t size, size_t nmemb)
 {
- unsigned int j;
+ byte_swap(ptr, ptr, size, nmemb);
+}
 
- char char_in[16];           /* characters used in byte swapping */
 
- char *in_ptr;
- double *double_ptr;         /* Pointer used in the double routines */
+      // Byte-swap an array of nmemb words of size "size" from "in"
+      // into "out"; "in" and "out" may be the same, but must not
+      // otherwise overlap.  Complex numbers are swapped as an array
+      // of twice as many real numbers.
 
+void ByteHandler::byte_swap(const void *in, void *out, size_t size, size_t nmemb)
+{
+ const char *src=static_cast<const char*>(in);
+ char *dst=static_cast<char*>(out);
+ size_t nbytes=size*nmemb;
  switch (size)
  {
- case 4:  /* n_uint32_t */
- {
-   n_uint32_t *w = (n_uint32_t *)ptr;
-           n_uint32_t old, recent;
-
-   for(j=0; j<nmemb; j++)
-   {
-     old = w[j];
-     recent = old >> 24 & 0x000000ff;
-     recent |= old >> 8 & 0x0000ff00;
-     recent |= old << 8 & 0x00ff0000;
-     recent |= old << 24 & 0xff000000;
-     w[j] = recent;
-   }
- }
- break;
+ case 1:  /* n_uint8_t: byte - copy only */
+   if (src!=dst) std::memcpy(dst,src,nbytes);
+   break;
 
- case 1:  /* n_uint8_t: byte - do nothing */
+ case 2:  /* n_uint16_t */
+   for (size_t k=0;k<nbytes;k+=2){
+      char c0=src[k];
+      dst[k]=src[k+1]; dst[k+1]=c0;}
    break;
 
+ case 4:  /* n_uint32_t */
  case 8:  /* n_uint64_t */
  {
-   for(j = 0, double_ptr = (double *) ptr;
-       j < nmemb;
-       j++, double_ptr++)
-   {
-     in_ptr = (char *) double_ptr; /* Set the character pointer to
-                                      point to the start of the double */
-
-     /*
-      *  Assign all the byte variables to a character
-      */
-     char_in[0] = in_ptr[0];
-     char_in[1] = in_ptr[1];
-     char_in[2] = in_ptr[2];
-     char_in[3] = in_ptr[3];
-     char_in[4] = in_ptr[4];
-     char_in[5] = in_ptr[5];
-     char_in[6] = in_ptr[6];
-     char_in[7] = in_ptr[7];
-
-     /*
-      *  Now just swap the order
-      */
-     in_ptr[0] = char_in[7];
-     in_ptr[1] = char_in[6];
-     in_ptr[2] = char_in[5];
-     in_ptr[3] = char_in[4];
-     in_ptr[4] = char_in[3];
-     in_ptr[5] = char_in[2];
-     in_ptr[6] = char_in[1];
-     in_ptr[7] = char_in[0];
-   }
+   size_t k=0;
+#ifdef BYTEHANDLER_X86
+   if (swap_level==2) k=swap_avx2(src,dst,nbytes,size);
+   else if (swap_level==1) k=swap_ssse3(src,dst,nbytes,size);
+#endif
+   if (size==4){
+      for (;k<nbytes;k+=4){
+         n_uint32_t w;
+         std::memcpy(&w,src+k,4);
+         w = (w >> 24) | ((w >> 8) & 0x0000ff00) | ((w << 8) & 0x00ff0000) | (w << 24);
+         std::memcpy(dst+k,&w,4);}}
+   else{
+      for (;k<nbytes;k+=8){
+         unsigned long long w;
+         std::memcpy(&w,src+k,8);
+         w = ((w >> 56) & 0x00000000000000ffULL) | ((w >> 40) & 0x000000000000ff00ULL)
+           | ((w >> 24) & 0x0000000000ff0000ULL) | ((w >> 8)  & 0x00000000ff000000ULL)
+           | ((w << 8)  & 0x000000ff00000000ULL) | ((w << 24) & 0x0000ff0000000000ULL)
+           | ((w << 40) & 0x00ff000000000000ULL) | ((w << 56) & 0xff00000000000000ULL);
+         std::memcpy(dst+k,&w,8);}}
  }
  break;
 
  case 16:  /* Long Long */
- {
-   for(j = 0, double_ptr = (double *) ptr;
-       j < nmemb;
-       j++, double_ptr+=2)
-   {
-
-     in_ptr = (char *) double_ptr; /* Set the character pointer to
-                                      point to the start of the double */
-
-     /*
-      *  Assign all the byte variables to a character
-      */
-     char_in[0] = in_ptr[0];
-     char_in[1] = in_ptr[1];
-     char_in[2] = in_ptr[2];
-     char_in[3] = in_ptr[3];
-     char_in[4] = in_ptr[4];
-     char_in[5] = in_ptr[5];
-     char_in[6] = in_ptr[6];
-     char_in[7] = in_ptr[7];
-     char_in[8] = in_ptr[8];
-     char_in[9] = in_ptr[9];
-     char_in[10] = in_ptr[10];
-     char_in[11] = in_ptr[11];
-     char_in[12] = in_ptr[12];
-     char_in[13] = in_ptr[13];
-     char_in[14] = in_ptr[14];
-     char_in[15] = in_ptr[15];
-
-     /*
-      *  Now just swap the order
-      */
-     in_ptr[0] = char_in[15];
-     in_ptr[1] = char_in[14];
-     in_ptr[2] = char_in[13];
-     in_ptr[3] = char_in[12];
-     in_ptr[4] = char_in[11];
-     in_ptr[5] = char_in[10];
-     in_ptr[6] = char_in[9];
-     in_ptr[7] = char_in[8];
-
-     in_ptr[8] = char_in[7];
-     in_ptr[9] = char_in[6];
-     in_ptr[10] = char_in[5];
-     in_ptr[11] = char_in[4];
-     in_ptr[12] = char_in[3];
-     in_ptr[13] = char_in[2];
-     in_ptr[14] = char_in[1];
-     in_ptr[15] = char_in[0];
-
-   }
- }
- break;
-
- case 2:  /* n_uint16_t */
- {
-   n_uint16_t *w = (n_uint16_t *)ptr;
-           n_uint16_t old, recent;
-
-   for(j=0; j<nmemb; j++)
-   {
-     old = w[j];
-     recent = old >> 8 & 0x00ff;
-     recent |= old << 8 & 0xff00;
-     w[j] = recent;
-   }
- }
- break;
+   for (size_t k=0;k<nbytes;k+=16)
+      for (int j=0;j<8;++j){
+         char c=src[k+j];
+         dst[k+j]=src[k+15-j]; dst[k+15-j]=c;}
+   break;
 
  default:
    throw(std::invalid_argument("unsupported word size"));
@@ -276,18 +263,118 @@ void ByteHandler::byte_swap(void *ptr, size_t size, size_t nmemb)
 
 
 
+    //  Slicing-by-16: the lookups only depend on the bytes of the
+    //  input, so the result does not depend on the host byte order.
+
+ByteHandler::n_uint32_t ByteHandler::crc_slice16(n_uint32_t crc,
+                           const unsigned char *buf, size_t len) const
+{
+ const n_uint32_t *t=crc_table.data();
+ while (len >= 16){
+    crc ^= n_uint32_t(buf[0]) | (n_uint32_t(buf[1]) << 8)
+         | (n_uint32_t(buf[2]) << 16) | (n_uint32_t(buf[3]) << 24);
+    crc = t[15*256 + (crc & 0xff)] ^ t[14*256 + ((crc >> 8) & 0xff)]
+        ^ t[13*256 + ((crc >> 16) & 0xff)] ^ t[12*256 + (crc >> 24)]
+        ^ t[11*256 + buf[4]]  ^ t[10*256 + buf[5]]
+        ^ t[9*256 + buf[6]]   ^ t[8*256 + buf[7]]
+        ^ t[7*256 + buf[8]]   ^ t[6*256 + buf[9]]
+        ^ t[5*256 + buf[10]]  ^ t[4*256 + buf[11]]
+        ^ t[3*256 + buf[12]]  ^ t[2*256 + buf[13]]
+        ^ t[256 + buf[14]]    ^ t[buf[15]];
+    buf += 16;
+    len -= 16;}
+ while (len--)
+    crc = t[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+ return crc;
+}
+
+
+#ifdef BYTEHANDLER_X86
+
+    //  Folding with carry-less multiplication, following Gopal et al.,
+    //  "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    //  Instruction" (Intel, 2009), with the bit-reflected constants for
+    //  the CRC32 polynomial.  Requires len >= 64 and len a multiple of 16.
+    //  The input and output "crc" are not inverted.
+
+__attribute__((target("pclmul,sse2")))
+static unsigned int crc_clmul(unsigned int crc, const unsigned char *buf, size_t len)
+{
+ const __m128i k1k2=_mm_set_epi64x(0x01c6e41596LL,0x0154442bd4LL);
+ const __m128i k3k4=_mm_set_epi64x(0x00ccaa009eLL,0x01751997d0LL);
+ const __m128i k5k0=_mm_set_epi64x(0,0x0163cd6124LL);
+ const __m128i poly=_mm_set_epi64x(0x01f7011641LL,0x01db710641LL);
+ const __m128i mask32=_mm_setr_epi32(~0,0,~0,0);
+
+ __m128i x1=_mm_loadu_si128((const __m128i*)(buf));
+ __m128i x2=_mm_loadu_si128((const __m128i*)(buf+16));
+ __m128i x3=_mm_loadu_si128((const __m128i*)(buf+32));
+ __m128i x4=_mm_loadu_si128((const __m128i*)(buf+48));
+ x1=_mm_xor_si128(x1,_mm_cvtsi32_si128(int(crc)));
+ buf+=64; len-=64;
+
+    // fold four 128-bit lanes over each 64-byte block
+
+ while (len>=64){
+    __m128i x5=_mm_clmulepi64_si128(x1,k1k2,0x00);
+    __m128i x6=_mm_clmulepi64_si128(x2,k1k2,0x00);
+    __m128i x7=_mm_clmulepi64_si128(x3,k1k2,0x00);
+    __m128i x8=_mm_clmulepi64_si128(x4,k1k2,0x00);
+    x1=_mm_clmulepi64_si128(x1,k1k2,0x11);
+    x2=_mm_clmulepi64_si128(x2,k1k2,0x11);
+    x3=_mm_clmulepi64_si128(x3,k1k2,0x11);
+    x4=_mm_clmulepi64_si128(x4,k1k2,0x11);
+    x1=_mm_xor_si128(_mm_xor_si128(x1,x5),_mm_loadu_si128((const __m128i*)(buf)));
+    x2=_mm_xor_si128(_mm_xor_si128(x2,x6),_mm_loadu_si128((const __m128i*)(buf+16)));
+    x3=_mm_xor_si128(_mm_xor_si128(x3,x7),_mm_loadu_si128((const __m128i*)(buf+32)));
+    x4=_mm_xor_si128(_mm_xor_si128(x4,x8),_mm_loadu_si128((const __m128i*)(buf+48)));
+    buf+=64; len-=64;}
+
+    // fold the lanes into one, then the remaining 16-byte blocks
+
+ __m128i x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x2),x5);
+ x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x3),x5);
+ x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x4),x5);
+ while (len>=16){
+    x2=_mm_loadu_si128((const __m128i*)buf);
+    x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+    x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x2),x5);
+    buf+=16; len-=16;}
+
+    // reduce 128 bits to 64, then Barrett reduction to 32 bits
+
+ x2=_mm_clmulepi64_si128(x1,k3k4,0x10);
+ x1=_mm_xor_si128(_mm_srli_si128(x1,8),x2);
+ x2=_mm_srli_si128(x1,4);
+ x1=_mm_and_si128(x1,mask32);
+ x1=_mm_xor_si128(_mm_clmulepi64_si128(x1,k5k0,0x00),x2);
+
+ x2=_mm_and_si128(x1,mask32);
+ x2=_mm_clmulepi64_si128(x2,poly,0x10);
+ x2=_mm_and_si128(x2,mask32);
+ x2=_mm_clmulepi64_si128(x2,poly,0x00);
+ x1=_mm_xor_si128(x1,x2);
+ return (unsigned int)(_mm_cvtsi128_si32(_mm_srli_si128(x1,4)));
+}
+
+#endif
+
+
 ByteHandler::n_uint32_t ByteHandler::get_checksum(n_uint32_t crc, 
                            const unsigned char *buf, size_t len)
 {
  crc = crc ^ 0xffffffffL;
- while (len >= 8){
-    for (int k=0;k<8;++k)
-       crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
-    len -= 8;}
- if (len){
-    do{
-       crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);} 
-       while (--len);}
+#ifdef BYTEHANDLER_X86
+ if ((use_clmul)&&(len >= 64)){
+    size_t nfold = len & ~size_t(15);
+    crc = crc_clmul(crc, buf, nfold);
+    buf += nfold;
+    len -= nfold;}
+#endif
+ crc = crc_slice16(crc, buf, len);
  return crc ^ 0xffffffffL;
 }
 
@@ -12,6 +12,18 @@
 // *    1  = little-endian    (alpha, x86_64, ...)  *
 // *    2  = big-endian       (sun, ibm, hp, ...)   *
 // *                                                *
+// *   The check sums are the zlib CRC32 values.    *
+// *   They are evaluated 16 bytes at a time with   *
+// *   "slicing" tables, or, on x86_64 processors   *
+// *   with the PCLMULQDQ instruction (detected     *
+// *   at run time), by carry-less multiplication   *
+// *   folding 64 bytes at a time.                  *
+// *                                                *
+// *   Byte swaps of 4- and 8-byte words use the    *
+// *   SSSE3 or AVX2 byte-shuffle instructions when *
+// *   available (detected at run time), and can    *
+// *   store into a separate output buffer.         *
+// *                                                *
 // **************************************************
 
 class ByteHandler
@@ -34,6 +46,9 @@ class ByteHandler
          // Byte-swap an array of data each of size nmemb
     void byte_swap(void *ptr, size_t size, size_t nmemb);
 
+         // Byte-swap from "in" into "out" (same or non-overlapping)
+    void byte_swap(const void *in, void *out, size_t size, size_t nmemb);
+
          // Return a check sum given an input checksum and buffer data
     n_uint32_t get_checksum(n_uint32_t crc, const unsigned char *buf, size_t len);
  
@@ -42,7 +57,11 @@ class ByteHandler
 
  private:
  
-    std::vector<n_uint32_t> crc_table;
+    std::vector<n_uint32_t> crc_table;   // 16 tables of 256 entries
+    bool use_clmul;
+    int swap_level;                      // 0 = scalar, 1 = SSSE3, 2 = AVX2
+
+    n_uint32_t crc_slice16(n_uint32_t crc, const unsigned char *buf, size_t len) const;
 
 };
 
@@ -507,8 +507,9 @@ bool DataGetHandlerMF<H,R,D>::addFile(const std::string& file_name, const std::s
  catch(const std::exception& xp){
     throw(std::invalid_argument(std::string("cannot addFile ")+file_name
           +std::string("in DataGetHandlerMF since single-file open failed: ")+xp.what()));}
- std::set<R> newkeys(newget->getKeys());
     // check that all keys in new file are different from all keys already available
+ std::set<R> newkeys;
+ if (!getptrs.empty()) newkeys=newget->getKeys();
  for (typename std::list<DataGetHandlerSF<H,R,D>* >::iterator it=getptrs.begin();it!=getptrs.end();it++){
     std::set<R> rkeys((*it)->getKeys());
     std::set<R> intersect;
@@ -1,7 +1,8 @@
 #include "io_handler_fstream.h"
-#ifdef XML
 #include <unistd.h>
-#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 using namespace std;
 
 
@@ -99,7 +100,8 @@ void IOFSTRHandler::readCommon(char *data, size_t nbytes)
 
 IOFSTRHandler::IOFSTRHandler() : read_only(true), openflag(false), read_mode(true),
                                  endian_format('U'), endian_convert(false), 
-                                 checksum_on(false), is_new_file(false), checksum(0)
+                                 checksum_on(false), is_new_file(false), checksum(0),
+                                 map_addr(0), map_len(0)
 {
 #ifndef NO_CXX11
  static_assert(sizeof(int)==4,"Invalid int size");
@@ -119,6 +121,7 @@ IOFSTRHandler::IOFSTRHandler(const std::string& filename, OpenMode mode,
  static__assert<sizeof(int)==4>();
 #endif
  openflag=false;
+ map_addr=0; map_len=0;
  open(filename,mode,filetype_id,endianness,turn_on_checksum);
 }
 
@@ -132,6 +135,7 @@ IOFSTRHandler::IOFSTRHandler(const std::string& filename, ios_base::openmode mod
  static__assert<sizeof(int)==4>();
 #endif
  openflag=false;
+ map_addr=0; map_len=0;
  open(filename,mode,filetype_id,endianness,turn_on_checksum);
 }
 
@@ -354,6 +358,7 @@ void IOFSTRHandler::close()
 
 void IOFSTRHandler::clear()
 { 
+ unmapRegion();
  file_close();
  m_filename.clear();
  openflag=false;
@@ -456,6 +461,55 @@ ByteHandler::n_uint32_t IOFSTRHandler::getChecksum()
 
 
 
+const char* IOFSTRHandler::mapRegion(pos_type offset, size_t nbytes)
+{
+ unmapRegion();
+ if ((!openflag)||(!read_only)||(nbytes==0)) return 0;
+ int fd=::open(m_filename.c_str(),O_RDONLY);
+ if (fd<0) return 0;
+ size_t start=size_t(offset)+size_t(data_start_pos);
+ struct stat st;
+ if ((fstat(fd,&st)!=0)||(size_t(st.st_size)<start+nbytes)){
+    ::close(fd); return 0;}
+ size_t pagesize=sysconf(_SC_PAGESIZE);
+ size_t skip=start%pagesize;
+ void *addr=mmap(0,nbytes+skip,PROT_READ,MAP_SHARED,fd,start-skip);
+ ::close(fd);
+ if (addr==MAP_FAILED) return 0;
+ map_addr=addr;
+ map_len=nbytes+skip;
+ return static_cast<const char*>(addr)+skip;
+}
+
+
+void IOFSTRHandler::unmapRegion()
+{
+ if (map_addr==0) return;
+ munmap(map_addr,map_len);
+ map_addr=0; map_len=0;
+}
+
+
+void IOFSTRHandler::mapped_read(const char* mem, unsigned int* output, int n) const
+{
+ std::memcpy(output,mem,n*sizeof(unsigned int));
+ if (endian_convert) m_bytehandler.byte_swap(output,sizeof(unsigned int),n);
+}
+
+
+void IOFSTRHandler::mapped_read(const char* mem, unsigned long long int* output, int n) const
+{
+ std::memcpy(output,mem,n*sizeof(unsigned long long int));
+ if (endian_convert) m_bytehandler.byte_swap(output,sizeof(unsigned long long int),n);
+}
+
+
+ByteHandler::n_uint32_t IOFSTRHandler::mapped_checksum(const char* mem, size_t nbytes) const
+{
+ return m_bytehandler.get_checksum(0,mem,nbytes);
+}
+
+
         // Print out file ID. Does not 
         // change file pointers.
 
@@ -557,11 +611,15 @@ void IOFSTRHandler::write_common(const char* output, size_t elementbytes, size_t
     check_for_failure(IO_ERR_ACCESS,"Write failure--read only file");
  if (read_mode){
     read_mode=false; checksum=0;}
- if (endian_convert){
-    m_bytehandler.byte_swap(const_cast<char *>(output), elementbytes, nelements);
-    if (checksum_on) checksum = m_bytehandler.get_checksum(checksum, output, elementbytes*nelements);
-    writeCommon(output, elementbytes*nelements);
-    m_bytehandler.byte_swap(const_cast<char *>(output), elementbytes, nelements);}
+ if (endian_convert){     // swap into a scratch buffer (in blocks), leaving "output" alone
+    size_t blockelems=(elementbytes<swap_block) ? swap_block/elementbytes : 1;
+    for (size_t k=0;k<nelements;k+=blockelems){
+       size_t nel=(nelements-k<blockelems) ? nelements-k : blockelems;
+       size_t nbytes=elementbytes*nel;
+       if (swap_buffer.size()<nbytes) swap_buffer.resize(nbytes);
+       m_bytehandler.byte_swap(output+k*elementbytes, &swap_buffer[0], elementbytes, nel);
+       if (checksum_on) checksum = m_bytehandler.get_checksum(checksum, &swap_buffer[0], nbytes);
+       writeCommon(&swap_buffer[0], nbytes);}}
  else{
     if (checksum_on) checksum = m_bytehandler.get_checksum(checksum, output, elementbytes*nelements);
     writeCommon(output, elementbytes*nelements);}
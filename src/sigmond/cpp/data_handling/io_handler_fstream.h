@@ -98,7 +98,9 @@ typedef std::complex<float>  fcmplx;
     //  may or may not be stored in contiguous memory; padding characters
     //  could be inserted between the struct elements (the GNU compiler
     //  allows an "__attribute__ ((packed))" to prevent such padding).
-    //  This is why we must treat complex numbers differently than basic floats, etc.
+    //  The standard does guarantee that a "std::complex<T>" is stored as an
+    //  array T[2] of its real and imaginary parts, so arrays of complex numbers
+    //  are read and written (and byte-swapped) directly as arrays of 2n reals.
 
 
 class IOFSTRHandler
@@ -119,6 +121,12 @@ class IOFSTRHandler
  
    ByteHandler::n_uint32_t checksum;
 
+   void *map_addr;                // memory-mapped region (read-only files)
+   size_t map_len;
+
+   std::vector<char> swap_buffer; // byte-swapped copy of the data being written
+   static const size_t swap_block=1048576;
+
       // disallow copying
    IOFSTRHandler(const IOFSTRHandler&);
    IOFSTRHandler(IOFSTRHandler&);
@@ -222,6 +230,22 @@ class IOFSTRHandler
    ByteHandler::n_uint32_t getChecksum();
    void printFileID();
 
+         //  Memory mapping (read-only files only).  "mapRegion" returns a
+         //  pointer to "nbytes" bytes of the file starting "offset" bytes
+         //  from the start of data, or 0 if the file is not read-only, the
+         //  region extends past the end of the file, or the mapping fails.
+         //  Only one region is mapped at a time; it stays valid until the
+         //  next "mapRegion", "unmapRegion", or the file is closed.
+         //  "mapped_read" copies values from mapped memory, byte swapping
+         //  if needed, and "mapped_checksum" returns the check sum of mapped
+         //  bytes.  Neither changes the file pointer or the running check sum.
+
+   const char* mapRegion(pos_type offset, size_t nbytes);
+   void unmapRegion();
+   void mapped_read(const char* mem, unsigned int* output, int n) const;
+   void mapped_read(const char* mem, unsigned long long int* output, int n) const;
+   ByteHandler::n_uint32_t mapped_checksum(const char* mem, size_t nbytes) const;
+
      // Open file, read string at a particular position, then close. Returns
      // true if the file exists and can be opened and its file type matches 
      // "filetype_id", returns false otherwise.  The string is returned in 
@@ -523,8 +547,7 @@ void IOFSTRHandler::write_basic(const T& output)
 template <typename T>
 void IOFSTRHandler::write_complex(const std::complex<T>& output)
 {
- T data[2]; data[0]=real(output); data[1]=imag(output);
- write_common((const char*)&data, sizeof(T), 2);
+ write_common((const char*)&output, sizeof(T), 2);
 }
 
 template <typename T>
@@ -535,15 +558,8 @@ void IOFSTRHandler::multi_write_basic(const T* output, int n)
 
 template <typename T>
 void IOFSTRHandler::multi_write_complex(const std::complex<T>* output, int n)
-{
- std::vector<T> data(2*n);
- int count=0;
- const std::complex<T> *ptr=output; 
- for (int k=0;k<n;++k){
-    data[count++]=real(*ptr);
-    data[count++]=imag(*ptr);
-    ++ptr;}
- write_common((const char*)&data[0],sizeof(T),size_t(2*n));
+{            // complex<T> is stored as T[2]: write as 2n reals
+ write_common((const char*)output,sizeof(T),size_t(2*n));
 }
 
 template <typename T>
@@ -561,11 +577,7 @@ void IOFSTRHandler::write_complex_vector(const std::vector<std::complex<T> >& ou
  int n=output.size();
  write_basic<int>(n);
  if (n==0) return;
- std::vector<T> data(2*n);
- int count=0; for (int k=0;k<n;++k){
-    data[count++]=real(output[k]);
-    data[count++]=imag(output[k]);}
- write_common((const char*)&data[0],sizeof(T),size_t(2*n));
+ write_common((const char*)&(output[0]),sizeof(T),size_t(2*n));
 }
 
 template <typename T>
@@ -592,9 +604,7 @@ void IOFSTRHandler::read_basic(T& input)
 template <typename T>
 void IOFSTRHandler::read_complex(std::complex<T>& input)
 {
- T data[2]; 
- read_common((char*)&data, sizeof(T), 2);
- input=std::complex<T>(data[0],data[1]);
+ read_common((char*)&input, sizeof(T), 2);
 }
 
 template <typename T>
@@ -605,14 +615,8 @@ void IOFSTRHandler::multi_read_basic(T* input, int n)
 
 template <typename T>
 void IOFSTRHandler::multi_read_complex(std::complex<T>* input, int n)
-{
- std::vector<T> data(2*n);
- read_common((char*)&data[0],sizeof(T),size_t(2*n));
- int count=0;
- std::complex<T> *ptr=input; 
- for (int k=0;k<n;++k){
-    *ptr=std::complex<T>(data[count],data[count+1]);
-    count+=2; ++ptr;}
+{            // complex<T> is stored as T[2]: read as 2n reals
+ read_common((char*)input,sizeof(T),size_t(2*n));
 }
 
 template <typename T>
@@ -638,11 +642,7 @@ void IOFSTRHandler::read_complex_vector(std::vector<std::complex<T> >& input)
     // so place a reasonable limit
  check_for_failure((n<0)||(n>16777216), "vector too large...bad file location?");
  input.resize(n);
- std::vector<T> data(2*n);
- read_common((char*)&data[0],sizeof(T),size_t(2*n));
- int count=0; for (int k=0;k<n;++k){
-    input[k]=std::complex<T>(data[count],data[count+1]);
-    count+=2;}
+ read_common((char*)&input[0],sizeof(T),size_t(2*n));
 }
 
 template <typename T>
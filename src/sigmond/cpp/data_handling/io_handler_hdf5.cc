@@ -16,6 +16,8 @@ const IOHDF5Handler::openmode_type IOHDF5Handler::IO_MODE_EXCL=   ios::trunc;
 
 ByteHandler IOHDF5Handler::m_bytehandler;
 
+std::recursive_mutex IOHDF5Handler::m_library_mutex;
+
 
 // *************************************************************************
 
@@ -47,6 +49,7 @@ void IOHDF5Handler::open(const std::string& filename, IOHDF5Handler::OpenMode mo
                          const std::string& filetype_id, char endianness,
                          bool turn_on_checksum)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  close();
  read_only=(mode==ReadOnly)?true:false;
 
@@ -224,6 +227,7 @@ IOHDF5Handler::~IOHDF5Handler()
 
 void IOHDF5Handler::mkdir(const std::string& path)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  if (!openflag) return;
  if (queryDir(path)) return;
  std::string ppath(tidyString(path));
@@ -252,6 +256,7 @@ void IOHDF5Handler::mkdir(const std::string& path)
 
 void IOHDF5Handler::cd(const std::string& path, bool makedir)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  if (!openflag) return;
  if (makedir) mkdir(path);
  std::string ppath(tidyString(path));
@@ -300,6 +305,7 @@ bool IOHDF5Handler::queryData(const std::string& objname) const
 
 char IOHDF5Handler::query_obj(const std::string& objname) const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  if (!openflag) return 'N';
  std::string ppath(tidyString(objname));
  const hid_t* cwdptr=(ppath[0]=='/')? (&fid) : (&currid);
@@ -327,6 +333,7 @@ char IOHDF5Handler::query_obj(const std::string& objname) const
 
 std::set<std::string> IOHDF5Handler::getAllDataNames() const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  set<std::string> result;
  if (openflag){
     std::string path;
@@ -339,6 +346,7 @@ std::set<std::string> IOHDF5Handler::getAllDataNames() const
 
 std::set<std::string> IOHDF5Handler::getAllDirNames() const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  set<std::string> result;
  if (openflag){
     std::string path;
@@ -412,6 +420,7 @@ void IOHDF5Handler::collect_dir_names(hid_t loc_id, const std::string& path,
 
 std::set<std::string> IOHDF5Handler::getDataNamesInCurrentDir() const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  set<std::string> result;
  if (openflag){
     collect_data_names_in_currdir(currid,result,H5O_TYPE_DATASET);}
@@ -421,6 +430,7 @@ std::set<std::string> IOHDF5Handler::getDataNamesInCurrentDir() const
 
 std::set<std::string> IOHDF5Handler::getDirNamesInCurrentDir() const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  set<std::string> result;
  if (openflag){
     collect_data_names_in_currdir(currid,result,H5O_TYPE_GROUP);}
@@ -638,6 +648,7 @@ void IOHDF5Handler::delete_file()
 
 void IOHDF5Handler::file_close()
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  herr_t status1=H5Gclose(currid);
  herr_t status2=H5Fclose(fid);
  check_for_herr_failure(status1,"Failure during close");
@@ -735,6 +746,7 @@ std::string IOHDF5Handler::form_absolute_path(const std::vector<std::string>& pa
 
 void IOHDF5Handler::write(const std::string& objname, const std::string& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  if (!openflag){
     check_for_failure(IO_ERR_ACCESS,"Attempt to write when no open file");}
  if (read_only){
@@ -761,143 +773,171 @@ void IOHDF5Handler::write(const std::string& objname, const std::string& output)
 
 void IOHDF5Handler::write(const std::string& objname, const char& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  char str[2]; str[0]=output; str[1]='\0';
  write(objname,std::string(str));
 }
 
 void IOHDF5Handler::write(const std::string& objname, const int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<int>(objname,&output,1,dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const unsigned int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<unsigned int>(objname,&output,1,dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const long int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<long int>(objname,&output,1,dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const unsigned long int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<unsigned long int>(objname,&output,1,dtype_ulong,H5T_NATIVE_ULONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const long long int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<long long int>(objname,&output,1,dtype_llong,H5T_NATIVE_LLONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const unsigned long long int& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<unsigned long long int>(objname,&output,1,dtype_ullong,H5T_NATIVE_ULLONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const float& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<float>(objname,&output,1,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const double& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<double>(objname,&output,1,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const fcmplx& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_values<float>(objname,&output,1,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const dcmplx& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_values<double>(objname,&output,1,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<char>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  std::string s(output.begin(), output.end());
  write(objname,s);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<int>(objname,output.data(),output.size(),dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<unsigned int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<unsigned int>(objname,output.data(),output.size(),dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<long int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<long int>(objname,output.data(),output.size(),dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<unsigned long int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<unsigned long int>(objname,output.data(),output.size(),dtype_ullong,H5T_NATIVE_ULLONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<float>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<float>(objname,output.data(),output.size(),dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<double>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_atomics<double>(objname,output.data(),output.size(),dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<fcmplx>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_values<float>(objname,output.data(),output.size(),dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const std::vector<dcmplx>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_values<double>(objname,output.data(),output.size(),dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<int>(objname,output,dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<unsigned int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<unsigned int>(objname,output,dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<long int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<long int>(objname,output,dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<unsigned long int>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<unsigned long int>(objname,output,dtype_ulong,H5T_NATIVE_ULONG);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<float>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<float>(objname,output,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<double>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_array<double>(objname,output,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<fcmplx>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_array<fcmplx>(objname,output,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::write(const std::string& objname, const Array<dcmplx>& output)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  write_complex_array<dcmplx>(objname,output,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
@@ -906,6 +946,7 @@ void IOHDF5Handler::write(const std::string& objname, const Array<dcmplx>& outpu
 
 void IOHDF5Handler::read(const std::string& objname, std::string& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  if (!openflag){
     check_for_failure(IO_ERR_ACCESS,"Attempt to read when no open file");}
  std::string obj(tidyString(objname));
@@ -933,6 +974,7 @@ void IOHDF5Handler::read(const std::string& objname, std::string& input)
 
 void IOHDF5Handler::read(const std::string& objname, char& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  std::string s;
  read(objname,s);
  if (s.length()!=1){
@@ -942,56 +984,67 @@ void IOHDF5Handler::read(const std::string& objname, char& input)
 
 void IOHDF5Handler::read(const std::string& objname, int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<int>(objname,input,dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, unsigned int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<unsigned int>(objname,input,dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, long int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<long int>(objname,input,dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, unsigned long int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<unsigned long int>(objname,input,dtype_ulong,H5T_NATIVE_ULONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, long long int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<long long int>(objname,input,dtype_llong,H5T_NATIVE_LLONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, unsigned long long int& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<unsigned long long int>(objname,input,dtype_ullong,H5T_NATIVE_ULLONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, float& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<float>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, double& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomic<double>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::read(const std::string& objname, fcmplx& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex<float>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
  
 void IOHDF5Handler::read(const std::string& objname, dcmplx& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex<double>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<char>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  std::string s;
  read(objname,s);
  input=std::vector<char>(s.begin(), s.end());
@@ -999,81 +1052,97 @@ void IOHDF5Handler::read(const std::string& objname, std::vector<char>& input)
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<int>(objname,input,dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<unsigned int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<unsigned int>(objname,input,dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<long int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<long int>(objname,input,dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<unsigned long int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<unsigned long int>(objname,input,dtype_ulong,H5T_NATIVE_ULONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<float>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<float>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<double>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_atomics<double>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<fcmplx>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex_vector<float>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, std::vector<dcmplx>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex_vector<double>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<int>(objname,input,dtype_int,H5T_NATIVE_INT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<unsigned int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<unsigned int>(objname,input,dtype_uint,H5T_NATIVE_UINT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<long int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<long int>(objname,input,dtype_long,H5T_NATIVE_LONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<unsigned long int>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<unsigned long int>(objname,input,dtype_ulong,H5T_NATIVE_ULONG);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<float>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<float>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<double>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_array<double>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<fcmplx>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex_array<fcmplx>(objname,input,dtype_float,H5T_NATIVE_FLOAT);
 }
 
 void IOHDF5Handler::read(const std::string& objname, Array<dcmplx>& input)
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  read_complex_array<dcmplx>(objname,input,dtype_double,H5T_NATIVE_DOUBLE);
 }
 
@@ -1087,6 +1156,7 @@ void IOHDF5Handler::peek_strings(const std::string& filename,
                                  const std::vector<std::string>& paths,
                                  std::vector<std::string>& stringvalues) const
 {
+ std::lock_guard<std::recursive_mutex> lock(m_library_mutex);
  stringvalues.clear();
  for (uint k=0;k<paths.size();++k){
     stringvalues.push_back("");}
@@ -11,6 +11,7 @@
 #endif
 #include <stdexcept>
 #include <complex>
+#include <mutex>
 #include <iostream>
 #include "byte_handler.h"
 #include "array.h"
@@ -78,6 +79,12 @@ typedef std::complex<float>  fcmplx;
  // *   but if you use separate code to access files produced by this class,        *
  // *   the separate code must be made aware of this!!!!                            *
  // *                                                                               *
+ // *   The HDF5 library is usually built without thread safety, so no two          *
+ // *   threads may be inside it at once, even for different files.  Every          *
+ // *   member that calls the library holds one mutex shared by all objects         *
+ // *   of this class, so handlers can be used on different threads (such           *
+ // *   as task threads reading while the output writer thread writes).             *
+ // *                                                                               *
  // *                                                                               *
  // *********************************************************************************
 
@@ -316,6 +323,8 @@ class IOHDF5Handler
 
    static ByteHandler m_bytehandler;
 
+   static std::recursive_mutex m_library_mutex;   // serializes calls to HDF5
+
    hid_t dtype_int;
    hid_t dtype_long;
    hid_t dtype_llong;
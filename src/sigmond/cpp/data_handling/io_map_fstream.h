@@ -5,6 +5,7 @@
 #include "io_map_base.h"
 #include <map>
 #include <set>
+#include <stdexcept>
 
 #ifndef NO_CXX11
 #include <type_traits>
@@ -14,6 +15,8 @@
 //#define SIZETSIZE    4
 #define SIZETSIZE    8
 #define ULONGLONG    8
+#define IOFSTR_INDEX_TAG      "KeyIndex"
+#define IOFSTR_INDEX_MAXINTS  64
 
 
  // *********************************************************************************
@@ -115,6 +118,16 @@
  // *  kept in memory.  The "keepKeys" members returns true if all requested        *
  // *  keys are available, false if some are missing (not available).               *
  // *                                                                               *
+ // *  The file map is stored with the keys in increasing order, and files now      *
+ // *  end with an index footer saying so.  When a file with this footer is         *
+ // *  opened read-only and the key class is one of the simple classes of unsigned  *
+ // *  ints (see the helper routines below), the file map is not read into memory:  *
+ // *  it is memory-mapped, and each look-up is a binary search in the mapped keys. *
+ // *  Opening is then independent of the number of records (except that the map    *
+ // *  is scanned once to verify its check sum, if check sums are used), and        *
+ // *  "keepKeys" only looks up the requested keys.  Files without the footer are   *
+ // *  read as before, and readers that do not know the footer ignore it.           *
+ // *                                                                               *
  // *  A completed IOFSTRMap file contains (in the following order):                *
  // *   (1) endian character 'L' or 'B'                                             *
  // *   (2) a 32-character ID string                                                *
@@ -124,6 +137,12 @@
  // *   (6) the data records one after another                                      *
  // *   (7) the file map describing locations of the records and keys               *
  // *   (8) an ending character 'E'                                                 *
+ // *   (9) the index footer: the map location (8 bytes) and the 8 characters       *
+ // *       "KeyIndex" (absent in older files)                                      *
+ // *                                                                               *
+ // *  The file map contains the number of records and the key size (8 bytes        *
+ // *  each), the keys in increasing order, the record locations in the same        *
+ // *  order (8 bytes each), then the check sum of the map (optionally).            *
  // *                                                                               *
  // *  Each record contains (in the following order):                               *
  // *   (1) the size in bytes of the record (excluding checksum)                    *
@@ -260,6 +279,31 @@ void multi_read(IOFSTRHandler& ioh, std::vector<T>& input, int n)
     input.push_back(T(&buf[k]));
 }
 
+         //  "IOFSTRKeyCodes<T>::value" is true if "T" is one of the simple
+         //  key classes above; the keys in the map of a file can then be
+         //  decoded one at a time from memory.
+
+#ifndef NO_CXX11
+template <typename T, typename = void>
+struct IOFSTRKeyCodes : std::false_type {};
+
+template <typename T>
+struct IOFSTRKeyCodes<T, decltype(void(T::numints()),
+                        void(T(static_cast<const unsigned int*>(0))))> : std::true_type {};
+
+template <typename T>
+T key_from_codes(const unsigned int *buf, std::true_type)
+{
+ return T(buf);
+}
+
+template <typename T>
+T key_from_codes(const unsigned int *buf, std::false_type)
+{
+ throw(std::logic_error("key class cannot be decoded from the file index"));
+}
+#endif
+
 
 
  // ********************************************************
@@ -287,6 +331,9 @@ class IOFSTRMap  : public IOMapBase<K,V>
      w_pos new_write_pos;
      bool write_map_on_close;
 
+     const char *index_mem;        // mapped keys when the map is not read in
+     size_t index_nrecords, index_keysize;
+
       // disallow copying
      IOFSTRMap(const IOFSTRMap&);
      IOFSTRMap(IOFSTRMap&);
@@ -388,7 +435,8 @@ class IOFSTRMap  : public IOMapBase<K,V>
      
 
 
-    virtual unsigned int size() const { return file_map.size(); }
+    virtual unsigned int size() const 
+     { return (index_mem) ? index_nrecords : file_map.size(); }
 
     virtual void getKeys(std::vector<K>& keys) const;
 
@@ -413,6 +461,16 @@ class IOFSTRMap  : public IOMapBase<K,V>
     void readMap(w_pos mapstart);
     
     void writeMap(w_pos mapstart);
+
+    bool openIndex(w_pos mapstart);
+
+    void closeIndex();
+
+    K index_key(size_t ind) const;
+
+    bool index_find(const K& key, pos_type& pos) const;
+
+    bool find_record(const K& key, pos_type& pos) const;
     
     void check_for_failure(bool errcond, const std::string& msg, bool abort=true);
 
@@ -431,7 +489,8 @@ class IOFSTRMap  : public IOMapBase<K,V>
 template <typename K, typename V>
 IOFSTRMap<K,V>::IOFSTRMap() : checksums_in_file(false), use_checksums(false), 
                               allow_overwrites(false), verbose1(false), verbose2(false), 
-                              new_write_pos(0), write_map_on_close(false)
+                              new_write_pos(0), write_map_on_close(false),
+                              index_mem(0), index_nrecords(0), index_keysize(0)
 {
           // rely on specific sizes in the file so check these sizes
 #ifndef NO_CXX11
@@ -530,7 +589,8 @@ void IOFSTRMap<K,V>::initialize(const std::string& filename, OpenMode mode,
     if (!use_checksums) ioh.turnOffChecksum();
     if (read_header) ioh.read(header);
     write_map_on_close=false;
-    readMap(new_write_pos);
+    if ((mode!=IOFSTRHandler::ReadOnly)||(!openIndex(new_write_pos)))
+       readMap(new_write_pos);
     }
 
  if (verbose2){
@@ -542,7 +602,8 @@ void IOFSTRMap<K,V>::initialize(const std::string& filename, OpenMode mode,
     else std::cout << "   Endian conversion is OFF"<<std::endl;
     if (ioh.isReadOnly()) std::cout << "   File is opened in read-only mode"<<std::endl;
     else std::cout << "   File is opened in read-write mode"<<std::endl;
-    std::cout << "   Number of key-value pairs is "<<file_map.size()<<std::endl;}
+    std::cout << "   Number of key-value pairs is "<<size()<<std::endl;
+    if (index_mem) std::cout << "   Look-ups use the file index"<<std::endl;}
 }
 
 
@@ -552,6 +613,7 @@ void IOFSTRMap<K,V>::close()
  if (!ioh.isOpen()) return;
  if (write_map_on_close) writeMap(new_write_pos);
  if (verbose1) std::cout << "IOFSTRMap: closed file "<<ioh.getFileName()<<std::endl;
+ closeIndex();
  ioh.close();
  file_map.clear();
 }
@@ -601,6 +663,8 @@ void IOFSTRMap<K,V>::writeMap(w_pos mapstart)
  if (!use_checksums) ioh.turnOffChecksum();
  char eof='E';
  ioh.write(eof);
+ ioh.write(mapstart);
+ ioh.multi_write(IOFSTR_INDEX_TAG,8);
  ioh.rewind(); 
  ioh.write(mapstart);
 }
@@ -649,6 +713,109 @@ void IOFSTRMap<K,V>::readMap(w_pos mapstart)
 }
 
 
+    // Sets up look-ups in the memory-mapped file map if the file ends
+    // with an index footer and the keys can be decoded from the map.
+    // Returns false if the map must be read in instead.
+
+template<typename K, typename V>
+bool IOFSTRMap<K,V>::openIndex(w_pos mapstart)
+{
+#ifndef NO_CXX11
+ if (!IOFSTRKeyCodes<K>::value) return false;
+ check_for_failure(mapstart==0,"IOFSTRMap file "+ioh.getFileName()+" corrupted from prior aborted execution");
+ w_pos head[2];
+ const char *mem=ioh.mapRegion(static_cast<pos_type>(mapstart),sizeof(head));
+ if (!mem) return false;
+ ioh.mapped_read(mem,head,2);
+ size_t nrecords=head[0], keysize=head[1];
+ check_for_failure(nrecords>16777216,"Too many records during readMap: bad read?");
+ check_for_failure(keysize>1024,"Key size too large during readMap: bad read?");
+ if ((nrecords==0)||(keysize%sizeof(unsigned int)!=0)
+    ||(keysize>IOFSTR_INDEX_MAXINTS*sizeof(unsigned int))){
+    ioh.unmapRegion(); return false;}
+ size_t maplen=sizeof(head)+nrecords*(keysize+sizeof(w_pos));
+ size_t cksize=(checksums_in_file)?sizeof(ByteHandler::n_uint32_t):0;
+ size_t total=maplen+cksize+1+sizeof(w_pos)+8;
+ mem=ioh.mapRegion(static_cast<pos_type>(mapstart),total);
+ if (!mem) return false;
+ const char *footer=mem+maplen+cksize;
+ w_pos footerstart;
+ ioh.mapped_read(footer+1,&footerstart,1);
+ if ((footer[0]!='E')||(footerstart!=mapstart)
+    ||(std::memcmp(footer+1+sizeof(w_pos),IOFSTR_INDEX_TAG,8)!=0)){
+    ioh.unmapRegion(); return false;}
+ if (use_checksums){
+    unsigned int checksumB;
+    ioh.mapped_read(mem+maplen,&checksumB,1);
+    check_for_failure(ioh.mapped_checksum(mem,maplen)!=checksumB,
+                      "checksum mismatch: bad read of file map");}
+ index_mem=mem+sizeof(head);
+ index_nrecords=nrecords;
+ index_keysize=keysize;
+ check_for_failure(keysize!=numbytes(ioh,index_key(0)),"Bad keysize in reading file map");
+ return true;
+#else
+ return false;
+#endif
+}
+
+
+template<typename K, typename V>
+void IOFSTRMap<K,V>::closeIndex()
+{
+ if (!index_mem) return;
+ ioh.unmapRegion();
+ index_mem=0;
+ index_nrecords=index_keysize=0;
+}
+
+
+    // Decodes the key "ind" in the mapped file map.
+
+template<typename K, typename V>
+K IOFSTRMap<K,V>::index_key(size_t ind) const
+{
+#ifndef NO_CXX11
+ unsigned int buf[IOFSTR_INDEX_MAXINTS];
+ ioh.mapped_read(index_mem+ind*index_keysize,buf,index_keysize/sizeof(unsigned int));
+ return key_from_codes<K>(buf,IOFSTRKeyCodes<K>());
+#else
+ throw(std::logic_error("file index not available"));
+#endif
+}
+
+
+    // Binary search for "key" in the mapped file map.
+
+template<typename K, typename V>
+bool IOFSTRMap<K,V>::index_find(const K& key, pos_type& pos) const
+{
+ size_t lo=0, hi=index_nrecords;
+ while (lo<hi){
+    size_t mid=lo+(hi-lo)/2;
+    K midkey(index_key(mid));
+    if (midkey<key) lo=mid+1;
+    else if (key<midkey) hi=mid;
+    else{
+       w_pos loc;
+       ioh.mapped_read(index_mem+index_nrecords*index_keysize+mid*sizeof(w_pos),&loc,1);
+       pos=static_cast<pos_type>(loc);
+       return true;}}
+ return false;
+}
+
+
+template<typename K, typename V>
+bool IOFSTRMap<K,V>::find_record(const K& key, pos_type& pos) const
+{
+ if (index_mem) return index_find(key,pos);
+ typename std::map<K, pos_type>::const_iterator ft=file_map.find(key);
+ if (ft==file_map.end()) return false;
+ pos=ft->second;
+ return true;
+}
+
+
 template<typename K, typename V>
 void IOFSTRMap<K,V>::setHighVerbosity() 
 { 
@@ -667,7 +834,8 @@ void IOFSTRMap<K,V>::setMediumVerbosity()
 template<typename K, typename V>
 bool IOFSTRMap<K,V>::exist(const K& key) const 
 {
- return (file_map.find(key) == file_map.end()) ? false : true;
+ pos_type pos;
+ return find_record(key,pos);
 }
   
 
@@ -736,9 +904,10 @@ void IOFSTRMap<K,V>::put(const K& key, const V& val)
 template<typename K, typename V>
 void IOFSTRMap<K,V>::get(const K& key, V& val) 
 {
- check_for_failure((!ioh.isOpen())||(!exist(key)),
+ pos_type recpos;
+ check_for_failure((!ioh.isOpen())||(!find_record(key,recpos)),
                    "Read failed: file not open or key not in file",false);
- off_type start = static_cast<off_type>(file_map.find(key)->second); 
+ off_type start = static_cast<off_type>(recpos); 
  if (verbose2) std::cout << "IOFSTRMap::get at file location "<<start<<std::endl;
  ioh.seekFromStart(start);
  size_t sz;
@@ -761,9 +930,9 @@ template<typename K, typename V>
 bool IOFSTRMap<K,V>::get_maybe(const K& key, V& val) 
 {
  if (!ioh.isOpen()) return false;
- typename std::map<K, pos_type>::iterator ft=file_map.find(key);
- if (ft==file_map.end()) return false;
- off_type start = static_cast<off_type>(ft->second); 
+ pos_type recpos;
+ if (!find_record(key,recpos)) return false;
+ off_type start = static_cast<off_type>(recpos); 
  if (verbose2) std::cout << "IOFSTRMap::get at file location "<<start<<std::endl;
  ioh.seekFromStart(start);
  size_t sz;
@@ -784,6 +953,11 @@ template<typename K, typename V>
 void IOFSTRMap<K,V>::getKeys(std::vector<K>& keys) const 
 {
  keys.clear();
+ if (index_mem){
+    keys.reserve(index_nrecords);
+    for (size_t ind=0;ind<index_nrecords;++ind)
+       keys.push_back(index_key(ind));
+    return;}
  keys.reserve(file_map.size());
  for (typename std::map<K,pos_type>::const_iterator it  = file_map.begin();
       it != file_map.end(); ++it){
@@ -795,6 +969,10 @@ template<typename K, typename V>
 void IOFSTRMap<K,V>::getKeys(std::set<K>& keys) const 
 {
  keys.clear();
+ if (index_mem){
+    for (size_t ind=0;ind<index_nrecords;++ind)
+       keys.insert(keys.end(),index_key(ind));
+    return;}
  for (typename std::map<K,pos_type>::const_iterator it  = file_map.begin();
       it != file_map.end(); ++it){
       keys.insert(it->first);}
@@ -809,8 +987,9 @@ bool IOFSTRMap<K,V>::keepKeys(const std::set<K>& keys_to_keep)
 {
  std::map<K, pos_type> newmap;
  for (typename std::set<K>::const_iterator it=keys_to_keep.begin();it!=keys_to_keep.end();it++){
-    typename std::map<K, pos_type>::iterator mt=file_map.find(*it);
-    if (mt!=file_map.end()) newmap.insert(*mt);} 
+    pos_type pos;
+    if (find_record(*it,pos)) newmap.insert(newmap.end(),std::make_pair(*it,pos));} 
+ closeIndex();
  file_map=newmap;
  return (file_map.size()==keys_to_keep.size());
 }
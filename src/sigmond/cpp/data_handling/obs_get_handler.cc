@@ -13,8 +13,14 @@ MCObsGetHandler::MCObsGetHandler(XMLHandler& xmlin, const MCBinsInfo& bins_info,
                        m_bins_info(bins_info), m_sampling_info(samp_info),
                        m_use_checksums(false)
 {
- XMLHandler xmlr(xmlin);
  m_xmlin = XMLHandler(xmlin,XMLHandler::copy);
+ setup();
+}
+
+
+void MCObsGetHandler::setup()
+{
+ XMLHandler xmlr(m_xmlin);
  list<FileListInfo> corrinputfiles;
  list<FileListInfo> vevinputfiles;
  set<string> binfiles;
@@ -77,7 +83,7 @@ MCObsGetHandler::MCObsGetHandler(XMLHandler& xmlin, const MCBinsInfo& bins_info,
  bool nodata=(corrinputfiles.empty())&&(vevinputfiles.empty())
              &&(binfiles.empty())&&(sampfiles.empty());
 
- if (xml_child_tag_count(xmlr,"UseCheckSums")>1){
+ if (xml_child_tag_count(xmlr,"UseCheckSums")>0){
     m_use_checksums=true;}
 
     //  get and rebin the weights, if ensemble is weighted
@@ -192,7 +198,8 @@ void MCObsGetHandler::connectBinsFile(const std::string& file_name)
        set<string> binfiles; binfiles.insert(file_name);
        m_binsdh=new BinsGetHandler(m_bins_info,binfiles,m_use_checksums);}
     else{
-       m_binsdh->addFile(file_name);}}
+       m_binsdh->addFile(file_name);}
+    m_bins_connects.push_back(make_pair(file_name,set<MCObsInfo>()));}
  catch(const std::exception& msg){
     clear(); throw;}
 }
@@ -209,7 +216,8 @@ void MCObsGetHandler::connectBinsFile(const std::string& file_name,
           throw(std::runtime_error("Requested observable not available in input bin files"));}
     else{
        if (!(m_binsdh->addFile(file_name,keys_to_keep)))
-          throw(std::runtime_error("Requested observable not available in input bin files"));}}
+          throw(std::runtime_error("Requested observable not available in input bin files"));}
+    m_bins_connects.push_back(make_pair(file_name,keys_to_keep));}
  catch(const std::exception& msg){
     clear(); throw;}
 }
@@ -219,6 +227,7 @@ void MCObsGetHandler::disconnectBinsFile(const std::string& file_name)
 {
  if (m_binsdh!=0)
     m_binsdh->removeFile(file_name);
+ forget_connect(m_bins_connects,file_name);
 }
 
 
@@ -230,7 +239,8 @@ void MCObsGetHandler::connectSamplingsFile(const std::string& file_name)
        m_sampsdh=new SamplingsGetHandler(m_bins_info,m_sampling_info, 
                                          sampfiles,m_use_checksums);}
     else{
-       m_sampsdh->addFile(file_name);}}
+       m_sampsdh->addFile(file_name);}
+    m_samps_connects.push_back(make_pair(file_name,set<MCObsInfo>()));}
  catch(const std::exception& msg){
     clear(); throw;}
 }
@@ -247,7 +257,8 @@ void MCObsGetHandler::connectSamplingsFile(const std::string& file_name,
           throw(std::runtime_error("Requested observable not available in input sampling files"));}
     else{
        if (!(m_sampsdh->addFile(file_name,keys_to_keep)))
-          throw(std::runtime_error("Requested observable not available in input sampling files"));}}
+          throw(std::runtime_error("Requested observable not available in input sampling files"));}
+    m_samps_connects.push_back(make_pair(file_name,keys_to_keep));}
  catch(const std::exception& msg){
     clear(); throw;}
 }
@@ -256,6 +267,37 @@ void MCObsGetHandler::disconnectSamplingsFile(const std::string& file_name)
 {
  if (m_sampsdh!=0)
     m_sampsdh->removeFile(file_name);
+ forget_connect(m_samps_connects,file_name);
+}
+
+
+void MCObsGetHandler::forget_connect(list<pair<string,set<MCObsInfo> > >& connects,
+                                     const string& file_name)
+{
+ for (list<pair<string,set<MCObsInfo> > >::iterator it=connects.begin();it!=connects.end();){
+    if (it->first==file_name) it=connects.erase(it);
+    else ++it;}
+}
+
+
+    //  Closes all files and opens them again, including those connected
+    //  after construction.  A process created by "fork" shares the file
+    //  offsets of its parent's open files, so it must call this before
+    //  reading any data.
+
+void MCObsGetHandler::reopen()
+{
+ list<pair<string,set<MCObsInfo> > > bconnects, sconnects;
+ bconnects.swap(m_bins_connects);
+ sconnects.swap(m_samps_connects);
+ clear();
+ setup();
+ for (list<pair<string,set<MCObsInfo> > >::const_iterator it=bconnects.begin();it!=bconnects.end();++it){
+    if (it->second.empty()) connectBinsFile(it->first);
+    else connectBinsFile(it->first,it->second);}
+ for (list<pair<string,set<MCObsInfo> > >::const_iterator it=sconnects.begin();it!=sconnects.end();++it){
+    if (it->second.empty()) connectSamplingsFile(it->first);
+    else connectSamplingsFile(it->first,it->second);}
 }
 
 
@@ -412,6 +454,45 @@ void MCObsGetHandler::getBins(const MCObsInfo& obsinfo, RVector& bins)
 
 #endif
 
+uint MCObsGetHandler::getMeasurementData(const MCObsInfo& obsinfo, RVector& data)
+{
+ if (obsinfo.isNonSimple())
+    throw(std::invalid_argument(string("cannot getMeasurementData for non simple observable for ")
+                                +obsinfo.str()));
+ if (obsinfo.isBasicLapH()){
+    try{
+#ifndef COMPLEXNUMBERS
+    if (obsinfo.isImaginaryPart())
+       throw(std::invalid_argument(string("cannot getMeasurementData for observable for ")
+                                   +obsinfo.str()));
+#endif
+    uint nmeas=m_bins_info.getNumberOfMeasurements();
+    const set<unsigned int>& omit=m_bins_info.getOmissions();
+    RVector values(nmeas);
+    uint count=0;
+    Scalar value;
+    for (uint serial=0;serial<nmeas;serial++){
+       if (omit.find(serial)!=omit.end()) continue;
+       getBasicLapHData(obsinfo,serial,value);
+#ifdef COMPLEXNUMBERS
+       values[count++]=(obsinfo.isRealPart()) ? realpart(value) : imaginarypart(value);
+#else
+       values[count++]=value;
+#endif
+       }
+    data.resize(count);
+    for (uint k=0;k<count;k++) data[k]=values[k];
+    return 1;}
+    catch(const std::exception& xp){}}
+ if (m_binsdh==0)
+    throw(std::invalid_argument(string("getMeasurementData fails due to unavailable bins for ")
+                                +obsinfo.str()));
+ m_binsdh->getSymData(obsinfo,data);
+ uint nbins=m_bins_info.getNumberOfBins();
+ return m_bins_info.getRebinFactor()/(data.size()/nbins);
+}
+
+
 void MCObsGetHandler::getSamplings(const MCObsInfo& obsinfo, RVector& samplings)
 {
  if (m_sampsdh==0)
@@ -233,6 +233,10 @@ class MCObsGetHandler
        //  data analysis; "m_BLorig_wts" are the weights for the
        //  original configs for Basic LapH observables.
    std::vector<double> m_wts, m_BLorig_wts;
+       //  files connected after construction, with the keys to keep
+       //  (empty means all), so that "reopen" can connect them again
+   std::list<std::pair<std::string,std::set<MCObsInfo> > > m_bins_connects;
+   std::list<std::pair<std::string,std::set<MCObsInfo> > > m_samps_connects;
 
        // Prevent copying ... handler might contain large
        // amounts of data
@@ -273,6 +277,10 @@ class MCObsGetHandler
 
    void disconnectSamplingsFile(const std::string& file_name);
 
+           // close and reopen all files (needed in a forked child process)
+
+   void reopen();
+
 
 
 
@@ -334,6 +342,14 @@ class MCObsGetHandler
 
    bool querySamplings(const MCObsInfo& obsinfo);
 
+          // Unbinned data of a simple observable: one value for each
+          // measurement not omitted, with no rebinning or weights, from
+          // the last_laph files.  Data only in SigMonD bin files is
+          // returned as stored in the file.  The number of measurements
+          // in each returned value is returned (1 for last_laph data).
+
+   uint getMeasurementData(const MCObsInfo& obsinfo, RVector& data);
+
 
 #ifdef COMPLEXNUMBERS
    void getBinsComplex(const MCObsInfo& obsinfo, RVector& bins_re, 
@@ -353,6 +369,11 @@ class MCObsGetHandler
  
    void clear();
 
+   void setup();
+
+   void forget_connect(std::list<std::pair<std::string,std::set<MCObsInfo> > >& connects,
+                       const std::string& file_name);
+
    void setup_correlators(XMLHandler& xmlin, 
                           const std::string& tagname, bool vevs, 
                           std::set<CorrelatorInfo>& corrSet,
@@ -62,6 +62,10 @@ void ChiSquare::setObsMeanCov()
  try{
     for (uint k=0;k<m_nobs;++k)
        m_means[k]=m_obs->getCurrentSamplingValue(m_obs_info[k]);
+    if (m_obs->isLowRankCorrelated()){
+       set_lowrank_cov(0);
+       return;}
+    m_lowrank=false;
     RealSymmetricMatrix cov(m_nobs);
     for (uint k=0;k<m_nobs;++k)
     for (uint j=0;j<=k;++j)
@@ -70,7 +74,8 @@ void ChiSquare::setObsMeanCov()
        else
           cov(j,k)=0.;
     CholeskyDecomposer CHD;
-    CHD.getCholeskyOfInverse(cov,m_inv_cov_cholesky);}
+    CHD.getCholeskyOfInverse(cov,m_inv_cov_cholesky);
+    query_grad_sparsity();}
  catch(const std::exception& errmsg){
     throw(std::invalid_argument(string("Could not setObsMeanCov: ")
       +string(errmsg.what())));}
@@ -82,6 +87,10 @@ void ChiSquare::setObsMeanCov(RVector& coveigvals)
  try{
     for (uint k=0;k<m_nobs;++k)
        m_means[k]=m_obs->getCurrentSamplingValue(m_obs_info[k]);
+    if (m_obs->isLowRankCorrelated()){
+       set_lowrank_cov(&coveigvals);
+       return;}
+    m_lowrank=false;
     RealSymmetricMatrix cov(m_nobs);
     for (uint k=0;k<m_nobs;++k)
     for (uint j=0;j<=k;++j)
@@ -92,13 +101,138 @@ void ChiSquare::setObsMeanCov(RVector& coveigvals)
     Diagonalizer Dc;
     Dc.getEigenvalues(cov,coveigvals);
     CholeskyDecomposer CHD;
-    CHD.getCholeskyOfInverse(cov,m_inv_cov_cholesky);}
+    CHD.getCholeskyOfInverse(cov,m_inv_cov_cholesky);
+    query_grad_sparsity();}
  catch(const std::exception& errmsg){
     throw(std::invalid_argument(string("Could not setObsMeanCov: ")
              +string(errmsg.what())));}
 }
 
 
+    //  Low-rank-plus-diagonal covariance:  the thin SVD of the scaled
+    //  samplings G = D^(-1/2) F is obtained from the eigenvectors of the
+    //  smaller of G^T G and G G^T.  Modes with negligible singular values
+    //  do not change the whitening and are dropped.
+
+void ChiSquare::set_lowrank_cov(RVector *coveigvals)
+{
+ SamplingMode covmode=m_obs->getCovMatCurrentSamplingMode();
+ double diag_weight=m_obs->getLowRankDiagonalWeight();
+ RMatrix G;
+ uint nsamp=0;
+ m_inv_sqrt_diag.resize(m_nobs);
+ for (uint j=0;j<m_nobs;++j){
+    const RVector& sampvals=m_obs->getFullAndSamplingValues(m_obs_info[j],covmode);
+    uint n=sampvals.size()-1;
+    if (j==0){
+       nsamp=n;
+       if (nsamp<2) throw(std::invalid_argument("Too few samplings for low-rank covariance"));
+       G.resize(m_nobs,nsamp);}
+    else if (n!=nsamp)
+       throw(std::invalid_argument("Inconsistent number of samplings in low-rank covariance"));
+    double avg=0.0;
+    for (uint k=1;k<=n;++k)
+       avg+=sampvals[k];
+    avg/=double(n);
+    double scale=(covmode==Jackknife)?sqrt(1.0-1.0/double(n)):sqrt(1.0/double(n-1));
+    double var=0.0;
+    for (uint k=1;k<=n;++k){
+       G(j,k-1)=scale*(sampvals[k]-avg);
+       var+=G(j,k-1)*G(j,k-1);}
+    if (!(var>0.0))
+       throw(std::invalid_argument(string("Zero variance for ")+m_obs_info[j].str()
+                +" in low-rank covariance"));
+    m_inv_sqrt_diag[j]=1.0/sqrt(diag_weight*var);
+    for (uint k=0;k<nsamp;++k)
+       G(j,k)*=m_inv_sqrt_diag[j];}
+
+ RVector eigvals;
+ RMatrix eigvecs;
+ Diagonalizer DG;
+ bool samp_side=(nsamp<=m_nobs);
+ uint ngram=samp_side?nsamp:m_nobs;
+ RealSymmetricMatrix gram(ngram);
+ if (samp_side){
+    for (uint k=0;k<nsamp;++k)
+    for (uint l=0;l<=k;++l){
+       double tmp=0.0;
+       for (uint j=0;j<m_nobs;++j)
+          tmp+=G(j,k)*G(j,l);
+       gram(l,k)=tmp;}}
+ else{
+    for (uint i=0;i<m_nobs;++i)
+    for (uint j=0;j<=i;++j){
+       double tmp=0.0;
+       for (uint k=0;k<nsamp;++k)
+          tmp+=G(i,k)*G(j,k);
+       gram(j,i)=tmp;}}
+ DG.getEigenvectors(gram,eigvals,eigvecs);
+
+ double cutoff=1e-12*eigvals[ngram-1];
+ uint first=0;
+ while ((first<ngram)&&(eigvals[first]<=cutoff)) ++first;
+ uint rank=ngram-first;
+ m_lowrank_vecs.resize(rank,m_nobs);
+ m_lowrank_coefs.resize(rank);
+ for (uint r=0;r<rank;++r){
+    uint e=first+r;
+    if (samp_side){
+       double invs=1.0/sqrt(eigvals[e]);
+       for (uint j=0;j<m_nobs;++j){
+          double tmp=0.0;
+          for (uint k=0;k<nsamp;++k)
+             tmp+=G(j,k)*eigvecs(k,e);
+          m_lowrank_vecs(r,j)=tmp*invs;}}
+    else{
+       for (uint j=0;j<m_nobs;++j)
+          m_lowrank_vecs(r,j)=eigvecs(j,e);}
+    m_lowrank_coefs[r]=1.0-1.0/sqrt(1.0+eigvals[e]);}
+ m_inv_cov_cholesky.clear();
+ m_lowrank=true;
+
+ if (coveigvals){
+    coveigvals->resize(m_nobs);
+    for (uint j=0;j<m_nobs-rank;++j)
+       (*coveigvals)[j]=1.0;
+    for (uint r=0;r<rank;++r)
+       (*coveigvals)[m_nobs-rank+r]=1.0+eigvals[first+r];}
+}
+
+
+    //  Applies W = (1 - U C U^T) D^(-1/2) to "values" (length nobs)
+
+void ChiSquare::lowrank_whiten(double *values) const
+{
+ uint rank=m_lowrank_coefs.size();
+ for (uint j=0;j<m_nobs;++j)
+    values[j]*=m_inv_sqrt_diag[j];
+ vector<double> proj(rank);
+ for (uint r=0;r<rank;++r){
+    double tmp=0.0;
+    for (uint j=0;j<m_nobs;++j)
+       tmp+=m_lowrank_vecs(r,j)*values[j];
+    proj[r]=m_lowrank_coefs[r]*tmp;}
+ for (uint r=0;r<rank;++r)
+ for (uint j=0;j<m_nobs;++j)
+    values[j]-=m_lowrank_vecs(r,j)*proj[r];
+}
+
+
+    //  Applies the Cholesky matrix, or W in low-rank mode, to "values"
+
+void ChiSquare::whiten(double *values) const
+{
+ if (m_lowrank)
+    lowrank_whiten(values);
+ else{
+    for (int i=m_nobs-1;i>=0;--i){
+       double tmp=0.0;
+       for (int j=0;j<=i;++j)
+          tmp+=m_inv_cov_cholesky(i,j)*values[j];
+       values[i]=tmp;}}
+}
+
+
 void ChiSquare::guessInitialFitParamValues(vector<double>& fitparams)
 {
  setObsMeanCov();
@@ -120,17 +254,22 @@ void ChiSquare::addPriors(map<string,Prior> in_priors)
   if (dof < 1) throw(std::invalid_argument("Degrees of Freedom must be greater than zero"));
 }
 
+static thread_local const std::atomic<bool> *t_stop=0;
+
+void ChiSquare::setThreadStopFlag(const std::atomic<bool> *stop)
+{
+ t_stop=stop;
+}
+
+
 void ChiSquare::evalResiduals(const vector<double>& fitparams,
                               vector<double>& residuals) const
 {
+ if ((t_stop!=0)&&(t_stop->load(std::memory_order_relaxed))) throw Stopped();
  evalModelPoints(fitparams,residuals);
  for (uint k=0;k<m_nobs;++k)
     residuals[k]-=m_means[k];
- for (int i=m_nobs-1;i>=0;--i){
-    double tmp=0.0;
-    for (int j=0;j<=i;++j)
-       tmp+=m_inv_cov_cholesky(i,j)*residuals[j];
-    residuals[i]=tmp;}
+ whiten(&residuals[0]);
  int i=m_nobs;
  for (map<uint,Prior>::const_iterator prior_it=m_priors.begin(); prior_it!=m_priors.end(); ++prior_it,++i){
    //  residuals[i]=(fitparams[prior_it->first] - prior_it->second.mean()) / (prior_it->second.error());
@@ -146,16 +285,52 @@ vector<double> ChiSquare::evalResiduals(const vector<double>& fitparams) const
     return residuals;
 } 
 
+    //  The sparsity is queried once, when the covariance is set, so that
+    //  evaluations of the gradients only read it.
+
+void ChiSquare::query_grad_sparsity()
+{
+ if (m_grad_sparse>=0) return;
+ m_grad_rows.clear();
+ m_grad_sparse=(getGradientSparsity(m_grad_rows)&&(m_grad_rows.size()==m_nparams))?1:0;
+}
+
+
+    //  If the derived class describes the sparsity of the gradients, only
+    //  the nonzero gradients enter the product with the Cholesky matrix,
+    //  and rows above the first nonzero gradient remain zero.
+
 void ChiSquare::evalResGradients(const vector<double>& fitparams,
                                  RMatrix& gradients) const
 {
+ if ((t_stop!=0)&&(t_stop->load(std::memory_order_relaxed))) throw Stopped();
  evalGradients(fitparams,gradients);
- for (uint p=0;p<m_nparams;++p)
- for (int i=m_nobs-1;i>=0;--i){
-    double tmp=0.0;
-    for (int j=0;j<=i;++j)
-       tmp+=m_inv_cov_cholesky(i,j)*gradients(j,p);
-    gradients(i,p)=tmp;}
+ if (m_lowrank){
+    vector<double> column(m_nobs);
+    for (uint p=0;p<m_nparams;++p){
+       for (uint i=0;i<m_nobs;++i)
+          column[i]=gradients(i,p);
+       lowrank_whiten(&column[0]);
+       for (uint i=0;i<m_nobs;++i)
+          gradients(i,p)=column[i];}}
+ else if (m_grad_sparse<=0){
+    for (uint p=0;p<m_nparams;++p)
+    for (int i=m_nobs-1;i>=0;--i){
+       double tmp=0.0;
+       for (int j=0;j<=i;++j)
+          tmp+=m_inv_cov_cholesky(i,j)*gradients(j,p);
+       gradients(i,p)=tmp;}}
+ else{
+    for (uint p=0;p<m_nparams;++p){
+       const vector<uint>& rows=m_grad_rows[p];
+       uint first=(rows.empty())?m_nobs:rows.front();
+       for (int i=m_nobs-1;i>=int(first);--i){
+          double tmp=0.0;
+          for (uint k=0;(k<rows.size())&&(int(rows[k])<=i);++k)
+             tmp+=m_inv_cov_cholesky(i,rows[k])*gradients(rows[k],p);
+          gradients(i,p)=tmp;}
+       for (uint i=0;i<first;++i)
+          gradients(i,p)=0.0;}}
  int i=m_nobs;
  for (map<uint,Prior>::const_iterator prior_it=m_priors.begin(); prior_it!=m_priors.end(); ++prior_it,++i){
    //  gradients(i,prior_it->first)=1./(prior_it->second.error());
@@ -7,6 +7,7 @@
 #include "mcobs_info.h"
 #include "mcobs_handler.h"
 #include "prior.h"
+#include <atomic>
 
 
 // ********************************************************************************
@@ -48,6 +49,24 @@
 // *   The fit parameters determine the model[j] values, and the fit parameters   *
 // *   are adjusted until the chi-square is a minimum.                            *
 // *                                                                              *
+// *   When the MCObsHandler is in low-rank correlated mode (see                  *
+// *   "setToLowRankCorrelated" in MCObsHandler), which is intended for fits      *
+// *   with more observables than resamplings, the covariance is instead          *
+// *                                                                              *
+// *        cov = F * transpose(F) + D,    D(j,j) = diag_weight * var[j]          *
+// *                                                                              *
+// *   where F is the nobs x nsamplings matrix of centered samplings (scaled so   *
+// *   that F * transpose(F) is the jackknife or bootstrap covariance) and D is   *
+// *   diagonal.  With G = D^(-1/2) F = U S transpose(V) (thin SVD), the          *
+// *   Woodbury identity gives inv_cov = transpose(W) * W with                    *
+// *                                                                              *
+// *        W = (1 - U * C * transpose(U)) * D^(-1/2),   C = 1 - 1/sqrt(1+S^2)    *
+// *                                                                              *
+// *   so only U (nobs x rank) is stored, and each application of W costs         *
+// *   O(nobs*rank) rather than O(nobs^2).  No dense nobs x nobs matrix is        *
+// *   formed when nsamplings < nobs.  In this mode, the eigenvalues returned     *
+// *   by "setObsMeanCov" are those of D^(-1/2) * cov * D^(-1/2).                 *
+// *                                                                              *
 // *                                                                              *
 // *   A class "DerivedFit" derived from "ChiSquare" must have a constructor      *
 // *   of the form                                                                *
@@ -81,6 +100,40 @@
 // *                                                                              *
 // *      virtual void do_output(XMLHandler& xmlout) const;                       *
 // *                                                                              *
+// *   A derived class whose gradients have many structural zeros, such as a      *
+// *   simultaneous fit of several correlators sharing only a few parameters,     *
+// *   can also define                                                            *
+// *                                                                              *
+// *      virtual bool getGradientSparsity(                                       *
+// *                        vector<vector<uint> >& rows) const;                   *
+// *                                                                              *
+// *   which returns true and sets "rows[p]" to the indices (increasing) of the   *
+// *   observables whose gradients with respect to the p-th parameter can be      *
+// *   nonzero.  "evalResGradients" then skips the zeros when multiplying by      *
+// *   the Cholesky matrix.  The default returns false (dense gradients).  It     *
+// *   is called once, by the first "setObsMeanCov".                              *
+// *                                                                              *
+// *                                                                              *
+// *   A derived class whose model is linear in some of its parameters (such as   *
+// *   the amplitudes of a sum of exponentials) can support variable projection   *
+// *   (see "chisq_varpro.h") by defining                                         *
+// *                                                                              *
+// *      virtual bool getLinearParams(vector<uint>& linear_params) const;        *
+// *                                                                              *
+// *      virtual void evalLinearBasis(const vector<double>& fitparams,           *
+// *                                   RMatrix& basis,                            *
+// *                                   vector<RMatrix>& basis_grads) const;       *
+// *                                                                              *
+// *      virtual void setLinearParams(const vector<double>& coefs,               *
+// *                                   vector<double>& fitparams) const;          *
+// *                                                                              *
+// *   where the model points are  sum_k basis(i,k)*coefs[k],  "basis_grads[p]"   *
+// *   holds the derivatives of "basis" with respect to the p-th parameter (it    *
+// *   is empty if they are not needed), and "basis" depends only on the          *
+// *   parameters not listed by "getLinearParams".                                *
+// *   "setLinearParams" sets the linear parameters from the coefficients.        *
+// *   The derived class requests this mode of fitting by returning true from     *
+// *   "useVariableProjection".                                                   *
 // *                                                                              *
 // *                                                                              *
 // *   Objects of classes derived from "ChiSquare" will generally be accessed     *
@@ -149,8 +202,19 @@ class ChiSquare
     RVector m_means;
     LowerTriangularMatrix<double> m_inv_cov_cholesky;
 
+ private:
+
+    int m_grad_sparse;    // -1 = not yet queried, 0 = dense, 1 = sparse
+    std::vector<std::vector<uint> > m_grad_rows;
 
-    ChiSquare(MCObsHandler& OH) : m_obs(&OH) {}
+    bool m_lowrank;                 // low-rank-plus-diagonal covariance in use
+    RVector m_inv_sqrt_diag;        // 1/sqrt of the diagonal part
+    RMatrix m_lowrank_vecs;         // (rank x nobs) singular vectors
+    RVector m_lowrank_coefs;        // 1 - 1/sqrt(1+s^2) for each singular value s
+
+ protected:
+
+    ChiSquare(MCObsHandler& OH) : m_obs(&OH), m_grad_sparse(-1), m_lowrank(false) {}
 
     virtual ~ChiSquare(){}
 
@@ -170,11 +234,61 @@ class ChiSquare
 
     virtual void do_output(XMLHandler& xmlout) const = 0;
 
+    virtual bool getGradientSparsity(std::vector<std::vector<uint> >&) const
+     {return false;}
+
+    virtual bool getLinearParams(std::vector<uint>&) const
+     {return false;}
+
+    virtual void evalLinearBasis(const std::vector<double>&, RMatrix&,
+                                 std::vector<RMatrix>&) const {}
+
+    virtual void setLinearParams(const std::vector<double>&,
+                                 std::vector<double>&) const {}
+
     void allocate_obs_memory();
 
+           // applies the Cholesky matrix of the inverse covariance (or its
+           // low-rank form) to "values", an array of nobs numbers
+
+    void whiten(double *values) const;
+
+           // the routines above of another ChiSquare, for a ChiSquare
+           // built on top of it (such as "VarProChiSquare")
+
+    static bool get_linear_params(const ChiSquare& chisq,
+                                  std::vector<uint>& linear_params)
+     {return chisq.getLinearParams(linear_params);}
+
+    static void eval_linear_basis(const ChiSquare& chisq,
+                                  const std::vector<double>& fitparams, RMatrix& basis,
+                                  std::vector<RMatrix>& basis_grads)
+     {chisq.evalLinearBasis(fitparams,basis,basis_grads);}
+
+    static void set_linear_params(const ChiSquare& chisq, const std::vector<double>& coefs,
+                                  std::vector<double>& fitparams)
+     {chisq.setLinearParams(coefs,fitparams);}
+
+    static void guess_initial_param_values(const ChiSquare& chisq,
+                                           const RVector& datapoints,
+                                           std::vector<double>& fitparams)
+     {chisq.guessInitialParamValues(datapoints,fitparams);}
+
+    static std::string get_parameter_name(const ChiSquare& chisq, uint param_index)
+     {return chisq.getParameterName(param_index);}
+
+    static void get_output(const ChiSquare& chisq, XMLHandler& xmlout)
+     {chisq.do_output(xmlout);}
+
 
  private:
 
+    void query_grad_sparsity();
+
+    void set_lowrank_cov(RVector *coveigvals);
+
+    void lowrank_whiten(double *values) const;
+
 #ifndef NO_CXX11
     ChiSquare() = delete;
     ChiSquare(const ChiSquare&) = delete;
@@ -197,6 +311,9 @@ class ChiSquare
     uint getNumberOfPriors() const
      {return m_npriors;}
 
+    virtual bool useVariableProjection() const
+     {return false;}
+
     const std::vector<MCObsInfo>& getObsInfos() const 
      {return m_obs_info;}
 
@@ -264,6 +381,17 @@ class ChiSquare
     virtual double evalChiSquarePy(const std::vector<double>& residuals) const{
         return evalChiSquare(residuals);
     }
+
+          // A minimization can be stopped from another thread: once the
+          // flag given here for the calling thread becomes true,
+          // "evalResiduals" and "evalResGradients" on this thread throw
+          // "ChiSquare::Stopped".  A null pointer (the default) turns
+          // this off.
+
+    struct Stopped : public std::exception
+     {const char *what() const noexcept {return "ChiSquare evaluation stopped";}};
+
+    static void setThreadStopFlag(const std::atomic<bool> *stop);
    
 
 };
@@ -1,5 +1,7 @@
 #include "chisq_fit.h"
+#include "chisq_varpro.h"
 #include "prior.h"
+#include <memory>
 using namespace std;
 
 
@@ -28,12 +30,20 @@ void doChiSquareFitting(ChiSquare& chisq_ref,
  if (covmode==Jackknife) xmlout.put_child("CovarianceCalculationMode","Jackknife");
  else if (covmode==Bootstrap) xmlout.put_child("CovarianceCalculationMode","Bootstrap");
 
- ChiSquareMinimizer CSM(chisq_ref,csm_info);
+    // with variable projection, only the nonlinear parameters are minimized over,
+    // and "varpro" gives all of the parameters from these
+ unique_ptr<VarProChiSquare> varpro;
+ if (chisq_ref.useVariableProjection()){
+    varpro.reset(new VarProChiSquare(chisq_ref));
+    xmlout.put_child("VariableProjection");}
+ ChiSquare& chisq_min=(varpro) ? *varpro : chisq_ref;
+
+ ChiSquareMinimizer CSM(chisq_min,csm_info);
  m_obs->begin();   // start with full sample
  double chisq;
- vector<double> params_fullsample;
+ vector<double> params_fullsample, params_min;
  RVector coveigvals;
- chisq_ref.setObsMeanCov(coveigvals);   // set means and covariance using full sample
+ chisq_min.setObsMeanCov(coveigvals);   // set means and covariance using full sample
     
  XMLHandler xmlcov("CovarianceMatrixEigenvalues");
  for (uint p=0;p<coveigvals.size();++p){
@@ -44,23 +54,25 @@ void doChiSquareFitting(ChiSquare& chisq_ref,
 
  XMLHandler xmlz;
     // first findMinimum guesses initial parameters
- bool flag=CSM.findMinimum(chisq,params_fullsample,xmlz);
+ bool flag=CSM.findMinimum(chisq,params_min,xmlz);
 
  if (xmlz.good()) xmlout.put_child(xmlz);
  if (!flag){
     throw(std::invalid_argument("Fitting with full sample failed"));}
  chisq_dof=chisq/dof;
+ if (varpro) varpro->getFullParams(params_min,params_fullsample);
+ else params_fullsample=params_min;
  for (uint p=0;p<nparams;++p)
     m_obs->putCurrentSamplingValue(param_infos[p],params_fullsample[p]);
  
- vector<double> start(params_fullsample);
+ vector<double> start(params_min);
  vector<double> params_sample;
 
     //   loop over the re-samplings
  for (++(*m_obs);!m_obs->end();++(*m_obs)){
-   chisq_ref.setObsMean();   // reset means for this resampling, keep covariance from full
+   chisq_min.setObsMean();   // reset means for this resampling, keep covariance from full
    double chisq_samp;
-   bool flag=CSM.findMinimum(start,chisq_samp,params_sample);
+   bool flag=CSM.findMinimum(start,chisq_samp,params_min);
    if (!flag){
         //if sample fit fails, resample the priors and try again x 100
         if (npriors){
@@ -70,16 +82,22 @@ void doChiSquareFitting(ChiSquare& chisq_ref,
                 for(ip=priors.begin();ip!=priors.end();ip++){
                     ip->second.resample_current_index();
                 }
-                flag=CSM.findMinimum(start,chisq_samp,params_sample);
+                flag=CSM.findMinimum(start,chisq_samp,params_min);
                 if(flag) break;
             }
             if (!flag) std::cout<<"Sample fit failed"<<std::endl;
         }
       if (!flag) throw(std::invalid_argument("Fitting with one of the resamplings failed"));
    }
+   if (varpro) varpro->getFullParams(params_min,params_sample);
+   else params_sample=params_min;
    for (uint p=0;p<nparams;++p)
       m_obs->putCurrentSamplingValue(param_infos[p],params_sample[p]);}
 
+ if (csm_info.usingPortfolio()){
+    XMLHandler xmlps;
+    CSM.outputPortfolioStatistics(xmlps);
+    xmlout.put_child(xmlps);}
  
  vector<double> prior_deviations;
  bestfit_params.resize(nparams);
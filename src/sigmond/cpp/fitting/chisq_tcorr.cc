@@ -99,6 +99,13 @@ RealTemporalCorrelatorFit::RealTemporalCorrelatorFit(
     m_model_ptr->setupPriors(m_priors);
  }
 
+ m_varpro=(xmlf.count_among_children("VariableProjection")>0);
+ if (m_varpro){
+    vector<uint> linear_params;
+    if (!m_model_ptr->getLinearParams(linear_params))
+       throw(std::invalid_argument(string("Model ")+modeltype
+                 +string(" does not support VariableProjection")));}
+
  allocate_obs_memory();
 
  CorrelatorAtTimeInfo CorTime(Cor,0,true,m_subt_vev);
@@ -143,6 +150,39 @@ void RealTemporalCorrelatorFit::evalGradients(
 }
 
 
+bool RealTemporalCorrelatorFit::getLinearParams(vector<uint>& linear_params) const
+{
+ return m_model_ptr->getLinearParams(linear_params);
+}
+
+
+void RealTemporalCorrelatorFit::evalLinearBasis(
+                               const vector<double>& fitparams, RMatrix& basis,
+                               vector<RMatrix>& basis_grads) const
+{
+ uint nparam=m_model_ptr->getNumberOfParams();
+ uint ncoef=basis.size(1);
+ vector<double> bvals(ncoef);
+ RMatrix bgrad(ncoef,nparam);
+ bool with_grads=!basis_grads.empty();
+ for (uint k=0;k<m_tvalues.size();k++){
+    bgrad=0.0;
+    m_model_ptr->evalLinearBasis(fitparams,double(m_tvalues[k]),bvals,bgrad);
+    for (uint c=0;c<ncoef;c++){
+       basis(k,c)=bvals[c];
+       for (uint p=0;(with_grads)&&(p<nparam);p++)
+          basis_grads[p](k,c)=bgrad(c,p);}}
+}
+
+
+void RealTemporalCorrelatorFit::setLinearParams(
+                               const vector<double>& coefs,
+                               vector<double>& fitparams) const
+{
+ m_model_ptr->setLinearParams(coefs,fitparams);
+}
+
+
 void RealTemporalCorrelatorFit::guessInitialParamValues(
                                const RVector& datapoints,
                                vector<double>& fitparams) const
@@ -167,6 +207,7 @@ void RealTemporalCorrelatorFit::do_output(XMLHandler& xmlout) const
  XMLHandler xmlmodel;
  m_model_ptr->output_tag(xmlmodel);
  xmlout.put_child(xmlmodel); 
+ if (m_varpro) xmlout.put_child("VariableProjection");
  XMLHandler xmlpriors("Priors");
  for (map<uint,Prior>::const_iterator prior_it=m_priors.begin(); prior_it!=m_priors.end(); ++prior_it){
     XMLHandler xmlprior(m_model_ptr->getParameterName(prior_it->first));
@@ -640,6 +681,22 @@ NSimRealTemporalCorrelatorFit::NSimRealTemporalCorrelatorFit(
          ti++;
      }
  }
+
+ // locate the parameters of each fit in the full parameter list once
+ m_param_indices.resize(n_fits);
+ for( i=0; i<n_fits; i++ ){ 
+     const vector<MCObsInfo>& these_fit_params_infos = m_fits[i]->getFitParamInfos();
+     for( uint ii = 0; ii< these_fit_params_infos.size(); ii++){
+         for( uint iii = 0; iii< m_nparams; iii++){
+             if( these_fit_params_infos[ii]==m_fitparam_info[iii]){ 
+                 m_param_indices[i].push_back(iii);
+                 break;
+             }
+         }
+     }
+     if( m_param_indices[i].size() != these_fit_params_infos.size() )
+         throw(std::invalid_argument("Missing param info somehow in NSimRealTemporalCorrelatorFit."));
+ }
     
 }
 
@@ -657,24 +714,18 @@ void NSimRealTemporalCorrelatorFit::evalModelPoints(
 {
     uint ti = 0;
     for( uint i = 0; i< m_fits.size(); i++){
-        vector<MCObsInfo> these_fit_params_infos = m_fits[i]->getFitParamInfos();
-        vector<double> these_fit_params;
-        for( uint ii = 0; ii< these_fit_params_infos.size(); ii++){
-            for( uint iii = 0; iii< m_nparams; iii++){
-                if( these_fit_params_infos[ii]==m_fitparam_info[iii]) these_fit_params.push_back(fitparams[iii]);
-            }
+        const vector<uint>& these_fit_param_indices = m_param_indices[i];
+        vector<double> these_fit_params(these_fit_param_indices.size());
+        for( uint ii = 0; ii< these_fit_param_indices.size(); ii++)
+            these_fit_params[ii] = fitparams[these_fit_param_indices[ii]];
+        uint this_n_obs = m_fits[i]->getNumberOfObervables();
+        vector<double> these_model_points;
+        these_model_points.resize(this_n_obs);
+        m_fits[i]->evalModelPoints( these_fit_params, these_model_points);
+        for( uint j = 0; j < this_n_obs; j++){
+            modelpoints[ti] = these_model_points[j];
+            ti++;
         }
-        if( these_fit_params.size() == these_fit_params_infos.size() ){
-            uint this_n_obs = m_fits[i]->getNumberOfObervables();
-            vector<double> these_model_points;
-            these_model_points.resize(this_n_obs);
-            m_fits[i]->evalModelPoints( these_fit_params, these_model_points);
-            for( uint j = 0; j < this_n_obs; j++){
-                modelpoints[ti] = these_model_points[j];
-                ti++;
-            }
-        }
-        else{ throw(std::invalid_argument("Missing param info somehow in evalModelPoints."));}
     }
 }
 
@@ -685,36 +736,44 @@ void NSimRealTemporalCorrelatorFit::evalGradients(
 {
     uint ti = 0;
     for( uint i = 0; i< m_fits.size(); i++){
-        vector<MCObsInfo> these_fit_params_infos = m_fits[i]->getFitParamInfos();
-        vector<double> these_fit_params;
-        vector<uint> these_fit_param_indices;
-        for( uint ii = 0; ii< these_fit_params_infos.size(); ii++){
-            for( uint iii = 0; iii< m_nparams; iii++){
-                if( these_fit_params_infos[ii]==m_fitparam_info[iii]){ 
-                    these_fit_params.push_back(fitparams[iii]);
-                    these_fit_param_indices.push_back(iii);
-                }
+        const vector<uint>& these_fit_param_indices = m_param_indices[i];
+        vector<double> these_fit_params(these_fit_param_indices.size());
+        for( uint ii = 0; ii< these_fit_param_indices.size(); ii++)
+            these_fit_params[ii] = fitparams[these_fit_param_indices[ii]];
+        uint this_n_obs = m_fits[i]->getNumberOfObervables();
+        RMatrix this_grad_matrix;
+        this_grad_matrix.resize(this_n_obs,these_fit_params.size());
+        m_fits[i]->evalGradients( these_fit_params, this_grad_matrix);
+        //fill in the correct parameters
+        for( uint j = 0; j < this_n_obs; j++){
+            //initialize gradient matrix to zero
+            for( uint jj = 0; jj < m_nparams; jj++){
+                gradients(ti,jj) = 0.0;
             }
-        }
-        if( these_fit_params.size() == these_fit_params_infos.size() ){
-            uint this_n_obs = m_fits[i]->getNumberOfObervables();
-            RMatrix this_grad_matrix;
-            this_grad_matrix.resize(this_n_obs,these_fit_params.size());
-            m_fits[i]->evalGradients( these_fit_params, this_grad_matrix);
-            //fill in the correct parameters
-            for( uint j = 0; j < this_n_obs; j++){
-                //initialize gradient matrix to zero
-                for( uint jj = 0; jj < m_fitparam_info.size(); jj++){
-                    gradients(ti,jj) = 0.0;
-                }
-                for( uint jj = 0; jj < these_fit_params.size(); jj++){
-                    gradients(ti,these_fit_param_indices[jj]) = this_grad_matrix(j,jj);
-                }
-                ti++;
+            for( uint jj = 0; jj < these_fit_params.size(); jj++){
+                gradients(ti,these_fit_param_indices[jj]) = this_grad_matrix(j,jj);
             }
+            ti++;
+        }
+    }
+}
+
+
+    // the observables of each fit depend only on that fit's parameters
+
+bool NSimRealTemporalCorrelatorFit::getGradientSparsity(vector<vector<uint> >& rows) const
+{
+    rows.assign(m_nparams,vector<uint>());
+    uint ti = 0;
+    for( uint i = 0; i< m_fits.size(); i++){
+        uint this_n_obs = m_fits[i]->getNumberOfObervables();
+        for( uint ii = 0; ii< m_param_indices[i].size(); ii++){
+            vector<uint>& prows = rows[m_param_indices[i][ii]];
+            for( uint j = 0; j < this_n_obs; j++) prows.push_back(ti+j);
         }
-        else{ throw(std::invalid_argument("Missing param info somehow in evalGradients."));}
+        ti+=this_n_obs;
     }
+    return true;
 }
 
 
@@ -725,40 +784,27 @@ void NSimRealTemporalCorrelatorFit::guessInitialParamValues(
     uint ti = 0;
     vector<bool> initialized(fitparams.size(),false);
     for( uint i = 0; i< m_fits.size(); i++){
-        vector<MCObsInfo> these_fit_params_infos = m_fits[i]->getFitParamInfos();
-        vector<double> these_fit_params;
-        vector<uint> these_fit_param_indices;
-        for( uint ii = 0; ii< these_fit_params_infos.size(); ii++){
-            for( uint iii = 0; iii< m_nparams; iii++){
-                if( these_fit_params_infos[ii]==m_fitparam_info[iii]){ 
-//                     these_fit_params.push_back(fitparams[iii]);
-                    these_fit_param_indices.push_back(iii);
-                }
-            }
+        const vector<uint>& these_fit_param_indices = m_param_indices[i];
+        uint this_n_obs = m_fits[i]->getNumberOfObervables();
+        uint this_n_param = m_fits[i]->getNumberOfParams();
+        vector<double> these_fit_params( this_n_param );
+        vector<double> these_datapoints;
+        these_datapoints.resize(this_n_obs);
+        for( uint k = 0; k < this_n_obs; k++){
+            these_datapoints[k] = datapoints[ti+k];
         }
-        if( these_fit_param_indices.size() == these_fit_params_infos.size() ){
-            uint this_n_obs = m_fits[i]->getNumberOfObervables();
-            uint this_n_param = m_fits[i]->getNumberOfParams();
-            these_fit_params.resize( this_n_param );
-            vector<double> these_datapoints;
-            these_datapoints.resize(this_n_obs);
-            for( uint k = 0; k < this_n_obs; k++){
-                these_datapoints[k] = datapoints[ti+k];
-            }
-            m_fits[i]->guessInitialParamValues( these_datapoints, these_fit_params);
-            for( uint j = 0; j<this_n_param; j++){
-                if( !initialized[these_fit_param_indices[j]] ){
-                    fitparams[these_fit_param_indices[j]] = these_fit_params[j];
-                    initialized[these_fit_param_indices[j]] = true;
-                }else{
-                    //rough average of multiple initial guesses
-                    fitparams[these_fit_param_indices[j]] += these_fit_params[j];
-                    fitparams[these_fit_param_indices[j]] /= 2.0;
-                }
+        m_fits[i]->guessInitialParamValues( these_datapoints, these_fit_params);
+        for( uint j = 0; j<this_n_param; j++){
+            if( !initialized[these_fit_param_indices[j]] ){
+                fitparams[these_fit_param_indices[j]] = these_fit_params[j];
+                initialized[these_fit_param_indices[j]] = true;
+            }else{
+                //rough average of multiple initial guesses
+                fitparams[these_fit_param_indices[j]] += these_fit_params[j];
+                fitparams[these_fit_param_indices[j]] /= 2.0;
             }
-            ti+=this_n_obs;
         }
-        else{ throw(std::invalid_argument("Missing param info somehow in guessInitialParamValues."));}
+        ti+=this_n_obs;
     }
 }
 
@@ -25,6 +25,7 @@
 // *         <ExcludeTimes>4 8</ExcludeTimes>  (optional)              *
 // *         <LargeTimeNoiseCutoff>1.0</LargeTimeNoiseCutoff>          *
 // *         <Model>...</Model>   (see "model_tcorr.h")                *
+// *         <VariableProjection/>      (optional)                     *
 // *       </TemporalCorrelatorFit>                                    *
 // *                                                                   *
 // *    "LargeTimeNoiseCutoff" will lower the maximum time             *
@@ -32,6 +33,13 @@
 // *    correlator over the correlator is smaller than                 *
 // *    "LargeTimeNoiseCutoff".                                        *
 // *                                                                   *
+// *    With "VariableProjection", the amplitudes are eliminated by a  *
+// *    linear solve and only the energies are varied by the minimizer *
+// *    (see "chisq_varpro.h").  This is available for models with a   *
+// *    "getLinearParams" (TimeForwardTwoExponential,                  *
+// *    TimeSymTwoExponential and TimeForwardThreeExponential), and    *
+// *    not with priors on the amplitudes.                             *
+// *                                                                   *
 // *********************************************************************
 
 
@@ -44,6 +52,7 @@ class RealTemporalCorrelatorFit :  public ChiSquare
     bool m_subt_vev;
     double m_noisecutoff;
     TemporalCorrelatorModel *m_model_ptr;
+    bool m_varpro;               // fit using variable projection
 
  public:
 
@@ -61,6 +70,8 @@ class RealTemporalCorrelatorFit :  public ChiSquare
     
     const std::vector<uint>& getTvalues() const {return m_tvalues;}
 
+    virtual bool useVariableProjection() const {return m_varpro;}
+
     virtual void evalModelPoints(const std::vector<double>& fitparams,
                                  std::vector<double>& modelpoints) const;
 
@@ -77,6 +88,14 @@ class RealTemporalCorrelatorFit :  public ChiSquare
     virtual void plot(const XMLHandler& xmlin, const int taskcount, const double qual, const double goodness, 
                       const uint lat_time_extent, const std::vector<MCEstimate>& bestfit_params, XMLHandler& xmlout) const;
 
+    virtual bool getLinearParams(std::vector<uint>& linear_params) const;
+
+    virtual void evalLinearBasis(const std::vector<double>& fitparams, RMatrix& basis,
+                                 std::vector<RMatrix>& basis_grads) const;
+
+    virtual void setLinearParams(const std::vector<double>& coefs,
+                                 std::vector<double>& fitparams) const;
+
     friend class TaskHandler;
 
 };
@@ -184,6 +203,7 @@ class TwoRealTemporalCorrelatorFit :  public ChiSquare
 class NSimRealTemporalCorrelatorFit :  public ChiSquare
 {
     std::vector<RealTemporalCorrelatorFit*> m_fits;
+    std::vector<std::vector<uint> > m_param_indices;   // parameters of each fit in the full list
 
  public:
 
@@ -210,6 +230,8 @@ class NSimRealTemporalCorrelatorFit :  public ChiSquare
                         const double qual, const double goodness, const uint lat_time_extent, 
                         const std::vector<MCEstimate>& bestfit_params, XMLHandler& xmlout) const;
 
+    virtual bool getGradientSparsity(std::vector<std::vector<uint> >& rows) const;
+
     friend class TaskHandler;
 
 };
@@ -0,0 +1,248 @@
+#include "chisq_varpro.h"
+#include <cmath>
+using namespace std;
+
+
+// *************************************************************
+
+
+VarProChiSquare::VarProChiSquare(const ChiSquare& full)
+   :  ChiSquare(*full.getMCObsHandlerPtr()), m_full(&full)
+{
+ if ((!get_linear_params(full,m_linear))||(m_linear.empty()))
+    throw(std::invalid_argument("Variable projection not supported by this fit"));
+ uint nfull=full.getNumberOfParams();
+ vector<bool> is_linear(nfull,false);
+ for (uint k=0;k<m_linear.size();k++){
+    if ((m_linear[k]>=nfull)||(is_linear[m_linear[k]]))
+       throw(std::invalid_argument("Invalid linear parameters in variable projection"));
+    is_linear[m_linear[k]]=true;}
+ for (uint p=0;p<nfull;p++)
+    if (!is_linear[p]) m_nonlinear.push_back(p);
+ if (m_nonlinear.empty())
+    throw(std::invalid_argument("No nonlinear parameters in variable projection"));
+
+ m_nobs=full.getNumberOfObervables();
+ m_nparams=m_nonlinear.size();
+ allocate_obs_memory();
+ m_obs_info=full.getObsInfos();
+ const vector<MCObsInfo>& full_param_info=full.getFitParamInfos();
+ for (uint j=0;j<m_nparams;j++)
+    m_fitparam_info.push_back(full_param_info[m_nonlinear[j]]);
+ const map<uint,Prior>& full_priors=full.getFitPriors();
+ m_npriors=0;
+ for (uint j=0;j<m_nparams;j++){
+    map<uint,Prior>::const_iterator prior_it=full_priors.find(m_nonlinear[j]);
+    if (prior_it!=full_priors.end()){
+       m_priors.insert(pair<uint,Prior>(j,prior_it->second));
+       m_npriors++;}}
+ if (m_npriors!=full.getNumberOfPriors())
+    throw(std::invalid_argument("Variable projection cannot be used with priors on linear parameters"));
+}
+
+
+void VarProChiSquare::getFullParams(const vector<double>& fitparams,
+                                    vector<double>& full_params) const
+{
+ RMatrix basis, Q, R;
+ vector<RMatrix> basis_grads;
+ vector<double> b, qb, coefs;
+ project(fitparams,full_params,basis,basis_grads,Q,R,b,qb,coefs,false);
+ set_linear_params(*m_full,coefs,full_params);
+}
+
+
+void VarProChiSquare::evalModelPoints(const vector<double>& fitparams,
+                                      vector<double>& modelpoints) const
+{
+ RMatrix basis, Q, R;
+ vector<RMatrix> basis_grads;
+ vector<double> full_params, b, qb, coefs;
+ project(fitparams,full_params,basis,basis_grads,Q,R,b,qb,coefs,false);
+ uint ncoef=coefs.size();
+ for (uint i=0;i<m_nobs;i++){
+    double tmp=0.0;
+    for (uint k=0;k<ncoef;k++)
+       tmp+=basis(i,k)*coefs[k];
+    modelpoints[i]=tmp;}
+}
+
+
+    //  The gradients here are of the model points  basis * coefs  (not
+    //  whitened), so that their whitening in "evalResGradients" gives the
+    //  derivatives of the projected residuals.  With  A = Q R,  the
+    //  whitened residual is  r = Q Q^T b - b,  and  A^T x = R^T Q^T x.
+
+void VarProChiSquare::evalGradients(const vector<double>& fitparams,
+                                    RMatrix& gradients) const
+{
+ RMatrix basis, Q, R;
+ vector<RMatrix> basis_grads;
+ vector<double> full_params, b, qb, coefs;
+ project(fitparams,full_params,basis,basis_grads,Q,R,b,qb,coefs,true);
+ uint ncoef=coefs.size();
+
+ vector<double> r(m_nobs);
+ for (uint i=0;i<m_nobs;i++){
+    double tmp=-b[i];
+    for (uint k=0;k<ncoef;k++)
+       tmp+=Q(i,k)*qb[k];
+    r[i]=tmp;}
+
+ vector<double> Dc(m_nobs), col(m_nobs), v(ncoef);
+ for (uint j=0;j<m_nparams;j++){
+    const RMatrix& dbasis=basis_grads[m_nonlinear[j]];
+       //  v = -D^T r - A^T D coefs,  whitening only the nonzero columns
+    for (uint i=0;i<m_nobs;i++) Dc[i]=0.0;
+    for (uint k=0;k<ncoef;k++){
+       bool zero=true;
+       for (uint i=0;i<m_nobs;i++){
+          col[i]=dbasis(i,k);
+          if (col[i]!=0.0) zero=false;}
+       v[k]=0.0;
+       if (zero) continue;
+       whiten(&col[0]);
+       double tmp=0.0;
+       for (uint i=0;i<m_nobs;i++){
+          tmp+=col[i]*r[i];
+          Dc[i]+=col[i]*coefs[k];}
+       v[k]=-tmp;}
+    for (uint k=0;k<ncoef;k++){
+       double tmp=0.0;
+       for (uint i=0;i<m_nobs;i++)
+          tmp+=Q(i,k)*Dc[i];
+       col[k]=tmp;}
+    for (uint k=0;k<ncoef;k++){
+       double tmp=0.0;
+       for (uint l=0;l<=k;l++)
+          tmp+=R(l,k)*col[l];
+       v[k]-=tmp;}
+       //  dcoefs = (R^T R)^(-1) v
+    solve_upper_transpose(R,v);
+    solve_upper(R,v);
+    for (uint i=0;i<m_nobs;i++){
+       double tmp=0.0;
+       for (uint k=0;k<ncoef;k++)
+          tmp+=dbasis(i,k)*coefs[k]+basis(i,k)*v[k];
+       gradients(i,j)=tmp;}}
+}
+
+
+void VarProChiSquare::guessInitialParamValues(const RVector& datapoints,
+                                              vector<double>& fitparams) const
+{
+ vector<double> full_params(m_full->getNumberOfParams());
+ guess_initial_param_values(*m_full,datapoints,full_params);
+ for (uint j=0;j<m_nparams;j++)
+    fitparams[j]=full_params[m_nonlinear[j]];
+}
+
+
+string VarProChiSquare::getParameterName(uint param_index) const
+{
+ return get_parameter_name(*m_full,m_nonlinear[param_index]);
+}
+
+
+void VarProChiSquare::do_output(XMLHandler& xmlout) const
+{
+ get_output(*m_full,xmlout);
+}
+
+
+    //  Evaluates the basis (and its derivatives if "with_grads") for the
+    //  nonlinear parameters "fitparams", factors the whitened basis by
+    //  modified Gram-Schmidt, and solves for the coefficients.  A column
+    //  whose remaining norm is negligible compared to its original norm
+    //  gets a zero column in Q and a zero diagonal in R, and its
+    //  coefficient is zero.
+
+void VarProChiSquare::project(const vector<double>& fitparams, vector<double>& full_params,
+                              RMatrix& basis, vector<RMatrix>& basis_grads, RMatrix& Q,
+                              RMatrix& R, vector<double>& b, vector<double>& qb,
+                              vector<double>& coefs, bool with_grads) const
+{
+ uint ncoef=m_linear.size();
+ uint nfull=m_full->getNumberOfParams();
+ full_params.assign(nfull,0.0);
+ for (uint j=0;j<m_nparams;j++)
+    full_params[m_nonlinear[j]]=fitparams[j];
+ basis.resize(m_nobs,ncoef);
+ if (with_grads) basis_grads.assign(nfull,RMatrix(m_nobs,ncoef,0.0));
+ else basis_grads.clear();
+ eval_linear_basis(*m_full,full_params,basis,basis_grads);
+
+ const double eps=1e-12;
+ Q.resize(m_nobs,ncoef);
+ R.resize(ncoef,ncoef);
+ R=0.0;
+ vector<double> col(m_nobs);
+ for (uint k=0;k<ncoef;k++){
+    for (uint i=0;i<m_nobs;i++)
+       col[i]=basis(i,k);
+    whiten(&col[0]);
+    double norm0=0.0;
+    for (uint i=0;i<m_nobs;i++)
+       norm0+=col[i]*col[i];
+    for (uint l=0;l<k;l++){
+       double tmp=0.0;
+       for (uint i=0;i<m_nobs;i++)
+          tmp+=Q(i,l)*col[i];
+       R(l,k)=tmp;
+       for (uint i=0;i<m_nobs;i++)
+          col[i]-=tmp*Q(i,l);}
+    double norm=0.0;
+    for (uint i=0;i<m_nobs;i++)
+       norm+=col[i]*col[i];
+    if (!(norm>eps*eps*norm0)) norm=0.0;
+    norm=sqrt(norm);
+    R(k,k)=norm;
+    for (uint i=0;i<m_nobs;i++)
+       Q(i,k)=(norm>0.0) ? col[i]/norm : 0.0;}
+
+ b.resize(m_nobs);
+ for (uint i=0;i<m_nobs;i++)
+    b[i]=m_means[i];
+ whiten(&b[0]);
+ qb.resize(ncoef);
+ for (uint k=0;k<ncoef;k++){
+    double tmp=0.0;
+    for (uint i=0;i<m_nobs;i++)
+       tmp+=Q(i,k)*b[i];
+    qb[k]=tmp;}
+ coefs=qb;
+ solve_upper(R,coefs);
+}
+
+
+    //  Solve R x = y (upper triangular) in place; zero diagonals give zero
+
+void VarProChiSquare::solve_upper(const RMatrix& R, vector<double>& x)
+{
+ int n=x.size();
+ for (int k=n-1;k>=0;k--){
+    if (R(k,k)==0.0){
+       x[k]=0.0; continue;}
+    double tmp=x[k];
+    for (int l=k+1;l<n;l++)
+       tmp-=R(k,l)*x[l];
+    x[k]=tmp/R(k,k);}
+}
+
+
+    //  Solve R^T x = y in place; zero diagonals give zero
+
+void VarProChiSquare::solve_upper_transpose(const RMatrix& R, vector<double>& x)
+{
+ int n=x.size();
+ for (int k=0;k<n;k++){
+    if (R(k,k)==0.0){
+       x[k]=0.0; continue;}
+    double tmp=x[k];
+    for (int l=0;l<k;l++)
+       tmp-=R(l,k)*x[l];
+    x[k]=tmp/R(k,k);}
+}
+
+
+// *************************************************************
@@ -0,0 +1,103 @@
+#ifndef CHISQ_VARPRO_H
+#define CHISQ_VARPRO_H
+
+#include "chisq_base.h"
+
+// *********************************************************************
+// *                                                                   *
+// *    The class "VarProChiSquare", derived from the base class       *
+// *    "ChiSquare", carries out a fit by variable projection          *
+// *    (Golub and Pereyra, SIAM J. Numer. Anal. 10 (1973) 413).  It   *
+// *    is constructed from a "full" ChiSquare whose model points      *
+// *    are linear in some of its parameters:                          *
+// *                                                                   *
+// *         model[i] = sum_k basis(i,k) * coefs[k]                    *
+// *                                                                   *
+// *    where the basis depends only on the other, "nonlinear",        *
+// *    parameters (see "getLinearParams" in "chisq_base.h").  The     *
+// *    parameters of a VarProChiSquare are these nonlinear            *
+// *    parameters only.  For each set of their values, the            *
+// *    coefficients are those minimizing the chi-square, found by a   *
+// *    linear least-squares solve with the whitened basis             *
+// *    A = L * basis, where inv_cov = transpose(L) * L:               *
+// *                                                                   *
+// *         A = Q R,    coefs = R^(-1) Q^T L means                    *
+// *                                                                   *
+// *    so the minimizer iterates over fewer parameters and needs no   *
+// *    starting values for the linear ones.  The gradients are the    *
+// *    exact derivatives of the projected residuals, including the    *
+// *    change of the coefficients:                                    *
+// *                                                                   *
+// *     d coefs/dp = -(A^T A)^(-1) [ D^T r + A^T D coefs ]            *
+// *                                                                   *
+// *    where D = L d(basis)/dp and r is the whitened residual.  A     *
+// *    basis function which is (numerically) a combination of the     *
+// *    others has its coefficient set to zero.                        *
+// *                                                                   *
+// *    The observables, the covariance and the priors (which must     *
+// *    not be on the linear parameters) are those of the full         *
+// *    ChiSquare, but the means and covariance are set in the         *
+// *    VarProChiSquare itself with "setObsMeanCov" and "setObsMean".  *
+// *    At the minimum, "getFullParams" returns the values of all      *
+// *    parameters of the full ChiSquare, at which its chi-square is   *
+// *    the same.                                                      *
+// *                                                                   *
+// *********************************************************************
+
+
+class VarProChiSquare :  public ChiSquare
+{
+    const ChiSquare *m_full;
+    std::vector<uint> m_linear;       // indices in the full parameters
+    std::vector<uint> m_nonlinear;    // full index of each parameter here
+
+#ifndef NO_CXX11
+    VarProChiSquare() = delete;
+    VarProChiSquare(const VarProChiSquare&) = delete;
+    VarProChiSquare& operator=(const VarProChiSquare&) = delete;
+#else
+    VarProChiSquare();
+    VarProChiSquare(const VarProChiSquare&);
+    VarProChiSquare& operator=(const VarProChiSquare&);
+#endif
+
+ public:
+
+    VarProChiSquare(const ChiSquare& full);
+
+    virtual ~VarProChiSquare(){}
+
+    uint getNumberOfLinearParams() const {return m_linear.size();}
+
+    void getFullParams(const std::vector<double>& fitparams,
+                       std::vector<double>& full_params) const;
+
+    virtual void evalModelPoints(const std::vector<double>& fitparams,
+                                 std::vector<double>& modelpoints) const;
+
+    virtual void evalGradients(const std::vector<double>& fitparams,
+                               RMatrix& gradients) const;
+
+    virtual void guessInitialParamValues(const RVector& datapoints,
+                                         std::vector<double>& fitparams) const;
+
+    virtual std::string getParameterName(uint param_index) const;
+
+    virtual void do_output(XMLHandler& xmlout) const;
+
+ private:
+
+    void project(const std::vector<double>& fitparams, std::vector<double>& full_params,
+                 RMatrix& basis, std::vector<RMatrix>& basis_grads, RMatrix& Q,
+                 RMatrix& R, std::vector<double>& b, std::vector<double>& qb,
+                 std::vector<double>& coefs, bool with_grads) const;
+
+    static void solve_upper(const RMatrix& R, std::vector<double>& x);
+
+    static void solve_upper_transpose(const RMatrix& R, std::vector<double>& x);
+
+};
+
+
+// *********************************************************************
+#endif
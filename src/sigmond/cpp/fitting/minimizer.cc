@@ -1,5 +1,8 @@
 #include "minimizer.h"
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <atomic>
 using namespace std;
 
 
@@ -7,8 +10,36 @@ using namespace std;
 
 
 ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(XMLHandler& xmlin)
+   :  m_race(true)
 {
  XMLHandler xmlr(xmlin,"MinimizerInfo");
+ read_settings(xmlr);
+ string reply;
+ m_verbosity='L';
+ if (xmlreadifchild(xmlr,"Verbosity",reply)){
+    if (reply=="Low") m_verbosity='L';
+    else if (reply=="Medium") m_verbosity='M';
+    else if (reply=="High") m_verbosity='H';
+    else throw(std::invalid_argument("Invalid <Verbosity> tag in ChiSquareMinimizerInfo"));}
+ if (xml_child_tag_count(xmlr,"Portfolio")>0){
+    XMLHandler xmlp(xmlr,"Portfolio");
+    if (xmlreadifchild(xmlp,"Mode",reply)){
+       if (reply=="Race") m_race=true;
+       else if (reply=="Fallback") m_race=false;
+       else throw(std::invalid_argument("Invalid <Mode> tag in <Portfolio> of ChiSquareMinimizerInfo"));}
+    list<XMLHandler> xmlm=xmlp.find_among_children("Member");
+    for (list<XMLHandler>::iterator it=xmlm.begin();it!=xmlm.end();++it){
+       ChiSquareMinimizerInfo member;
+       member.read_settings(*it);
+       addPortfolioMember(member);}
+    if (m_portfolio.empty())
+       throw(std::invalid_argument("<Portfolio> with no <Member> in ChiSquareMinimizerInfo"));
+    check_portfolio();}
+}
+
+
+void ChiSquareMinimizerInfo::read_settings(XMLHandler& xmlr)
+{
  m_method=defaultmethod;
  string reply;
  if (xmlreadifchild(xmlr,"Method",reply)){
@@ -30,12 +61,6 @@ ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(XMLHandler& xmlin)
  int its;
  if (xmlreadifchild(xmlr,"MaximumIterations",its)) 
     setMaximumIterations(its);
- m_verbosity='L';
- if (xmlreadifchild(xmlr,"Verbosity",reply)){
-    if (reply=="Low") m_verbosity='L';
-    else if (reply=="Medium") m_verbosity='M';
-    else if (reply=="High") m_verbosity='H';
-    else throw(std::invalid_argument("Invalid <Verbosity> tag in ChiSquareMinimizerInfo"));}
 }
 
 
@@ -43,6 +68,7 @@ ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(XMLHandler& xmlin)
 ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(char method, 
                                                double param_reltol, double chisq_reltol, 
                                                int max_its, char verbosity)
+   :  m_race(true)
 {
  setMethod(method);
  setParameterRelativeTolerance(param_reltol);
@@ -55,7 +81,8 @@ ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(char method,
 ChiSquareMinimizerInfo::ChiSquareMinimizerInfo(const ChiSquareMinimizerInfo& info)
    :   m_method(info.m_method),  m_param_reltol(info.m_param_reltol),
        m_chisq_reltol(info.m_chisq_reltol),  m_max_its(info.m_max_its),
-       m_verbosity(info.m_verbosity)
+       m_verbosity(info.m_verbosity), m_portfolio(info.m_portfolio),
+       m_race(info.m_race)
 {}
 
 
@@ -66,6 +93,8 @@ ChiSquareMinimizerInfo& ChiSquareMinimizerInfo::operator=(const ChiSquareMinimiz
  m_chisq_reltol=info.m_chisq_reltol;
  m_max_its=info.m_max_its;
  m_verbosity=info.m_verbosity;   
+ m_portfolio=info.m_portfolio;
+ m_race=info.m_race;
  return *this;
 }
 
@@ -134,10 +163,64 @@ void ChiSquareMinimizerInfo::setVerbosity(char verbosity)
 }
 
 
+    //  A member's own portfolio is dropped; its verbosity is that of
+    //  the whole portfolio.
+
+void ChiSquareMinimizerInfo::addPortfolioMember(const ChiSquareMinimizerInfo& member)
+{
+ m_portfolio.push_back(member);
+ m_portfolio.back().m_portfolio.clear();
+}
+
+
+    //  The NL2SOL routines can only run one fit at a time (see
+    //  "NL2SolMinimizer::chisq_fit"), so NL2Sol members of a race would
+    //  only take turns.
+
+void ChiSquareMinimizerInfo::check_portfolio() const
+{
+ if ((m_portfolio.empty())||(!m_race)) return;
+ uint nnl2sol=(m_method=='N') ? 1 : 0;
+ for (uint k=0;k<m_portfolio.size();++k)
+    if (m_portfolio[k].m_method=='N') ++nnl2sol;
+ if (nnl2sol>1)
+    throw(std::invalid_argument("At most one NL2Sol member allowed in a Race <Portfolio>"
+                                " (NL2SOL fits cannot run concurrently); use Fallback mode"));
+}
+
+
+ChiSquareMinimizerInfo ChiSquareMinimizerInfo::getPortfolioMember(unsigned int k) const
+{
+ if (k>m_portfolio.size())
+    throw(std::invalid_argument("Invalid index in ChiSquareMinimizerInfo::getPortfolioMember"));
+ ChiSquareMinimizerInfo member((k==0) ? *this : m_portfolio[k-1]);
+ member.m_portfolio.clear();
+ member.m_verbosity=m_verbosity;
+ return member;
+}
+
+
 
 void ChiSquareMinimizerInfo::output(XMLHandler& xmlout) const
 {
  xmlout.set_root("MinimizerInfo");
+ output_settings(xmlout);
+ if (m_verbosity=='L') xmlout.put_child("Verbosity","Low");
+ else if (m_verbosity=='M') xmlout.put_child("Verbosity","Medium");
+ else if (m_verbosity=='H') xmlout.put_child("Verbosity","High");
+ if (!m_portfolio.empty()){
+    XMLHandler xmlp("Portfolio");
+    xmlp.put_child("Mode",(m_race) ? "Race" : "Fallback");
+    for (uint k=0;k<m_portfolio.size();++k){
+       XMLHandler xmlm("Member");
+       m_portfolio[k].output_settings(xmlm);
+       xmlp.put_child(xmlm);}
+    xmlout.put_child(xmlp);}
+}
+
+
+void ChiSquareMinimizerInfo::output_settings(XMLHandler& xmlout) const
+{
  if (m_method=='M') xmlout.put_child("Method","Minuit2");
  else if (m_method=='F') xmlout.put_child("Method","Minuit2NoGradient");
  else if (m_method=='L') xmlout.put_child("Method","LMDer");
@@ -145,9 +228,6 @@ void ChiSquareMinimizerInfo::output(XMLHandler& xmlout) const
  xmlout.put_child("ParameterRelTol",make_string(m_param_reltol));
  xmlout.put_child("ChiSquareRelTol",make_string(m_chisq_reltol));
  xmlout.put_child("MaximumIterations",make_string(m_max_its));
- if (m_verbosity=='L') xmlout.put_child("Verbosity","Low");
- else if (m_verbosity=='M') xmlout.put_child("Verbosity","Medium");
- else if (m_verbosity=='H') xmlout.put_child("Verbosity","High");
 }
 
 
@@ -175,6 +255,7 @@ ChiSquareMinimizer::ChiSquareMinimizer(ChiSquare &in_chisq)
 #ifndef NO_MINUIT
      , m_minuit2(0), m_minuit2ng(0)
 #endif
+     , m_nfits(0), m_nfailed(0)
 {
  alloc_method();
 }
@@ -185,6 +266,7 @@ ChiSquareMinimizer::ChiSquareMinimizer(ChiSquare &in_chisq, const ChiSquareMinim
 #ifndef NO_MINUIT
      , m_minuit2(0), m_minuit2ng(0)
 #endif
+     , m_nfits(0), m_nfailed(0)
 {
  alloc_method();
 }
@@ -205,11 +287,21 @@ void ChiSquareMinimizer::dealloc_method()
  delete m_minuit2; m_minuit2=0;
  delete m_minuit2ng; m_minuit2ng=0;
 #endif
+ for (uint k=0;k<m_members.size();++k)
+    delete m_members[k];
+ m_members.clear();
 }
 
 
 void ChiSquareMinimizer::alloc_method()
 {
+ if (m_info.usingPortfolio()){
+    m_info.check_portfolio();
+    uint nmembers=m_info.getNumberOfPortfolioMembers();
+    for (uint k=0;k<nmembers;++k)
+       m_members.push_back(new ChiSquareMinimizer(*m_chisq,m_info.getPortfolioMember(k)));
+    clearPortfolioStatistics();
+    return;}
  if (m_info.m_method=='L')
     m_lmder=new LMDerMinimizer(*m_chisq);
  else if (m_info.m_method=='N')
@@ -226,7 +318,8 @@ void ChiSquareMinimizer::alloc_method()
 
 void ChiSquareMinimizer::reset(const ChiSquareMinimizerInfo& info)
 {
- if (m_info.m_method==info.m_method) return;
+ if ((m_info.m_method==info.m_method)&&(!m_info.usingPortfolio())
+     &&(!info.usingPortfolio())) return;
  dealloc_method();
  m_info=info;
  alloc_method();
@@ -239,6 +332,9 @@ bool ChiSquareMinimizer::find_minimum(const vector<double>& starting_params,
                                       vector<double>& params_at_minimum,
                                       XMLHandler& xmlout, char verbosity)
 {
+ if (!m_members.empty())
+    return find_minimum_portfolio(starting_params,chisq_min,params_at_minimum,
+                                  xmlout,verbosity);
  if (m_info.m_method=='L')
     return find_minimum_lmder(starting_params,chisq_min,params_at_minimum,
                               xmlout,verbosity);
@@ -452,6 +548,104 @@ bool ChiSquareMinimizer::find_minimum_nl2sol(const vector<double>& starting_para
 }
 
 
+    //  In a race, each member runs on its own thread (the first on this
+    //  one) with a stop flag that the first member to converge sets, so
+    //  the others throw "ChiSquare::Stopped" at their next evaluation of
+    //  the residuals.  All have stopped before this returns, so the
+    //  ChiSquare can then be changed for the next resampling.  An error
+    //  in one member is only reported if no member converges.
+
+bool ChiSquareMinimizer::find_minimum_portfolio(const vector<double>& starting_params,
+                                                double& chisq_min, 
+                                                vector<double>& params_at_minimum,
+                                                XMLHandler& xmlout, char verbosity)
+{
+ xmlout.clear();
+ uint nmembers=m_members.size();
+ vector<double> chisqs(nmembers,-1.0);
+ vector<vector<double> > results(nmembers);
+ vector<XMLHandler> logs(nmembers);
+ int winner=-1;
+ string errmsg;
+ m_nfits++;
+ if (!m_info.m_race){
+    for (uint k=0;(k<nmembers)&&(winner<0);++k){
+       try{
+          if (m_members[k]->find_minimum(starting_params,chisqs[k],results[k],
+                                         logs[k],verbosity)) winner=k;}
+       catch(const std::exception& xp){
+          if (errmsg.empty()) errmsg=xp.what();}}}
+ else{
+    atomic<bool> stop(false);
+    atomic<int> first(-1);
+    mutex errmutex;
+    auto run=[&](uint k){
+       ChiSquare::setThreadStopFlag(&stop);
+       try{
+          if (m_members[k]->find_minimum(starting_params,chisqs[k],results[k],
+                                         logs[k],verbosity)){
+             int none=-1;
+             if (first.compare_exchange_strong(none,int(k))) stop=true;}}
+       catch(const ChiSquare::Stopped&){}
+       catch(const std::exception& xp){
+          lock_guard<mutex> lock(errmutex);
+          if (errmsg.empty()) errmsg=xp.what();}
+       ChiSquare::setThreadStopFlag(0);};
+    vector<thread> workers;
+    for (uint k=1;k<nmembers;++k)
+       workers.push_back(thread(run,k));
+    run(0);
+    for (uint k=0;k<workers.size();++k)
+       workers[k].join();
+    winner=first;}
+
+ m_winners.push_back(winner);
+ if (winner<0){
+    m_nfailed++;
+    if (!errmsg.empty())
+       throw(std::runtime_error(string("All minimizers in portfolio failed: ")+errmsg));
+    chisq_min=-1.0;
+    params_at_minimum.clear();
+    return false;}
+ m_wins[winner]++;
+ chisq_min=chisqs[winner];
+ params_at_minimum=results[winner];
+ if (verbosity!='L'){
+    xmlout.set_root("PortfolioLog");
+    XMLHandler xmlw;
+    m_members[winner]->m_info.output(xmlw);
+    xmlw.rename_tag("Winner");
+    xmlout.put_child(xmlw);
+    if (logs[winner].good()) xmlout.put_child(logs[winner]);}
+ return true;
+}
+
+
+void ChiSquareMinimizer::outputPortfolioStatistics(XMLHandler& xmlout) const
+{
+ xmlout.set_root("MinimizerPortfolio");
+ xmlout.put_child("Mode",(m_info.m_race) ? "Race" : "Fallback");
+ xmlout.put_child("NumberOfMinimizations",make_string(m_nfits));
+ xmlout.put_child("NumberFailed",make_string(m_nfailed));
+ for (uint k=0;k<m_members.size();++k){
+    XMLHandler xmlm("Member");
+    xmlm.put_child("Index",make_string(k));
+    m_members[k]->m_info.output_settings(xmlm);
+    xmlm.put_child("Wins",make_string(m_wins[k]));
+    xmlout.put_child(xmlm);}
+ xmlout.put_child("WinnerOfEachMinimization",make_string(m_winners));
+}
+
+
+void ChiSquareMinimizer::clearPortfolioStatistics()
+{
+ m_wins.assign(m_members.size(),0);
+ m_winners.clear();
+ m_nfits=0;
+ m_nfailed=0;
+}
+
+
 void ChiSquareMinimizer::xmlformat(const string& roottag, const string& inlogstr,
                                    XMLHandler& xmlout)
 {
@@ -607,9 +801,15 @@ void LMDerMinimizer::setInitialFitParamValues(const std::vector<double>& start_p
 // ***************************************************************
 
 
+    //  The NL2SOL routines keep their work variables in static storage,
+    //  so only one NL2SOL fit can be running at any time.
+
+static std::mutex nl2sol_mutex;
+
 int NL2SolMinimizer::chisq_fit(double paramreltol, double chisqreltol, char verbosity, 
                                int max_its, double& chisq, ostringstream& outlog)
 {
+ std::lock_guard<std::mutex> lock(nl2sol_mutex);
  int p=m_chisq->getNumberOfParams();
  int n=m_chisq->getNumberOfObervables();
 
@@ -94,6 +94,36 @@ class ChiSquareMinimizerInfo;
 // *    needing a gradient routine.  LMDer and NL2Sol cannot be used in such      *
 // *    cases.  Minuit2 evaluates the gradient numerically.                       *
 // *                                                                              *
+// *   For difficult fits, a portfolio of minimizers can be used: the method      *
+// *   above is the first member, and further members (other methods, or the      *
+// *   same method with other tolerances) are added in a <Portfolio> tag:         *
+// *                                                                              *
+// *      <MinimizerInfo>                                                         *
+// *         <Method>LMDer</Method>                                               *
+// *           ...                                                                *
+// *         <Portfolio>                                                          *
+// *            <Mode>Race</Mode>    (default, or Fallback)                       *
+// *            <Member>                                                          *
+// *               <Method>NL2Sol</Method>                                        *
+// *               <ParameterRelTol>1e-6</ParameterRelTol>    (optional)          *
+// *               <ChiSquareRelTol>1e-4</ChiSquareRelTol>    (optional)          *
+// *               <MaximumIterations>1024</MaximumIterations>  (optional)        *
+// *            </Member>                                                         *
+// *              ...                                                             *
+// *         </Portfolio>                                                         *
+// *      </MinimizerInfo>                                                        *
+// *                                                                              *
+// *    In "Race" mode, every member starts from the same parameters on its own   *
+// *    thread, the first one to converge gives the result, and the others are    *
+// *    then stopped.  In "Fallback" mode, the members are tried in order until   *
+// *    one converges.  The number of minimizations won by each member is         *
+// *    counted, and "outputPortfolioStatistics" writes these counts and the      *
+// *    member that won each minimization.  Which member wins a race depends on   *
+// *    the timing of the threads, so a race is not deterministic: repeated runs  *
+// *    agree only to within the tolerances.  Use "Fallback" mode for results     *
+// *    that are reproducible bit for bit.  A race can have at most one NL2Sol    *
+// *    member, since NL2SOL fits cannot run concurrently.                        *
+// *                                                                              *
 // ********************************************************************************
 
 
@@ -105,6 +135,8 @@ class ChiSquareMinimizerInfo
     double m_chisq_reltol;
     uint m_max_its;
     char m_verbosity;   // 'L' = low, 'M' = medium,  'H' = high
+    std::vector<ChiSquareMinimizerInfo> m_portfolio;   // members after the first
+    bool m_race;        // portfolio run concurrently (true) or in order
 
 #ifndef NO_MINUIT
     static const char defaultmethod='M';
@@ -134,6 +166,10 @@ class ChiSquareMinimizerInfo
     void setLowVerbosity() {m_verbosity='L';}
     void setMediumVerbosity() {m_verbosity='M';}
     void setHighVerbosity() {m_verbosity='H';}
+    void addPortfolioMember(const ChiSquareMinimizerInfo& member);
+    void clearPortfolio() {m_portfolio.clear();}
+    void setPortfolioRace() {m_race=true;}
+    void setPortfolioFallback() {m_race=false;}
 
     bool usingLMDer() const {return (m_method=='L');}
     bool usingNL2Sol() const {return (m_method=='N');}
@@ -146,11 +182,21 @@ class ChiSquareMinimizerInfo
     bool isMediumVerbosity() const {return (m_verbosity=='M');}
     bool isHighVerbosity() const {return (m_verbosity=='H');}
     bool isNotLowVerbosity() const {return (m_verbosity!='L');}
+    bool usingPortfolio() const {return !m_portfolio.empty();}
+    bool isPortfolioRace() const {return m_race;}
+    unsigned int getNumberOfPortfolioMembers() const {return m_portfolio.size()+1;}
+    ChiSquareMinimizerInfo getPortfolioMember(unsigned int k) const;  // k=0 is this method
 
     void output(XMLHandler& xmlout) const;
     std::string output(int indent=0) const;  // XML output 
     std::string str() const;  // XML output
 
+ private:
+
+    void read_settings(XMLHandler& xmlr);
+    void output_settings(XMLHandler& xmlout) const;
+    void check_portfolio() const;
+
  friend class ChiSquareMinimizer;
    
 };
@@ -172,6 +218,11 @@ class ChiSquareMinimizer
     Minuit2NoGradChiSquare *m_minuit2ng;
 #endif
 
+    std::vector<ChiSquareMinimizer*> m_members;   // portfolio members, if any
+    std::vector<uint> m_wins;
+    std::vector<int> m_winners;    // winning member of each minimization, -1 if none
+    uint m_nfits, m_nfailed;
+
 #ifndef NO_CXX11
     ChiSquareMinimizer() = delete;
     ChiSquareMinimizer(const ChiSquareMinimizer&) = delete;
@@ -205,6 +256,13 @@ class ChiSquareMinimizer
                  
     bool findMinimum(double& chisq_min, std::vector<double>& params_at_minimum);
 
+         // number of minimizations won by each portfolio member, and
+         // the winner of each minimization in the order they were done
+
+    void outputPortfolioStatistics(XMLHandler& xmlout) const;
+
+    void clearPortfolioStatistics();
+
  private:
 
     void dealloc_method();
@@ -226,6 +284,9 @@ class ChiSquareMinimizer
     bool find_minimum_nl2sol(const std::vector<double>& starting_params,
                              double& chisq_min, std::vector<double>& params_at_minimum,
                              XMLHandler& xmlout, char verbosity);
+    bool find_minimum_portfolio(const std::vector<double>& starting_params,
+                                double& chisq_min, std::vector<double>& params_at_minimum,
+                                XMLHandler& xmlout, char verbosity);
 
     void xmlformat(const std::string& roottag, const std::string& logstr,
                    XMLHandler& xmlout);
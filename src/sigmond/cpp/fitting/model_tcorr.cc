@@ -198,6 +198,20 @@ void TemporalCorrelatorModel::initializeParametersWithPriors( std::vector<double
    }
 }
 
+
+void TemporalCorrelatorModel::evalLinearBasis(const vector<double>&, double,
+                                              vector<double>&, RMatrix&) const
+{
+ throw(std::invalid_argument(string("Variable projection not supported by model ")+model_name));
+}
+
+
+void TemporalCorrelatorModel::setLinearParams(const vector<double>&,
+                                              vector<double>&) const
+{
+ throw(std::invalid_argument(string("Variable projection not supported by model ")+model_name));
+}
+
 // ******************************************************************************
 
 
@@ -847,6 +861,37 @@ void TimeForwardTwoExponential::eval_grad(
 }
 
 
+      //  Linear in  c0 = A  and  c1 = A*B,  with basis functions
+      //     exp(-m*t)  and  exp(-(m+DD^2)*t)
+
+bool TimeForwardTwoExponential::getLinearParams(vector<uint>& linear_params) const
+{
+ linear_params={1,3};
+ return true;
+}
+
+
+void TimeForwardTwoExponential::evalLinearBasis(
+              const vector<double>& fitparams, double tf,
+              vector<double>& basis, RMatrix& basis_grad) const
+{
+ double m=fitparams[0], DD=fitparams[2];
+ basis[0]=exp(-m*tf);
+ basis[1]=basis[0]*exp(-DD*DD*tf);
+ basis_grad(0,0)=-tf*basis[0];
+ basis_grad(1,0)=-tf*basis[1];
+ basis_grad(1,2)=-2.0*tf*DD*basis[1];
+}
+
+
+void TimeForwardTwoExponential::setLinearParams(
+              const vector<double>& coefs, vector<double>& fitparams) const
+{
+ fitparams[1]=coefs[0];
+ fitparams[3]=coefs[1]/coefs[0];
+}
+
+
    //   Given a set of time separations in "tvals" and corresponding correlator
    //   values in "corrvals", this routine finds initial "best fit" guesses
    //   for energy0, amp0, gapsq, and gapamp, approximating the correlator by
@@ -1039,6 +1084,42 @@ void TimeSymTwoExponential::eval_grad(
 }
 
 
+      //  Linear in  c0 = A  and  c1 = A*B,  with basis functions
+      //     exp(-m*t) + exp(-m*(Nt-t))
+      //     exp(-(m+DD^2)*t) + exp(-(m+DD^2)*(Nt-t))
+
+bool TimeSymTwoExponential::getLinearParams(vector<uint>& linear_params) const
+{
+ linear_params={1,3};
+ return true;
+}
+
+
+void TimeSymTwoExponential::evalLinearBasis(
+              const vector<double>& fitparams, double tf,
+              vector<double>& basis, RMatrix& basis_grad) const
+{
+ double m=fitparams[0], DD=fitparams[2];
+ double tb=double(T_period)-tf;
+ double m1=m+DD*DD;
+ double f0=exp(-m*tf), b0=exp(-m*tb);
+ double f1=exp(-m1*tf), b1=exp(-m1*tb);
+ basis[0]=f0+b0;
+ basis[1]=f1+b1;
+ basis_grad(0,0)=-tf*f0-tb*b0;
+ basis_grad(1,0)=-tf*f1-tb*b1;
+ basis_grad(1,2)=2.0*DD*basis_grad(1,0);
+}
+
+
+void TimeSymTwoExponential::setLinearParams(
+              const vector<double>& coefs, vector<double>& fitparams) const
+{
+ fitparams[1]=coefs[0];
+ fitparams[3]=coefs[1]/coefs[0];
+}
+
+
  // ***********************************************************************************
 
 
@@ -2598,6 +2679,41 @@ void TimeForwardThreeExponential::eval_grad(
  dCval=A*r1*r3;
  dDDDval=-2.0*tf*C*DDD*dCval;
 }
+
+
+      //  Linear in  c0 = A,  c1 = A*B  and  c2 = A*C,  with basis functions
+      //     exp(-m*t),  exp(-(m+DD^2)*t)  and  exp(-(m+DDD^2)*t)
+
+bool TimeForwardThreeExponential::getLinearParams(vector<uint>& linear_params) const
+{
+ linear_params={1,3,5};
+ return true;
+}
+
+
+void TimeForwardThreeExponential::evalLinearBasis(
+              const vector<double>& fitparams, double tf,
+              vector<double>& basis, RMatrix& basis_grad) const
+{
+ double m=fitparams[0], DD=fitparams[2], DDD=fitparams[4];
+ basis[0]=exp(-m*tf);
+ basis[1]=basis[0]*exp(-DD*DD*tf);
+ basis[2]=basis[0]*exp(-DDD*DDD*tf);
+ basis_grad(0,0)=-tf*basis[0];
+ basis_grad(1,0)=-tf*basis[1];
+ basis_grad(1,2)=-2.0*tf*DD*basis[1];
+ basis_grad(2,0)=-tf*basis[2];
+ basis_grad(2,4)=-2.0*tf*DDD*basis[2];
+}
+
+
+void TimeForwardThreeExponential::setLinearParams(
+              const vector<double>& coefs, vector<double>& fitparams) const
+{
+ fitparams[1]=coefs[0];
+ fitparams[3]=coefs[1]/coefs[0];
+ fitparams[5]=coefs[2]/coefs[0];
+}
 // ******************************************************************************
 
       // The fitting function is a sum of two exponentials, time-forward:
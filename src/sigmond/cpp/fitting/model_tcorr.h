@@ -5,6 +5,7 @@
 #include "grace_plot.h"
 #include "mc_estimate.h"
 #include "prior.h"
+#include "matrix.h"
 
 class TCorrFitInfo;
 
@@ -200,6 +201,25 @@ class TemporalCorrelatorModel
         return grad;
     }
 
+         // For variable projection (see "chisq_varpro.h"), a model that can
+         // be written  f(t) = sum_k coef[k]*basis[k](t),  with basis functions
+         // independent of the parameters listed by "getLinearParams", returns
+         // true from that routine.  "evalLinearBasis" then evaluates basis[k]
+         // and basis_grad(k,p), the derivative of basis[k] with respect to
+         // fitparams[p] (the entries of "basis_grad" are zero on input, and
+         // those of the linear parameters must stay zero), and
+         // "setLinearParams" sets the linear parameters in "fitparams" from
+         // the coefficients, in the order of "getLinearParams".
+
+    virtual bool getLinearParams(std::vector<uint>&) const
+     {return false;}
+
+    virtual void evalLinearBasis(const std::vector<double>& fitparams, double tval,
+                                 std::vector<double>& basis, RMatrix& basis_grad) const;
+
+    virtual void setLinearParams(const std::vector<double>& coefs,
+                                 std::vector<double>& fitparams) const;
+
  protected:
 
     void simpleSetFitInfo(const std::vector<MCObsInfo>& fitparams_info,
@@ -810,6 +830,14 @@ class TimeForwardTwoExponential :  public TemporalCorrelatorModel
 
     virtual ~TimeForwardTwoExponential(){}
 
+    virtual bool getLinearParams(std::vector<uint>& linear_params) const;
+
+    virtual void evalLinearBasis(const std::vector<double>& fitparams, double tval,
+                                 std::vector<double>& basis, RMatrix& basis_grad) const;
+
+    virtual void setLinearParams(const std::vector<double>& coefs,
+                                 std::vector<double>& fitparams) const;
+
     virtual void setFitInfo(const std::vector<MCObsInfo>& fitparams_info,
                             const std::vector<MCEstimate>& fitparams, uint fit_tmin,
                             uint fit_tmax, bool show_approach,
@@ -906,6 +934,14 @@ class TimeSymTwoExponential :  public TemporalCorrelatorModel
 
     virtual ~TimeSymTwoExponential(){}
 
+    virtual bool getLinearParams(std::vector<uint>& linear_params) const;
+
+    virtual void evalLinearBasis(const std::vector<double>& fitparams, double tval,
+                                 std::vector<double>& basis, RMatrix& basis_grad) const;
+
+    virtual void setLinearParams(const std::vector<double>& coefs,
+                                 std::vector<double>& fitparams) const;
+
     virtual void setFitInfo(const std::vector<MCObsInfo>& fitparams_info,
                             const std::vector<MCEstimate>& fitparams, uint fit_tmin,
                             uint fit_tmax, bool show_approach,
@@ -1636,6 +1672,14 @@ class TimeForwardThreeExponential :  public TemporalCorrelatorModel
 
     virtual ~TimeForwardThreeExponential(){}
 
+    virtual bool getLinearParams(std::vector<uint>& linear_params) const;
+
+    virtual void evalLinearBasis(const std::vector<double>& fitparams, double tval,
+                                 std::vector<double>& basis, RMatrix& basis_grad) const;
+
+    virtual void setLinearParams(const std::vector<double>& coefs,
+                                 std::vector<double>& fitparams) const;
+
     virtual void setFitInfo(const std::vector<MCObsInfo>& fitparams_info,
                             const std::vector<MCEstimate>& fitparams, uint fit_tmin,
                             uint fit_tmax, bool show_approach,
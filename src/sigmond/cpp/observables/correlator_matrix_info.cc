@@ -20,6 +20,7 @@ using namespace std;
 
 
 map<string,CorrelatorMatrixInfo> CorrelatorMatrixInfo::m_cormat_namemap;
+std::mutex CorrelatorMatrixInfo::m_namemap_mutex;
 
 
 // ****************************************************************
@@ -36,6 +37,7 @@ CorrelatorMatrixInfo::CorrelatorMatrixInfo(XMLHandler& xml_in)
     if (namecount==1){
        string name; xmlreadchild(xmlf,"Name",name);
        name=tidyString(name);
+       std::lock_guard<std::mutex> lock(m_namemap_mutex);
        map<string,CorrelatorMatrixInfo>::const_iterator it=m_cormat_namemap.find(name);
        if (it==m_cormat_namemap.end())
           throw(std::invalid_argument("<Name> tag not associated with any object"));
@@ -76,6 +78,7 @@ void CorrelatorMatrixInfo::setName(const string& corrmatname)
     throw(std::invalid_argument("CorrelatorMatrixInfo assign name cannot contain space, tabs, newlines"));}
  if (name.empty()){
     throw(std::invalid_argument("CorrelatorMatrixInfo assign name is empty"));}
+ std::lock_guard<std::mutex> lock(m_namemap_mutex);
  map<string,CorrelatorMatrixInfo>::const_iterator it=m_cormat_namemap.find(name);
  if (it!=m_cormat_namemap.end())
     throw(std::invalid_argument("CorrelatorMatrixInfo <AssignName> tag already associated with an object"));
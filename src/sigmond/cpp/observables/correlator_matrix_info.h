@@ -3,6 +3,7 @@
 
 #include <map>
 #include <vector>
+#include <mutex>
 #include "operator_info.h"
 #include "correlator_info.h"
 
@@ -159,6 +160,7 @@ class CorrelatorMatrixInfo
  private:
 
    static std::map<std::string,CorrelatorMatrixInfo> m_cormat_namemap;
+   static std::mutex m_namemap_mutex;     // tasks may run concurrently
 
 };
 
@@ -1,4 +1,5 @@
 #include "grace_plot.h"
+#include "plot_writer.h"
 #include <cstring>
 #include <cstdlib>
 #ifdef GRACE
@@ -72,6 +73,7 @@ GracePlot::GracePlot(const GracePlot& gplot)
     :  m_dparams(gplot.m_dparams), m_title(gplot.m_title), m_xlabel(gplot.m_xlabel),
        m_ylabel(gplot.m_ylabel), m_curr_dataset_index(gplot.m_curr_dataset_index),
        m_curr_dataset_type(gplot.m_curr_dataset_type), m_data(gplot.m_data),
+       m_set_types(gplot.m_set_types), m_values(gplot.m_values),
        m_text(gplot.m_text), m_dcount(gplot.m_dcount), m_dset(gplot.m_dset)
 
 {}
@@ -80,6 +82,7 @@ GracePlot::GracePlot(GracePlot& gplot)
     :  m_dparams(gplot.m_dparams), m_title(gplot.m_title), m_xlabel(gplot.m_xlabel),
        m_ylabel(gplot.m_ylabel), m_curr_dataset_index(gplot.m_curr_dataset_index),
        m_curr_dataset_type(gplot.m_curr_dataset_type), m_data(gplot.m_data),
+       m_set_types(gplot.m_set_types), m_values(gplot.m_values),
        m_text(gplot.m_text), m_dcount(gplot.m_dcount), m_dset(gplot.m_dset)
 {}
 
@@ -92,6 +95,8 @@ GracePlot& GracePlot::operator=(const GracePlot& gplot)
  m_curr_dataset_index=gplot.m_curr_dataset_index;
  m_curr_dataset_type=gplot.m_curr_dataset_type;
  m_data=gplot.m_data;
+ m_set_types=gplot.m_set_types;
+ m_values=gplot.m_values;
  m_text=gplot.m_text;
  m_dcount=gplot.m_dcount;
  m_dset=gplot.m_dset;
@@ -107,6 +112,8 @@ GracePlot& GracePlot::operator=(GracePlot& gplot)
  m_curr_dataset_index=gplot.m_curr_dataset_index;
  m_curr_dataset_type=gplot.m_curr_dataset_type;
  m_data=gplot.m_data;
+ m_set_types=gplot.m_set_types;
+ m_values=gplot.m_values;
  m_text=gplot.m_text;
  m_dcount=gplot.m_dcount;
  m_dset=gplot.m_dset;
@@ -270,7 +277,7 @@ void GracePlot::addXYDataPoint(const XYPoint& pt)
 {
  if (m_curr_dataset_type!=0){
     throw(std::invalid_argument("Current data set is not XY: could not add XY point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDataPoint(double x, double y)
@@ -282,9 +289,8 @@ void GracePlot::addXYDataPoints(const vector<XYPoint>& pts)
 {
  if (m_curr_dataset_type!=0){
     throw(std::invalid_argument("Current data set is not XY: could not add XY point"));}
- string prefix="g0."+m_dset;
  for (vector<XYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -301,7 +307,7 @@ void GracePlot::addXYDYDataPoint(const XYDYPoint& pt)
 {
  if (m_curr_dataset_type!=1){
     throw(std::invalid_argument("Current data set is not XYDY: could not add XYDY point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDYDataPoint(double x, double y, double dy)
@@ -313,9 +319,8 @@ void GracePlot::addXYDYDataPoints(const vector<XYDYPoint>& pts)
 {
  if (m_curr_dataset_type!=1){
     throw(std::invalid_argument("Current data set is not XYDY: could not add XYDY point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -333,7 +338,7 @@ void GracePlot::addXYDXDataPoint(const XYDXPoint& pt)
 {
  if (m_curr_dataset_type!=2){
     throw(std::invalid_argument("Current data set is not XYDX: could not add XYDX point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDXDataPoint(double x, double y, double dx)
@@ -345,9 +350,8 @@ void GracePlot::addXYDXDataPoints(const vector<XYDXPoint>& pts)
 {
  if (m_curr_dataset_type!=2){
     throw(std::invalid_argument("Current data set is not XYDX: could not add XYDX point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDXPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -365,7 +369,7 @@ void GracePlot::addXYDXDYDataPoint(const XYDXDYPoint& pt)
 {
  if (m_curr_dataset_type!=3){
     throw(std::invalid_argument("Current data set is not XYDXDY: could not add XYDXDY point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDXDYDataPoint(double x, double y, double dx, double dy)
@@ -377,9 +381,8 @@ void GracePlot::addXYDXDYDataPoints(const vector<XYDXDYPoint>& pts)
 {
  if (m_curr_dataset_type!=3){
     throw(std::invalid_argument("Current data set is not XYDXDY: could not add XYDXDY point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDXDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -396,7 +399,7 @@ void GracePlot::addXYDXDXDataPoint(const XYDXDXPoint& pt)
 {
  if (m_curr_dataset_type!=4){
     throw(std::invalid_argument("Current data set is not XYDXDX: could not add XYDXDX point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDXDXDataPoint(double x, double y, double dxup, double dxdn)
@@ -408,9 +411,8 @@ void GracePlot::addXYDXDXDataPoints(const vector<XYDXDXPoint>& pts)
 {
  if (m_curr_dataset_type!=4){
     throw(std::invalid_argument("Current data set is not XYDXDX: could not add XYDXDX point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDXDXPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -428,7 +430,7 @@ void GracePlot::addXYDYDYDataPoint(const XYDYDYPoint& pt)
 {
  if (m_curr_dataset_type!=5){
     throw(std::invalid_argument("Current data set is not XYDYDY: could not add XYDYDY point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDYDYDataPoint(double x, double y, double dyup, double dydn)
@@ -440,9 +442,8 @@ void GracePlot::addXYDYDYDataPoints(const vector<XYDYDYPoint>& pts)
 {
  if (m_curr_dataset_type!=5){
     throw(std::invalid_argument("Current data set is not XYDYDY: could not add XYDYDY point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDYDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -460,7 +461,7 @@ void GracePlot::addXYDXDXDYDYDataPoint(const XYDXDXDYDYPoint& pt)
 {
  if (m_curr_dataset_type!=6){
     throw(std::invalid_argument("Current data set is not XYDXDXDYDY: could not add XYDXDXDYDY point"));}
- addPoint(string("g0.")+m_dset, pt, m_dcount);
+ addPoint(pt);
 }
 
 void GracePlot::addXYDXDXDYDYDataPoint(double x, double y, double dxup, double dxdn,
@@ -473,9 +474,8 @@ void GracePlot::addXYDXDXDYDYDataPoints(const vector<XYDXDXDYDYPoint>& pts)
 {
  if (m_curr_dataset_type!=6){
     throw(std::invalid_argument("Current data set is not XYDXDXDYDY: could not add XYDXDXDYDY point"));}
- string prefix="g0."+m_dset;
  for (vector<XYDXDXDYDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addPoint(prefix, *it, m_dcount);}
+    addPoint(*it);}
 }
 
 
@@ -490,6 +490,8 @@ void GracePlot::addDataSet(int dataset_type, bool error_bars, const string& symb
  m_curr_dataset_index++;
  m_dset="s"+make_string(m_curr_dataset_index);
  m_dcount=0;
+ m_set_types.push_back(dataset_type);
+ m_values.push_back(vector<double>());
  string colcode(encode_color(color));
  string cmd;
  cmd=m_dset+" on"; m_data.push_back(cmd);
@@ -522,103 +524,90 @@ void GracePlot::addDataSet(int dataset_type, bool error_bars, const string& symb
 }
 
 
-void GracePlot::addPoint(const string& prefix, const XYPoint& pt, int& count)
+void GracePlot::addPoint(const XYPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval);
  update_horizontal_span(pt.xval);
  update_vertical_span(pt.yval);
- count++;
 }
 
 
-void GracePlot::addPoint(const string& prefix, const XYDYPoint& pt, int& count)
+void GracePlot::addPoint(const XYDYPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.yerr);
  update_horizontal_span(pt.xval);
  update_vertical_span(pt.yval+pt.yerr);
  update_vertical_span(pt.yval-pt.yerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.yerr);
- m_data.push_back(cmd);
- count++;
 }
 
 
 
 
-void GracePlot::addPoint(const string& prefix, const XYDXPoint& pt, int& count)
+void GracePlot::addPoint(const XYDXPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.xerr);
  update_vertical_span(pt.yval);
  update_horizontal_span(pt.xval+pt.xerr);
  update_horizontal_span(pt.xval-pt.xerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.xerr);
- m_data.push_back(cmd);
- count++;
 }
 
-void GracePlot::addPoint(const string& prefix, const XYDXDXPoint& pt, int& count)
+void GracePlot::addPoint(const XYDXDXPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.xuperr,pt.xdnerr);
  update_vertical_span(pt.yval);
  update_horizontal_span(pt.xval+pt.xuperr);
  update_horizontal_span(pt.xval-pt.xdnerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.xuperr);
- m_data.push_back(cmd);
- cmd=prefix+".y2["+make_string(count)+"]="+make_string(pt.xdnerr);
- m_data.push_back(cmd);
- count++;
 }
 
-void GracePlot::addPoint(const string& prefix, const XYDXDYPoint& pt, int& count)
+void GracePlot::addPoint(const XYDXDYPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.xerr,pt.yerr);
  update_horizontal_span(pt.xval+pt.xerr);
  update_horizontal_span(pt.xval-pt.xerr);
  update_vertical_span(pt.yval+pt.yerr);
  update_vertical_span(pt.yval-pt.yerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.xerr);
- m_data.push_back(cmd);
- cmd=prefix+".y2["+make_string(count)+"]="+make_string(pt.yerr);
- m_data.push_back(cmd);
- count++;
 }
 
-void GracePlot::addPoint(const string& prefix, const XYDYDYPoint& pt, int& count)
+void GracePlot::addPoint(const XYDYDYPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.yuperr,pt.ydnerr);
  update_horizontal_span(pt.xval);
  update_vertical_span(pt.yval+pt.yuperr);
  update_vertical_span(pt.yval-pt.ydnerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.yuperr);
- m_data.push_back(cmd);
- cmd=prefix+".y2["+make_string(count)+"]="+make_string(pt.ydnerr);
- m_data.push_back(cmd);
- count++;
 }
 
-void GracePlot::addPoint(const string& prefix, const XYDXDXDYDYPoint& pt, int& count)
+void GracePlot::addPoint(const XYDXDXDYDYPoint& pt)
 {
- string cmd=prefix+" point "+make_string(pt.xval)+", "+make_string(pt.yval);
- m_data.push_back(cmd);
+ add_values(pt.xval,pt.yval,pt.xuperr,pt.xdnerr);
+ m_values.back().push_back(pt.yuperr);
+ m_values.back().push_back(pt.ydnerr);
  update_horizontal_span(pt.xval+pt.xuperr);
  update_horizontal_span(pt.xval-pt.xdnerr);
  update_vertical_span(pt.yval+pt.yuperr);
  update_vertical_span(pt.yval-pt.ydnerr);
- cmd=prefix+".y1["+make_string(count)+"]="+make_string(pt.xuperr);
- m_data.push_back(cmd);
- cmd=prefix+".y2["+make_string(count)+"]="+make_string(pt.xdnerr);
- m_data.push_back(cmd);
- cmd=prefix+".y3["+make_string(count)+"]="+make_string(pt.yuperr);
- m_data.push_back(cmd);
- cmd=prefix+".y4["+make_string(count)+"]="+make_string(pt.ydnerr);
- m_data.push_back(cmd);
- count++;
+}
+
+
+    // Points of the current data set are stored row by row in
+    // m_values.back(); the number of columns follows from the type.
+
+void GracePlot::add_values(double x, double y)
+{
+ vector<double>& vals=m_values.back();
+ vals.push_back(x); vals.push_back(y);
+ m_dcount++;
+}
+
+void GracePlot::add_values(double x, double y, double e1)
+{
+ add_values(x,y);
+ m_values.back().push_back(e1);
+}
+
+void GracePlot::add_values(double x, double y, double e1, double e2)
+{
+ add_values(x,y,e1);
+ m_values.back().push_back(e2);
 }
 
 
@@ -633,7 +622,7 @@ void GracePlot::addBarDataPoint(const XYPoint& pt)
 {
  if (m_curr_dataset_type!=7){
     throw(std::invalid_argument("Current data set is not BAR: could not add BAR data"));}
- addBar(string("g0.")+m_dset, pt, m_dcount);
+ addBar(pt);
 }
 
 void GracePlot::addBarDataPoint(double x, double y)
@@ -645,9 +634,8 @@ void GracePlot::addBarDataPoints(const vector<XYPoint>& pts)
 {
  if (m_curr_dataset_type!=7){
     throw(std::invalid_argument("Current data set is not BAR: could not add BAR data"));}
- string prefix="g0."+m_dset;
  for (vector<XYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addBar(prefix, *it, m_dcount);}
+    addBar(*it);}
 }
 
 
@@ -662,7 +650,7 @@ void GracePlot::addBarDYDataPoint(const XYDYPoint& pt)
 {
  if (m_curr_dataset_type!=8){
     throw(std::invalid_argument("Current data set is not BARDY: could not add BARDY data"));}
- addBar(string("g0.")+m_dset, pt, m_dcount);
+ addBar(pt);
 }
 
 void GracePlot::addBarDYDataPoint(double x, double y, double yerr)
@@ -674,9 +662,8 @@ void GracePlot::addBarDYDataPoints(const vector<XYDYPoint>& pts)
 {
  if (m_curr_dataset_type!=8){
     throw(std::invalid_argument("Current data set is not BARDY: could not add BARDY data"));}
- string prefix="g0."+m_dset;
  for (vector<XYDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addBar(prefix, *it, m_dcount);}
+    addBar(*it);}
 }
 
 
@@ -690,7 +677,7 @@ void GracePlot::addBarDYDYDataPoint(const XYDYDYPoint& pt)
 {
  if (m_curr_dataset_type!=9){
     throw(std::invalid_argument("Current data set is not BARDYDY: could not add BARDYDY data"));}
- addBar(string("g0.")+m_dset, pt, m_dcount);
+ addBar(pt);
 }
 
 void GracePlot::addBarDYDYDataPoint(double x, double y, double yuperr, double ydnerr)
@@ -702,9 +689,8 @@ void GracePlot::addBarDYDYDataPoints(const vector<XYDYDYPoint>& pts)
 {
  if (m_curr_dataset_type!=9){
     throw(std::invalid_argument("Current data set is not BARDYDY: could not add BARDYDY data"));}
- string prefix="g0."+m_dset;
  for (vector<XYDYDYPoint>::const_iterator it=pts.begin();it!=pts.end();++it){
-    addBar(prefix, *it, m_dcount);}
+    addBar(*it);}
 }
 
 
@@ -720,6 +706,8 @@ void GracePlot::addBarSet(int dataset_type, bool error_bars, const string& color
  m_curr_dataset_index++;
  m_dset="s"+make_string(m_curr_dataset_index);
  m_dcount=0;
+ m_set_types.push_back(dataset_type);
+ m_values.push_back(vector<double>());
  string colcode(encode_color(color));
  string bcolcode(encode_color(bordercolor));
  string cmd;
@@ -752,49 +740,49 @@ void GracePlot::addBarSet(int dataset_type, bool error_bars, const string& color
 }
 
 
-void GracePlot::addBar(const string& prefix, const XYPoint& pt, int& count)
+void GracePlot::addBar(const XYPoint& pt)
 {
  double barhalfwidth=0.5*m_dparams[i_temp];
  XYPoint xy(pt.xval-barhalfwidth,0.0);
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=pt.yval;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval+barhalfwidth;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=0.0;
- addPoint(prefix,xy,count);
+ addPoint(xy);
 }
 
-void GracePlot::addBar(const string& prefix, const XYDYPoint& pt, int& count)
+void GracePlot::addBar(const XYDYPoint& pt)
 {
  double barhalfwidth=0.5*m_dparams[i_temp];
  XYDYPoint xy(pt.xval-barhalfwidth,0.0,0.0);
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=pt.yval;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval; xy.yerr=pt.yerr;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval+barhalfwidth; xy.yerr=0.0;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=0.0;
- addPoint(prefix,xy,count);
+ addPoint(xy);
 }
 
-void GracePlot::addBar(const string& prefix, const XYDYDYPoint& pt, int& count)
+void GracePlot::addBar(const XYDYDYPoint& pt)
 {
  double barhalfwidth=0.5*m_dparams[i_temp];
  XYDYDYPoint xy(pt.xval-barhalfwidth,0.0,0.0,0.0);
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=pt.yval;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval; xy.yuperr=pt.yuperr; xy.ydnerr=pt.ydnerr;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.xval=pt.xval+barhalfwidth; xy.yuperr=xy.ydnerr=0.0;
- addPoint(prefix,xy,count);
+ addPoint(xy);
  xy.yval=0.0;
- addPoint(prefix,xy,count);
+ addPoint(xy);
 }
 
 
@@ -1006,6 +994,18 @@ string GracePlot::encode_datatype(int dataset_type)
 }
 
 
+    // number of columns (x, y, errors) in a data set of this type
+
+uint GracePlot::number_of_columns(int dataset_type)
+{
+ string dtype(encode_datatype(dataset_type));
+ uint ncol=2;
+ for (size_t k=2;k<dtype.length();k++)
+    if (dtype[k]=='d') ncol++;
+ return ncol;
+}
+
+
 int GracePlot::encode_font(const std::string& fontname)
 {
  if (fontname.empty())
@@ -1163,22 +1163,48 @@ void GracePlot::drawToScreenAndSave(const string& filename, UserInterface *ui,
 }
 */
 
+    // The project file is written directly from the command lists,
+    // without running grace; see "PlotWriter" for when it is written
+    // and for conversion to a hardcopy format.
+
 void GracePlot::saveToFile(const string& filename)
 {
-#ifdef GRACE
  string fname(tidy_string(filename));
- if (fname.empty()) throw(std::invalid_argument("Invalid file name in GracePlot::printToFile"));
- if (GraceIsOpen()) GraceClose();
- char prog[9]="gracebat";
- if (GraceOpenVA(prog,2048,"-hardcopy","-noprint","-nosafe", "-noask", NULL)==-1) {
-    throw(std::invalid_argument("Can't run Grace"));}
- doDraw(false);
- string cmd=string("saveall \"")+fname+"\"";
- GraceCommand(cmd.c_str());
- GraceClose();
-#endif
+ if (fname.empty()) throw(std::invalid_argument("Invalid file name in GracePlot::saveToFile"));
+ ostringstream agr;
+ writeProject(agr);
+ PlotWriter::submit(fname,agr.str());
 }
 
+
+void GracePlot::writeProject(ostream& out)
+{
+ list<string> commands;
+ renderCommands(commands);
+ out << "# Grace project file"<<endl<<"#"<<endl;
+ out << "@version 50125"<<endl;
+ out << "@page size 440, 440"<<endl;
+ for (list<string>::const_iterator it=commands.begin();it!=commands.end();it++)
+    out << "@"<<*it<<endl;
+ for (list<string>::const_iterator dt=m_data.begin();dt!=m_data.end();dt++)
+    out << "@"<<*dt<<endl;
+ for (list<string>::const_iterator tt=m_text.begin();tt!=m_text.end();tt++)
+    out << "@"<<*tt<<endl;
+ streamsize oldprec=out.precision(12);
+ for (uint k=0;k<m_values.size();k++){
+    out << "@target G0.S"<<k<<endl;
+    out << "@type "<<encode_datatype(m_set_types[k])<<endl;
+    uint ncol=number_of_columns(m_set_types[k]);
+    const vector<double>& vals=m_values[k];
+    for (uint i=0;i+ncol<=vals.size();i+=ncol){
+       out << vals[i];
+       for (uint j=1;j<ncol;j++) out << " "<<vals[i+j];
+       out << endl;}
+    out << "&"<<endl;}
+ out.precision(oldprec);
+}
+
+
 void GracePlot::doDraw(bool redraw)
 {
 #ifdef GRACE
@@ -1190,6 +1216,17 @@ void GracePlot::doDraw(bool redraw)
     GraceCommand(it->c_str());
  for (list<string>::const_iterator dt=m_data.begin();dt!=m_data.end();dt++)
     GraceCommand(dt->c_str());
+ for (uint k=0;k<m_values.size();k++){
+    string prefix="g0.s"+make_string(int(k));
+    uint ncol=number_of_columns(m_set_types[k]);
+    const vector<double>& vals=m_values[k];
+    for (uint i=0,row=0;i+ncol<=vals.size();i+=ncol,row++){
+       string cmd=prefix+" point "+make_string(vals[i])+", "+make_string(vals[i+1]);
+       GraceCommand(cmd.c_str());
+       for (uint j=2;j<ncol;j++){
+          cmd=prefix+".y"+make_string(int(j-1))+"["+make_string(int(row))+"]="
+             +make_string(vals[i+j]);
+          GraceCommand(cmd.c_str());}}}
  for (list<string>::const_iterator tt=m_text.begin();tt!=m_text.end();tt++)
     GraceCommand(tt->c_str());
  if (redraw) GraceCommand("redraw");
@@ -1215,10 +1252,8 @@ void GracePlot::drawToScreenAndSave(const string& filename, double borderfrac,
 
 void GracePlot::saveToFile(const string& filename, double borderfrac)
 {
-#ifdef GRACE
  autoScale(borderfrac);
  saveToFile(filename);
-#endif
 }
 
 
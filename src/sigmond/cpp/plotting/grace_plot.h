@@ -35,6 +35,11 @@ class XYDXDXDYDYPoint;
  // *   are usually needed in Monte Carlo data analysis.  This class is         *
  // *   meant to be used by objects of the class "PlotHandler".                 *
  // *                                                                           *
+ // *   "saveToFile" writes the xmgrace project (.agr) file directly from the   *
+ // *   stored commands and data points; no grace process is started.  See      *
+ // *   "PlotWriter" in "plot_writer.h" for writing the files in the            *
+ // *   background and for conversion to a hardcopy format.                     *
+ // *                                                                           *
  // *   To add XY data, one first uses an "addXYDataSet" which specifies        *
  // *   the symbol type, color, line style, legend information, etc.            *
  // *   One then uses "addXYDataPoint" or "addXYDataPoints" to add              *
@@ -86,6 +91,8 @@ class GracePlot
    std::string m_title, m_xlabel, m_ylabel;
    int m_curr_dataset_index, m_curr_dataset_type;
    std::list<std::string> m_data;
+   std::vector<int> m_set_types;
+   std::vector<std::vector<double> > m_values;
    std::list<std::string> m_text;
    int m_dcount;
    std::string m_dset;
@@ -214,6 +221,9 @@ class GracePlot
    //                         UserInterface *ui=0, bool keep=true);
    void saveToFile(const std::string& filename, double borderfrac);
 
+      // writes the xmgrace project (.agr) file contents
+   void writeProject(std::ostream& out);
+
 
  private:
 
@@ -257,6 +267,7 @@ class GracePlot
    std::string encode_symbolfill(const std::string& symbolfill);
    std::string encode_linestyle(const std::string& linestyle);
    std::string encode_datatype(int dataset_type);
+   unsigned int number_of_columns(int dataset_type);
    int encode_font(const std::string& fontname);
    int encode_justification(const std::string& justify);
 
@@ -264,21 +275,25 @@ class GracePlot
                    const std::string& symbolfill, const std::string& linestyle, 
                    const std::string& color, const std::string& legendtext);
 
-   void addPoint(const std::string& prefix, const XYPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDYPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDXPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDXDXPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDXDYPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDYDYPoint& pt, int& count);
-   void addPoint(const std::string& prefix, const XYDXDXDYDYPoint& pt, int& count);
+   void addPoint(const XYPoint& pt);
+   void addPoint(const XYDYPoint& pt);
+   void addPoint(const XYDXPoint& pt);
+   void addPoint(const XYDXDXPoint& pt);
+   void addPoint(const XYDXDYPoint& pt);
+   void addPoint(const XYDYDYPoint& pt);
+   void addPoint(const XYDXDXDYDYPoint& pt);
 
    void addBarSet(int dataset_type, bool errorbars, const std::string& color, 
                   const std::string& bordercolor, double barwidth, 
                   const std::string& legendtext);
 
-   void addBar(const std::string& prefix, const XYPoint& pt, int& count);
-   void addBar(const std::string& prefix, const XYDYPoint& pt, int& count);
-   void addBar(const std::string& prefix, const XYDYDYPoint& pt, int& count);
+   void addBar(const XYPoint& pt);
+   void addBar(const XYDYPoint& pt);
+   void addBar(const XYDYDYPoint& pt);
+
+   void add_values(double x, double y);
+   void add_values(double x, double y, double e1);
+   void add_values(double x, double y, double e1, double e2);
 
    void update_horizontal_span(double x);
    void update_vertical_span(double y);
@@ -0,0 +1,179 @@
+#include "plot_writer.h"
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+using namespace std;
+
+// *************************************************************
+
+
+mutex PlotWriter::m_mutex;
+condition_variable PlotWriter::m_work;
+condition_variable PlotWriter::m_space;
+deque<pair<string,string> > PlotWriter::m_queue;
+vector<thread> PlotWriter::m_threads;
+list<string> PlotWriter::m_errors;
+unsigned int PlotWriter::m_nwriters=0;
+string PlotWriter::m_format;
+bool PlotWriter::m_stop=false;
+
+
+    // gracebat device name for each hardcopy format
+
+static string hardcopy_device(const string& format)
+{
+ if (format=="eps") return "EPS";
+ else if (format=="ps") return "PostScript";
+ else if (format=="pdf") return "PDF";
+ else if (format=="png") return "PNG";
+ else if (format=="jpg") return "JPEG";
+ else if (format=="svg") return "SVG";
+ return "";
+}
+
+
+void PlotWriter::setNumberOfWriters(unsigned int nwriters)
+{
+ lock_guard<mutex> lock(m_mutex);
+ m_nwriters=nwriters;
+}
+
+
+unsigned int PlotWriter::getNumberOfWriters()
+{
+ lock_guard<mutex> lock(m_mutex);
+ return m_nwriters;
+}
+
+
+void PlotWriter::setHardCopyFormat(const string& format)
+{
+ if ((!format.empty())&&(hardcopy_device(format).empty()))
+    throw(std::invalid_argument(string("Unsupported plot hardcopy format: ")+format));
+ lock_guard<mutex> lock(m_mutex);
+ m_format=format;
+}
+
+
+string PlotWriter::getHardCopyFormat()
+{
+ lock_guard<mutex> lock(m_mutex);
+ return m_format;
+}
+
+
+void PlotWriter::submit(const string& filename, const string& contents)
+{
+ unique_lock<mutex> lock(m_mutex);
+ if (m_nwriters==0){
+    string format(m_format);
+    lock.unlock();
+    write_plot(filename,contents,format);
+    return;}
+ m_space.wait(lock,[]{return m_queue.size()<4*m_nwriters;});
+ m_queue.push_back(make_pair(filename,contents));
+ if (m_threads.size()<m_nwriters)
+    m_threads.push_back(thread(&PlotWriter::run_writer));
+ m_work.notify_one();
+}
+
+
+    // Stops the writer threads once the queue is empty; the next
+    // "submit" starts them again.
+
+void PlotWriter::wait(list<string>& errors)
+{
+ vector<thread> threads;
+ {lock_guard<mutex> lock(m_mutex);
+  m_stop=true;
+  threads.swap(m_threads);}
+ m_work.notify_all();
+ for (vector<thread>::iterator it=threads.begin();it!=threads.end();++it)
+    it->join();
+ lock_guard<mutex> lock(m_mutex);
+ m_stop=false;
+ errors.splice(errors.end(),m_errors);
+}
+
+
+void PlotWriter::run_writer()
+{
+ unique_lock<mutex> lock(m_mutex);
+ while (true){
+    m_work.wait(lock,[]{return (!m_queue.empty())||m_stop;});
+    if (m_queue.empty()) return;
+    pair<string,string> plot(std::move(m_queue.front()));
+    m_queue.pop_front();
+    string format(m_format);
+    m_space.notify_one();
+    lock.unlock();
+    try{
+       write_plot(plot.first,plot.second,format);}
+    catch(const std::exception& xp){
+       lock.lock();
+       m_errors.push_back(xp.what());
+       lock.unlock();}
+    lock.lock();}
+}
+
+
+void PlotWriter::write_plot(const string& filename, const string& contents,
+                            const string& format)
+{
+ ofstream fout(filename.c_str());
+ if (!fout)
+    throw(std::runtime_error(string("Could not open plot file ")+filename));
+ fout << contents;
+ fout.close();
+ if (fout.fail())
+    throw(std::runtime_error(string("Could not write plot file ")+filename));
+ if (!format.empty()) convert(filename,format);
+}
+
+
+    // Runs "gracebat" on the project file "filename" to produce the
+    // hardcopy file.
+
+void PlotWriter::convert(const string& filename, const string& format)
+{
+ string outfile(filename);
+ if ((outfile.length()>4)&&(outfile.substr(outfile.length()-4)==".agr"))
+    outfile.erase(outfile.length()-4);
+ outfile+="."+format;
+ vector<string> args;
+ args.push_back("gracebat");
+ args.push_back("-nosafe");
+ args.push_back("-noask");
+ args.push_back("-hardcopy");
+ args.push_back("-hdevice");
+ args.push_back(hardcopy_device(format));
+ args.push_back("-printfile");
+ args.push_back(outfile);
+ args.push_back(filename);
+ vector<char*> argv;
+ for (vector<string>::iterator it=args.begin();it!=args.end();++it)
+    argv.push_back(&(*it)[0]);
+ argv.push_back(0);
+
+ pid_t pid;
+ int rc=posix_spawnp(&pid,"gracebat",0,0,&argv[0],environ);
+ if (rc!=0)
+    throw(std::runtime_error(string("Could not run gracebat for plot file ")
+                             +filename+": "+strerror(rc)));
+ int status=0;
+ while (waitpid(pid,&status,0)<0)
+    if (errno!=EINTR)
+       throw(std::runtime_error(string("Lost the gracebat process for plot file ")+filename));
+ if ((!WIFEXITED(status))||(WEXITSTATUS(status)!=0))
+    throw(std::runtime_error(string("gracebat could not convert plot file ")+filename));
+}
+
+
+// *************************************************************
@@ -0,0 +1,87 @@
+#ifndef PLOT_WRITER_H
+#define PLOT_WRITER_H
+
+#include <list>
+#include <deque>
+#include <vector>
+#include <string>
+#include <utility>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+
+ // *****************************************************************************
+ // *                                                                           *
+ // *   "PlotWriter" writes the xmgrace project files made by "GracePlot" and   *
+ // *   optionally converts them to a hardcopy format by running "gracebat".    *
+ // *   All members are static: the settings apply to the whole program.        *
+ // *                                                                           *
+ // *   By default (zero writers), "submit" writes the file (and converts it)   *
+ // *   before returning, and throws an exception on failure.  After            *
+ // *                                                                           *
+ // *       PlotWriter::setNumberOfWriters(4);                                  *
+ // *                                                                           *
+ // *   "submit" only queues the file contents, and up to 4 background          *
+ // *   threads write the queued files and run the conversions, so plots are    *
+ // *   produced while the next computation proceeds and no more than 4         *
+ // *   "gracebat" processes run at once.  A "submit" waits if too many files   *
+ // *   are queued.  "wait" returns once all queued files are done, and         *
+ // *   returns the failures since the last "wait"; it must be called before    *
+ // *   the program exits or forks.  The writer threads exist only while        *
+ // *   there are files to write.                                               *
+ // *                                                                           *
+ // *   The hardcopy format is set by                                           *
+ // *                                                                           *
+ // *       PlotWriter::setHardCopyFormat("eps");                               *
+ // *                                                                           *
+ // *   Allowed formats are "eps", "ps", "pdf", "png", "jpg" and "svg"; an      *
+ // *   empty string (the default) means no conversion.  The hardcopy file      *
+ // *   name is the project file name with its ".agr" suffix (if any)           *
+ // *   replaced by the format.  "gracebat" must be in the PATH.                *
+ // *                                                                           *
+ // *****************************************************************************
+
+
+class PlotWriter
+{
+
+ public:
+
+   static void setNumberOfWriters(unsigned int nwriters);
+
+   static unsigned int getNumberOfWriters();
+
+   static void setHardCopyFormat(const std::string& format);
+
+   static std::string getHardCopyFormat();
+
+   static void submit(const std::string& filename, const std::string& contents);
+
+   static void wait(std::list<std::string>& errors);
+
+ private:
+
+   static std::mutex m_mutex;
+   static std::condition_variable m_work, m_space;
+   static std::deque<std::pair<std::string,std::string> > m_queue;
+   static std::vector<std::thread> m_threads;
+   static std::list<std::string> m_errors;
+   static unsigned int m_nwriters;
+   static std::string m_format;
+   static bool m_stop;
+
+   PlotWriter();
+
+   static void write_plot(const std::string& filename, const std::string& contents,
+                          const std::string& format);
+
+   static void convert(const std::string& filename, const std::string& format);
+
+   static void run_writer();
+
+};
+
+
+// *****************************************************************************
+#endif
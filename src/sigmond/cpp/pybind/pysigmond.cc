@@ -157,7 +157,7 @@ FileType getFileID(const string& filename)
     return Correlator;
   else if (ID=="Laph--VEVFile")
     return VEV;
-  else if (ID=="Sigmond--BinsFile")
+  else if ((ID=="Sigmond--BinsFile")||(ID=="Sigmond--BinsFile-Float"))
     return Bins;
   else if (ID=="Sigmond--SamplingsFile")
     return Samplings;
@@ -327,6 +327,8 @@ PYBIND11_MODULE(sigmond, m) {
     .value("SinglePivot_RN", FileType::SinglePivot_RN)
     .value("RollingPivot", FileType::RollingPivot);
   
+  m.def("doExpressionByBins", &doExpressionByBins);
+  m.def("doExpressionBySamplings", &doExpressionBySamplings);
   m.def("doRatioBySamplings", (void (*)(MCObsHandler&, const MCObsInfo&, const MCObsInfo&, const MCObsInfo&)) &doRatioBySamplings);
   m.def("doBoostBySamplings", (void (*)(MCObsHandler&, const MCObsInfo&, double, const MCObsInfo&)) &doBoostBySamplings);
   m.def("doLinearSuperpositionBySamplings", (void (*)(MCObsHandler&, vector<MCObsInfo>&, vector<double>&, const MCObsInfo&)) &doLinearSuperpositionBySamplings);
@@ -670,6 +672,13 @@ PYBIND11_MODULE(sigmond, m) {
     .def(py::init<const vector<double> &>())
     .def("array", &RVector::c_vector);
 
+  py::class_<ObsExpression>(m, "ObsExpression")
+    .def(py::init<const string &, const vector<string> &>())
+    .def(py::init<const string &, const vector<string> &, const map<string,double> &>())
+    .def("getExpression", &ObsExpression::getExpression)
+    .def("getVariableNames", &ObsExpression::getVariableNames)
+    .def("evaluate", (double (ObsExpression::*)(const vector<double>&) const) &ObsExpression::evaluate);
+
   py::class_<MCEstimate>(m, "MCEstimate")
     .def(py::init<>())
     .def("getFullEstimate", &MCEstimate::getFullEstimate)
@@ -714,6 +723,8 @@ PYBIND11_MODULE(sigmond, m) {
     .def("getBins", (const RVector & (MCObsHandler::*)(const MCObsInfo &) ) &MCObsHandler::getBins)
     .def("getBin", (double (MCObsHandler::*)(const MCObsInfo &, int) ) &MCObsHandler::getBin)
     .def("getEstimate", (MCEstimate (MCObsHandler::*)(const MCObsInfo &) ) &MCObsHandler::getEstimate)
+    .def("getUnstoredEstimate", (MCEstimate (MCObsHandler::*)(const MCObsInfo &, SamplingMode) ) &MCObsHandler::getUnstoredEstimate)
+    .def("getEstimateFromSamplings", &MCObsHandler::getEstimateFromSamplings)
     .def("setSamplingBegin", &MCObsHandler::setSamplingBegin)
     .def("isSamplingEnd", &MCObsHandler::isSamplingEnd)
     .def("setSamplingNext", &MCObsHandler::setSamplingNext)
@@ -722,9 +733,19 @@ PYBIND11_MODULE(sigmond, m) {
     .def("queryBins", (bool (MCObsHandler::*)(const MCObsInfo&) ) &MCObsHandler::queryBins)
     .def("getCurrentSamplingValue", &MCObsHandler::getCurrentSamplingValue)
     .def("putCurrentSamplingValue", &MCObsHandler::putCurrentSamplingValue)
+    .def("putFullAndSamplingValues", &MCObsHandler::putFullAndSamplingValues)
     .def("writeSamplingValuesToFile", &MCObsHandler::writeSamplingValuesToFile)
     .def("putBins", &MCObsHandler::putBins)
+    .def("writeBinsToFile", [](MCObsHandler &a, const set<MCObsInfo> &obskeys,
+                               const string &filename, XMLHandler &xmlout,
+                               WriteMode wmode, char file_format) {
+      a.writeBinsToFile(obskeys, filename, xmlout, wmode, file_format); })
     .def("writeBinsToFile", &MCObsHandler::writeBinsToFile)
+    .def("setBatchedOutput", &MCObsHandler::setBatchedOutput)
+    .def("flushOutputFiles", [](MCObsHandler &a) {
+      list<string> errors;
+      a.flushOutputFiles(errors);
+      return errors; })
     .def("clearData", &MCObsHandler::clearData)
     .def("clearSamplings", &MCObsHandler::clearSamplings)
     .def("eraseData", &MCObsHandler::eraseData)
@@ -0,0 +1,153 @@
+#include "log_writer.h"
+#include <stdexcept>
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+// *************************************************************************
+
+
+XMLLogWriter::XMLLogWriter() : m_gzout(0), m_streaming(false)
+{}
+
+
+XMLLogWriter::~XMLLogWriter()
+{
+ close();
+}
+
+
+void XMLLogWriter::open(const string& filename, bool compress)
+{
+ close();
+ m_filename=filename;
+ if (compress){
+#ifdef ZLIB
+    gzFile gz=gzopen(filename.c_str(),"wb");
+    if (gz==0) throw(std::invalid_argument(string("Could not open log file ")+filename));
+    m_gzout=(void*)gz;
+    return;
+#else
+    throw(std::invalid_argument("Compressed log file requested but sigmond was built without zlib"));
+#endif
+    }
+ m_fout.open(filename.c_str());
+ if (!m_fout.is_open())
+    throw(std::invalid_argument(string("Could not open log file ")+filename));
+}
+
+
+bool XMLLogWriter::is_open() const
+{
+ return (m_gzout!=0)||(m_fout.is_open());
+}
+
+
+void XMLLogWriter::write_to_file(const string& str)
+{
+ if (str.empty()) return;
+#ifdef ZLIB
+ if (m_gzout){
+    gzwrite((gzFile)m_gzout,str.data(),str.length());
+    return;}
+#endif
+ if (m_fout.is_open()) m_fout.write(str.data(),str.length());
+}
+
+
+    //  Writes out all buffered text and flushes the file, so that the
+    //  log on disk is complete up to this point.
+
+void XMLLogWriter::flush()
+{
+ write_to_file(m_buffer.str());
+ m_buffer.str(string());
+#ifdef ZLIB
+ if (m_gzout){
+    gzflush((gzFile)m_gzout,Z_SYNC_FLUSH);
+    return;}
+#endif
+ if (m_fout.is_open()) m_fout.flush();
+}
+
+
+void XMLLogWriter::close()
+{
+ if (!is_open()) return;
+ flush();
+#ifdef ZLIB
+ if (m_gzout){
+    gzclose((gzFile)m_gzout);
+    m_gzout=0;}
+#endif
+ if (m_fout.is_open()) m_fout.close();
+ m_streaming=false;
+}
+
+
+    //  A gzip stream cannot be closed without writing its trailer, so
+    //  its state is simply abandoned.  The ofstream buffer is empty if
+    //  the parent flushed before the fork, so closing it writes nothing.
+
+void XMLLogWriter::detach()
+{
+ m_buffer.str(string());
+ m_gzout=0;
+ if (m_fout.is_open()) m_fout.close();
+ m_streaming=false;
+ m_stream_tag.clear();
+}
+
+
+    //  Writes the start tag of the root of "xmlout" (first call only)
+    //  followed by all child elements currently attached to the root,
+    //  using the same indentation as "xmlout.output()".  The children
+    //  are then erased from "xmlout" to release their memory.
+
+void XMLLogWriter::stream_element(XMLHandler& xmlout)
+{
+ if (xmlout.empty()) return;
+ XMLHandler xmlh(xmlout,XMLHandler::pointer);
+ xmlh.set_exceptions_off();
+ xmlh.seek_root();
+ string rootname(xmlh.get_node_name());
+ xmlh.seek_first_child();
+ if ((xmlh.fail())||(xmlh.is_text_valued())) return;
+ if (!m_streaming){
+    m_buffer << endl << "<"<<rootname<<">";
+    m_stream_tag=rootname;
+    m_streaming=true;}
+ else if (rootname!=m_stream_tag)
+    throw(std::invalid_argument("Cannot stream two different elements to the log"));
+ while ((xmlh.good())&&(!xmlh.is_text_valued())){
+    string elem(xmlh.output_current(1));
+    if ((!elem.empty())&&(elem[elem.length()-1]=='\n'))
+       elem.erase(elem.length()-1);
+    m_buffer << elem;
+    xmlh.erase_current_element();
+    xmlh.seek_first_child();}
+ flush();
+}
+
+
+    //  Completes the output of "xmlout": if part of it has been
+    //  streamed, the remaining children and the closing tag are
+    //  written; otherwise the entire tree is written.
+
+void XMLLogWriter::finish_element(XMLHandler& xmlout)
+{
+ if (!m_streaming){
+    m_buffer << xmlout.output();
+    flush();
+    return;}
+ stream_element(xmlout);
+ m_buffer << endl << "</"<<m_stream_tag<<">"<<endl;
+ m_streaming=false;
+ m_stream_tag.clear();
+ flush();
+}
+
+
+// *************************************************************************
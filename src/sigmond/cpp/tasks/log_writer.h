@@ -0,0 +1,116 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include "xml_handler.h"
+
+// *************************************************************************
+// *                                                                       *
+// *   The class "XMLLogWriter" is the append-only sink for the sigmond    *
+// *   log file.  Text is buffered and written to disk at "flush" points,  *
+// *   which occur at task boundaries and whenever a task streams its      *
+// *   output.  Since nothing is kept in memory after a flush, a killed    *
+// *   job leaves all completed output on disk.                            *
+// *                                                                       *
+// *   Text is inserted with the usual "<<" operators, so the log is       *
+// *   written as with an ofstream:                                        *
+// *                                                                       *
+// *     XMLLogWriter xlog;                                                *
+// *     xlog.open("output.log");           // plain text                  *
+// *     xlog.open("output.log.gz",true);   // gzip compressed             *
+// *     xlog << "<LogSigMonD>"<<endl;                                     *
+// *     xlog.flush();                                                     *
+// *     xlog.close();                                                     *
+// *                                                                       *
+// *   Compression requires zlib at compile time (the ZLIB define).  The   *
+// *   compressed stream is sync-flushed at every flush point, so a        *
+// *   truncated file can still be decompressed up to the last flush.      *
+// *                                                                       *
+// *   Task output can be streamed to the log as it is produced.  A task   *
+// *   builds its output in an XMLHandler as usual; calling                *
+// *   "stream_element" writes the start tag of the root (once), then     *
+// *   writes each child element currently attached to the root and       *
+// *   erases it from the XMLHandler.  "finish_element" writes any         *
+// *   remaining children and the closing tag.  If nothing was streamed,   *
+// *   "finish_element" writes the whole tree, so the resulting log text   *
+// *   is identical to "xmlout.output()" either way.                       *
+// *                                                                       *
+// *     XMLHandler xmlout("DoFit");                                       *
+// *     xmlout.put_child(...);                                            *
+// *     xlog.stream_element(xmlout);   // children written, then erased   *
+// *     xmlout.put_child(...);                                            *
+// *     xlog.finish_element(xmlout);   // remaining children + </DoFit>   *
+// *                                                                       *
+// *   Only element children are streamed: a root with textual content     *
+// *   is written whole by "finish_element".  Any other XMLHandler         *
+// *   pointing into a streamed child becomes invalid after streaming.     *
+// *                                                                       *
+// *************************************************************************
+
+
+class XMLLogWriter
+{
+
+   std::ofstream m_fout;
+   void *m_gzout;                 // gzFile when compressing
+   std::ostringstream m_buffer;   // text not yet written to file
+   std::string m_filename;
+   bool m_streaming;              // root start tag already written?
+   std::string m_stream_tag;
+
+#ifndef NO_CXX11
+   XMLLogWriter(const XMLLogWriter&) = delete;
+   XMLLogWriter& operator=(const XMLLogWriter&) = delete;
+#else
+   XMLLogWriter(const XMLLogWriter&);
+   XMLLogWriter& operator=(const XMLLogWriter&);
+#endif
+
+ public:
+
+   XMLLogWriter();
+
+   ~XMLLogWriter();
+
+   void open(const std::string& filename, bool compress=false);
+
+   bool is_open() const;
+
+   bool is_compressed() const {return (m_gzout!=0);}
+
+   const std::string& getFileName() const {return m_filename;}
+
+   void flush();
+
+   void close();
+
+       // forget the file without writing to it: used by a child process
+       // created by "fork", whose copy of the file belongs to the parent
+
+   void detach();
+
+   template <typename T>
+   XMLLogWriter& operator<<(const T& val)
+    {m_buffer << val; return *this;}
+
+   XMLLogWriter& operator<<(std::ostream& (*manip)(std::ostream&))
+    {m_buffer << manip; return *this;}
+
+   void stream_element(XMLHandler& xmlout);
+
+   void finish_element(XMLHandler& xmlout);
+
+   bool is_streaming() const {return m_streaming;}
+
+ private:
+
+   void write_to_file(const std::string& str);
+
+};
+
+
+// *************************************************************************
+#endif
@@ -0,0 +1,324 @@
+#include "obs_expression.h"
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// *****************************************************************************
+
+
+ObsExpression::ObsExpression(const string& expression, const vector<string>& varnames,
+                             const map<string,double>& parameters)
+   :  m_expr(expression), m_varnames(varnames), m_params(parameters),
+      m_depth(0), m_maxdepth(0)
+{
+ for (uint k=0;k<m_varnames.size();++k){
+    if ((!is_name(m_varnames[k]))||(is_function(m_varnames[k])))
+       throw(std::invalid_argument(string("Invalid variable name ")+m_varnames[k]
+                                   +" in ObsExpression"));
+    if (m_params.find(m_varnames[k])!=m_params.end())
+       throw(std::invalid_argument(string("Name ")+m_varnames[k]
+                                   +" is both a variable and a parameter in ObsExpression"));
+    for (uint j=0;j<k;++j)
+       if (m_varnames[j]==m_varnames[k])
+          throw(std::invalid_argument(string("Duplicate variable name ")+m_varnames[k]
+                                      +" in ObsExpression"));}
+ for (map<string,double>::const_iterator it=m_params.begin();it!=m_params.end();++it)
+    if ((!is_name(it->first))||(is_function(it->first)))
+       throw(std::invalid_argument(string("Invalid parameter name ")+it->first
+                                   +" in ObsExpression"));
+ size_t pos=0;
+ parse_sum(pos);
+ skip_space(pos);
+ if (pos<m_expr.length()) error("unexpected character",pos);
+}
+
+
+    //  sum:      product { (+|-) product }
+    //  product:  unary { (*|/) unary }
+    //  unary:    (-|+) unary  |  power
+    //  power:    primary [ ^ unary ]
+    //  primary:  number | variable | parameter | function(sum[,sum]) | (sum)
+
+void ObsExpression::parse_sum(size_t& pos)
+{
+ parse_product(pos);
+ while (true){
+    skip_space(pos);
+    if (pos>=m_expr.length()) return;
+    char c=m_expr[pos];
+    if ((c!='+')&&(c!='-')) return;
+    ++pos;
+    parse_product(pos);
+    emit((c=='+') ? Add : Sub);}
+}
+
+
+void ObsExpression::parse_product(size_t& pos)
+{
+ parse_unary(pos);
+ while (true){
+    skip_space(pos);
+    if (pos>=m_expr.length()) return;
+    char c=m_expr[pos];
+    if ((c!='*')&&(c!='/')) return;
+    ++pos;
+    parse_unary(pos);
+    emit((c=='*') ? Mul : Div);}
+}
+
+
+void ObsExpression::parse_unary(size_t& pos)
+{
+ skip_space(pos);
+ if ((pos<m_expr.length())&&((m_expr[pos]=='-')||(m_expr[pos]=='+'))){
+    char c=m_expr[pos++];
+    parse_unary(pos);
+    if (c=='-') emit(Neg);
+    return;}
+ parse_power(pos);
+}
+
+
+void ObsExpression::parse_power(size_t& pos)
+{
+ parse_primary(pos);
+ skip_space(pos);
+ if ((pos<m_expr.length())&&(m_expr[pos]=='^')){
+    ++pos;
+    parse_unary(pos);
+    emit(Pow);}
+}
+
+
+void ObsExpression::parse_primary(size_t& pos)
+{
+ skip_space(pos);
+ if (pos>=m_expr.length()) error("unexpected end",pos);
+ char c=m_expr[pos];
+ if (c=='('){
+    ++pos;
+    parse_sum(pos);
+    expect(pos,')');
+    return;}
+ if ((isdigit(c))||(c=='.')){
+    const char *start=m_expr.c_str()+pos;
+    char *finish;
+    double value=strtod(start,&finish);
+    if (finish==start) error("invalid number",pos);
+    pos+=finish-start;
+    push_const(value);
+    return;}
+ if ((isalpha(c))||(c=='_')){
+    size_t start=pos;
+    while ((pos<m_expr.length())&&((isalnum(m_expr[pos]))||(m_expr[pos]=='_'))) ++pos;
+    string name(m_expr.substr(start,pos-start));
+    if (is_function(name)){
+       expect(pos,'(');
+       parse_sum(pos);
+       if (name=="pow"){
+          expect(pos,',');
+          parse_sum(pos);
+          expect(pos,')');
+          emit(Pow);
+          return;}
+       expect(pos,')');
+       if (name=="sqrt") emit(Sqrt);
+       else if (name=="exp") emit(Exp);
+       else if (name=="log") emit(Log);
+       else emit(Abs);
+       return;}
+    for (uint k=0;k<m_varnames.size();++k)
+       if (m_varnames[k]==name){
+          push_var(k);
+          return;}
+    map<string,double>::const_iterator pt=m_params.find(name);
+    if (pt!=m_params.end()){
+       push_const(pt->second);
+       return;}
+    error(string("unknown name ")+name,start);}
+ error("unexpected character",pos);
+}
+
+
+void ObsExpression::skip_space(size_t& pos) const
+{
+ while ((pos<m_expr.length())&&(isspace(m_expr[pos]))) ++pos;
+}
+
+
+void ObsExpression::expect(size_t& pos, char c)
+{
+ skip_space(pos);
+ if ((pos>=m_expr.length())||(m_expr[pos]!=c))
+    error(string("expected '")+c+"'",pos);
+ ++pos;
+}
+
+
+void ObsExpression::error(const string& msg, size_t pos) const
+{
+ throw(std::invalid_argument(string("Invalid expression \"")+m_expr+"\": "+msg
+                             +" at position "+to_string(pos)));
+}
+
+
+void ObsExpression::push_var(uint index)
+{
+ m_code.push_back(Instruction(PushVar,index));
+ m_maxdepth=max(m_maxdepth,++m_depth);
+}
+
+
+void ObsExpression::push_const(double value)
+{
+ m_code.push_back(Instruction(PushConst,m_consts.size()));
+ m_consts.push_back(value);
+ m_maxdepth=max(m_maxdepth,++m_depth);
+}
+
+
+    //  An operation whose operands are all constants is done here.  A
+    //  subexpression whose last instruction is a push is that push alone,
+    //  so the last one or two instructions are then the operands.
+
+void ObsExpression::emit(OpCode op)
+{
+ bool binary=((op==Add)||(op==Sub)||(op==Mul)||(op==Div)||(op==Pow));
+ uint nops=binary ? 2 : 1;
+ uint ncode=m_code.size();
+ bool folds=(ncode>=nops);
+ for (uint k=ncode-nops;(folds)&&(k<ncode);++k)
+    folds=(m_code[k].m_op==PushConst);
+ if (binary) --m_depth;
+ if (!folds){
+    m_code.push_back(Instruction(op));
+    return;}
+ double a=m_consts[m_code[ncode-nops].m_index];
+ double b=binary ? m_consts[m_code[ncode-1].m_index] : 0.0;
+ m_code.erase(m_code.begin()+(ncode-nops),m_code.end());
+ m_code.push_back(Instruction(PushConst,m_consts.size()));
+ m_consts.push_back(apply(op,a,b));
+}
+
+
+bool ObsExpression::is_name(const string& name)
+{
+ if ((name.empty())||((!isalpha(name[0]))&&(name[0]!='_'))) return false;
+ for (uint k=1;k<name.length();++k)
+    if ((!isalnum(name[k]))&&(name[k]!='_')) return false;
+ return true;
+}
+
+
+bool ObsExpression::is_function(const string& name)
+{
+ return (name=="sqrt")||(name=="exp")||(name=="log")||(name=="abs")||(name=="pow");
+}
+
+
+double ObsExpression::apply(OpCode op, double a, double b)
+{
+ switch (op){
+    case Neg:  return -a;
+    case Add:  return a+b;
+    case Sub:  return a-b;
+    case Mul:  return a*b;
+    case Div:  return a/b;
+    case Pow:  return pow(a,b);
+    case Sqrt: return sqrt(a);
+    case Exp:  return exp(a);
+    case Log:  return log(a);
+    case Abs:  return fabs(a);
+    default:   return a;}
+}
+
+
+static thread_local uint t_default_threads=0;
+
+void ObsExpression::setThreadDefaultThreads(uint nthreads)
+{
+ t_default_threads=nthreads;
+}
+
+
+void ObsExpression::evaluate(const vector<const double*>& args, double *result,
+                             uint nvalues, uint nthreads) const
+{
+ if (args.size()!=m_varnames.size())
+    throw(std::invalid_argument("Wrong number of arguments in ObsExpression::evaluate"));
+ if (nthreads==0) nthreads=t_default_threads;
+ if (nthreads==0) nthreads=thread::hardware_concurrency();
+ nthreads=min(nthreads,nvalues/min_thread_values);
+ if (nthreads<=1){
+    evaluate_range(args,result,0,nvalues);
+    return;}
+ uint chunk=((nvalues/nthreads+block_size-1)/block_size)*block_size;
+ vector<thread> workers;
+ for (uint begin=chunk;begin<nvalues;begin+=chunk)
+    workers.push_back(thread(&ObsExpression::evaluate_range,this,cref(args),result,
+                             begin,min(begin+chunk,nvalues)));
+ evaluate_range(args,result,0,chunk);
+ for (uint k=0;k<workers.size();++k)
+    workers[k].join();
+}
+
+
+double ObsExpression::evaluate(const vector<double>& args) const
+{
+ vector<const double*> argptrs(args.size());
+ for (uint k=0;k<args.size();++k)
+    argptrs[k]=&args[k];
+ double result;
+ evaluate(argptrs,&result,1,1);
+ return result;
+}
+
+
+    //  The stack holds one block of values per entry.  Each case is a
+    //  plain loop over "n" values so that it vectorizes.
+
+void ObsExpression::evaluate_range(const vector<const double*>& args, double *result,
+                                   uint begin, uint end) const
+{
+ vector<double> stack(m_maxdepth*block_size);
+ for (uint start=begin;start<end;start+=block_size){
+    uint n=(end-start<block_size) ? end-start : block_size;
+    double *top=stack.data();       // first free entry
+    for (vector<Instruction>::const_iterator it=m_code.begin();it!=m_code.end();++it){
+       if (it->m_op==PushVar){
+          const double *x=args[it->m_index]+start;
+          for (uint j=0;j<n;++j) top[j]=x[j];
+          top+=block_size;
+          continue;}
+       if (it->m_op==PushConst){
+          double c=m_consts[it->m_index];
+          for (uint j=0;j<n;++j) top[j]=c;
+          top+=block_size;
+          continue;}
+       double *a=top-block_size;
+       const double *b=top;
+       switch (it->m_op){
+          case Neg:  for (uint j=0;j<n;++j) a[j]=-a[j]; break;
+          case Sqrt: for (uint j=0;j<n;++j) a[j]=sqrt(a[j]); break;
+          case Exp:  for (uint j=0;j<n;++j) a[j]=exp(a[j]); break;
+          case Log:  for (uint j=0;j<n;++j) a[j]=log(a[j]); break;
+          case Abs:  for (uint j=0;j<n;++j) a[j]=fabs(a[j]); break;
+          default:
+             top-=block_size; a-=block_size; b-=block_size;
+             switch (it->m_op){
+                case Add: for (uint j=0;j<n;++j) a[j]+=b[j]; break;
+                case Sub: for (uint j=0;j<n;++j) a[j]-=b[j]; break;
+                case Mul: for (uint j=0;j<n;++j) a[j]*=b[j]; break;
+                case Div: for (uint j=0;j<n;++j) a[j]/=b[j]; break;
+                default:  for (uint j=0;j<n;++j) a[j]=pow(a[j],b[j]); break;}}}
+    const double *r=stack.data();
+    for (uint j=0;j<n;++j) result[start+j]=r[j];}
+}
+
+
+// *****************************************************************************
@@ -0,0 +1,121 @@
+#ifndef OBS_EXPRESSION_H
+#define OBS_EXPRESSION_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "matrix.h"
+
+// *****************************************************************************
+// *                                                                           *
+// *   "ObsExpression" is an arithmetic expression in a set of named           *
+// *   variables, such as                                                      *
+// *                                                                           *
+// *         E0*sqrt(1+p/(xi*xi))-2*m^2+pow(a,1/3)                             *
+// *                                                                           *
+// *   which is compiled once and then evaluated element by element over       *
+// *   whole arrays of values, one array per variable.  It is used to compute  *
+// *   functions of observables over all bins or all samplings at once.        *
+// *                                                                           *
+// *   Allowed are numbers, the variables, the binary operators + - * / and    *
+// *   ^ (power, right associative, binding tighter than unary minus),         *
+// *   unary minus and plus, parentheses, and the functions                    *
+// *                                                                           *
+// *         sqrt(x)  exp(x)  log(x)  abs(x)  pow(x,y)                         *
+// *                                                                           *
+// *   Optional named "parameters" are constants known when the expression     *
+// *   is compiled; operations on constants only are done at compile time.     *
+// *   Variable and parameter names must start with a letter or underscore,    *
+// *   followed by letters, digits or underscores.  Errors in the expression   *
+// *   throw an "invalid_argument" exception.                                  *
+// *                                                                           *
+// *      vector<string> vars(2); vars[0]="m"; vars[1]="xi";                   *
+// *      map<string,double> params; params["p"]=psqfactor;                    *
+// *      ObsExpression expr("sqrt(m*m+p/(xi*xi))",vars,params);               *
+// *                                                                           *
+// *      vector<const double*> args(2);                                       *
+// *      args[0]=&mvalues[0]; args[1]=&xivalues[0];                           *
+// *      expr.evaluate(args,&result[0],nvalues);                              *
+// *                                                                           *
+// *   The values are processed in blocks that stay in the cache, and each     *
+// *   operation is a simple loop over a block which the compiler vectorizes.  *
+// *   Each operation is done exactly as the same C++ expression would do it   *
+// *   on one value, so results do not depend on the block size.  Arrays long  *
+// *   enough to be worth it are split among several threads; "nthreads"       *
+// *   limits the number of threads.  Zero means the calling thread's default, *
+// *   which is the hardware concurrency unless "setThreadDefaultThreads" has  *
+// *   changed it.  The TaskScheduler sets it to one in its worker threads,    *
+// *   which already keep the hardware busy, so that expressions evaluated     *
+// *   by concurrent tasks do not oversubscribe the machine.                   *
+// *                                                                           *
+// *****************************************************************************
+
+
+class ObsExpression
+{
+
+   enum OpCode {PushVar, PushConst, Neg, Add, Sub, Mul, Div, Pow, Sqrt, Exp, Log, Abs};
+
+   struct Instruction
+   {
+      OpCode m_op;
+      uint m_index;          // variable or constant index for the push codes
+      Instruction(OpCode op, uint index=0) : m_op(op), m_index(index) {}
+   };
+
+   std::string m_expr;
+   std::vector<std::string> m_varnames;
+   std::map<std::string,double> m_params;
+   std::vector<double> m_consts;
+   std::vector<Instruction> m_code;
+   uint m_depth, m_maxdepth;      // stack depths while compiling, and the largest
+
+   static const uint block_size=256;
+   static const uint min_thread_values=65536;   // fewest values per thread
+
+ public:
+
+   ObsExpression(const std::string& expression, const std::vector<std::string>& varnames,
+                 const std::map<std::string,double>& parameters=std::map<std::string,double>());
+
+   const std::string& getExpression() const {return m_expr;}
+
+   uint getNumberOfVariables() const {return m_varnames.size();}
+
+   const std::vector<std::string>& getVariableNames() const {return m_varnames;}
+
+   void evaluate(const std::vector<const double*>& args, double *result, uint nvalues,
+                 uint nthreads=0) const;
+
+   double evaluate(const std::vector<double>& args) const;
+
+   static void setThreadDefaultThreads(uint nthreads);   // zero restores hardware concurrency
+
+ private:
+
+   void parse_sum(size_t& pos);
+   void parse_product(size_t& pos);
+   void parse_unary(size_t& pos);
+   void parse_power(size_t& pos);
+   void parse_primary(size_t& pos);
+
+   void skip_space(size_t& pos) const;
+   void expect(size_t& pos, char c);
+   void error(const std::string& msg, size_t pos) const;
+
+   void push_var(uint index);
+   void push_const(double value);
+   void emit(OpCode op);
+
+   static bool is_name(const std::string& name);
+   static bool is_function(const std::string& name);
+   static double apply(OpCode op, double a, double b=0.0);
+
+   void evaluate_range(const std::vector<const double*>& args, double *result,
+                       uint begin, uint end) const;
+
+};
+
+
+// *****************************************************************************
+#endif
@@ -1,4 +1,6 @@
 #include "rolling_pivot.h"
+#include <atomic>
+#include <thread>
 
 using namespace std;
 using namespace LaphEnv;
@@ -9,10 +11,12 @@ using namespace LaphEnv;
 RollingPivotOfCorrMat::RollingPivotOfCorrMat(TaskHandler& taskhandler, ArgsHandler& xml_in,
                                              LogHelper& xmlout)
                         : m_moh(taskhandler.getMCObsHandler()), m_cormat_info(0), 
-                          m_rotated_info(0), m_diag(0), m_refstart(0), m_Zmat(0)
+                          m_rotated_info(0), m_diag(0), m_refstart(0), m_Zmat(0),
+                          m_nthreads(1)
 {
  try{
     ArgsHandler xmlin(xml_in,"RollingPivotInitiate"); 
+    xmlin.getOptionalUInt("NumberOfThreads",m_nthreads);
     if (xmlin.queryTag("ReadPivotFromFile")){
        ArgsHandler xmlf(xmlin,"ReadPivotFromFile");
        initiate_from_file(xmlf,xmlout);
@@ -29,10 +33,12 @@ RollingPivotOfCorrMat::RollingPivotOfCorrMat(TaskHandler& taskhandler, ArgsHandl
 RollingPivotOfCorrMat::RollingPivotOfCorrMat(MCObsHandler* moh, ArgsHandler& xml_in,
                                              LogHelper& xmlout)
                         : m_moh(moh), m_cormat_info(0), 
-                          m_rotated_info(0), m_diag(0), m_refstart(0), m_Zmat(0)
+                          m_rotated_info(0), m_diag(0), m_refstart(0), m_Zmat(0),
+                          m_nthreads(1)
 {
  try{
     ArgsHandler xmlin(xml_in,"RollingPivotInitiate"); 
+    xmlin.getOptionalUInt("NumberOfThreads",m_nthreads);
     if (xmlin.queryTag("ReadPivotFromFile")){
        ArgsHandler xmlf(xmlin,"ReadPivotFromFile");
        initiate_from_file(xmlf,xmlout);
@@ -560,12 +566,28 @@ void RollingPivotOfCorrMat::doRotation(uint tmin, uint tmax, LogHelper& xmllog)
        throw(std::invalid_argument(string("VEVRotation failed ")
                +string(errmsg.what())));}
  }
- for (uint tval=m_tauZ;tval>=tmin;tval--){
+
+    // time slices in the order they are pinned: from tauZ down to tmin,
+    // then from tauZ+1 up to tmax
+
+ vector<SliceSolution> slices;
+ for (uint tval=m_tauZ+1;tval>tmin;tval--){
+    slices.push_back(SliceSolution());
+    slices.back().timeval=tval-1;}
+ uint nbackward=slices.size();
+ for (uint tval=m_tauZ+1;tval<=tmax;tval++){
+    slices.push_back(SliceSolution());
+    slices.back().timeval=tval;}
+ HermMatrix corrN;
+ solve_slices(slices,corrN);
+
+ for (uint k=0;k<nbackward;k++){
+    uint tval=slices[k].timeval;
     bool diagonly= true; //(tval<=m_tauD) ? true : false;
     LogHelper xmlc("CorrelatorRotation");
     xmlc.putUInt("TimeValue",tval);
     try{
-       do_corr_rotation(tval,diagonly);
+       do_corr_rotation(slices[k],corrN,diagonly);
        xmlc.putString("Status","Success");}
     catch(const std::exception& errmsg){
        flag=false;
@@ -635,12 +657,13 @@ void RollingPivotOfCorrMat::doRotation(uint tmin, uint tmax, LogHelper& xmllog)
  //reset vector pinner to tauZ
  m_vecpin.resetReferenceVectors(*m_refstart);
  
- for (uint tval=m_tauZ+1;tval<=tmax;tval++){
+ for (uint k=nbackward;k<slices.size();k++){
+    uint tval=slices[k].timeval;
     bool diagonly= false; //true; //(tval<=m_tauD) ? true : false;
     LogHelper xmlc("CorrelatorRotation");
     xmlc.putUInt("TimeValue",tval);
     try{
-       do_corr_rotation(tval,diagonly);
+       do_corr_rotation(slices[k],corrN,diagonly);
        xmlc.putString("Status","Success");}
     catch(const std::exception& errmsg){
        flag=false;
@@ -710,6 +733,172 @@ void RollingPivotOfCorrMat::doRotation(uint tmin, uint tmax, LogHelper& xmllog)
 }
 
 
+    //  Reads the correlator matrices at all of the time slices in "slices"
+    //  (full estimates), and finds the eigenvectors at each time slice with
+    //  the metric C(tau0).  The time slices are independent, so the
+    //  diagonalizations are shared among "m_nthreads" threads.  A failure
+    //  is recorded in the "error" member of the time slice.
+
+void RollingPivotOfCorrMat::solve_slices(vector<SliceSolution>& slices, HermMatrix& corrN)
+{
+ uint nslices=slices.size();
+ const TransMatrix *dummy_tmat; 
+ HermMatrix corr0;
+ vector<HermMatrix> corrT(nslices);
+ string errmsg;
+ m_moh->setSamplingBegin();   // rotate using full estimates
+ for (uint k=0;k<nslices;k++){
+    slices[k].invcondnum=-1.0;
+    slices[k].solved=false;}
+
+ try{
+    getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,m_tauN,corrN,m_cormat_info,dummy_tmat);
+ }catch(const std::exception& xp){
+    errmsg=string("get Correlator matrix at "+to_string(m_tauN)+" failed in RollingPivot: ")
+          +string(xp.what());
+ }
+ if (errmsg.empty()){
+    try{
+       getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,m_tau0,corr0,m_cormat_info,dummy_tmat);
+    }catch(const std::exception& xp){
+       errmsg=string("get Correlator matrix at "+to_string(m_tau0)+"failed in RollingPivot: ")
+             +string(xp.what());
+    }}
+ for (uint k=0;k<nslices;k++){
+    if (!errmsg.empty()){
+       slices[k].error=errmsg;
+       continue;}
+    try{
+       getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,slices[k].timeval,corrT[k],m_cormat_info,dummy_tmat);
+    }catch(const std::exception& xp){
+       slices[k].error=string("get Correlator matrix at "+to_string(slices[k].timeval)+"failed in RollingPivot: ")
+                      +string(xp.what());
+    }}
+ if (!errmsg.empty()) return;
+
+ //set matrix by estimate for each timeslice -> don't reorder eigenvalues -> make sure they overlap strongly with the ref
+ doRescaleByDiagonals(corr0,corrN);
+ DiagonalizerWithMetric metric_diag(m_min_inv_condnum,m_neg_eig_alarm);
+ metric_diag.setExceptionsOff();
+ int info=metric_diag.setMetric(corr0);
+ vector<uint> todo;
+ for (uint k=0;k<nslices;k++){
+    if (!slices[k].error.empty()) continue;
+    if (info!=0)
+       slices[k].error=string("setMetric encountered problem in RollingPivot: ")
+                 +DiagonalizerWithMetric::getRotateMetricCode(info)+string(" at time ")+to_string(slices[k].timeval);
+    else
+       todo.push_back(k);}
+
+ std::atomic<uint> next(0);
+ auto solve=[&](){
+    uint j;
+    while ((j=next++)<todo.size()){
+       SliceSolution& slice=slices[todo[j]];
+       try{
+          DiagonalizerWithMetric this_diag(metric_diag);
+          doRescaleByDiagonals(corrT[todo[j]],corrN);
+          int sinfo=this_diag.setMatrix(corrT[todo[j]]);
+          slice.invcondnum=this_diag.getInvCondNum();
+          slice.solved=true;
+          if ((sinfo!=0)&&(sinfo!=-5))
+             slice.error=string("setMatrix encountered problem in RollingPivot: ")
+                 +DiagonalizerWithMetric::getRotateMatrixCode(sinfo)+string(" at time ")+to_string(slice.timeval);
+          else
+             this_diag.getEigenvectors(slice.eigvecs);}
+       catch(const std::exception& xp){
+          slice.error=string("diagonalization failed in RollingPivot: ")+string(xp.what());}}};
+
+ uint nthreads=(m_nthreads<todo.size()) ? m_nthreads : todo.size();
+ vector<thread> workers;
+ for (uint t=1;t<nthreads;t++)
+    workers.push_back(thread(solve));
+ solve();
+ for (vector<thread>::iterator it=workers.begin();it!=workers.end();++it)
+    it->join();
+}
+
+
+    //  Pins the eigenvectors of one time slice to the reference vectors
+    //  of the previous time slice, then rotates the correlator bins.
+
+void RollingPivotOfCorrMat::do_corr_rotation(const SliceSolution& slice, const HermMatrix& corrN,
+                                             bool diagonly)
+{
+ uint timeval=slice.timeval;
+ if (slice.solved) m_invcondnum=slice.invcondnum;
+ if (!slice.error.empty())
+    throw(std::invalid_argument(slice.error));
+ const TransMatrix& eigvecs=slice.eigvecs;
+ bool subvev=m_cormat_info->subtractVEV();
+  
+ uint nops = eigvecs.size(0); 
+ uint nlevels = eigvecs.size(1);
+ if( m_vecpin.getNumberRefVectors()<eigvecs.size(1) ) 
+     nlevels = m_vecpin.getNumberRefVectors();
+    
+ //check eigenvectors against ref eigenvectors from recent timeslice
+ std::vector<int> pinnings;
+ uint warning, skip = 0;
+ bool repeat;
+ TransMatrix reordered_eigvecs; 
+    
+ m_vecpin.getPinnings(eigvecs,pinnings,repeat,warning);
+ try{ //rotate bins
+     if( timeval==m_tau0 ){ //warning){ //if fail to match eigenvectors, use most recent successful time slice eigenvectors to pivot
+         reordered_eigvecs = TransMatrix(m_refrecent);
+    //      throw(std::invalid_argument(string("vectorPinner failed to match eigenvectors in RollingPivot at time ")
+    //                                          +to_string(timeval) ));
+     }else{ //reorder eigenvectors based on pinnings from vector Pinner and update reference eigen vectors
+         m_taurecent = timeval;
+         reordered_eigvecs.resize(nops, nlevels);
+         m_refrecent.resize(nops, nlevels);
+         for( uint i = 0; i<nlevels;i++){
+             for( uint j = 0; j<nops;j++){
+                 if( pinnings[i+skip] < 0 ) skip++;
+                 if( i+skip >= nlevels ) break;
+                 if( pinnings[i+skip] >= nlevels ) break;
+                 reordered_eigvecs.put( j, pinnings[i+skip], eigvecs.get(j,i+skip) ); 
+                 m_refrecent.put( j, pinnings[i+skip], eigvecs.get(j,i+skip) );
+             }
+         }
+         m_vecpin.resetReferenceVectors(reordered_eigvecs);
+     }
+ }catch(const std::exception& errmsg){
+    throw(std::invalid_argument(string("reordering pinnings failed in RollingPivot: ")
+          +string(errmsg.what())));
+ }
+    
+ doRescaleTransformation(reordered_eigvecs,corrN);
+ 
+          // if there are nonzero VEVs, rephase rotated operators
+         // so all VEVs are real and positive
+ if (subvev && m_vevs_avail){
+//     uint nops=reordered_eigvecs.size(0);
+//     uint nlevels=reordered_eigvecs.size(1);
+//     doVectorRotation(vev,reordered_eigvecs);
+    for (uint col=0;col<nlevels;col++){
+// #if defined COMPLEXNUMBERS
+//        complex<double> phase(vev[col]/std::abs(vev[col]));
+// #else
+//        double phase=(vev[col]>=0.0)?1.0:-1.0;
+// #endif
+       for (uint row=0;row<nops;row++){
+          reordered_eigvecs(row,col)*=m_phase_matrix(row,col);
+       }
+    }
+ }
+
+ do_bins_rotation(timeval,reordered_eigvecs,nlevels,diagonly);
+
+    if( (warning) && (timeval!=m_tau0) ){
+         throw(std::invalid_argument(string("vectorPinner failed to match ")+to_string(warning)+string(" eigenvectors at time=")
+                                 +to_string(timeval) //+string(". Using pivot from time=")+to_string(m_taurecent) 
+                                    ));
+     }
+}
+
+
 /*
 void RollingPivotOfCorrMat::do_a_rotation(const HermMatrix& corrD, const HermMatrix& corrN,
                                           uint tsep, const VVector& vev, LevelPinner& ref_vecs)
@@ -825,125 +1014,12 @@ void RollingPivotOfCorrMat::do_vev_rotation()
 
 
 
-void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly) //need to set up vevs
+void RollingPivotOfCorrMat::do_bins_rotation(uint timeval, const TransMatrix& rotation,
+                                             uint nlevels, bool diagonly)
 { 
  uint nops=getNumberOfOperators();
- uint nlevels=getNumberOfLevels();
  uint nbins=m_moh->getNumberOfBins();
  const set<OperatorInfo>& ops=m_cormat_info->getOperators();
- bool subvev=m_cormat_info->subtractVEV();
- const TransMatrix *dummy_tmat; 
- HermMatrix corr0,corrN,corrT;
- VVector vev;
- m_moh->setSamplingBegin();   // rotate using full estimates
- 
- // rotate using full estimates
- try{
-    getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,m_tauN,corrN,m_cormat_info,dummy_tmat);
- }catch(const std::exception& errmsg){
-    throw(std::invalid_argument(string("get Correlator matrix at "+to_string(m_tauN)+" failed in RollingPivot: ")
-          +string(errmsg.what())));
- }
-//     if (subvev){
-//         try{
-//             getHermCorrelatorMatrixVEVs_CurrentSampling(m_moh,m_cormat_info,vev,m_cormat_info,dummy_tmat);
-//         }catch(const std::exception& xp){m_vevs_avail=false;}
-//     }
- try{
-    getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,m_tau0,corr0,m_cormat_info,dummy_tmat);
- }catch(const std::exception& errmsg){
-    throw(std::invalid_argument(string("get Correlator matrix at "+to_string(m_tau0)+"failed in RollingPivot: ")
-          +string(errmsg.what())));
- }
- try{
-    getHermCorrelatorMatrixAtTime_CurrentSampling(m_moh,m_cormat_info,timeval,corrT,m_cormat_info,dummy_tmat);
- }catch(const std::exception& errmsg){
-    throw(std::invalid_argument(string("get Correlator matrix at "+to_string(timeval)+"failed in RollingPivot: ")
-          +string(errmsg.what())));
- }
-     
- //set matrix by estimate for each timeslice -> don't reorder eigenvalues -> make sure they overlap strongly with the ref
- doRescaleByDiagonals(corr0,corrN);
- doRescaleByDiagonals(corrT,corrN);
-    
- DiagonalizerWithMetric this_diag(m_min_inv_condnum,m_neg_eig_alarm);
- this_diag.setExceptionsOff();
- int info=this_diag.setMetric(corr0);
- if (info!=0) 
-    throw(std::invalid_argument(string("setMetric encountered problem in RollingPivot: ")
-                 +DiagonalizerWithMetric::getRotateMetricCode(info)+string(" at time ")+to_string(timeval) ));
-    
-  //setup input parameter to allow falling rank?
-//  this_diag.set_strip_eigenvectors(false);
-//  this_diag.setMinInvCondNum(0.0);  // exclude states in metric, but not in rotated matrix with time
-    
- //create rotation matrix
- info=this_diag.setMatrix(corrT);
- m_invcondnum=this_diag.getInvCondNum();
- if ((info!=0)&&(info!=-5)){
-    throw(std::invalid_argument(string("setMatrix encountered problem in RollingPivot: ")
-        +DiagonalizerWithMetric::getRotateMatrixCode(info)+string(" at time ")+to_string(timeval) ));
- }
- TransMatrix eigvecs; 
- this_diag.getEigenvectors(eigvecs);
-  
- nops = eigvecs.size(0); 
- nlevels = eigvecs.size(1);
- if( m_vecpin.getNumberRefVectors()<eigvecs.size(1) ) 
-     nlevels = m_vecpin.getNumberRefVectors();
-    
- //check eigenvectors against ref eigenvectors from recent timeslice
- std::vector<int> pinnings;
- uint warning, skip = 0;
- bool repeat;
- TransMatrix reordered_eigvecs; 
-    
- m_vecpin.getPinnings(eigvecs,pinnings,repeat,warning);
- try{ //rotate bins
-     if( timeval==m_tau0 ){ //warning){ //if fail to match eigenvectors, use most recent successful time slice eigenvectors to pivot
-         reordered_eigvecs = TransMatrix(m_refrecent);
-    //      throw(std::invalid_argument(string("vectorPinner failed to match eigenvectors in RollingPivot at time ")
-    //                                          +to_string(timeval) ));
-     }else{ //reorder eigenvectors based on pinnings from vector Pinner and update reference eigen vectors
-         m_taurecent = timeval;
-         reordered_eigvecs.resize(nops, nlevels);
-         m_refrecent.resize(nops, nlevels);
-         for( uint i = 0; i<nlevels;i++){
-             for( uint j = 0; j<nops;j++){
-                 if( pinnings[i+skip] < 0 ) skip++;
-                 if( i+skip >= nlevels ) break;
-                 if( pinnings[i+skip] >= nlevels ) break;
-                 reordered_eigvecs.put( j, pinnings[i+skip], eigvecs.get(j,i+skip) ); 
-                 m_refrecent.put( j, pinnings[i+skip], eigvecs.get(j,i+skip) );
-             }
-         }
-         m_vecpin.resetReferenceVectors(reordered_eigvecs);
-     }
- }catch(const std::exception& errmsg){
-    throw(std::invalid_argument(string("reordering pinnings failed in RollingPivot: ")
-          +string(errmsg.what())));
- }
-    
- doRescaleTransformation(reordered_eigvecs,corrN);
- 
-          // if there are nonzero VEVs, rephase rotated operators
-         // so all VEVs are real and positive
- if (subvev && m_vevs_avail){
-//     uint nops=reordered_eigvecs.size(0);
-//     uint nlevels=reordered_eigvecs.size(1);
-//     doVectorRotation(vev,reordered_eigvecs);
-    for (uint col=0;col<nlevels;col++){
-// #if defined COMPLEXNUMBERS
-//        complex<double> phase(vev[col]/std::abs(vev[col]));
-// #else
-//        double phase=(vev[col]>=0.0)?1.0:-1.0;
-// #endif
-       for (uint row=0;row<nops;row++){
-          reordered_eigvecs(row,col)*=m_phase_matrix(row,col);
-       }
-    }
- }
-    
                 // read original bins, arrange pointers in certain way
  vector<const Vector<double>* > binptrs(nops*nops);  // pointers to original bins
  uint count=0;
@@ -981,12 +1057,12 @@ void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly) //need
               // do the rotation
     if (diagonly){
        RVector diagbuf;
-       doMatrixRotation(Cbuffer,reordered_eigvecs,diagbuf);
+       doMatrixRotation(Cbuffer,rotation,diagbuf);
                 // store results in Crotated
        for (uint level=0;level<nlevels;level++)
           Crotated[level][bin]=diagbuf[level];}
     else{
-       doMatrixRotation(Cbuffer,reordered_eigvecs);
+       doMatrixRotation(Cbuffer,rotation);
                 // store results in Crotated
        count=0;
        for (uint col=0;col<nlevels;col++){ //what about levels being smaller than nops
@@ -1035,14 +1111,6 @@ void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly) //need
        m_moh->putBins(obskey,Crotated[count++]);
        obskey.setToImaginaryPart();
        m_moh->putBins(obskey,imCdiag);}}
-    
-    if( (warning) && (timeval!=m_tau0) ){
-         throw(std::invalid_argument(string("vectorPinner failed to match ")+to_string(warning)+string(" eigenvectors at time=")
-                                 +to_string(timeval) //+string(". Using pivot from time=")+to_string(m_taurecent) 
-                                    ));
-     }
-    
-    
 }
 
 
@@ -1097,11 +1165,10 @@ void RollingPivotOfCorrMat::do_vev_rotation()
 
 
 
-void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly)
+void RollingPivotOfCorrMat::do_bins_rotation(uint timeval, const TransMatrix& rotation,
+                                             uint nlevels, bool diagonly)
 { 
- throw( std::invalid_argument(string("RollingPivot is not set up for REALNUMBERS.")) );
- /*uint nops=getNumberOfOperators();
- uint nlevels=getNumberOfLevels();
+ uint nops=getNumberOfOperators();
  uint nbins=m_moh->getNumberOfBins();
  const set<OperatorInfo>& ops=m_cormat_info->getOperators();
                 // read original bins, arrange pointers in certain way
@@ -1129,16 +1196,16 @@ void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly)
     count=0;
     for (uint col=0;col<nops;col++)
        for (uint row=0;row<=col;row++){
-          Cbuffer(row,col)=(*binptrs[count++])[bin];}
+          Cbuffer.put(row,col,(*binptrs[count++])[bin]);}
               // do the rotation
     if (diagonly){
        RVector diagbuf;
-       doMatrixRotation(Cbuffer,*m_transmat,diagbuf);
+       doMatrixRotation(Cbuffer,rotation,diagbuf);
                 // store results in Crotated
        for (uint level=0;level<nlevels;level++)
           Crotated[level][bin]=diagbuf[level];}
     else{
-       doMatrixRotation(Cbuffer,*m_transmat);
+       doMatrixRotation(Cbuffer,rotation);
                 // store results in Crotated
        count=0;
        for (uint col=0;col<nlevels;col++)
@@ -1146,16 +1213,6 @@ void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly)
              Crotated[count++][bin]=Cbuffer(row,col);}
        Cbuffer.resize(nops);}}
 
-       //  free up memory for original bins
-
- for (itcol=ops.begin();itcol!=ops.end();itcol++){
-    for (itrow=ops.begin();itrow!=itcol;itrow++){
-       CorrelatorAtTimeInfo corrt(*itrow,*itcol,timeval,true,false);
-       MCObsInfo obskey(corrt,RealPart);
-       m_moh->eraseData(obskey);}
-    CorrelatorAtTimeInfo corrt(*itcol,*itcol,timeval,true,false);
-    m_moh->eraseData(MCObsInfo(corrt,RealPart));}
-
        // put rotated bins into memory
  if (diagonly){
     for (uint level=0;level<nlevels;level++){
@@ -1172,7 +1229,6 @@ void RollingPivotOfCorrMat::do_corr_rotation(uint timeval, bool diagonly)
           rowop.resetIDIndex(row);
           MCObsInfo obskey(OperatorInfo(rowop),OperatorInfo(colop),timeval,true,RealPart,false);
           m_moh->putBins(obskey,Crotated[count++]);}}}
-*/
 }
 
 #else
@@ -1392,6 +1448,9 @@ void RollingPivotOfCorrMat::computeZMagnitudesSquared(Matrix<MCEstimate>& ZMagSq
    //  each diagonal element of rotated correlator matrix is
    //  fit to  A * exp(-E_n t )    then   Zrotsq = std::abs(A)
 
+ bool batched=m_moh->isBatchedOutput();
+ if (!outfile.empty()) m_moh->setBatchedOutput(true);   // file stays open for all levels
+
  try{
  ZMagSq.resize(nops,nlevels);   //  final results put in here
  bool overwrite=true;
@@ -1419,7 +1478,14 @@ void RollingPivotOfCorrMat::computeZMagnitudesSquared(Matrix<MCEstimate>& ZMagSq
        ZMagSq(opindex,level)=m_moh->getEstimate(obskey);
        m_moh->eraseSamplings(obskey); }}
  }catch(const std::exception& xp){
+    if (!batched) m_moh->setBatchedOutput(false);
     throw(std::runtime_error(string("Not all fit amplitudes known so cannot compute Z factors: ")+xp.what()));}
+ if ((!outfile.empty())&&(!batched)){
+    list<string> errors;
+    m_moh->flushThreadOutputFiles(errors);
+    m_moh->setBatchedOutput(false);
+    if (!errors.empty())
+       throw(std::runtime_error(string("Could not write ")+outfile+": "+errors.front()));}
 }
 
  // ******************************************************************
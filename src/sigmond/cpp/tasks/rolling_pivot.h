@@ -117,6 +117,7 @@
 // *         <WarningFraction>0.7</WarningFraction>  (optional)                      *
 // *         <CheckMetricErrors/>    (optional)                                      *
 // *         <CheckCommonMetricMatrixNullSpace/>    (optional)                       *
+// *         <NumberOfThreads>4</NumberOfThreads>    (optional)                      *
 // *         <WritePivotToFile>    (optional)                                        *
 // *            <PivotFileName>pivot_test</PivotFileName>                            *
 // *            <Overwrite/>                                                         *
@@ -160,6 +161,10 @@
 // *   property when removing noisy eigenvectors.  Finding this false indicates      *
 // *   caution in interpreting the overlap factors.                                  *
 // *                                                                                 *
+// *   The eigenvectors at different time slices are found independently             *
+// *   before being pinned in time order, so these diagonalizations are shared       *
+// *   among "NumberOfThreads" threads (default 1) in "doRotation".                  *
+// *                                                                                 *
 // *   If the "WritePivotToFile" tag is assigned, the information in the pivot       *
 // *   is written out to a file so that it can be input by later sigmond runs.       *
 // *   The pivot file is an IOMap (a single integer key) with an XML header string   *
@@ -288,6 +293,18 @@ class RollingPivotOfCorrMat : public TaskHandlerData
    std::vector<uint> m_reorder;
    bool m_vevs_avail;
    double m_invcondnum;
+   uint m_nthreads;
+
+         // eigenvectors at one time slice, found before pinning
+
+   struct SliceSolution
+   {
+    uint timeval;
+    TransMatrix eigvecs;
+    double invcondnum;
+    bool solved;
+    std::string error;
+   };
 
 #ifndef NO_CXX11
     RollingPivotOfCorrMat() = delete;
@@ -380,7 +397,11 @@ class RollingPivotOfCorrMat : public TaskHandlerData
    void create_pivot(LogHelper& xmllog, bool checkMetricErrors, 
                      bool checkCommonNullSpace);
    void do_vev_rotation();
-   void do_corr_rotation(uint timeval, bool diagonly);
+   void solve_slices(std::vector<SliceSolution>& slices, HermMatrix& corrN);
+   void do_corr_rotation(const SliceSolution& slice, const HermMatrix& corrN,
+                         bool diagonly);
+   void do_bins_rotation(uint timeval, const TransMatrix& rotation,
+                         uint nlevels, bool diagonly);
    void write_to_file(const std::string& fname, bool overwrite, char file_format);
    
    
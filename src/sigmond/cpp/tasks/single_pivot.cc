@@ -1442,6 +1442,9 @@ void SinglePivotOfCorrMat::computeZMagnitudesSquared(Matrix<MCEstimate>& ZMagSq,
    //  each diagonal element of rotated correlator matrix is
    //  fit to  A * exp(-E_n t )    then   Zrotsq = std::abs(A)
 
+ bool batched=m_moh->isBatchedOutput();
+ if (!outfile.empty()) m_moh->setBatchedOutput(true);   // file stays open for all levels
+
  try{
  ZMagSq.resize(nops,nlevels);   //  final results put in here
  bool overwrite=true;
@@ -1472,7 +1475,14 @@ void SinglePivotOfCorrMat::computeZMagnitudesSquared(Matrix<MCEstimate>& ZMagSq,
        ZMagSq(opindex,level)=m_moh->getEstimate(obskey);
        m_moh->eraseSamplings(obskey); }}}
  catch(const std::exception& xp){
+    if (!batched) m_moh->setBatchedOutput(false);
     throw(std::runtime_error(string("Not all fit amplitudes known so cannot compute Z factors: ")+xp.what()));}
+ if ((!outfile.empty())&&(!batched)){
+    list<string> errors;
+    m_moh->flushThreadOutputFiles(errors);
+    m_moh->setBatchedOutput(false);
+    if (!errors.empty())
+       throw(std::runtime_error(string("Could not write ")+outfile+": "+errors.front()));}
 
 }
 
@@ -0,0 +1,154 @@
+#include "task_handler.h"
+#include "task_utils.h"
+
+using namespace std;
+
+// *******************************************************************************
+// *                                                                             *
+// *    XML format for integrated autocorrelation analysis: for each simple      *
+// *    observable, the autocorrelation function of its Markov-chain data is     *
+// *    computed by fast Fourier transform, and the integrated autocorrelation   *
+// *    time is summed up to an automatically chosen window (see                 *
+// *    "autocorrelation.h").  The unbinned measurements are used when they      *
+// *    are in the last_laph files; otherwise the data in the bin files (or      *
+// *    in memory) is used, and <MeasurementsPerValue> in the output gives the   *
+// *    number of measurements in each value.  Times are in units of these       *
+// *    values.  The observables are analyzed concurrently on                    *
+// *    <NumberOfThreads> threads (default: the hardware concurrency).           *
+// *                                                                             *
+// *    <Task>                                                                   *
+// *     <Action>DoAutocorrelationAnalysis</Action>                              *
+// *       <MCObservable>...</MCObservable>   (any number; must be simple)       *
+// *       <Correlator>...</Correlator>       (any number; all available times)  *
+// *       <AllCorrelators/>     (optional: every correlator in input files)     *
+// *       <AllVEVs/>            (optional: every VEV in the input files)        *
+// *       <HermitianMatrix/>    (optional: for the correlators)                 *
+// *       <Arg>Re</Arg>         (optional: correlators and VEVs; Re default)    *
+// *       <MinTimeSep>3</MinTimeSep>       (optional: for the correlators)      *
+// *       <MaxTimeSep>25</MaxTimeSep>      (optional: for the correlators)      *
+// *       <Windowing>Wolff</Windowing>     (optional: or MadrasSokal)           *
+// *       <WindowFactor>1.5</WindowFactor> (optional: default 1.5 or 6)         *
+// *       <MaxMarkovTime>10</MaxMarkovTime> (optional: prints the normalized    *
+// *                                 autocorrelations up to this time)           *
+// *       <NumberOfThreads>4</NumberOfThreads>  (optional)                      *
+// *    </Task>                                                                  *
+// *                                                                             *
+// *    The output gives, for each observable, the number of values, the         *
+// *    window, the integrated autocorrelation time and its error, and           *
+// *    <WindowFound>false</WindowFound> if no window was found before half      *
+// *    the number of values.  The largest integrated autocorrelation time       *
+// *    is given at the end.                                                     *
+// *                                                                             *
+// *******************************************************************************
+
+
+void TaskHandler::doAutocorrelationAnalysis(XMLHandler& xmltask, XMLHandler& xmlout,
+                                            int taskcount)
+{
+ xmlout.set_root("DoAutocorrelationAnalysis");
+ try{
+ AutoCorrelation::Windowing windowing=AutoCorrelation::Wolff;
+ string instr;
+ if (xmlreadifchild(xmltask,"Windowing",instr)){
+    if (instr=="Wolff") windowing=AutoCorrelation::Wolff;
+    else if (instr=="MadrasSokal") windowing=AutoCorrelation::MadrasSokal;
+    else throw(std::invalid_argument("Invalid <Windowing> tag"));}
+ double factor=AutoCorrelation::getDefaultFactor(windowing);
+ xmlreadifchild(xmltask,"WindowFactor",factor);
+ if (factor<=0.0) throw(std::invalid_argument("<WindowFactor> must be positive"));
+ uint maxmarkov=0;
+ xmlreadifchild(xmltask,"MaxMarkovTime",maxmarkov);
+ uint nthreads=0;
+ xmlreadifchild(xmltask,"NumberOfThreads",nthreads);
+ bool herm=(xml_tag_count(xmltask,"HermitianMatrix")==1);
+ ComplexArg arg=RealPart;
+ read_arg_type(xmltask,arg);
+ uint mintimesep=0, maxtimesep=getLatticeTimeExtent()-1;
+ xmlreadifchild(xmltask,"MinTimeSep",mintimesep);
+ xmlreadifchild(xmltask,"MaxTimeSep",maxtimesep);
+ xmlout.put_child("Windowing",(windowing==AutoCorrelation::Wolff) ? "Wolff" : "MadrasSokal");
+ xmlout.put_child("WindowFactor",make_string(factor));
+
+    // the observables, in input order without repeats
+
+ vector<MCObsInfo> obskeys;
+ set<MCObsInfo> obsdone;
+ list<XMLHandler> obsxml=xmltask.find_among_children("MCObservable");
+ for (list<XMLHandler>::iterator it=obsxml.begin();it!=obsxml.end();++it){
+    MCObsInfo obskey(*it);
+    if (obskey.isNonSimple())
+       throw(std::invalid_argument(string("Observable must be simple: ")+obskey.str()));
+    if (obsdone.insert(obskey).second) obskeys.push_back(obskey);}
+ set<CorrelatorInfo> corrs;
+ list<XMLHandler> corrxml=xmltask.find_among_children("Correlator");
+ for (list<XMLHandler>::iterator it=corrxml.begin();it!=corrxml.end();++it)
+    corrs.insert(CorrelatorInfo(*it));
+ if (xml_child_tag_count(xmltask,"AllCorrelators")>0){
+    set<CorrelatorInfo> allcorrs=m_getter->getCorrelatorInfos();
+    corrs.insert(allcorrs.begin(),allcorrs.end());}
+ for (set<CorrelatorInfo>::const_iterator ct=corrs.begin();ct!=corrs.end();++ct){
+    CorrelatorAtTimeInfo corrt(*ct,0,herm,false);
+    for (uint t=mintimesep;t<=maxtimesep;t++){
+       corrt.resetTimeSeparation(t);
+       MCObsInfo obskey(corrt,arg);
+       if ((m_obs->queryBins(obskey))&&(obsdone.insert(obskey).second))
+          obskeys.push_back(obskey);}}
+ if (xml_child_tag_count(xmltask,"AllVEVs")>0){
+    set<OperatorInfo> vevs=m_getter->getVEVInfos();
+    for (set<OperatorInfo>::const_iterator vt=vevs.begin();vt!=vevs.end();++vt){
+       MCObsInfo obskey(*vt,arg);
+       if ((m_obs->queryBins(obskey))&&(obsdone.insert(obskey).second))
+          obskeys.push_back(obskey);}}
+ if (obskeys.empty())
+    throw(std::invalid_argument("No observables to analyze"));
+
+ vector<MCObsInfo> available;
+ for (uint k=0;k<obskeys.size();k++){
+    if (m_obs->queryBins(obskeys[k]))
+       available.push_back(obskeys[k]);
+    else{
+       XMLHandler xmlo("AutoCorrelationAnalysis");
+       XMLHandler xmlk; obskeys[k].output(xmlk);
+       xmlo.put_child(xmlk);
+       xmlo.put_child("Error","Data not available");
+       xmlout.put_child(xmlo);}}
+
+ vector<AutoCorrelation> results;
+ m_obs->getAutoCorrelations(available,results,windowing,factor,maxmarkov,nthreads);
+
+ uint kmax=0;
+ for (uint k=0;k<available.size();k++){
+    const AutoCorrelation& ac=results[k];
+    XMLHandler xmlo("AutoCorrelationAnalysis");
+    XMLHandler xmlk; available[k].output(xmlk);
+    xmlo.put_child(xmlk);
+    xmlo.put_child("NumberOfValues",make_string(ac.getNumberOfValues()));
+    xmlo.put_child("MeasurementsPerValue",make_string(ac.getMeasurementsPerValue()));
+    xmlo.put_child("Window",make_string(ac.getWindow()));
+    if (!ac.isWindowFound()) xmlo.put_child("WindowFound","false");
+    xmlo.put_child("TauIntegrated",make_string(ac.getIntegratedAutoCorrelationTime()));
+    xmlo.put_child("TauIntegratedError",make_string(ac.getIntegratedAutoCorrelationTimeError()));
+    uint tmax=(maxmarkov<ac.getMaxMarkovTime()) ? maxmarkov : ac.getMaxMarkovTime();
+    for (uint markovtime=1;markovtime<=tmax;markovtime++){
+       XMLHandler xmla("AutoCorrelation");
+       xmla.put_child("MarkovTime",make_string(markovtime));
+       xmla.put_child("Value",make_string(ac.getAutoCorrelation(markovtime)));
+       xmlo.put_child(xmla);}
+    xmlout.put_child(xmlo);
+    if (ac.getIntegratedAutoCorrelationTime()>results[kmax].getIntegratedAutoCorrelationTime())
+       kmax=k;}
+ if (!available.empty()){
+    XMLHandler xmlm("MaxTauIntegrated");
+    XMLHandler xmlk; available[kmax].output(xmlk);
+    xmlm.put_child(xmlk);
+    xmlm.put_child("TauIntegrated",make_string(results[kmax].getIntegratedAutoCorrelationTime()));
+    xmlout.put_child(xmlm);}}
+
+ catch(const std::exception& errmsg){
+    xmlout.clear();
+    throw(std::invalid_argument(string("DoAutocorrelationAnalysis encountered an error: ")
+             +string(errmsg.what())));}
+}
+
+
+// ***************************************************************************************
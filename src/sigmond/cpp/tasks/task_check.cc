@@ -1,7 +1,11 @@
 #include "task_handler.h"
 #include "correlator_matrix_info.h"
 #include "histogram.h"
-
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 using namespace std;
 
@@ -22,6 +26,14 @@ using namespace std;
 // *    If <Type>TemporalCorrelatorMatrixIsHermitian</Type> is used, it checks   *
 // *    that the correlator matrix is hermitian.                                 *
 // *                                                                             *
+// *    The observables are checked concurrently on <NumberOfThreads> threads    *
+// *    (default: the hardware concurrency); each is read once, and its bins     *
+// *    are scanned for NaN or infinite values, outliers and (if needed) a       *
+// *    zero mean.  For <Type>TemporalCorrelatorMatrix</Type>, a <Summary>       *
+// *    gives the number of observables failing each check and the first of      *
+// *    them; the failing observables are listed individually only if            *
+// *    <Verbose/> is given.                                                     *
+// *                                                                             *
 // *    <Task>                                                                   *
 // *     <Action>DoChecks</Action>                                               *
 // *       <Type>TemporalCorrelatorMatrix</Type>                                 *
@@ -36,6 +48,7 @@ using namespace std;
 // *       <MaxTimeSep>25</MaxTimeSep>                                           *
 // *       <Verbose/>                        (optional)                          *
 // *       <OutlierScale>12.5</OutlierScale> (optional: default 9.5)             *
+// *       <NumberOfThreads>4</NumberOfThreads>  (optional)                      *
 // *    </Task>                                                                  *
 // *                                                                             *
 // *                                                                             *
@@ -50,6 +63,7 @@ using namespace std;
 // *       <MinTimeSep>3</MinTimeSep>                                            *
 // *       <MaxTimeSep>25</MaxTimeSep>                                           *
 // *       <Verbose/>                        (optional)                          *
+// *       <NumberOfThreads>4</NumberOfThreads>  (optional)                      *
 // *    </Task>                                                                  *
 // *                                                                             *
 // *                                                                             *
@@ -57,143 +71,230 @@ using namespace std;
 
 
 
-void do_obs_check(MCObsHandler *m_obs, const MCObsInfo& obskey, XMLHandler& xmlout,
-                  double outlier_scale, bool verbose, bool& checkflag)
+    //  Runs "check(k)" for k=0..n-1 on "nthreads" threads (0 means the
+    //  hardware concurrency).  The first error stops the remaining checks
+    //  and is rethrown here.
+
+template <typename CheckFunc>
+static void run_checks(uint n, uint nthreads, CheckFunc check)
 {
- if (!m_obs->queryBins(obskey)){
-    if (verbose){
-       XMLHandler xmlc; obskey.output(xmlc,false);
-       XMLHandler xmlres; xmlres.set_root("Missing");
-       xmlres.put_child(xmlc);
-       xmlout.put_sibling(xmlres);}
-    checkflag=false;}
- else{
-    const Vector<double>& bins=m_obs->getBins(obskey);
-    for (uint k=0;k<bins.size();k++)
-       if (std::isnan(bins[k])){
-          XMLHandler xmlc; obskey.output(xmlc,false);
-          XMLHandler xmlres; xmlres.set_root("NaNValuesPresent");
-          xmlres.put_child(xmlc);
-          xmlout.put_sibling(xmlres);
-          checkflag=false;
-          m_obs->eraseData(obskey);
-          return;}
-    Vector<uint> outliers;
-    getOutliers(bins,outliers,outlier_scale);
-    if (outliers.size()>0){
-       checkflag=false;
-       if (verbose){
-          XMLHandler xmlc; obskey.output(xmlc,false);
-          XMLHandler xmlres; xmlres.set_root("Outliers");
-          xmlres.put_child(xmlc);
-          xmlres.seek_first_child();
-          for (uint k=0;k<outliers.size();k++)
-             xmlres.put_sibling("SerialIndex",make_string(outliers[k]));
-          xmlout.put_sibling(xmlres);}}
-    m_obs->eraseData(obskey);}
+ if (nthreads==0) nthreads=thread::hardware_concurrency();
+ if (nthreads>n) nthreads=n;
+ if (nthreads==0) nthreads=1;
+ atomic<uint> next(0);
+ mutex errmutex;
+ string errmsg;
+ auto worker=[&](){
+    uint k;
+    while ((k=next++)<n){
+       try{
+          check(k);}
+       catch(const std::exception& xp){
+          lock_guard<mutex> lock(errmutex);
+          if (errmsg.empty()) errmsg=xp.what();
+          next=n;}}};
+ vector<thread> workers;
+ for (uint k=1;k<nthreads;k++)
+    workers.push_back(thread(worker));
+ worker();
+ for (uint k=0;k<workers.size();k++)
+    workers[k].join();
+ if (!errmsg.empty())
+    throw(std::runtime_error(errmsg));
 }
 
 
+    //  Copies the bins of "obskey" into "bins" and removes them from the
+    //  handler, returning false if they are not available.  Reading is
+    //  serialized by "iomutex"; the checks are then done on the copy.
 
-void do_snk_src_check(MCObsHandler *m_obs, const OperatorInfo& snk, const OperatorInfo& src,
-                      uint mintimesep, uint maxtimesep,
-                      XMLHandler& xmlout, bool verbose, uint& total, 
-                      uint& onesig, uint& twosig, uint& foursig, 
-                      uint& missing)
+static bool fetch_bins(MCObsHandler *m_obs, const MCObsInfo& obskey, RVector& bins,
+                       mutex& iomutex)
 {
- CorrelatorAtTimeInfo corA(snk,src,0,false,false);
- CorrelatorAtTimeInfo corB(src,snk,0,false,false);
- for (uint t=mintimesep;t<=maxtimesep;t++){
-    corA.resetTimeSeparation(t);
-    corB.resetTimeSeparation(t);
-    MCObsInfo obsAre(corA,RealPart);
-    MCObsInfo obsAim(corA,ImaginaryPart);
-    MCObsInfo obsBre(corB,RealPart);
-    MCObsInfo obsBim(corB,ImaginaryPart);
-    bool availA=m_obs->queryBins(obsAre)&&m_obs->queryBins(obsAim);
-    bool availB=m_obs->queryBins(obsBre)&&m_obs->queryBins(obsBim);
-    if ((!availA)&&(!availB)){
-       missing++;
-       if (verbose){
-          XMLHandler xmlsnk; snk.output(xmlsnk,false);
-          XMLHandler xmlsrc; src.output(xmlsrc,false);
-          XMLHandler xmlres; xmlres.set_root("MissingCorrelation");
-          xmlres.put_child(xmlsnk);
-          xmlres.put_child(xmlsrc);
-          xmlres.put_child("TimeSeparation",make_string(t));
-          xmlout.put_sibling(xmlres);}}
-    else if (availA && availB){
-       const Vector<double>& bufAre=m_obs->getBins(obsAre);
-       const Vector<double>& bufBre=m_obs->getBins(obsBre);
-       uint nbins=m_obs->getNumberOfBins();
-       Vector<double> buf(nbins);
-       for (uint k=0;k<nbins;k++){
-          buf[k]=bufAre[k]-bufBre[k];}
-       MCObsInfo oredif("RealPartDiff",0,true);
-       m_obs->putBins(oredif,buf);
-       MCEstimate mredif=m_obs->getJackknifeEstimate(oredif);
-       double df1=std::abs(mredif.getFullEstimate())/mredif.getSymmetricError();
-       total++;
-       if (df1>1.0) onesig++;
-       if (df1>2.0) twosig++;
-       if (df1>4.0) foursig++;
-       m_obs->eraseData(oredif);
-       const Vector<double>& bufAim=m_obs->getBins(obsAim);
-       const Vector<double>& bufBim=m_obs->getBins(obsBim);
-       for (uint k=0;k<nbins;k++){
-          buf[k]=bufAim[k]+bufBim[k];}
-       MCObsInfo oimsum("ImagPartSum",0,true);
-       m_obs->putBins(oimsum,buf);
-       MCEstimate mimsum=m_obs->getJackknifeEstimate(oimsum);
-       double df2=std::abs(mimsum.getFullEstimate())/mimsum.getSymmetricError();
-       total++;
-       if (df2>1.0) onesig++;
-       if (df2>2.0) twosig++;
-       if (df2>4.0) foursig++;
-       m_obs->eraseData(oimsum);
-       if (((df1>4.0)||(df2>4.0))&&(verbose)){
-          XMLHandler xmlsnk; snk.output(xmlsnk,false);
-          XMLHandler xmlsrc; src.output(xmlsrc,false);
-          XMLHandler xmlres; xmlres.set_root("Discrepancy");
-          xmlres.put_child(xmlsnk);
-          xmlres.put_child(xmlsrc);
-          xmlres.put_child("TimeSeparation",make_string(t));
-          xmlres.put_child("DiffRealPartRatio",make_string(df1));
-          xmlres.put_child("SumImagPartRatio",make_string(df2));
-          xmlout.put_sibling(xmlres);}}
-    m_obs->eraseData(obsAre);
-    m_obs->eraseData(obsAim);
-    m_obs->eraseData(obsBre);
-    m_obs->eraseData(obsBim);
-    }
+ lock_guard<mutex> lock(iomutex);
+ if (!m_obs->queryBins(obskey)) return false;
+ bins=m_obs->getBins(obskey);
+ m_obs->eraseData(obskey);
+ return true;
+}
+
+
+    //  A NaN or infinite value has all exponent bits set; testing the bits
+    //  instead of calling "std::isfinite" keeps the loop branch-free, so the
+    //  whole vector is scanned in one vectorized pass.
+
+static bool all_finite(const RVector& bins)
+{
+ const uint64_t expmask=0x7ff0000000000000ULL;
+ const double *x=&bins[0];
+ uint n=bins.size();
+ uint64_t bad=0;
+ for (uint k=0;k<n;k++){
+    uint64_t b;
+    memcpy(&b,x+k,sizeof(b));
+    bad|=((b&expmask)==expmask);}
+ return (bad==0);
 }
 
 
+    //  Results of the checks of one complex observable: missing data,
+    //  NaN or infinite values and outliers in the real and imaginary
+    //  parts, and (if "zerotest") whether it is consistent with zero.
+
+struct ObsCheck
+{
+ MCObsInfo obskey[2];           // real and imaginary parts
+ bool zerotest;
+ bool missing[2], nonfinite[2], zero;
+ Vector<uint> outliers[2];
+
+ ObsCheck(const MCObsInfo& key, bool ztest) : zerotest(ztest), zero(false)
+  {obskey[0]=key; obskey[0].setToRealPart();
+   obskey[1]=key; obskey[1].setToImaginaryPart();
+   missing[0]=missing[1]=nonfinite[0]=nonfinite[1]=false;}
+
+ bool failed() const
+  {return zero||missing[0]||missing[1]||nonfinite[0]||nonfinite[1]
+          ||(outliers[0].size()>0)||(outliers[1].size()>0);}
+};
+
 
-void is_obs_zero(MCObsHandler *m_obs, const MCObsInfo& obskey,
-                 XMLHandler& xmlout, bool& checkflag)
+static void do_obs_check(MCObsHandler *m_obs, ObsCheck& chk, double outlier_scale,
+                         mutex& iomutex)
 {
- MCObsInfo obskey1(obskey); obskey1.setToRealPart();
- MCObsInfo obskey2(obskey); obskey2.setToImaginaryPart();
- if ((!m_obs->queryBins(obskey1))&&(!m_obs->queryBins(obskey2))) return;
- double re_mean=0.0; double re_err=1.0;
- double im_mean=0.0; double im_err=1.0;
- if (m_obs->queryBins(obskey1)){
-    MCEstimate est=m_obs->getJackknifeEstimate(obskey1);
-    re_mean=std::abs(est.getFullEstimate());
-    re_err=est.getSymmetricError();}
- if (m_obs->queryBins(obskey2)){
-    MCEstimate est=m_obs->getJackknifeEstimate(obskey2);
-    im_mean=std::abs(est.getFullEstimate());
-    im_err=est.getSymmetricError();}
- if ((re_mean<=4.0*re_err)&&(im_mean<=4.0*im_err)){
-    checkflag=false;
-    XMLHandler xmlc; obskey.output(xmlc,false);
+ bool zero=chk.zerotest, avail=false;
+ RVector bins;
+ for (uint p=0;p<2;p++){
+    if (!fetch_bins(m_obs,chk.obskey[p],bins,iomutex)){
+       chk.missing[p]=true;
+       continue;}
+    avail=true;
+    if (!all_finite(bins)){
+       chk.nonfinite[p]=true;
+       zero=false;
+       continue;}
+    getOutliers(bins,chk.outliers[p],outlier_scale);
+    if (zero){
+       MCEstimate est=m_obs->getJackknifeEstimateFromBins(bins);
+       zero=(std::abs(est.getFullEstimate())<=4.0*est.getSymmetricError());}}
+ chk.zero=(zero)&&(avail);
+}
+
+
+static void output_obs_check(const ObsCheck& chk, XMLHandler& xmlout)
+{
+ for (uint p=0;p<2;p++){
+    XMLHandler xmlc; chk.obskey[p].output(xmlc,false);
+    XMLHandler xmlres;
+    if (chk.missing[p]){
+       xmlres.set_root("Missing");
+       xmlres.put_child(xmlc);}
+    else if (chk.nonfinite[p]){
+       xmlres.set_root("NaNValuesPresent");
+       xmlres.put_child(xmlc);}
+    else if (chk.outliers[p].size()>0){
+       xmlres.set_root("Outliers");
+       xmlres.put_child(xmlc);
+       xmlres.seek_first_child();
+       for (uint k=0;k<chk.outliers[p].size();k++)
+          xmlres.put_sibling("SerialIndex",make_string(chk.outliers[p][k]));}
+    else
+       continue;
+    xmlout.put_sibling(xmlres);}
+ if (chk.zero){
+    XMLHandler xmlc; chk.obskey[0].output(xmlc,false);
     XMLHandler xmlres; xmlres.set_root("Zero");
     xmlres.put_child(xmlc);
     xmlout.put_sibling(xmlres);}
- m_obs->eraseData(obskey1);
- m_obs->eraseData(obskey2);
+}
+
+
+    //  One row of the summary table: the number of observables failing
+    //  a check and the first of them
+
+static void add_summary_row(XMLHandler& xmls, const string& name, uint nfailed,
+                            const MCObsInfo *first)
+{
+ XMLHandler xmlr("Check");
+ xmlr.put_child("Name",name);
+ xmlr.put_child("NumberFailed",make_string(nfailed));
+ if (first!=0){
+    XMLHandler xmlc; first->output(xmlc,false);
+    XMLHandler xmlf("FirstFailed");
+    xmlf.put_child(xmlc);
+    xmlr.put_child(xmlf);}
+ xmls.put_child(xmlr);
+}
+
+
+static void output_summary(const vector<ObsCheck>& checks, XMLHandler& xmlout)
+{
+ uint nmissing=0, nnonfinite=0, noutliers=0, nzero=0;
+ const MCObsInfo *fmissing=0, *fnonfinite=0, *foutliers=0, *fzero=0;
+ for (uint k=0;k<checks.size();k++){
+    const ObsCheck& chk=checks[k];
+    for (uint p=0;p<2;p++){
+       if (chk.missing[p]){
+          if (nmissing++==0) fmissing=&chk.obskey[p];}
+       else if (chk.nonfinite[p]){
+          if (nnonfinite++==0) fnonfinite=&chk.obskey[p];}
+       else if (chk.outliers[p].size()>0){
+          if (noutliers++==0) foutliers=&chk.obskey[p];}}
+    if ((chk.zero)&&(nzero++==0)) fzero=&chk.obskey[0];}
+ XMLHandler xmls("Summary");
+ xmls.put_child("NumberOfObservables",make_string(2*checks.size()));
+ add_summary_row(xmls,"Missing",nmissing,fmissing);
+ add_summary_row(xmls,"NaNValuesPresent",nnonfinite,fnonfinite);
+ add_summary_row(xmls,"Outliers",noutliers,foutliers);
+ add_summary_row(xmls,"Zero",nzero,fzero);
+ xmlout.put_sibling(xmls);
+}
+
+
+    //  Results of the hermiticity check of one sink-source pair at one
+    //  time separation
+
+struct HermCheck
+{
+ const OperatorInfo *snk, *src;
+ uint tsep;
+ bool missing, tested;
+ double df1, df2;
+
+ HermCheck(const OperatorInfo& insnk, const OperatorInfo& insrc, uint t)
+   : snk(&insnk), src(&insrc), tsep(t), missing(false), tested(false),
+     df1(0.0), df2(0.0) {}
+};
+
+
+static void do_snk_src_check(MCObsHandler *m_obs, HermCheck& chk, mutex& iomutex)
+{
+ CorrelatorAtTimeInfo corA(*chk.snk,*chk.src,chk.tsep,false,false);
+ CorrelatorAtTimeInfo corB(*chk.src,*chk.snk,chk.tsep,false,false);
+ RVector bufAre, bufAim, bufBre, bufBim;
+ bool availA=fetch_bins(m_obs,MCObsInfo(corA,RealPart),bufAre,iomutex);
+ availA=fetch_bins(m_obs,MCObsInfo(corA,ImaginaryPart),bufAim,iomutex)&&availA;
+ bool availB;
+ if (chk.snk==chk.src){
+    bufBre=bufAre; bufBim=bufAim; availB=availA;}
+ else{
+    availB=fetch_bins(m_obs,MCObsInfo(corB,RealPart),bufBre,iomutex);
+    availB=fetch_bins(m_obs,MCObsInfo(corB,ImaginaryPart),bufBim,iomutex)&&availB;}
+ if ((!availA)&&(!availB)){
+    chk.missing=true;
+    return;}
+ if ((!availA)||(!availB)) return;
+ uint nbins=bufAre.size();
+ RVector buf(nbins);
+ for (uint k=0;k<nbins;k++)
+    buf[k]=bufAre[k]-bufBre[k];
+ MCEstimate mredif=m_obs->getJackknifeEstimateFromBins(buf);
+ chk.df1=std::abs(mredif.getFullEstimate())/mredif.getSymmetricError();
+ for (uint k=0;k<nbins;k++)
+    buf[k]=bufAim[k]+bufBim[k];
+ MCEstimate mimsum=m_obs->getJackknifeEstimateFromBins(buf);
+ chk.df2=std::abs(mimsum.getFullEstimate())/mimsum.getSymmetricError();
+ chk.tested=true;
 }
 
 
@@ -224,28 +325,28 @@ void TaskHandler::doChecks(XMLHandler& xmltask, XMLHandler& xmlout, int taskcoun
     xmlout.put_sibling("MinTimeSep",make_string(mintimesep));
     xmlout.put_sibling("MaxTimeSep",make_string(maxtimesep));
     xmlout.put_sibling("OutlierScale",make_string(outlier_scale));
-    vector<ComplexArg> args(2);
-    args[0]=RealPart; args[1]=ImaginaryPart;
+    uint nthreads=0;
+    xmlreadifchild(xmltask,"NumberOfThreads",nthreads);
+    vector<ObsCheck> checks;
     for (cormat.begin();!cormat.end();++cormat){
        const CorrelatorInfo& cor=cormat.getCurrentCorrelatorInfo();
        CorrelatorAtTimeInfo cort(cor,0,herm,false);
        for (uint t=mintimesep;t<=maxtimesep;t++){
           cort.resetTimeSeparation(t);
-          for (uint kk=0;kk<args.size();kk++){
-             MCObsInfo obskey(cort,args[kk]);
-             do_obs_check(m_obs,obskey,xmlout,outlier_scale,verbose,checkflag);}}
-       if (cor.isSinkSourceSame()){
-          cort.resetTimeSeparation(mintimesep);
-          MCObsInfo obskey(cort,RealPart);
-          is_obs_zero(m_obs,obskey,xmlout,checkflag);}}
+          bool ztest=(cor.isSinkSourceSame())&&(t==mintimesep);
+          checks.push_back(ObsCheck(MCObsInfo(cort,RealPart),ztest));}}
     if (vevs){
        const set<OperatorInfo>& vevops=cormat.getOperators();
-       for (set<OperatorInfo>::const_iterator it=vevops.begin();it!=vevops.end();it++){
-          for (uint kk=0;kk<args.size();kk++){
-             MCObsInfo obskey(*it,args[kk]);
-             do_obs_check(m_obs,obskey,xmlout,outlier_scale,verbose,checkflag);}
-             MCObsInfo obskey2(*it,RealPart);
-             is_obs_zero(m_obs,obskey2,xmlout,checkflag);}}
+       for (set<OperatorInfo>::const_iterator it=vevops.begin();it!=vevops.end();it++)
+          checks.push_back(ObsCheck(MCObsInfo(*it,RealPart),true));}
+    mutex iomutex;
+    run_checks(checks.size(),nthreads,[&](uint k){
+       do_obs_check(m_obs,checks[k],outlier_scale,iomutex);});
+    for (uint k=0;k<checks.size();k++){
+       if (checks[k].failed()){
+          checkflag=false;
+          if (verbose) output_obs_check(checks[k],xmlout);}}
+    output_summary(checks,xmlout);
     if (checkflag){
        xmlout.put_sibling("Status","All checks PASSED");}
     else{
@@ -275,11 +376,47 @@ void TaskHandler::doChecks(XMLHandler& xmltask, XMLHandler& xmlout, int taskcoun
     xmlout.put_sibling("MinTimeSep",make_string(mintimesep));
     xmlout.put_sibling("MaxTimeSep",make_string(maxtimesep));
     xmlout.put_sibling("Type","CheckIfHermitian");
+    uint nthreads=0;
+    xmlreadifchild(xmltask,"NumberOfThreads",nthreads);
     const set<OperatorInfo>& corrops=cormat.getOperators();
+    vector<HermCheck> checks;
     for (set<OperatorInfo>::const_iterator snk=corrops.begin();snk!=corrops.end();snk++)
-    for (set<OperatorInfo>::const_iterator src=snk;src!=corrops.end();src++){
-       do_snk_src_check(m_obs,*snk,*src,mintimesep,maxtimesep,xmlout,verbose,total, 
-                        onesig,twosig,foursig,missing);}
+    for (set<OperatorInfo>::const_iterator src=snk;src!=corrops.end();src++)
+    for (uint t=mintimesep;t<=maxtimesep;t++)
+       checks.push_back(HermCheck(*snk,*src,t));
+    mutex iomutex;
+    run_checks(checks.size(),nthreads,[&](uint k){
+       do_snk_src_check(m_obs,checks[k],iomutex);});
+    for (uint k=0;k<checks.size();k++){
+       const HermCheck& chk=checks[k];
+       if (chk.missing){
+          missing++;
+          if (verbose){
+             XMLHandler xmlsnk; chk.snk->output(xmlsnk,false);
+             XMLHandler xmlsrc; chk.src->output(xmlsrc,false);
+             XMLHandler xmlres; xmlres.set_root("MissingCorrelation");
+             xmlres.put_child(xmlsnk);
+             xmlres.put_child(xmlsrc);
+             xmlres.put_child("TimeSeparation",make_string(chk.tsep));
+             xmlout.put_sibling(xmlres);}}
+       else if (chk.tested){
+          total+=2;
+          if (chk.df1>1.0) onesig++;
+          if (chk.df1>2.0) twosig++;
+          if (chk.df1>4.0) foursig++;
+          if (chk.df2>1.0) onesig++;
+          if (chk.df2>2.0) twosig++;
+          if (chk.df2>4.0) foursig++;
+          if (((chk.df1>4.0)||(chk.df2>4.0))&&(verbose)){
+             XMLHandler xmlsnk; chk.snk->output(xmlsnk,false);
+             XMLHandler xmlsrc; chk.src->output(xmlsrc,false);
+             XMLHandler xmlres; xmlres.set_root("Discrepancy");
+             xmlres.put_child(xmlsnk);
+             xmlres.put_child(xmlsrc);
+             xmlres.put_child("TimeSeparation",make_string(chk.tsep));
+             xmlres.put_child("DiffRealPartRatio",make_string(chk.df1));
+             xmlres.put_child("SumImagPartRatio",make_string(chk.df2));
+             xmlout.put_sibling(xmlres);}}}
     XMLHandler xmls("Status");
     xmls.put_child("NumberMissing",make_string(missing));
     xmls.put_child("TotalNumberTests",make_string(total));
@@ -28,6 +28,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <TemporalCorrelatorFit>                                               *
 // *         <Operator>.... </Operator>                                          *
 // *         <SubtractVEV/>             (as appropriate)                         *
@@ -75,6 +76,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <LogTemporalCorrelatorFit>                                            *
 // *         <Operator>.... </Operator>                                          *
 // *         <SubtractVEV/>             (as appropriate)                         *
@@ -143,6 +145,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <TemporalCorrelatorInteractionRatioFit>                               *
 // *         <Ratio>                                                             *
 // *            <Operator>...</Operator>                                         *
@@ -209,6 +212,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <TwoTemporalCorrelatorFit>                                            *
 // *         <CorrelatorOne>                                                     *
 // *           <Operator>.... </Operator>                                        *
@@ -258,6 +262,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <NSimTemporalCorrelatorFit>                                           *
 // *         <Fits>                                                              *
 // *         <TemporalCorrelatorFit>                                             *
@@ -304,6 +309,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <TemporalCorrelatorTminVaryFit>                                       *
 // *         <Operator>.... </Operator>                                          *
 // *         <SubtractVEV/>             (as appropriate)                         *
@@ -370,6 +376,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <LogTemporalCorrelatorTminVaryFit>                                    *
 // *         <Operator>.... </Operator>                                          *
 // *         <SubtractVEV/>             (as appropriate)                         *
@@ -436,6 +443,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <TemporalCorrelatorInteractionRatioTminVaryFit>                       *
 // *         <Ratio>                                                             *
 // *            <Operator>...</Operator>                                         *
@@ -529,6 +537,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <DispersionFit>                                                       *
 // *         <SpatialExtentNumSites>24</SpatialExtentNumSites>                   *
 // *         <Energy>                                                            *
@@ -583,6 +592,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <AnisotropyFromDispersionFit>                                         *
 // *         <SpatialExtentNumSites>24</SpatialExtentNumSites>                   *
 // *         <Energy>                                                            *
@@ -635,6 +645,7 @@ using namespace std;
 // *       <SamplingMode>Bootstrap</SamplingMode>   (optional)                   *
 // *       <CovMatCalcSamplingMode>Bootstrap</CovMatCalcSamplingMode> (optional) *
 // *       <Uncorrelated/>  (optional) performs an uncorrelated fit              *
+// *       <LowRankCovariance/>  (optional) see note at end                      *
 // *       <LatticeDispersionRelationFit>                                        *
 // *         <SpatialExtentNumSites>24</SpatialExtentNumSites>                   *
 // *         <Energy>                                                            *
@@ -662,6 +673,20 @@ using namespace std;
 // *       </LatticeDispersionRelationFit>                                       *
 // *    </Task>                                                                  *
 // *                                                                             *
+// *    Note on <LowRankCovariance>:  for fits with many observables and         *
+// *    comparatively few resamplings, the covariance matrix is singular or      *
+// *    nearly so, and forming and inverting it costs O(nobs^3).  With           *
+// *                                                                             *
+// *       <LowRankCovariance>                                                   *
+// *          <DiagonalWeight>1e-3</DiagonalWeight>   (optional: 1e-3 default)   *
+// *       </LowRankCovariance>                                                  *
+// *                                                                             *
+// *    the covariance is replaced by the centered-samplings factor plus         *
+// *    DiagonalWeight times the variances on the diagonal, and its inverse      *
+// *    is applied with the Woodbury identity (see chisq_base.h).  Memory is     *
+// *    O(nobs*nsamplings) and each evaluation of the residuals costs            *
+// *    O(nobs*nsamplings).  This cannot be combined with <Uncorrelated/>.       *
+// *                                                                             *
 // *******************************************************************************
 
 
@@ -710,9 +735,20 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
        m_obs->setCovMatToJackknifeMode();}}
 
  bool uncorrelated=(xmltask.count_among_children("Uncorrelated")>0) ? true: false;
+ bool lowrank=(xmltask.count_among_children("LowRankCovariance")>0) ? true: false;
+ if ((uncorrelated)&&(lowrank))
+    throw(std::invalid_argument("Cannot have both Uncorrelated and LowRankCovariance in DoFit"));
  if (uncorrelated){
    m_obs->setToUnCorrelated();
    xmlout.put_child("Uncorrelated");}
+ else if (lowrank){
+   XMLHandler xmllr(xmltask,"LowRankCovariance");
+   double diag_weight=1e-3;
+   xmlreadifchild(xmllr,"DiagonalWeight",diag_weight);
+   m_obs->setToLowRankCorrelated(diag_weight);
+   XMLHandler xmllo("LowRankCovariance");
+   xmllo.put_child("DiagonalWeight",make_string(diag_weight));
+   xmlout.put_child(xmllo);}
  else
    m_obs->setToCorrelated();
 
@@ -1256,6 +1292,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
     if (xml_child_tag_count(xmlp,"UncorrelatedFitSymbolHollow")>0) uncorrelatedfit_hollow=true;
     vector<XYDYDYPoint> goodcorrelatedfits,gooduncorrelatedfits,badcorrelatedfits,baduncorrelatedfits;
     for (uint tmin=tminfirst;tmin<=tminlast;++tmin){
+       stream_task_output(xmlout);     // write previous fit to log
        xmltf.seek_unique("MinimumTimeSeparation");
        xmltf.seek_next_node();       
        xmltf.set_text_content(make_string(tmin)); 
@@ -1417,6 +1454,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
     if (xml_child_tag_count(xmlp,"UncorrelatedFitSymbolHollow")>0) uncorrelatedfit_hollow=true;
     vector<XYDYDYPoint> goodcorrelatedfits,gooduncorrelatedfits,badcorrelatedfits,baduncorrelatedfits;
     for (uint tmin=tminfirst;tmin<=tminlast;++tmin){
+       stream_task_output(xmlout);     // write previous fit to log
        xmltf.seek_unique("MinimumTimeSeparation");
        xmltf.seek_next_node();       
        xmltf.set_text_content(make_string(tmin)); 
@@ -1616,6 +1654,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
     if (xml_child_tag_count(xmlp,"UncorrelatedFitSymbolHollow")>0) uncorrelatedfit_hollow=true;
     vector<XYDYDYPoint> goodcorrelatedfits,gooduncorrelatedfits,badcorrelatedfits,baduncorrelatedfits;
     for (uint tmin=tminfirst;tmin<=tminlast;++tmin){
+       stream_task_output(xmlout);     // write previous fit to log
        xmltf.seek_unique("MinimumTimeSeparation");
        xmltf.seek_next_node();       
        xmltf.set_text_content(make_string(tmin)); 
@@ -2449,7 +2488,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
        Esq[k].yerr=est.getSymmetricError();
        if (Esq[k].xval<Esq[kmin].xval) kmin=k;
        if (Esq[k].xval>Esq[kmax].xval) kmax=k;}
-    MCObsInfo randtemp("RandomTemporary",0);
+    MCObsInfo randtemp("RandomTemporary",taskcount);
     doAnisoDispersionBySamplings(*m_obs,AFD.getAnisotropyKey(),AFD.getRestMassSquaredKey(), 
                             AFD.m_momsq_quantum*AFD.m_imomsq[kmin],randtemp);
     MCEstimate fit1=m_obs->getEstimate(randtemp);
@@ -2521,7 +2560,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
        Esq[k].yerr=est.getSymmetricError();
        if (Esq[k].xval<Esq[kmin].xval) kmin=k;
        if (Esq[k].xval>Esq[kmax].xval) kmax=k;}
-    MCObsInfo randtemp("RandomTemporary",0);
+    MCObsInfo randtemp("RandomTemporary",taskcount);
     doCoeffDispersionBySamplings(*m_obs,DF.getCoefficientKey(),DF.getRestMassSquaredKey(), 
                             DF.m_momsq_quantum*DF.m_imomsq[kmin],randtemp);
     MCEstimate fit1=m_obs->getEstimate(randtemp);
@@ -2594,7 +2633,7 @@ void TaskHandler::doFit(XMLHandler& xmltask, XMLHandler& xmlout, int taskcount)
        Esq[k].yerr=est.getSymmetricError();
        if (Esq[k].xval<Esq[kmin].xval) kmin=k;
        if (Esq[k].xval>Esq[kmax].xval) kmax=k;}
-    MCObsInfo randtemp("RandomTemporary",0);
+    MCObsInfo randtemp("RandomTemporary",taskcount);
     doAnisoDispersionBySamplings(*m_obs,AFD.getAnisotropyKey(),AFD.getRestMassSquaredKey(), 
                             AFD.m_momsq_quantum*AFD.m_imomsq[kmin],randtemp);
     MCEstimate fit1=m_obs->getEstimate(randtemp);
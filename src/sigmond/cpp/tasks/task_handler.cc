@@ -1,6 +1,7 @@
 #include "task_handler.h"
 // #include "stopwatch.h"
 #include "correlator_matrix_info.h"
+#include "obs_expression.h"
 using namespace std;
 using namespace LaphEnv;
 
@@ -9,7 +10,8 @@ using namespace LaphEnv;
      // set up the known tasks, create logfile, open stream for logging
 
 TaskHandler::TaskHandler(XMLHandler& xmlin)
-                       : m_bins_info(0), m_samp_info(0), m_getter(0), m_obs(0)
+                       : m_bins_info(0), m_samp_info(0), m_getter(0), m_obs(0),
+                         m_concurrent(false)
 {
  if (xmlin.get_node_name()!="SigMonD")
     throw(std::invalid_argument("Input file must have root tag <SigMonD>"));
@@ -51,9 +53,13 @@ TaskHandler::TaskHandler(XMLHandler& xmlin)
  else
     logfile=string("sigmond_log_")+nowstr+".xml";
 
- clog.open(logfile.c_str());
- if (!clog.is_open()){
-    cout << "Could not open log file "<<logfile<<" for output"<<endl;
+ bool compress=(xmli.count_among_children("CompressLog")>=1);
+ if ((compress)&&((logfile.length()<3)||(logfile.substr(logfile.length()-3)!=".gz")))
+    logfile+=".gz";
+ try{
+    clog.open(logfile,compress);}
+ catch(const std::exception& errmsg){
+    cout << errmsg.what()<<endl;
     throw(std::invalid_argument("Could not write to log file"));}
  clog << "<LogSigMonD>"<<endl;
 
@@ -73,6 +79,7 @@ TaskHandler::TaskHandler(XMLHandler& xmlin)
     input.erase(pos,string::npos);
     clog << " <InputXML>";
     clog << input<<"</InputXML>"<<endl;}
+ clog.flush();
 
  try{
     XMLHandler xmlr(xmli,"MCObservables");
@@ -83,13 +90,54 @@ TaskHandler::TaskHandler(XMLHandler& xmlin)
     throw(std::invalid_argument("Failure reading MCObservables and/or data"));}
 
  try{
-    m_obs=new MCObsHandler(*m_getter,boot_precompute);}
+    m_obs=new MCObsHandler(*m_getter,boot_precompute);
+    m_obs->setBatchedOutput(true);}
  catch(const std::exception& errmsg){
     delete m_getter; m_getter=0;
     clog << endl<<"<ERROR>"<<errmsg.what()<<"</ERROR>"<<endl<<endl;
     finish_log(); 
     throw(std::invalid_argument("Bad MCObsHandler construction"));}
 
+ if (xmli.count_among_children("MemoryLimitGB")==1){
+    double memlimit=0.0;
+    string spillstub;
+    xmlread(xmli,"MemoryLimitGB",memlimit,"TaskHandler");
+    xmlreadifchild(xmli,"SpillFileStub",spillstub);
+    m_obs->setMemoryLimit(memlimit,spillstub);
+    clog << " <MemoryLimitGB>"<<memlimit<<"</MemoryLimitGB>"<<endl;
+    clog.flush();}
+
+ if (xmli.count_among_children("SamplingsCacheDirectory")==1){
+    string cachedir;
+    xmlread(xmli,"SamplingsCacheDirectory",cachedir,"TaskHandler");
+    try{
+       m_obs->setSamplingsCache(cachedir);}
+    catch(const std::exception& errmsg){
+       clog << endl<<"<ERROR>"<<errmsg.what()<<"</ERROR>"<<endl<<endl;
+       finish_log();
+       throw(std::invalid_argument("Bad samplings cache"));}
+    clog << " <SamplingsCacheDirectory>"<<tidyString(cachedir)<<"</SamplingsCacheDirectory>"<<endl;
+    clog.flush();}
+
+ if (xmli.count_among_children("PlotWriters")==1){
+    uint nwriters=0;
+    xmlread(xmli,"PlotWriters",nwriters,"TaskHandler");
+    PlotWriter::setNumberOfWriters(nwriters);
+    clog << " <PlotWriters>"<<nwriters<<"</PlotWriters>"<<endl;
+    clog.flush();}
+
+ if (xmli.count_among_children("PlotHardCopy")==1){
+    string format;
+    xmlread(xmli,"PlotHardCopy",format,"TaskHandler");
+    try{
+       PlotWriter::setHardCopyFormat(tidyString(format));}
+    catch(const std::exception& errmsg){
+       clog << endl<<"<ERROR>"<<errmsg.what()<<"</ERROR>"<<endl<<endl;
+       finish_log();
+       throw(std::invalid_argument("Bad plot hardcopy format"));}
+    clog << " <PlotHardCopy>"<<tidyString(format)<<"</PlotHardCopy>"<<endl;
+    clog.flush();}
+
  m_task_map["ClearMemory"]=&TaskHandler::clearMemory;
  m_task_map["ClearSamplings"]=&TaskHandler::clearSamplings;
  m_task_map["EraseData"]=&TaskHandler::eraseData;
@@ -110,6 +158,7 @@ TaskHandler::TaskHandler(XMLHandler& xmlin)
 
  m_task_map["GetFromPivot"]=&TaskHandler::getFromPivot;
  m_task_map["DoRebinAnalysis"]=&TaskHandler::doRebinAnalysis;
+ m_task_map["DoAutocorrelationAnalysis"]=&TaskHandler::doAutocorrelationAnalysis;
 
 // m_ui=new UserInterface;
 }
@@ -130,8 +179,54 @@ TaskHandler::~TaskHandler()
 }
 
 
+    //  Waits until all plots submitted to the "PlotWriter" are on disk,
+    //  and logs the plots that could not be written or converted.
+
+void TaskHandler::finish_plots()
+{
+ list<string> errors;
+ PlotWriter::wait(errors);
+ for (list<string>::const_iterator it=errors.begin();it!=errors.end();++it){
+    XMLHandler xmle("PlotError",*it);
+    clog << xmle.output();}
+ if (!errors.empty()) clog.flush();
+}
+
+
+    //  Logs the records of the output files (written in the background
+    //  during a task) that could not be written.
+
+void TaskHandler::log_write_errors(list<string>& errors)
+{
+ for (list<string>::const_iterator it=errors.begin();it!=errors.end();++it){
+    XMLHandler xmle("WriteError",*it);
+    clog << xmle.output();}
+ errors.clear();
+}
+
+
+    //  Logs an exception that escaped a task run by the scheduler.
+
+void TaskHandler::log_task_exception(exception_ptr error)
+{
+ string msg("unknown exception");
+ try{
+    rethrow_exception(error);}
+ catch(const std::exception& xp){
+    msg=xp.what();}
+ catch(...){}
+ XMLHandler xmle("Error",string("Task did not complete: ")+msg);
+ clog << xmle.output();
+}
+
+
 void TaskHandler::finish_log()
 {
+ finish_plots();
+ if ((m_obs)&&(m_obs->hasSamplingsCache())){
+    XMLHandler xmlc;
+    m_obs->getSamplingsCacheInfo(xmlc);
+    clog << xmlc.output();}
  string nowstr=get_date_time();
  clog << " <FinishDateTime>"<<nowstr<<"</FinishDateTime>"<<endl;
  clog << "</LogSigMonD>"<<endl<<endl;
@@ -143,19 +238,116 @@ void TaskHandler::do_batch_tasks(XMLHandler& xmlin)
 {
  XMLHandler xmlt(xmlin,"TaskSequence");
  list<XMLHandler> taskxml=xmlt.find_among_children("Task");
- int count=0;
+ uint nthreads=1;
+ xmlreadifchild(xmlt,"NumberOfThreads",nthreads);
+ vector<uint> counts(taskxml.size());
+ for (uint k=0;k<counts.size();++k) counts[k]=k;
  clog << endl<<"<BeginTasks>****************************************</BeginTasks>"<<endl;
- for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();it++,count++){
+ do_task_list(taskxml,counts,nthreads);
+}
+
+
+    //  Carries out the tasks in "taskxml"; "counts" are their positions in
+    //  the <TaskSequence>, which are used in the log.
+
+void TaskHandler::do_task_list(list<XMLHandler>& taskxml, const vector<uint>& counts,
+                               uint nthreads)
+{
+ if ((nthreads>1)&&(taskxml.size()>1)){
+    do_concurrent_tasks(taskxml,counts,nthreads);
+    finish_plots();
+    return;}
+ uint k=0;
+ for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();it++,k++){
     clog << endl<<"<Task>"<<endl;
-    clog << " <Count>"<<count<<"</Count>"<<endl;
+    clog << " <Count>"<<counts[k]<<"</Count>"<<endl;
+    clog.flush();
     XMLHandler xmlout;
     //StopWatch rolex; rolex.start();
-    do_task(*it,xmlout,count);
+    m_obs->beginTask();
+    do_task(*it,xmlout,counts[k]);
+    list<string> writeerrs;
+    m_obs->flushOutputFiles(writeerrs);
     // rolex.stop();
-    clog << xmlout.output()<<endl;
+    clog.finish_element(xmlout);
+    clog << endl;
+    log_write_errors(writeerrs);
+    if (m_obs->getMemoryLimit()>0.0){
+       XMLHandler xmlres;
+       m_obs->getResidencyInfo(xmlres);
+       clog << xmlres.output();}
    //  clog << "<RunTimeInSeconds>"<<rolex.getTimeInSeconds()<<"</RunTimeInSeconds>"<<endl;
     clog << "</Task>"<<endl;
+    clog.flush();
+}
+ finish_plots();
 }
+
+
+    //  Each task gets its own copy of its input XML since XMLDoc
+    //  objects are not safe to share between threads.  The output of
+    //  each task is kept until all earlier tasks have been logged.
+
+void TaskHandler::do_concurrent_tasks(const list<XMLHandler>& taskxml, 
+                                      const vector<uint>& counts, uint nthreads)
+{
+ TaskScheduler scheduler(taskxml);
+ XMLHandler xmls;
+ scheduler.output(xmls);
+ xmls.put_child("NumberOfThreads",make_string(nthreads));
+ clog << endl << xmls.output();
+ clog.flush();
+
+ uint ntasks=scheduler.getNumberOfTasks();
+ vector<XMLHandler> xmlins(ntasks), xmlouts(ntasks), xmlres(ntasks);
+ vector<list<string> > writeerrs(ntasks);
+ uint k=0;
+ for (list<XMLHandler>::const_iterator it=taskxml.begin();it!=taskxml.end();++it,++k)
+    xmlins[k].set(*it,XMLHandler::subtree_copy);
+
+ m_concurrent=true;
+ scheduler.execute(nthreads,
+    [&](uint count, bool in_worker){
+       if (in_worker){
+          m_obs->attachThread();
+          ObsExpression::setThreadDefaultThreads(1);}   // workers already fill the cores
+       else m_obs->beginTask();    // no other task is running
+       try{
+          do_task(xmlins[count],xmlouts[count],counts[count]);
+          m_obs->flushThreadOutputFiles(writeerrs[count]);}   // only this task's files
+       catch(...){
+          if (in_worker){
+             ObsExpression::setThreadDefaultThreads(0);
+             m_obs->detachThread();}
+          throw;}
+       if (in_worker){
+          ObsExpression::setThreadDefaultThreads(0);
+          m_obs->detachThread();}
+       else if (m_obs->getMemoryLimit()>0.0) m_obs->getResidencyInfo(xmlres[count]);},
+    [&](uint count, exception_ptr error){
+       clog << endl<<"<Task>"<<endl;
+       clog << " <Count>"<<counts[count]<<"</Count>"<<endl;
+       clog.finish_element(xmlouts[count]);
+       clog << endl;
+       if (error) log_task_exception(error);
+       log_write_errors(writeerrs[count]);
+       if (!xmlres[count].empty()) clog << xmlres[count].output();
+       clog << "</Task>"<<endl;
+       clog.flush();
+       xmlouts[count].clear();
+       xmlres[count].clear();
+       xmlins[count].clear();});
+ m_concurrent=false;
+ list<string> writeerrs_left;    // files written by threads other than the tasks'
+ m_obs->flushOutputFiles(writeerrs_left);
+ log_write_errors(writeerrs_left);
+}
+
+
+void TaskHandler::stream_task_output(XMLHandler& xml_out)
+{
+ if (m_concurrent) return;   // output is written in order once the task is done
+ clog.stream_element(xml_out);
 }
 
 
@@ -204,6 +396,7 @@ string TaskHandler::get_date_time()
 
 void TaskHandler::clear_task_data()
 {
+ lock_guard<mutex> lock(m_task_data_mutex);
  for (map<string,TaskHandlerData*>::iterator it
       =m_task_data_map.begin();it!=m_task_data_map.end();it++)
     delete it->second;
@@ -213,6 +406,7 @@ void TaskHandler::clear_task_data()
 
 void TaskHandler::erase_task_data(const string& tdname)
 {
+ lock_guard<mutex> lock(m_task_data_mutex);
  string taskname=tidyName(tdname);
  map<string,TaskHandlerData*>::iterator it=m_task_data_map.find(taskname);
  if (it!=m_task_data_map.end()){
@@ -225,6 +419,7 @@ void TaskHandler::erase_task_data(const string& tdname)
 
 void TaskHandler::insert_task_data(const std::string& tdname, TaskHandlerData* tdata)
 {
+ lock_guard<mutex> lock(m_task_data_mutex);
  string taskname=tidyName(tdname);
  if (taskname.empty()){
     throw(std::invalid_argument("Cannot insert task data since name is invalid"));}
@@ -240,6 +435,7 @@ void TaskHandler::insert_task_data(const std::string& tdname, TaskHandlerData* t
 
 TaskHandlerData* TaskHandler::get_task_data(const string& tdname)
 {
+ lock_guard<mutex> lock(m_task_data_mutex);
  string taskname=tidyName(tdname);
  if (taskname.empty()) return 0;
  map<string,TaskHandlerData*>::iterator it=m_task_data_map.find(taskname);
@@ -346,6 +542,7 @@ void TaskHandler::readFromFile(XMLHandler &xmltask, XMLHandler& xmlout, int task
    //      <FileName>name_of_file</FileName>
    //      <FileFormat>fstr</FileFormat> (or hdf5: default if absent)
    //      <WriteMode>overwrite</WriteMode>   (optional: protect, or update, overwrite) 
+   //      <SinglePrecision/>   (optional: bins only, store in single precision)
    //      <MCObservable>...</MCObservable>   (these are needed)
    //      <MCObservable>...</MCObservable>
    //   </Task>
@@ -373,13 +570,16 @@ void TaskHandler::writeToFile(XMLHandler &xmltask, XMLHandler& xmlout, int taskc
     fmode=tidyString(fmode);
     if (fmode=="overwrite") wmode=Overwrite;
     else if (fmode=="update") wmode=Update;}
+ bool single=(xmltask.count_among_children("SinglePrecision")>0);
+ if ((single)&&(type!="bins"))
+    throw(std::invalid_argument("<SinglePrecision> only allowed for bins in WriteToFile"));
  list<XMLHandler> xmlh=xmltask.find("MCObservable");
  set<MCObsInfo> obskeys;
  for (list<XMLHandler>::iterator tt=xmlh.begin();tt!=xmlh.end();tt++){
        obskeys.insert(MCObsInfo(*tt));}
  XMLHandler xmlf;
  if (type=="bins")
-    m_obs->writeBinsToFile(obskeys,filename,xmlf,wmode,ffmt);
+    m_obs->writeBinsToFile(obskeys,filename,xmlf,wmode,ffmt,single);
  else
     m_obs->writeSamplingValuesToFile(obskeys,filename,xmlf,wmode,ffmt);
  xmlout.put_child(xmlf);
@@ -391,6 +591,7 @@ void TaskHandler::writeToFile(XMLHandler &xmltask, XMLHandler& xmlout, int taskc
    //       <FileName>name_of_file</FileName>
    //       <FileFormat>fstr</FileFormat> (or hdf5: default if absent)
    //       <WriteMode>overwrite</WriteMode>   (optional: default protect, update, overwrite) 
+   //       <SinglePrecision/>   (optional: bins only, store in single precision)
    //   <CorrelatorMatrixInfo>
    //     <BLOperatorString>....</BLOperatorString>
    //      ....
@@ -427,6 +628,9 @@ void TaskHandler::writeCorrMatToFile(XMLHandler &xmltask, XMLHandler& xmlout, in
     fmode=tidyString(fmode);
     if (fmode=="overwrite") wmode=Overwrite;
     else if (fmode=="update") wmode=Update;}
+ bool single=(xmltask.count_among_children("SinglePrecision")>0);
+ if ((single)&&(type!="bins"))
+    throw(std::invalid_argument("<SinglePrecision> only allowed for bins in WriteCorrMatToFile"));
  uint tmin,tmax;
  xmlreadchild(xmltask,"MinTimeSep",tmin,"WriteCorrMatToFile");
  xmlreadchild(xmltask,"MaxTimeSep",tmax,"WriteCorrMatToFile");
@@ -461,7 +665,7 @@ void TaskHandler::writeCorrMatToFile(XMLHandler &xmltask, XMLHandler& xmlout, in
        }}
  XMLHandler xmlf;
  if (type=="bins")
-    m_obs->writeBinsToFile(obskeys,filename,xmlf,wmode,ffmt);
+    m_obs->writeBinsToFile(obskeys,filename,xmlf,wmode,ffmt,single);
  else
     m_obs->writeSamplingValuesToFile(obskeys,filename,xmlf,wmode,ffmt);
  xmlout.put_child(xmlf);
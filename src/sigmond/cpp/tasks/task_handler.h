@@ -6,9 +6,13 @@
 #include "mcobs_handler.h"
 #include "mcobs_info.h"
 #include "obs_get_handler.h"
+#include "log_writer.h"
+#include "task_scheduler.h"
+#include "plot_writer.h"
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <mutex>
 //#include "user_interface.h"
 #include "minimizer.h"
 
@@ -47,6 +51,12 @@ class TaskHandlerData;  // base class for persistent data
 // *       <Initialize>                                                         *
 // *         <ProjectName>NameOfProject</ProjectName>                           * 
 // *         <LogFile>output.log</LogFile>                                      *
+// *         <CompressLog/>    (optional)                                       *
+// *         <MemoryLimitGB>200</MemoryLimitGB>  (optional)                     *
+// *         <SpillFileStub>/scratch/spill</SpillFileStub>  (optional)          *
+// *         <SamplingsCacheDirectory>dir</SamplingsCacheDirectory> (optional)  *
+// *         <PlotWriters>4</PlotWriters>  (optional)                           *
+// *         <PlotHardCopy>eps</PlotHardCopy>  (optional)                       *
 // *         <KnownEnsemblesFile>/path/ensembles.xml</KnownEnsemblesFile> (optional)  *
 // *         <EchoXML/>                                                         *
 // *         <MCBinsInfo>  ...  </MCBinsInfo>                                   *
@@ -55,6 +65,7 @@ class TaskHandlerData;  // base class for persistent data
 // *       </Initialize>                                                        *
 // *                                                                            *
 // *       <TaskSequence>                                                       *
+// *         <NumberOfThreads>4</NumberOfThreads>  (optional)                   *
 // *         <Task><Action>...</Action> ...  </Task>                            *
 // *         <Task><Action>...</Action> ...  </Task>                            *
 // *           ....                                                             *
@@ -66,6 +77,10 @@ class TaskHandlerData;  // base class for persistent data
 // *   (a) If <ProjectName> is missing, a default name will be created.         *
 // *                                                                            *
 // *   (b) If <LogFile> is missing, a default name for the log file is used.    *
+// *       The log is written as the tasks proceed (see "XMLLogWriter"), so     *
+// *       the output of all completed tasks is on disk even if the job is      *
+// *       killed.  If <CompressLog/> is present, the log is gzip compressed    *
+// *       and ".gz" is appended to the file name if not already present.       *
 // *                                                                            *
 // *   (c) If <EchoXML> is missing, the input XML will not be written to the    *
 // *       log file.                                                            *
@@ -161,6 +176,76 @@ class TaskHandlerData;  // base class for persistent data
 // *   The <Action> tag must be a string in the "m_task_map".  The remaining    *
 // *   XML depends on the action being taken.                                   *
 // *                                                                            *
+// *   (i) If <NumberOfThreads> is larger than one, tasks which do not depend   *
+// *       on each other are carried out concurrently on that many threads.     *
+// *       See "TaskScheduler" in "task_scheduler.h" for how the dependencies   *
+// *       are determined and how a <Task> can declare them.  The log still     *
+// *       lists the tasks in the input order.  The default is one thread.      *
+// *                                                                            *
+// *   (j) If <MemoryLimitGB> is given, the bins and samplings kept in memory   *
+// *       are limited to about that many gigabytes: data not used by the       *
+// *       current task is removed from memory, least recently used first.      *
+// *       Data that can be read again from the input files is dropped; other   *
+// *       data is written to scratch files whose names begin with the          *
+// *       <SpillFileStub> (default "sigmond_spill") and read back when needed. *
+// *       The memory use is reported in each <Task> of the log.  See           *
+// *       "MCObsHandler" for details.  When tasks run concurrently, the        *
+// *       memory use is reported only for barrier tasks.                       *
+// *                                                                            *
+// *   (k) If <SamplingsCacheDirectory> is given, the jackknife and bootstrap   *
+// *       samplings computed from bins are stored in files in that directory   *
+// *       and reused by later runs with the same bins and sampling info,       *
+// *       instead of being recomputed.  The directory is created if needed.    *
+// *       The number of cache hits is reported at the end of the log.  See     *
+// *       "SamplingsCache" in "samplings_cache.h".                             *
+// *                                                                            *
+// *   (l) "sigmond_batch --shards N" carries out the tasks in up to N child    *
+// *       processes ("shards") instead of in one process.  Each <Task> can     *
+// *       declare a shard key:                                                 *
+// *                                                                            *
+// *         <Task>                                                             *
+// *           <Action>DoFit</Action>                                           *
+// *           <ShardKey>T1up_P000</ShardKey>                                   *
+// *           ...                                                              *
+// *         </Task>                                                            *
+// *                                                                            *
+// *       All tasks with the same key are carried out in order by the same     *
+// *       shard; the distinct keys are dealt out to the shards in order of     *
+// *       first appearance.  Tasks before the first task with a key are done   *
+// *       by the main process before the shards are started, so data they      *
+// *       read (such as bins) is shared by all shards through the copy-on-     *
+// *       write memory of "fork".  A task must not need the results of a       *
+// *       task with a different key.  Each shard writes its own log, and       *
+// *       writes samplings files under its own names (see "MCObsHandler").     *
+// *       When all shards have finished, the main process copies the output    *
+// *       of the tasks into the log in the input order, then merges the        *
+// *       samplings files into the requested files: the write mode of the      *
+// *       first write by the first shard is used, and the other shards add     *
+// *       to the file.  A record written by more than one shard is copied      *
+// *       once if the data agree, and is an error otherwise.  Other output     *
+// *       files, such as bins files and plots, must have different names in    *
+// *       different shards.  Tasks without a key that come after the first     *
+// *       task with a key are then done once by the main process, after the    *
+// *       merge; they can read the merged samplings files, but not the data    *
+// *       the shards kept in memory.                                           *
+// *                                                                            *
+// *   (m) Plots are written as xmgrace project files without running grace.    *
+// *       If <PlotWriters> is larger than zero, the plot files are written     *
+// *       by that many background threads while the tasks proceed; all plots   *
+// *       are on disk at the end of the <TaskSequence>, and failures are       *
+// *       then reported in <PlotError> tags.  If <PlotHardCopy> is given       *
+// *       ("eps", "ps", "pdf", "png", "jpg" or "svg"), each plot file is       *
+// *       also converted to that format by running "gracebat"; with            *
+// *       <PlotWriters>, no more than that many conversions run at once.       *
+// *       See "PlotWriter" in "plot_writer.h".                                 *
+// *                                                                            *
+// *   (n) Bins and samplings files written by a task stay open until the       *
+// *       task is done, and their records are written by a background          *
+// *       thread, so a task that writes to the same file many times does not   *
+// *       reopen it each time.  The files are complete before the next task    *
+// *       starts; records that could not be written are then reported in       *
+// *       <WriteError> tags in the output of the task.  See "MCObsHandler".    *
+// *                                                                            *
 // *                                                                            *
 // ******************************************************************************
 
@@ -173,11 +258,13 @@ class TaskHandler
    MCObsGetHandler *m_getter;
    MCObsHandler *m_obs;
    //UserInterface *m_ui;
-   std::ofstream clog;
+   XMLLogWriter clog;
 
    typedef void (TaskHandler::*task_ptr)(XMLHandler&, XMLHandler&, int);
    std::map<std::string, task_ptr>    m_task_map;
    std::map<std::string, TaskHandlerData*> m_task_data_map;
+   std::mutex m_task_data_mutex;
+   bool m_concurrent;     // true while tasks are run by the TaskScheduler
 
        // Prevent copying ... handler might contain large
        // amounts of data
@@ -199,6 +286,8 @@ class TaskHandler
 
    void do_batch_tasks(XMLHandler& xmlin);
 
+   void do_sharded_tasks(XMLHandler& xmlin, uint nshards);
+
    void clear_task_data();
    void erase_task_data(const std::string& tdname);
    void insert_task_data(const std::string& tdname, TaskHandlerData* tdata);
@@ -209,8 +298,35 @@ class TaskHandler
 
    void do_task(XMLHandler& xml_in, XMLHandler& output, int taskcount);
 
+   void do_task_list(std::list<XMLHandler>& taskxml, const std::vector<uint>& counts,
+                     uint nthreads);
+
+   void do_concurrent_tasks(const std::list<XMLHandler>& taskxml,
+                            const std::vector<uint>& counts, uint nthreads);
+
+       // sharded runs (see "task_shards.cc")
+
+   void run_shard(uint shard, std::list<XMLHandler>& taskxml,
+                  const std::vector<int>& owner, uint nthreads,
+                  const std::string& shardlog);
+
+   void merge_shard_samplings(const std::vector<XMLHandler>& shardfiles,
+                              XMLHandler& xmlout);
+
+       // Tasks producing large output (such as tmin scans) can call this
+       // to write the children of "output" completed so far to the log
+       // and release them from memory.
+
+   void stream_task_output(XMLHandler& output);
+
    std::string get_date_time();
 
+   void finish_plots();
+
+   void log_write_errors(std::list<std::string>& errors);
+
+   void log_task_exception(std::exception_ptr error);
+
    void finish_log();
 
 
@@ -236,6 +352,7 @@ class TaskHandler
 
    void getFromPivot(XMLHandler& xml_in, XMLHandler& output, int taskcount);
    void doRebinAnalysis(XMLHandler& xml_in, XMLHandler& output, int taskcount);
+   void doAutocorrelationAnalysis(XMLHandler& xml_in, XMLHandler& output, int taskcount);
 
        // Utility subroutines
 
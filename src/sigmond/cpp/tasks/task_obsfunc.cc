@@ -336,6 +336,34 @@ using namespace std;
 // *                      (or Bootstrap or Jackknife or bins )                   *
 // *    </Task>                                                                  *
 // *                                                                             *
+// *      For any function of observables given by an arithmetic expression.     *
+// *      Each <Variable> gives the symbol used for an observable in the         *
+// *      expression; each optional <Parameter> gives a symbol for a constant.   *
+// *      Allowed are numbers, the symbols, + - * / ^ (power), parentheses,      *
+// *      and the functions sqrt, exp, log, abs, pow(x,y).  The expression is    *
+// *      evaluated over all bins or all samplings at once.                      *
+// *                                                                             *
+// *    <Task>                                                                   *
+// *     <Action>DoObsFunction</Action>                                          *
+// *       <Type>Expression</Type>                                               *
+// *       <Result>                                                              *
+// *          <Name>result-name</Name><IDIndex>0</IDIndex>                       *
+// *       </Result>                                                             *
+// *       <Expression>sqrt(m*m+p/(xi*xi))-E</Expression>                        *
+// *       <Variable>                                                            *
+// *          <Symbol>m</Symbol><MCObservable> ... </MCObservable>               *
+// *       </Variable>                                                           *
+// *       <Variable>                                                            *
+// *          <Symbol>xi</Symbol><MCObservable> ... </MCObservable>              *
+// *       </Variable>                                                           *
+// *       <Variable>                                                            *
+// *          <Symbol>E</Symbol><MCObservable> ... </MCObservable>               *
+// *       </Variable>                                                           *
+// *       <Parameter><Symbol>p</Symbol><Value>0.0385</Value></Parameter>        *
+// *       <Mode>samplings</Mode> (default: current sampling method)             *
+// *                      (or Bootstrap or Jackknife or bins )                   *
+// *    </Task>                                                                  *
+// *                                                                             *
 // *                                                                             *
 // *                                                                             *
 // *******************************************************************************
@@ -1507,6 +1535,89 @@ void TaskHandler::doObsFunction(XMLHandler& xmltask, XMLHandler& xmlout, int tas
                 +string(errmsg.what())));}
     }
 
+ else if (functype=="Expression"){
+    xmlout.set_root("DoObsFunction");
+    xmlout.put_child("Type","Expression");
+    try{
+    string expression;
+    xmlreadchild(xmltask,"Expression",expression);
+    xmlout.put_child("Expression",expression);
+    list<XMLHandler> xmlvars=xmltask.find_among_children("Variable");
+    vector<string> varnames;
+    vector<MCObsInfo> varinfos;
+    XMLHandler xmlt1,xmlt2;
+    for (list<XMLHandler>::iterator it=xmlvars.begin();it!=xmlvars.end();it++){
+       string symbol;
+       xmlreadchild(*it,"Symbol",symbol);
+       MCObsInfo obskey(*it);
+       varnames.push_back(tidyString(symbol));
+       varinfos.push_back(obskey);
+       xmlt1.set_root("Variable");
+       xmlt1.put_child("Symbol",varnames.back());
+       obskey.output(xmlt2);
+       xmlt1.put_child(xmlt2);
+       xmlout.put_child(xmlt1);}
+    list<XMLHandler> xmlpars=xmltask.find_among_children("Parameter");
+    map<string,double> params;
+    for (list<XMLHandler>::iterator it=xmlpars.begin();it!=xmlpars.end();it++){
+       string symbol;
+       double value;
+       xmlreadchild(*it,"Symbol",symbol);
+       xmlreadchild(*it,"Value",value);
+       if (!params.insert(make_pair(tidyString(symbol),value)).second)
+          throw(std::invalid_argument(string("Duplicate parameter ")+symbol));
+       xmlt1.set_root("Parameter");
+       xmlt1.put_child("Symbol",tidyString(symbol));
+       xmlt1.put_child("Value",make_string(value));
+       xmlout.put_child(xmlt1);}
+    ObsExpression expr(expression,varnames,params);
+
+    string datamode="samplings";
+    xmlreadifchild(xmltask,"Mode",datamode);
+    char mcode;
+    if (datamode=="bins") mcode='D';
+    else if (datamode=="Bootstrap") mcode='B';
+    else if (datamode=="Jackknife") mcode='J';
+    else if (datamode=="samplings"){
+       if (m_obs->isJackknifeMode()){
+          mcode='J'; datamode="Jackknife";}
+       else{
+          mcode='B'; datamode="Bootstrap";}}
+    else throw(std::invalid_argument("Invalid Sampling Mode"));
+    xmlout.put_child("Mode",datamode);
+
+    XMLHandler xmlres(xmltask,"Result");
+    string name; int index;
+    xmlreadchild(xmlres,"Name",name);
+    if (name.empty()) throw(std::invalid_argument("Must provide name for Expression result"));
+    index=taskcount;
+    xmlreadifchild(xmlres,"IDIndex",index);
+    MCObsInfo resinfo(name,index,mcode=='D');
+    xmlt1.set_root("ResultInfo");
+    resinfo.output(xmlt2);
+    xmlt1.put_child(xmlt2);
+    xmlout.put_child(xmlt1);
+
+    if (mcode=='D'){
+       doExpressionByBins(*m_obs,expr,varinfos,resinfo);
+       MCEstimate est=m_obs->getEstimate(resinfo);
+       est.output(xmlt1);
+       xmlout.put_child(xmlt1);}
+    else{
+       SamplingMode origmode=m_obs->getCurrentSamplingMode();
+       if (mcode=='J') m_obs->setToJackknifeMode();
+       else m_obs->setToBootstrapMode();
+       doExpressionBySamplings(*m_obs,expr,varinfos,resinfo);
+       MCEstimate est=m_obs->getEstimate(resinfo);
+       est.output(xmlt1);
+       xmlout.put_child(xmlt1);
+       m_obs->setSamplingMode(origmode);} }
+    catch(const std::exception& errmsg){
+       xmlout.clear();
+       throw(std::invalid_argument(string("DoObsFunction with type Expression encountered an error: ")
+                +string(errmsg.what())));}
+    }
+
  else{
     throw(std::invalid_argument("DoObsFunction encountered unsupported function: "));}
 
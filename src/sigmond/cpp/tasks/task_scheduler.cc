@@ -0,0 +1,230 @@
+#include "task_scheduler.h"
+#include <sstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+using namespace std;
+
+// *************************************************************************
+
+
+TaskScheduler::TaskScheduler(const list<XMLHandler>& taskxml)
+{
+ m_tasks.resize(taskxml.size());
+ uint k=0;
+ for (list<XMLHandler>::const_iterator it=taskxml.begin();it!=taskxml.end();++it,++k){
+    TaskInfo& info=m_tasks[k];
+    XMLHandler xmlt(*it);
+    info.barrier=true;
+    info.declared=false;
+    xmlreadifchild(xmlt,"Action",info.action);
+    info.action=tidyString(info.action);
+    if (xmlt.count_among_children("Dependencies")==1)
+       read_labels(xmlt,info);
+    else
+       infer_labels(xmlt,info);
+
+       //  a task must wait for every earlier task it conflicts with
+
+    for (uint j=0;j<k;++j)
+       if (conflict(m_tasks[j],info)) info.prereqs.push_back(j);}
+}
+
+
+void TaskScheduler::read_labels(XMLHandler& xmltask, TaskInfo& info)
+{
+ XMLHandler xmld(xmltask,"Dependencies");
+ string labels;
+ if (xmlreadifchild(xmld,"Reads",labels)){
+    istringstream rin(labels);
+    string label;
+    while (rin >> label) info.reads.insert(label);}
+ labels.clear();
+ if (xmlreadifchild(xmld,"Writes",labels)){
+    istringstream win(labels);
+    string label;
+    while (win >> label) info.writes.insert(label);}
+ info.barrier=false;
+ info.declared=true;
+}
+
+
+static bool ends_with(const string& str, const string& suffix)
+{
+ return (str.length()>=suffix.length())
+      &&(str.compare(str.length()-suffix.length(),suffix.length(),suffix)==0);
+}
+
+
+void TaskScheduler::infer_labels(XMLHandler& xmltask, TaskInfo& info)
+{
+ if (info.action=="DoFit"){
+    string fittype;
+    xmlreadifchild(xmltask,"Type",fittype);
+    fittype=tidyString(fittype);
+    if ((fittype!="TemporalCorrelator")&&(fittype!="TemporalCorrelatorTminVary")
+      &&(fittype!="TemporalCorrelatorTmaxVary")&&(fittype!="TwoTemporalCorrelator")
+      &&(fittype!="NSimTemporalCorrelator")&&(fittype!="NSimTemporalCorrelatorTminVary")
+      &&(fittype!="NSimTemporalCorrelatorTmaxVary"))
+       return;}
+ else if (info.action!="DoPlot")
+    return;
+
+ info.barrier=false;
+ info.reads.insert("MCData");
+ bool fit=(info.action=="DoFit");
+ XMLHandler xmlh(xmltask,XMLHandler::subtree_pointer);
+ xmlh.set_exceptions_off();
+ xmlh.seek_root();
+ for (xmlh.seek_next_node();xmlh.good();xmlh.seek_next_node()){
+    if ((xmlh.is_text_valued())||(!xmlh.is_simple_element())) continue;
+    string tag(xmlh.get_node_name());
+    string text(tidyString(xmlh.get_text_content()));
+    if ((tag=="Name")||(tag=="ObsName")||(tag=="AssignName")){
+       if (text.empty()) continue;
+       info.reads.insert(text);
+       if (fit) info.writes.insert(text);}
+    else if (ends_with(tag,"File")||ends_with(tag,"FileName")||ends_with(tag,"FileStub")){
+       if (!text.empty()) info.writes.insert(string("file:")+text);}}
+
+     //  samplings of priors are stored under names that depend only on
+     //  the prior mean and width, so fits with priors are serialized
+
+ if ((fit)&&(xmltask.count("Priors")>0))
+    info.writes.insert("Priors");
+}
+
+
+bool TaskScheduler::conflict(const TaskInfo& first, const TaskInfo& second)
+{
+ if ((first.barrier)||(second.barrier)) return true;
+ for (set<string>::const_iterator it=first.writes.begin();it!=first.writes.end();++it)
+    if ((second.reads.count(*it)>0)||(second.writes.count(*it)>0)) return true;
+ for (set<string>::const_iterator it=second.writes.begin();it!=second.writes.end();++it)
+    if (first.reads.count(*it)>0) return true;
+ return false;
+}
+
+
+void TaskScheduler::output(XMLHandler& xmlout) const
+{
+ xmlout.set_root("TaskScheduler");
+ for (uint k=0;k<m_tasks.size();++k){
+    const TaskInfo& info=m_tasks[k];
+    XMLHandler xmlt("Task");
+    xmlt.put_child("Count",make_string(k));
+    xmlt.put_child("Action",info.action);
+    if (info.barrier){
+       xmlt.put_child("Barrier");}
+    else{
+       xmlt.put_child("Dependencies",(info.declared)?"declared":"inferred");
+       if (!info.prereqs.empty()){
+          ostringstream oss;
+          for (uint j=0;j<info.prereqs.size();++j){
+             if (j>0) oss << " ";
+             oss << info.prereqs[j];}
+          xmlt.put_child("After",oss.str());}}
+    xmlout.put_child(xmlt);}
+}
+
+
+    //  The calling thread hands out tasks whose prerequisites have all
+    //  finished to the worker threads, runs the barriers itself, and
+    //  calls "finish_task" in the input order.  An exception thrown by
+    //  "run_task" is kept and handed to "finish_task" for that task.
+
+void TaskScheduler::execute(uint nthreads,
+                            const function<void(uint,bool)>& run_task,
+                            const function<void(uint,exception_ptr)>& finish_task) const
+{
+ uint ntasks=m_tasks.size();
+ if (nthreads<1) nthreads=1;
+
+ vector<uint> npending(ntasks);
+ vector<vector<uint> > successors(ntasks);
+ for (uint k=0;k<ntasks;++k){
+    npending[k]=m_tasks[k].prereqs.size();
+    for (uint j=0;j<m_tasks[k].prereqs.size();++j)
+       successors[m_tasks[k].prereqs[j]].push_back(k);}
+
+ vector<exception_ptr> errors(ntasks);
+ mutex mtx;
+ condition_variable work_cv, done_cv;
+ deque<uint> work_queue, done_queue;
+ bool stop=false;
+
+ vector<thread> workers;
+ for (uint t=0;t<nthreads;++t)
+    workers.push_back(thread([&](){
+       while (true){
+          uint k;
+          {unique_lock<mutex> lock(mtx);
+           work_cv.wait(lock,[&](){return stop||!work_queue.empty();});
+           if (work_queue.empty()) return;
+           k=work_queue.front(); work_queue.pop_front();}
+          try{ run_task(k,true);}
+          catch(...){ errors[k]=current_exception();}
+          {lock_guard<mutex> lock(mtx);
+           done_queue.push_back(k);}
+          done_cv.notify_one();}}));
+
+ vector<bool> started(ntasks,false), finished(ntasks,false);
+ uint nextready=0;      // all tasks before this one have been started
+ uint nextfinish=0;     // all tasks before this one have been finished and logged
+ uint nrunning=0;
+ deque<uint> completed;
+
+ while (nextfinish<ntasks){
+
+       //  start every task whose prerequisites are done
+
+    for (uint k=nextready;k<ntasks;++k){
+       if ((started[k])||(npending[k]>0)) continue;
+       started[k]=true;
+       if (m_tasks[k].barrier){
+          try{ run_task(k,false);}   // all other tasks are finished or waiting
+          catch(...){ errors[k]=current_exception();}
+          completed.push_back(k);
+          break;}
+       {lock_guard<mutex> lock(mtx);
+        work_queue.push_back(k);}
+       work_cv.notify_one();
+       ++nrunning;}
+    while ((nextready<ntasks)&&(started[nextready])) ++nextready;
+
+       //  wait for a worker if nothing finished inline
+
+    if ((completed.empty())&&(nrunning>0)){
+       unique_lock<mutex> lock(mtx);
+       done_cv.wait(lock,[&](){return !done_queue.empty();});
+       while (!done_queue.empty()){
+          completed.push_back(done_queue.front());
+          done_queue.pop_front();
+          --nrunning;}}
+    if ((completed.empty())&&(nrunning==0)) break;   // cannot happen
+
+    while (!completed.empty()){
+       uint k=completed.front(); completed.pop_front();
+       finished[k]=true;
+       for (uint j=0;j<successors[k].size();++j)
+          --npending[successors[k][j]];}
+
+       //  output in the input order
+
+    while ((nextfinish<ntasks)&&(finished[nextfinish])){
+       finish_task(nextfinish,errors[nextfinish]);
+       errors[nextfinish]=nullptr;
+       ++nextfinish;}}
+
+ {lock_guard<mutex> lock(mtx);
+  stop=true;}
+ work_cv.notify_all();
+ for (uint t=0;t<workers.size();++t)
+    workers[t].join();
+}
+
+
+// *************************************************************************
@@ -0,0 +1,127 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <string>
+#include <set>
+#include <list>
+#include <vector>
+#include <functional>
+#include <exception>
+#include "xml_handler.h"
+
+// ******************************************************************************
+// *                                                                            *
+// *   The class "TaskScheduler" determines which of the <Task> elements in a   *
+// *   <TaskSequence> can be carried out concurrently, and runs them on a pool  *
+// *   of threads.  Each task is assigned a set of "labels" that it reads and   *
+// *   a set of labels that it writes.  Two tasks conflict if one writes a      *
+// *   label that the other reads or writes.  A task is started only after      *
+// *   all earlier conflicting tasks have finished, so the results are the      *
+// *   same as running the tasks in order.                                      *
+// *                                                                            *
+// *   The labels of a task can be declared in the task XML:                    *
+// *                                                                            *
+// *      <Task>                                                                *
+// *         <Action>...</Action>                                               *
+// *         <Dependencies>                                                     *
+// *            <Reads>MCData E0 E1</Reads>                                     *
+// *            <Writes>A0 file:plot_A0.agr</Writes>                            *
+// *         </Dependencies>                                                    *
+// *         ...                                                                *
+// *      </Task>                                                               *
+// *                                                                            *
+// *   Labels are separated by white space.  Usually a label is the name of     *
+// *   an observable (as in <Name> or <ObsName> tags), but any string without   *
+// *   spaces can be used.  The label "MCData" stands for all data which is     *
+// *   not named in this way: correlators, vevs, rotated correlators, and so    *
+// *   on.  Output files are labelled "file:" followed by the file name.        *
+// *                                                                            *
+// *   If <Dependencies> is absent, the labels are inferred for the following   *
+// *   tasks:                                                                   *
+// *                                                                            *
+// *     DoFit of type TemporalCorrelator, TwoTemporalCorrelator,               *
+// *       NSimTemporalCorrelator, and their TminVary/TmaxVary variants:        *
+// *       reads "MCData"; reads and writes the text of every <Name>,           *
+// *       <ObsName> and <AssignName> tag in the task; writes "file:..." for    *
+// *       each tag whose name ends in "File", "FileName" or "FileStub"; fits   *
+// *       with <Priors> also write the label "Priors".                         *
+// *                                                                            *
+// *     DoPlot: reads "MCData" and the names as above; writes the files.       *
+// *                                                                            *
+// *   All other tasks are "barriers": a barrier starts only after all          *
+// *   earlier tasks have finished, and no later task starts before the         *
+// *   barrier has finished.  Barriers are run by the calling thread.           *
+// *                                                                            *
+// *   Usage:                                                                   *
+// *                                                                            *
+// *     list<XMLHandler> taskxml=...;                                          *
+// *     TaskScheduler TS(taskxml);                                             *
+// *     TS.execute(nthreads,run_task,finish_task);                             *
+// *                                                                            *
+// *   "run_task(k,in_worker)" carries out task "k"; "in_worker" is false if    *
+// *   it is called by the thread calling "execute".  "finish_task(k,error)"    *
+// *   is called by the thread calling "execute" once task "k" and all tasks    *
+// *   before it have finished, so output can be written in the input order.    *
+// *   If "run_task" threw, "error" holds the exception (otherwise it is        *
+// *   null); the other tasks go on.                                            *
+// *                                                                            *
+// ******************************************************************************
+
+
+class TaskScheduler
+{
+
+   struct TaskInfo
+   {
+      std::string action;
+      bool barrier;
+      bool declared;                   // labels given in <Dependencies>
+      std::set<std::string> reads;
+      std::set<std::string> writes;
+      std::vector<uint> prereqs;       // earlier tasks that must finish first
+   };
+
+   std::vector<TaskInfo> m_tasks;
+
+#ifndef NO_CXX11
+   TaskScheduler() = delete;
+   TaskScheduler(const TaskScheduler&) = delete;
+   TaskScheduler& operator=(const TaskScheduler&) = delete;
+#else
+   TaskScheduler();
+   TaskScheduler(const TaskScheduler&);
+   TaskScheduler& operator=(const TaskScheduler&);
+#endif
+
+ public:
+
+   TaskScheduler(const std::list<XMLHandler>& taskxml);
+
+   ~TaskScheduler() {}
+
+   uint getNumberOfTasks() const {return m_tasks.size();}
+
+   bool isBarrier(uint taskindex) const {return m_tasks.at(taskindex).barrier;}
+
+   const std::vector<uint>& getPrerequisites(uint taskindex) const
+    {return m_tasks.at(taskindex).prereqs;}
+
+   void output(XMLHandler& xmlout) const;
+
+   void execute(uint nthreads,
+                const std::function<void(uint,bool)>& run_task,
+                const std::function<void(uint,std::exception_ptr)>& finish_task) const;
+
+ private:
+
+   void read_labels(XMLHandler& xmltask, TaskInfo& info);
+
+   void infer_labels(XMLHandler& xmltask, TaskInfo& info);
+
+   static bool conflict(const TaskInfo& first, const TaskInfo& second);
+
+};
+
+
+// ******************************************************************************
+#endif
@@ -0,0 +1,332 @@
+#include "task_handler.h"
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// *************************************************************************
+// *                                                                       *
+// *   Sharded execution of a <TaskSequence> in child processes, as        *
+// *   requested by "sigmond_batch --shards N".  See item (l) in the       *
+// *   comments of "task_handler.h" for how tasks are assigned to shards.  *
+// *                                                                       *
+// *   The main process carries out the setup tasks, then forks one child  *
+// *   per shard.  A child reopens the input files, writes its log to      *
+// *   "<logfile>.shard<k>", carries out its tasks with their original     *
+// *   <Count> values, writes the list of samplings files it produced at   *
+// *   the end of its log, and exits without running any destructors       *
+// *   (the open files it inherited belong to the main process).  The      *
+// *   main process waits for all children, copies the <Task> output of    *
+// *   the shard logs into its own log in the input order, and merges the  *
+// *   samplings files.  Shard logs and files are removed once merged;     *
+// *   those of a failed shard are kept for inspection.  Finally, the      *
+// *   main process carries out the tasks without a key that come after    *
+// *   the first task with a key.                                          *
+// *                                                                       *
+// *************************************************************************
+
+
+    //  A shard log is a sequence of elements with no root element, so it
+    //  is read inside a <ShardLog> root.  The log of a shard that was
+    //  killed can end in the middle of a task; it is then read up to the
+    //  end of its last complete <Task>.
+
+static bool read_shard_log(const string& filename, XMLHandler& xmllog)
+{
+ ifstream fin(filename.c_str());
+ if (!fin) return false;
+ ostringstream text;
+ text << fin.rdbuf();
+ string str(text.str());
+ try{
+    xmllog.set_from_string("<ShardLog>"+str+"</ShardLog>");
+    return true;}
+ catch(const std::exception& xp){}
+ size_t pos=str.rfind("</Task>");
+ if (pos==string::npos) return false;
+ try{
+    xmllog.set_from_string("<ShardLog>"+str.substr(0,pos+7)+"</ShardLog>");
+    return true;}
+ catch(const std::exception& xp){}
+ return false;
+}
+
+
+    //  Owner of each task:  -2 = main process (setup), -1 = main process
+    //  after the merge, otherwise the shard index.
+
+void TaskHandler::do_sharded_tasks(XMLHandler& xmlin, uint nshards)
+{
+ if (nshards==0)
+    throw(std::invalid_argument("Number of shards must be positive"));
+ XMLHandler xmlt(xmlin,"TaskSequence");
+ list<XMLHandler> taskxml=xmlt.find_among_children("Task");
+ uint nthreads=1;
+ xmlreadifchild(xmlt,"NumberOfThreads",nthreads);
+ uint ntasks=taskxml.size();
+
+ vector<int> owner(ntasks,-2);
+ map<string,uint> keyshard;
+ vector<string> shardkeys(nshards);
+ vector<uint> shardtasks(nshards,0);
+ uint nkeys=0, nfinal=0;
+ uint k=0;
+ for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();++it,++k){
+    string key;
+    xmlreadifchild(*it,"ShardKey",key);
+    key=tidyString(key);
+    if (key.empty()){
+       if (nkeys>0){ owner[k]=-1; ++nfinal;}
+       continue;}
+    map<string,uint>::const_iterator kt=keyshard.find(key);
+    if (kt==keyshard.end()){
+       uint shard=nkeys%nshards;
+       kt=keyshard.insert(make_pair(key,shard)).first;
+       if (!shardkeys[shard].empty()) shardkeys[shard]+=" ";
+       shardkeys[shard]+=key;
+       ++nkeys;}
+    owner[k]=kt->second;
+    ++shardtasks[kt->second];}
+
+ if (nkeys==0){    // nothing to shard
+    do_batch_tasks(xmlin);
+    return;}
+ uint nused=(nkeys<nshards)?nkeys:nshards;
+
+ clog << endl<<"<BeginTasks>****************************************</BeginTasks>"<<endl;
+
+    // setup tasks, done before forking so their data is shared
+
+ list<XMLHandler> setupxml;
+ vector<uint> setupcounts;
+ k=0;
+ for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();++it,++k)
+    if (owner[k]==-2){ setupxml.push_back(*it); setupcounts.push_back(k);}
+ do_task_list(setupxml,setupcounts,nthreads);
+
+ XMLHandler xmls("Shards");
+ xmls.put_child("NumberOfShards",make_string(nused));
+ xmls.put_child("NumberOfSetupTasks",make_string(uint(setupxml.size())));
+ xmls.put_child("NumberOfFinalTasks",make_string(nfinal));
+ for (uint shard=0;shard<nused;++shard){
+    XMLHandler xmlsh("Shard");
+    xmlsh.put_child("Index",make_string(shard));
+    xmlsh.put_child("ShardKeys",shardkeys[shard]);
+    xmlsh.put_child("NumberOfTasks",make_string(shardtasks[shard]));
+    xmls.put_child(xmlsh);}
+ clog << endl << xmls.output();
+ m_obs->beginTask();      // flushes the samplings cache
+ clog.flush();
+ cout.flush();
+
+ vector<string> shardlogs(nused);
+ vector<pid_t> pids(nused,-1);
+ for (uint shard=0;shard<nused;++shard){
+    shardlogs[shard]=clog.getFileName()+".shard"+make_string(shard);
+    pid_t pid=fork();
+    if (pid==0)
+       run_shard(shard,taskxml,owner,nthreads,shardlogs[shard]);   // does not return
+    pids[shard]=pid;}
+
+ XMLHandler xmlm("ShardResults");
+ vector<bool> success(nused,false);
+ for (uint shard=0;shard<nused;++shard){
+    XMLHandler xmlsh("Shard");
+    xmlsh.put_child("Index",make_string(shard));
+    if (pids[shard]<0){
+       xmlsh.put_child("Error","Could not create the process");}
+    else{
+       int status=0;
+       waitpid(pids[shard],&status,0);
+       if ((WIFEXITED(status))&&(WEXITSTATUS(status)==0)){
+          success[shard]=true;
+          xmlsh.put_child("Status","done");}
+       else if (WIFEXITED(status))
+          xmlsh.put_child("Error","Shard process failed with exit status "
+                          +make_string(int(WEXITSTATUS(status))));
+       else
+          xmlsh.put_child("Error","Shard process was killed by signal "
+                          +make_string(int(WTERMSIG(status))));}
+    xmlm.put_child(xmlsh);}
+
+    // locate the <Task> output in each shard log, and read the
+    // list of samplings files written
+
+ vector<map<uint,XMLHandler> > blocks(nused);
+ vector<XMLHandler> shardfiles(nused);
+ for (uint shard=0;shard<nused;++shard){
+    XMLHandler xmllog;
+    if (!read_shard_log(shardlogs[shard],xmllog)){
+       xmlm.put_child("ShardError","shard "+make_string(shard)+": could not read its log");
+       continue;}
+    list<XMLHandler> xmlt=xmllog.find_among_children("Task");
+    for (list<XMLHandler>::iterator it=xmlt.begin();it!=xmlt.end();++it){
+       uint count;
+       if (xmlreadifchild(*it,"Count",count)) blocks[shard][count]=*it;}
+    list<XMLHandler> xmle=xmllog.find_among_children("ShardError");
+    for (list<XMLHandler>::iterator it=xmle.begin();it!=xmle.end();++it)
+       xmlm.put_child("ShardError","shard "+make_string(shard)+": "+it->get_text_content());
+    list<XMLHandler> xmlp=xmllog.find_among_children("PlotError");
+    for (list<XMLHandler>::iterator it=xmlp.begin();it!=xmlp.end();++it)
+       xmlm.put_child("PlotError","shard "+make_string(shard)+": "+it->get_text_content());
+    if ((success[shard])&&(xml_child_tag_count(xmllog,"ShardSamplingFiles")==1))
+       shardfiles[shard].set(XMLHandler(xmllog,"ShardSamplingFiles"),XMLHandler::subtree_copy);}
+
+    // copy the task output into the log in the input order
+
+ for (k=0;k<ntasks;++k){
+    if (owner[k]<0) continue;
+    uint shard=owner[k];
+    map<uint,XMLHandler>::const_iterator bt=blocks[shard].find(k);
+    if (bt==blocks[shard].end()){
+       clog << endl<<"<Task>"<<endl;
+       clog << " <Count>"<<k<<"</Count>"<<endl;
+       clog << "<Error>Shard "<<shard<<" did not complete this task</Error>"<<endl;
+       clog << "</Task>"<<endl;
+       clog.flush();
+       continue;}
+    clog << endl<<"<Task>"<<endl;
+    clog << " <Count>"<<k<<"</Count>"<<endl;
+    XMLHandler xmlc(bt->second);
+    xmlc.set_exceptions_off();
+    xmlc.seek_first_child();
+    while (xmlc.good()){
+       if (xmlc.get_node_name()!="Count") clog << xmlc.output_current() << endl;
+       xmlc.seek_next_sibling();}
+    clog << "</Task>"<<endl;
+    clog.flush();}
+
+ XMLHandler xmlf;
+ merge_shard_samplings(shardfiles,xmlf);
+ xmlm.put_child(xmlf);
+ clog << endl << xmlm.output();
+ clog.flush();
+
+ for (uint shard=0;shard<nused;++shard)
+    if (success[shard]) std::remove(shardlogs[shard].c_str());
+
+    // tasks without a key after the first key, done once on the merged files
+
+ list<XMLHandler> finalxml;
+ vector<uint> finalcounts;
+ k=0;
+ for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();++it,++k)
+    if (owner[k]==-1){ finalxml.push_back(*it); finalcounts.push_back(k);}
+ if (!finalxml.empty()){
+    m_obs->beginTask();
+    do_task_list(finalxml,finalcounts,nthreads);}
+}
+
+
+    //  Carried out by the child process for shard "shard".  Never returns.
+
+void TaskHandler::run_shard(uint shard, list<XMLHandler>& taskxml,
+                            const vector<int>& owner, uint nthreads,
+                            const string& shardlog)
+{
+ int status=0;
+ try{
+    clog.detach();
+    clog.open(shardlog);
+    try{
+       m_obs->beginShard(shard);
+       list<XMLHandler> shardxml;
+       vector<uint> counts;
+       uint k=0;
+       for (list<XMLHandler>::iterator it=taskxml.begin();it!=taskxml.end();++it,++k)
+          if (owner[k]==int(shard)){
+             shardxml.push_back(*it); counts.push_back(k);}
+       do_task_list(shardxml,counts,nthreads);
+       XMLHandler xmlf;
+       m_obs->getShardSamplingFiles(xmlf);
+       clog << endl << xmlf.output();}
+    catch(const std::exception& xp){
+       XMLHandler xmle("ShardError",string(xp.what()));
+       clog << endl << xmle.output();
+       status=1;}
+    clog.close();}
+ catch(const std::exception& xp){
+    cout << "Shard "<<shard<<" error: "<<xp.what()<<endl;
+    status=1;}
+ cout.flush();
+ _exit(status);
+}
+
+
+    //  Copies the records of the shard samplings files into the requested
+    //  files.  Files from the first shard that wrote them use the recorded
+    //  write mode; later shards add to the file.  A record already copied
+    //  from another shard is skipped if its data is the same, and is an
+    //  error (without stopping the copy of the other records) if not.  A
+    //  shard file is removed once all of its records have been copied.
+
+void TaskHandler::merge_shard_samplings(const vector<XMLHandler>& shardfiles,
+                                        XMLHandler& xmlout)
+{
+ xmlout.set_root("MergeSamplingFiles");
+ set<string> started, failedpaths, shardpaths;
+ map<string,map<MCObsInfo,size_t> > merged;    // hash of the data copied
+ for (uint shard=0;shard<shardfiles.size();++shard){
+    if (shardfiles[shard].empty()) continue;
+    XMLHandler xmlsf(shardfiles[shard]);
+    list<XMLHandler> files=xmlsf.find_among_children("File");
+    for (list<XMLHandler>::iterator it=files.begin();it!=files.end();++it){
+       string fname, sname, fmode, fformat;
+       xmlreadchild(*it,"FileName",fname,"TaskHandler");
+       xmlreadchild(*it,"ShardFileName",sname,"TaskHandler");
+       xmlreadchild(*it,"WriteMode",fmode,"TaskHandler");
+       xmlreadchild(*it,"FileFormat",fformat,"TaskHandler");
+       WriteMode wmode=(fmode=="overwrite")?Overwrite:((fmode=="update")?Update:Protect);
+       if ((!started.insert(fname).second)&&(wmode==Overwrite)) wmode=Update;
+       string spath=sname.substr(0,sname.find('['));
+       shardpaths.insert(spath);
+       XMLHandler xmle("File");
+       xmle.put_child("FileName",fname);
+       xmle.put_child("ShardFileName",sname);
+       uint nrec=0, ndup=0, nerr=0;
+       map<MCObsInfo,size_t>& mergedkeys=merged[fname];
+       try{
+          set<string> snames; snames.insert(sname);
+          SamplingsGetHandler SG(m_obs->getBinsInfo(),m_obs->getSamplingInfo(),
+                                 snames,m_getter->useCheckSums());
+          SamplingsPutHandler SP(m_obs->getBinsInfo(),m_obs->getSamplingInfo(),fname,
+                                 wmode,m_getter->useCheckSums(),fformat.empty()?'D':fformat[0]);
+          set<MCObsInfo> keys=SG.getKeys();
+          for (set<MCObsInfo>::const_iterator kt=keys.begin();kt!=keys.end();++kt){
+             Vector<double> buffer;
+             SG.getData(*kt,buffer);
+             const vector<double>& vbuf=buffer.c_vector();
+             size_t hash=std::hash<string>()(string((const char*)vbuf.data(),
+                                                     vbuf.size()*sizeof(double)));
+             map<MCObsInfo,size_t>::const_iterator mt=mergedkeys.find(*kt);
+             if (mt!=mergedkeys.end()){
+                if (mt->second==hash){ ++ndup; continue;}
+                ++nerr;
+                xmle.put_child("Error","Different data for "+kt->str()+" in another shard");
+                continue;}
+             try{
+                SP.putData(*kt,buffer);
+                mergedkeys.insert(make_pair(*kt,hash));
+                ++nrec;}
+             catch(const std::exception& xp){
+                ++nerr;
+                xmle.put_child("Error",string(xp.what()));}}
+          xmle.put_child("NumberOfRecords",make_string(nrec));
+          if (ndup>0) xmle.put_child("NumberOfDuplicates",make_string(ndup));
+          if (nerr>0) failedpaths.insert(spath);}
+       catch(const std::exception& xp){
+          failedpaths.insert(spath);
+          xmle.put_child("NumberOfRecords",make_string(nrec));
+          xmle.put_child("Error",string(xp.what()));}
+       xmlout.put_child(xmle);}}
+ for (set<string>::const_iterator it=shardpaths.begin();it!=shardpaths.end();++it)
+    if (failedpaths.find(*it)==failedpaths.end()) std::remove(it->c_str());
+}
+
+// *************************************************************************
@@ -326,7 +326,7 @@ void getCorrelatorEstimates(MCObsHandler *moh, const CorrelatorInfo& corr,
     MCObsInfo obskey(corrtv,arg);
     try{
        if (moh->queryFullAndSamplings(obskey,mode)){
-          MCEstimate est=moh->getEstimate(obskey,mode);
+          MCEstimate est=moh->getUnstoredEstimate(obskey,mode);
           results.insert(make_pair(double(tval),est));}}
     catch(const std::exception& xp){}} 
 }
@@ -578,7 +578,7 @@ void getDiagonalCorrelatorsAtTimeEstimates(MCObsHandler *moh,
  for (set<OperatorInfo>::const_iterator snk=corrops.begin();snk!=corrops.end();snk++,row++){
     CorrelatorAtTimeInfo corrt(*snk,*snk,timeval,herm,subtract_vevs);
     MCObsInfo obskey(corrt,RealPart);
-    corrdiag_estimates[row]=moh->getEstimate(obskey);}}
+    corrdiag_estimates[row]=moh->getUnstoredEstimate(obskey);}}
  catch(const std::exception& errmsg){
     corrdiag_estimates.clear();
     throw(std::invalid_argument(string("Error in getDiagonalCorrelatorsAtTimeEstimates: ")
@@ -607,6 +607,20 @@ void getDiagonalCorrelatorsAtTimeEstimates(MCObsHandler *moh,
    //  with efftype 0 and 1, and somewhat redundant with efftypes 2,3).
 
 
+    //  Samplings of "obskey" for "getEffectiveEnergy", held in "window"
+    //  instead of the handler (unless already in the handler).
+
+static const RVector& getWindowedSamplings(MCObsHandler *moh, const MCObsInfo& obskey,
+                                           SamplingMode mode, map<MCObsInfo,RVector>& window)
+{
+ map<MCObsInfo,RVector>::const_iterator it=window.find(obskey);
+ if (it!=window.end()) return it->second;
+ RVector buffer;
+ const RVector& samps=moh->getUnstoredFullAndSamplingValues(obskey,buffer,mode);
+ return window.insert(make_pair(obskey,samps)).first->second;
+}
+
+
 void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
                   bool hermitian, bool subtract_vev, ComplexArg arg,
                   SamplingMode mode, uint step,
@@ -615,9 +629,6 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
 {
  results.clear();
  EffectiveEnergyCalculator effcalc(step,moh->getLatticeTimeExtent(),efftype);
- string effname("EffEn_");
- // effname+=currDateTimeString();
- MCObsInfo effkey(effname);
  moh->setSamplingMode(mode);
 
            //  get correlators into memory
@@ -653,9 +664,14 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
 	&& ((!moh->queryFullAndSamplings(src_re_info))||(!moh->queryFullAndSamplings(snk_re_info))))
       return;
 #endif
+       // samplings already in memory are not rewritten, since other
+       // threads may be reading them
     for (uint tval=0;tval<moh->getLatticeTimeExtent();tval++){
        corrt.resetTimeSeparation(tval);
-       if (moh->queryBins(MCObsInfo(corrt,arg))) tavail.insert(tval);}
+       corrtv.resetTimeSeparation(tval);
+       if ((moh->queryBins(MCObsInfo(corrt,arg)))
+           &&(!moh->queryFullAndSamplingsInMemory(MCObsInfo(corrtv,arg))))
+          tavail.insert(tval);}
     for (moh->begin();!moh->end();++(*moh)){
        double vev=0.0;
        double src_re=moh->getCurrentSamplingValue(src_re_info);
@@ -677,10 +693,13 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
           double corrval=moh->getCurrentSamplingValue(obskey)-vev;
           moh->putCurrentSamplingValue(MCObsInfo(corrtv,arg),corrval,true);}}}
 
-   //  now compute the effective energy
+   //  now compute the effective energy; the correlator samplings are
+   //  kept in "window" only while still needed
 
  CorrelatorAtTimeInfo corrt(corr,0,hermitian,subtract_vev);
  CorrelatorAtTimeInfo corrtstep(corr,0,hermitian,subtract_vev);
+ map<MCObsInfo,RVector> window;
+ RVector effsamps;
  double effenergy;
  if (efftype<2){
     for (uint tval=0;tval<moh->getLatticeTimeExtent();tval++){
@@ -688,19 +707,21 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
        corrtstep.resetTimeSeparation(tval+step);
        MCObsInfo obskey1(corrt,arg);
        MCObsInfo obskey2(corrtstep,arg);
-       effkey.resetObsIndex(tval);
        if (moh->queryFullAndSamplings(obskey1)&&moh->queryFullAndSamplings(obskey2)){
         try{
-          for (moh->begin();!moh->end();++(*moh)){
-             double cval1=moh->getCurrentSamplingValue(obskey1)-subtract_const;
-             double cval2=moh->getCurrentSamplingValue(obskey2)-subtract_const;
+          const RVector& corr1=getWindowedSamplings(moh,obskey1,mode,window);
+          const RVector& corr2=getWindowedSamplings(moh,obskey2,mode,window);
+          effsamps.resize(corr1.size());
+          for (uint k=0;k<effsamps.size();++k){
+             double cval1=corr1[k]-subtract_const;
+             double cval2=corr2[k]-subtract_const;
              if (effcalc.calculate(effenergy,tval,cval1,cval2))
-                moh->putCurrentSamplingValue(effkey,effenergy,true);
+                effsamps[k]=effenergy;
              else throw(std::runtime_error("Could not compute effective energy"));}
-          MCEstimate est=moh->getEstimate(effkey);
+          MCEstimate est=moh->getEstimateFromSamplings(effsamps,mode);
           results.insert(make_pair(double(tval)+0.5*double(step),est));}
         catch(const std::exception& xp){}}
-       moh->eraseData(effkey);}}
+       window.erase(obskey1);}}
  else{
     CorrelatorAtTimeInfo corrtbackstep(corr,0,hermitian,subtract_vev);
     for (uint tval=step;tval<moh->getLatticeTimeExtent();tval++){
@@ -710,20 +731,23 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
        MCObsInfo obskey1(corrt,arg);
        MCObsInfo obskey2(corrtstep,arg);
        MCObsInfo obskey3(corrtbackstep,arg);
-       effkey.resetObsIndex(tval);
        if (moh->queryFullAndSamplings(obskey1)&&moh->queryFullAndSamplings(obskey2)){
         try{
-          for (moh->begin();!moh->end();++(*moh)){
-             double cval1=moh->getCurrentSamplingValue(obskey1)-subtract_const;
-             double cval2=moh->getCurrentSamplingValue(obskey2)-subtract_const;
-             double cval3=moh->getCurrentSamplingValue(obskey3)-subtract_const;
+          const RVector& corr1=getWindowedSamplings(moh,obskey1,mode,window);
+          const RVector& corr2=getWindowedSamplings(moh,obskey2,mode,window);
+          const RVector& corr3=getWindowedSamplings(moh,obskey3,mode,window);
+          effsamps.resize(corr1.size());
+          for (uint k=0;k<effsamps.size();++k){
+             double cval1=corr1[k]-subtract_const;
+             double cval2=corr2[k]-subtract_const;
+             double cval3=corr3[k]-subtract_const;
              if (effcalc.calculate(effenergy,tval,cval1,cval2,cval3))
-                moh->putCurrentSamplingValue(effkey,effenergy,true);
+                effsamps[k]=effenergy;
              else throw(std::runtime_error("Could not compute effective energy"));}
-       MCEstimate est=moh->getEstimate(effkey);
+       MCEstimate est=moh->getEstimateFromSamplings(effsamps,mode);
        results.insert(make_pair(double(tval),est));}
         catch(const std::exception& xp){}}
-       moh->eraseData(effkey);}}
+       window.erase(obskey3);}}
 
 }
 
@@ -754,12 +778,64 @@ extern "C"{
    void zheev_(char *jobz, char *uplo, int *n, double *a, int *lda,
                double *w, double *work, int *lwork, double *rwork,
                int *info);
+   void dsyevd_(char *jobz, char *uplo, int *n, double *a, int *lda,
+                double *w, double *work, int *lwork, int *iwork,
+                int *liwork, int *info);
+   void zheevd_(char *jobz, char *uplo, int *n, double *a, int *lda,
+                double *w, double *work, int *lwork, double *rwork,
+                int *lrwork, int *iwork, int *liwork, int *info);
 }
 #endif
 
 // ***************************************************************
 
 
+int EigenSolverWorkspace::solveRealSymmetric(char jobz, int n, double *a, double *w)
+{
+ char uplo='U';
+ int info=0;
+#ifdef LAPACK
+ if ((n!=qsize)||(jobz!=qjobz)||(qtype!='R')){
+    double wquery;
+    int iwquery, lwork=-1, liwork=-1;
+    dsyevd_(&jobz,&uplo,&n,a,&n,w,&wquery,&lwork,&iwquery,&liwork,&info);
+    if (info!=0) return info;
+    if (int(wquery)>int(work.size())) work.resize(int(wquery));
+    if (iwquery>int(iwork.size())) iwork.resize(iwquery);
+    qsize=n; qjobz=jobz; qtype='R';}
+ int lwork=work.size(), liwork=iwork.size();
+ dsyevd_(&jobz,&uplo,&n,a,&n,w,&work[0],&lwork,&iwork[0],&liwork,&info);
+#else
+ throw(std::invalid_argument("no lapack"));
+#endif
+ return info;
+}
+
+
+int EigenSolverWorkspace::solveComplexHermitian(char jobz, int n, double *a, double *w)
+{
+ char uplo='U';
+ int info=0;
+#ifdef LAPACK
+ if ((n!=qsize)||(jobz!=qjobz)||(qtype!='C')){
+    double wquery[2], rwquery;
+    int iwquery, lwork=-1, lrwork=-1, liwork=-1;
+    zheevd_(&jobz,&uplo,&n,a,&n,w,wquery,&lwork,&rwquery,&lrwork,&iwquery,&liwork,&info);
+    if (info!=0) return info;
+    if (2*int(wquery[0])>int(work.size())) work.resize(2*int(wquery[0]));
+    if (int(rwquery)>int(rwork.size())) rwork.resize(int(rwquery));
+    if (iwquery>int(iwork.size())) iwork.resize(iwquery);
+    qsize=n; qjobz=jobz; qtype='C';}
+ int lwork=work.size()/2, lrwork=rwork.size(), liwork=iwork.size();
+ zheevd_(&jobz,&uplo,&n,a,&n,w,&work[0],&lwork,&rwork[0],&lrwork,&iwork[0],&liwork,&info);
+#else
+ throw(std::invalid_argument("no lapack"));
+#endif
+ return info;
+}
+
+
+
    //  Takes a Hermitian matrix "H" and returns the eigenvalues in
    //  ascending order in "eigvals" and the associated eigenvectors
    //  in the columns of "eigvecs".  Throws an exception if fails.
@@ -771,25 +847,17 @@ void Diagonalizer::diagonalize(const RealSymmetricMatrix& H, RVector& eigvals,
  if (n==0){
    eigvals.clear();
    eigvecs.clear();return;}
- int lwork=5*n;
- RVector work(lwork);
  eigvals.resize(n);
- int info;
  char jobz=(calceigvecs)?'V':'N';
- char uplo='U';
 
     // load H (upper triangle) into matf fortran format
     //    (column major; row index changes fastest)
- vector<double> matf(n*n);
+ matf.resize(n*n);
  for (int col=0;col<n;++col)
  for (int row=0;row<=col;++row)
     matf[row+n*col]=H(row,col);
 
-#ifdef LAPACK
- dsyev_(&jobz,&uplo,&n,&matf[0],&n,&eigvals[0],&work[0],&lwork,&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveRealSymmetric(jobz,n,&matf[0],&eigvals[0]);
  if (info<0){
     throw(std::invalid_argument(" bad arguments in diagonalize"));}
  else if (info>0){
@@ -827,18 +895,13 @@ void Diagonalizer::diagonalize(const ComplexHermitianMatrix& H,
  if (n==0){
    eigvals.clear();
    eigvecs.clear();return;}
- int lwork=4*n;
- RVector work(2*lwork);
- RVector rwork(3*n);
  eigvals.resize(n);
- int info;
  char jobz=(calceigvecs)?'V':'N';
- char uplo='U';
 
     // load H (upper triangle) into matf fortran format
     //    (column major; row index changes fastest)
     //    complex stored as real,imag contiguous in fortran
- vector<double> matf(2*n*n);
+ matf.resize(2*n*n);
  for (int col=0;col<n;col++)
  for (int row=0;row<=col;row++){
     int index=2*(row+n*col);
@@ -846,11 +909,7 @@ void Diagonalizer::diagonalize(const ComplexHermitianMatrix& H,
     matf[index]=z.real();
     matf[index+1]=z.imag();}
 
-#ifdef LAPACK
- zheev_(&jobz,&uplo,&n,&matf[0],&n,&eigvals[0],&work[0],&lwork,&rwork[0],&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveComplexHermitian(jobz,n,&matf[0],&eigvals[0]);
  if (info<0){
     throw(std::invalid_argument(" bad arguments in diagonalize"));}
  else if (info>0){
@@ -1092,13 +1151,7 @@ int HermDiagonalizerWithMetric::setMetric(const ComplexHermitianMatrix& B,
  n=B.size();
  if (n==0) return -3;
 
- int info;
- char jobz='V';
- char uplo='U';
- int lwork=4*n;
  Beigvals.resize(n);
- RVector work(2*lwork);
- RVector rwork(3*n);
 
     // load B (upper triangle) into matb fortran format
     //    (column major; row index changes fastest)
@@ -1112,11 +1165,7 @@ int HermDiagonalizerWithMetric::setMetric(const ComplexHermitianMatrix& B,
 
     // solve for eigenvectors and eigenvalues of Hermitian B
     // eigenvectors returned in matb, eigenvalues in Beigvals
-#ifdef LAPACK
- zheev_(&jobz,&uplo,&n,&matb[0],&n,&Beigvals[0],&work[0],&lwork,&rwork[0],&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveComplexHermitian('V',n,&matb[0],&Beigvals[0]);
 
  if (info<0){
     clear();
@@ -1268,47 +1317,47 @@ int HermDiagonalizerWithMetric::setMatrix(const ComplexHermitianMatrix& A,
     xmlout.put(xmlnull);}
 
 
- int info;
- char jobz='V';
- char uplo='U';
- int lwork=4*n;
- RVector work(2*lwork);
- RVector rwork(3*n);
  int Bnull=n-n0;
  RVector Btildeinvsqrt(n0);
  RVector ev(n0);
  for (int i=0;i<n0;i++)
     Btildeinvsqrt[i]=1.0/sqrt(Beigvals[i+Bnull]);
 
-     // make the matrix  matg = Btilde^(-1/2) Atilde Btilde^(-1/2)
- matg.resize(2*n0*n0);
+     // make the matrix  matg = Btilde^(-1/2) Atilde Btilde^(-1/2),
+     // first forming matt = A P0 (n x n0)
+ matt.resize(2*n*n0);
  for (int col=0;col<n0;++col){
     int fcol=col+Bnull;
-    for (int row=0;row<=col;++row){
-       int frow=row+Bnull;
+    for (int l=0;l<n;l++){
        double tmpr=0.0,tmpi=0.0;
        for (int k=0;k<n;k++){
           int ind1=2*(k+n*fcol);
           double br=matb[ind1], bi=matb[ind1+1];
-          for (int l=0;l<n;l++){
-             int ind2=2*(l+n*frow);
-             double ar=matb[ind2], ai=matb[ind2+1];
-             double abr=ar*br+ai*bi;
-             double abi=ar*bi-ai*br;
-             double Are=real(A(l,k)),Aim=imag(A(l,k));
-             tmpr+=abr*Are-abi*Aim;
-             tmpi+=abr*Aim+abi*Are;}}
+          double Are=real(A(l,k)),Aim=imag(A(l,k));
+          tmpr+=Are*br-Aim*bi;
+          tmpi+=Are*bi+Aim*br;}
+       int index=2*(l+n*col);
+       matt[index]=tmpr;
+       matt[index+1]=tmpi;}}
+ matg.resize(2*n0*n0);
+ for (int col=0;col<n0;++col){
+    for (int row=0;row<=col;++row){
+       int frow=row+Bnull;
+       double tmpr=0.0,tmpi=0.0;
+       for (int l=0;l<n;l++){
+          int ind1=2*(l+n*frow);
+          double ar=matb[ind1], ai=matb[ind1+1];
+          int ind2=2*(l+n*col);
+          double tr=matt[ind2], ti=matt[ind2+1];
+          tmpr+=ar*tr+ai*ti;
+          tmpi+=ar*ti-ai*tr;}
        int index=2*(row+n0*col);
        matg[index]=tmpr*Btildeinvsqrt[row]*Btildeinvsqrt[col];
        matg[index+1]=tmpi*Btildeinvsqrt[row]*Btildeinvsqrt[col];}}
 
      // diagonalize, orthonormal eigenvectors in columns of matg,
      // eigenvalues in "ev"
-#ifdef LAPACK
- zheev_(&jobz,&uplo,&n0,&matg[0],&n0,&ev[0],&work[0],&lwork,&rwork[0],&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveComplexHermitian('V',n0,&matg[0],&ev[0]);
 
  if (info<0){
     clearMatrix();
@@ -1604,11 +1653,6 @@ int RealSymDiagonalizerWithMetric::setMetric(const RealSymmetricMatrix& B,
  n=B.size();
  if (n==0) return -3;
 
- int info;
- char jobz='V';
- char uplo='U';
- int lwork=5*n;
- RVector work(lwork);
  Beigvals.resize(n);
 
     // load B (upper triangle) into matb fortran format
@@ -1620,11 +1664,7 @@ int RealSymDiagonalizerWithMetric::setMetric(const RealSymmetricMatrix& B,
 
     // solve for eigenvectors and eigenvalues of Hermitian B
     // eigenvectors returned in matb, eigenvalues in Beigvals
-#ifdef LAPACK
- dsyev_(&jobz,&uplo,&n,&matb[0],&n,&Beigvals[0],&work[0],&lwork,&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveRealSymmetric('V',n,&matb[0],&Beigvals[0]);
 
  if (info<0){
     clear();
@@ -1768,37 +1808,34 @@ int RealSymDiagonalizerWithMetric::setMatrix(const RealSymmetricMatrix& A,
     xmlout.put(xmlnull);}
 
 
- int info;
- char jobz='V';
- char uplo='U';
- int lwork=5*n;
- RVector work(lwork);
  int Bnull=n-n0;
  RVector Btildeinvsqrt(n0);
  RVector ev(n0);
  for (int i=0;i<n0;i++)
     Btildeinvsqrt[i]=1.0/sqrt(Beigvals[i+Bnull]);
 
-     // make the matrix  matg = Btilde^(-1/2) Atilde Btilde^(-1/2)
- matg.resize(n0*n0);
+     // make the matrix  matg = Btilde^(-1/2) Atilde Btilde^(-1/2),
+     // first forming matt = A P0 (n x n0)
+ matt.resize(n*n0);
  for (int col=0;col<n0;++col){
     int fcol=col+Bnull;
+    for (int l=0;l<n;l++){
+       double tmp=0.0;
+       for (int k=0;k<n;k++)
+          tmp+=A(l,k)*matb[k+n*fcol];
+       matt[l+n*col]=tmp;}}
+ matg.resize(n0*n0);
+ for (int col=0;col<n0;++col){
     for (int row=0;row<=col;++row){
        int frow=row+Bnull;
        double tmp=0.0;
-       for (int k=0;k<n;k++){
-          double bk=matb[k+n*fcol];
-          for (int l=0;l<n;l++)
-             tmp+=matb[l+n*frow]*A(l,k)*bk;}
+       for (int l=0;l<n;l++)
+          tmp+=matb[l+n*frow]*matt[l+n*col];
        matg[row+n0*col]=tmp*Btildeinvsqrt[row]*Btildeinvsqrt[col];}}
 
      // diagonalize, orthonormal eigenvectors in columns of matg,
      // eigenvalues in "ev"
-#ifdef LAPACK
- dsyev_(&jobz,&uplo,&n0,&matg[0],&n0,&ev[0],&work[0],&lwork,&info);
-#else
- throw(std::invalid_argument("no lapack"));
-#endif
+ int info=ws.solveRealSymmetric('V',n0,&matg[0],&ev[0]);
 
  if (info<0){
     clearMatrix();
@@ -1828,6 +1865,7 @@ int RealSymDiagonalizerWithMetric::setMatrix(const RealSymmetricMatrix& A,
     clearMatrix();
     if (xon) throw(std::invalid_argument("Null space is dim of Matrix in RealSymDiagonalizerWithMetric::setMatrix"));
     else return -3;}
+ invcondnum = ev[Aremove]/ev[n0-1];
 
    //  put final retained eigenvalues in "eigvals"
  np=n0-Aremove;
@@ -2682,6 +2720,58 @@ vector<uint> form_tvalues(uint tmin, uint tmax,
 
 // ********************************************************************
 
+void doExpressionByBins(MCObsHandler& moh, const ObsExpression& expr,
+                        const vector<MCObsInfo>& args, const MCObsInfo& obs_result)
+{
+ uint nargs=args.size();
+ if (nargs!=expr.getNumberOfVariables())
+    throw(std::invalid_argument(string("Wrong number of observables for expression ")
+                                +expr.getExpression()));
+ uint nbins=moh.getNumberOfBins();
+ vector<const double*> argvals(nargs);
+ for (uint k=0;k<nargs;++k){
+    const RVector& bins=moh.getBins(args[k]);
+    argvals[k]=&bins[0];}
+ RVector result(nbins);
+ expr.evaluate(argvals,&result[0],nbins);
+ moh.putBins(obs_result,result);
+}
+
+
+void doExpressionBySamplings(MCObsHandler& moh, const ObsExpression& expr,
+                             const vector<MCObsInfo>& args, const MCObsInfo& obs_result)
+{
+ uint nargs=args.size();
+ if (nargs!=expr.getNumberOfVariables())
+    throw(std::invalid_argument(string("Wrong number of observables for expression ")
+                                +expr.getExpression()));
+ SamplingMode mode=moh.getCurrentSamplingMode();
+ uint nsamps=(mode==Jackknife) ? moh.getNumberOfBins()+1
+                               : moh.getNumberOfBootstrapResamplings()+1;
+ vector<const double*> argvals(nargs);
+ for (uint k=0;k<nargs;++k){
+    const RVector& samps=moh.getFullAndSamplingValues(args[k],mode);
+    if (samps.size()!=nsamps)
+       throw(std::runtime_error(string("Wrong number of samplings for ")+args[k].str()));
+    argvals[k]=&samps[0];}
+ RVector result(nsamps);
+ expr.evaluate(argvals,&result[0],nsamps);
+ moh.putFullAndSamplingValues(obs_result,result,mode);
+}
+
+
+    //  functions of a single observable "x"
+
+static void doFunctionOfOne(MCObsHandler& moh, const string& expression,
+                            const MCObsInfo& obs_in, const MCObsInfo& obs_out, bool bins)
+{
+ ObsExpression expr(expression,vector<string>(1,"x"));
+ vector<MCObsInfo> args(1,obs_in);
+ if (bins) doExpressionByBins(moh,expr,args,obs_out);
+ else doExpressionBySamplings(moh,expr,args,obs_out);
+}
+
+
 void doCopyByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
  const Vector<double>& inbins=moh.getBins(obs_in);
@@ -2691,143 +2781,127 @@ void doCopyByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& o
 
 void doCopyBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double val=moh.getCurrentSamplingValue(obs_in);
-    moh.putCurrentSamplingValue(obs_out,val);}
+ SamplingMode mode=moh.getCurrentSamplingMode();
+ RVector samps(moh.getFullAndSamplingValues(obs_in,mode));
+ moh.putFullAndSamplingValues(obs_out,samps,mode);
 }
 
 
 void doSquareByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- const Vector<double>& inbins=moh.getBins(obs_in);
- int nbins=inbins.size();
- Vector<double> sqvalues(nbins);
- for (int bin=0;bin<nbins;bin++)
-    sqvalues[bin]=inbins[bin]*inbins[bin];
- moh.putBins(obs_out,sqvalues);
+ doFunctionOfOne(moh,"x*x",obs_in,obs_out,true);
 }
 
 
 void doSquareBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double val=moh.getCurrentSamplingValue(obs_in);
-    moh.putCurrentSamplingValue(obs_out,val*val);}
+ doFunctionOfOne(moh,"x*x",obs_in,obs_out,false);
 }
 
 
 void doSquareRootByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- const Vector<double>& inbins=moh.getBins(obs_in);
- int nbins=inbins.size();
- Vector<double> sqvalues(nbins);
- for (int bin=0;bin<nbins;bin++)
-   sqvalues[bin]=sqrt(inbins[bin]);
- moh.putBins(obs_out,sqvalues);
+ doFunctionOfOne(moh,"sqrt(x)",obs_in,obs_out,true);
 }
 
 
 void doSquareRootBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double val=moh.getCurrentSamplingValue(obs_in);
-    moh.putCurrentSamplingValue(obs_out,sqrt(val));}
+ doFunctionOfOne(moh,"sqrt(x)",obs_in,obs_out,false);
 }
 
 
 void doLogByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- const Vector<double>& inbins=moh.getBins(obs_in);
- int nbins=inbins.size();
- Vector<double> logvalues(nbins);
- for (int bin=0;bin<nbins;bin++)
-   logvalues[bin]=log(inbins[bin]);
- moh.putBins(obs_out,logvalues);
+ doFunctionOfOne(moh,"log(x)",obs_in,obs_out,true);
 }
 
 
 void doLogBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double val=moh.getCurrentSamplingValue(obs_in);
-    moh.putCurrentSamplingValue(obs_out,log(val));}
+ doFunctionOfOne(moh,"log(x)",obs_in,obs_out,false);
 }
 
 void doExpByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- const Vector<double>& inbins=moh.getBins(obs_in);
- int nbins=inbins.size();
- Vector<double> expvalues(nbins);
- for (int bin=0;bin<nbins;bin++)
-   expvalues[bin]=exp(inbins[bin]);
- moh.putBins(obs_out,expvalues);
+ doFunctionOfOne(moh,"exp(x)",obs_in,obs_out,true);
 }
 
 
 void doExpBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double val=moh.getCurrentSamplingValue(obs_in);
-    moh.putCurrentSamplingValue(obs_out,exp(val));}
+ doFunctionOfOne(moh,"exp(x)",obs_in,obs_out,false);
+}
+
+
+static ObsExpression ratioExpression()
+{
+ vector<string> vars(2);
+ vars[0]="n"; vars[1]="d";
+ return ObsExpression("n/d",vars);
 }
 
 
 void doRatioByBins(MCObsHandler& moh, const MCObsInfo& obs_numer, const MCObsInfo& obs_denom,
                    const MCObsInfo& obs_ratio)
 {
- const Vector<double>& numerbins=moh.getBins(obs_numer);
- const Vector<double>& denombins=moh.getBins(obs_denom);
- int nbins=numerbins.size();
- Vector<double> ratiovalues(nbins);
- for (int bin=0;bin<nbins;bin++)
-    ratiovalues[bin]=numerbins[bin]/denombins[bin];
- moh.putBins(obs_ratio,ratiovalues);
+ vector<MCObsInfo> args(2);
+ args[0]=obs_numer; args[1]=obs_denom;
+ doExpressionByBins(moh,ratioExpression(),args,obs_ratio);
 }
 
 
 void doRatioBySamplings(MCObsHandler& moh, const MCObsInfo& obs_numer, const MCObsInfo& obs_denom,
                         const MCObsInfo& obs_ratio)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double ratiovalue=moh.getCurrentSamplingValue(obs_numer)
-                     /moh.getCurrentSamplingValue(obs_denom);
-    moh.putCurrentSamplingValue(obs_ratio,ratiovalue);}
+ vector<MCObsInfo> args(2);
+ args[0]=obs_numer; args[1]=obs_denom;
+ doExpressionBySamplings(moh,ratioExpression(),args,obs_ratio);
+}
+
+
+    //  variables L, S, N, X in that order
+
+static ObsExpression gmoExpression(const string& expression)
+{
+ vector<string> vars(4);
+ vars[0]="L"; vars[1]="S"; vars[2]="N"; vars[3]="X";
+ return ObsExpression(expression,vars);
 }
 
+
+static void doGMOCorrelator(MCObsHandler& moh, const CorrelatorInfo& L, const CorrelatorInfo& S,
+                            const CorrelatorInfo& N, const CorrelatorInfo& X,
+                            const CorrelatorInfo& GMO, bool bins)
+{
+ ObsExpression expr(gmoExpression("L*pow(S,1/3)/(pow(N,2/3)*pow(X,2/3))"));
+ CorrelatorAtTimeInfo corrL(L,0);
+ CorrelatorAtTimeInfo corrS(S,0);
+ CorrelatorAtTimeInfo corrN(N,0);
+ CorrelatorAtTimeInfo corrX(X,0);
+ CorrelatorAtTimeInfo corrGMO(GMO,0);
+ vector<MCObsInfo> args(4);
+ for (uint tval=0;tval<moh.getLatticeTimeExtent();tval++){
+    corrL.resetTimeSeparation(tval);
+    corrS.resetTimeSeparation(tval);
+    corrN.resetTimeSeparation(tval);
+    corrX.resetTimeSeparation(tval);
+    corrGMO.resetTimeSeparation(tval);
+    args[0]=MCObsInfo(corrL);
+    args[1]=MCObsInfo(corrS);
+    args[2]=MCObsInfo(corrN);
+    args[3]=MCObsInfo(corrX);
+    if (moh.queryBins(args[0])){
+       if (bins) doExpressionByBins(moh,expr,args,MCObsInfo(corrGMO));
+       else doExpressionBySamplings(moh,expr,args,MCObsInfo(corrGMO));}}
+}
+
+
 void doGMOByBins(MCObsHandler& moh, const CorrelatorInfo& L, const CorrelatorInfo& S,
                  const CorrelatorInfo& N, const CorrelatorInfo& X,
                    const CorrelatorInfo& GMO)
 {
-    CorrelatorAtTimeInfo corrL(L,0);
-    CorrelatorAtTimeInfo corrS(S,0);
-    CorrelatorAtTimeInfo corrN(N,0);
-    CorrelatorAtTimeInfo corrX(X,0);
-    CorrelatorAtTimeInfo corrGMO(GMO,0);
-    double one_third = 1.0/3.0;
-    double two_thirds = 2.0/3.0;
-     for (uint tval=0;tval<moh.getLatticeTimeExtent();tval++){
-        corrL.resetTimeSeparation(tval);
-        corrS.resetTimeSeparation(tval);
-        corrN.resetTimeSeparation(tval);
-        corrX.resetTimeSeparation(tval);
-        corrGMO.resetTimeSeparation(tval);
-        MCObsInfo obsL(corrL);
-        MCObsInfo obsS(corrS);
-        MCObsInfo obsN(corrN);
-        MCObsInfo obsX(corrX);
-        MCObsInfo obsGMO(corrGMO);
-        if( moh.queryBins(obsL) ){
-            const Vector<double>& Lbins=moh.getBins(obsL);
-            const Vector<double>& Sbins=moh.getBins(obsS);
-            const Vector<double>& Nbins=moh.getBins(obsN);
-            const Vector<double>& Xbins=moh.getBins(obsX);
-            int nbins=Lbins.size();
-            Vector<double> GMObins(nbins);
-            for (int bin=0;bin<nbins;bin++) 
-                GMObins[bin]=Lbins[bin]*pow(Sbins[bin],one_third)/( pow(Nbins[bin],two_thirds) * pow(Xbins[bin],two_thirds) );
-            moh.putBins(obsGMO,GMObins);
-        }
-     }
+ doGMOCorrelator(moh,L,S,N,X,GMO,true);
 }
 
 
@@ -2835,74 +2909,65 @@ void doGMOBySamplings(MCObsHandler& moh, const CorrelatorInfo& L, const Correlat
                  const CorrelatorInfo& N, const CorrelatorInfo& X,
                         const CorrelatorInfo& GMO)
 {
-    CorrelatorAtTimeInfo corrL(L,0);
-    CorrelatorAtTimeInfo corrS(S,0);
-    CorrelatorAtTimeInfo corrN(N,0);
-    CorrelatorAtTimeInfo corrX(X,0);
-    CorrelatorAtTimeInfo corrGMO(GMO,0);
-    double one_third = 1.0/3.0;
-    double two_thirds = 2.0/3.0;
-     for (uint tval=0;tval<moh.getLatticeTimeExtent();tval++){
-        corrL.resetTimeSeparation(tval);
-        corrS.resetTimeSeparation(tval);
-        corrN.resetTimeSeparation(tval);
-        corrX.resetTimeSeparation(tval);
-        corrGMO.resetTimeSeparation(tval);
-        MCObsInfo obsL(corrL);
-        MCObsInfo obsS(corrS);
-        MCObsInfo obsN(corrN);
-        MCObsInfo obsX(corrX);
-        MCObsInfo obsGMO(corrGMO);
-        if( moh.queryBins(obsL) ){
-         for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-            double gmovalue=moh.getCurrentSamplingValue(obsL)*pow(moh.getCurrentSamplingValue(obsS),one_third)
-                /( pow(moh.getCurrentSamplingValue(obsN),two_thirds) * pow(moh.getCurrentSamplingValue(obsX),two_thirds) );
-            moh.putCurrentSamplingValue(obsGMO,gmovalue);
-         }
-        }
-     }
+ doGMOCorrelator(moh,L,S,N,X,GMO,false);
 }
 
 void doGMOBySamplings(MCObsHandler& moh, const MCObsInfo& L, const MCObsInfo& S,
                  const MCObsInfo& N, const MCObsInfo& X,
                         const MCObsInfo& GMO)
 {
-    double one_third = 1.0/3.0;
-    double two_thirds = 2.0/3.0;
-     for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-        double gmovalue=moh.getCurrentSamplingValue(L)+moh.getCurrentSamplingValue(S)*one_third
-            -moh.getCurrentSamplingValue(N)*two_thirds - moh.getCurrentSamplingValue(X)*two_thirds;
-        moh.putCurrentSamplingValue(GMO,gmovalue);
-     }
+ vector<MCObsInfo> args(4);
+ args[0]=L; args[1]=S; args[2]=N; args[3]=X;
+ doExpressionBySamplings(moh,gmoExpression("L+S*(1/3)-N*(2/3)-X*(2/3)"),args,GMO);
+}
+
+
+    //  c0*x0+c1*x1+...
+
+static ObsExpression superpositionExpression(const vector<double>& sumcoefs)
+{
+ uint nsummands=sumcoefs.size();
+ if (nsummands==0)
+    throw(std::invalid_argument("No summands in linear superposition"));
+ vector<string> vars(nsummands);
+ map<string,double> params;
+ string expression;
+ for (uint k=0;k<nsummands;k++){
+    vars[k]="x"+make_string(k);
+    params["c"+make_string(k)]=sumcoefs[k];
+    if (k>0) expression+="+";
+    expression+="c"+make_string(k)+"*x"+make_string(k);}
+ return ObsExpression(expression,vars,params);
 }
 
+
 void doLinearSuperpositionByBins(MCObsHandler& moh, std::vector<MCObsInfo>& suminfos,
                    std::vector<double>& sumcoefs, const MCObsInfo& obs_superposition)
 {
- int nsummands=suminfos.size();
- vector<const Vector<double>* > bins(nsummands);
- for (int k=0;k<nsummands;k++)
-    bins[k]=&(moh.getBins(suminfos[k]));
- int nbins=bins[0]->size();
- Vector<double> result(nbins);
- for (int bin=0;bin<nbins;bin++){
-    double temp=0.0;
-    for (int k=0;k<nsummands;k++)
-       temp+=sumcoefs[k]*(*(bins[k]))[bin];
-    result[bin]=temp;}
- moh.putBins(obs_superposition,result);
+ doExpressionByBins(moh,superpositionExpression(sumcoefs),suminfos,obs_superposition);
 }
 
 
 void doLinearSuperpositionBySamplings(MCObsHandler& moh, std::vector<MCObsInfo>& suminfos,
                    std::vector<double>& sumcoefs, const MCObsInfo& obs_superposition)
 {
- int nsummands=suminfos.size();
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double result=0.0;
-    for (int k=0;k<nsummands;k++)
-       result+=sumcoefs[k]*moh.getCurrentSamplingValue(suminfos[k]);
-    moh.putCurrentSamplingValue(obs_superposition,result);}
+ doExpressionBySamplings(moh,superpositionExpression(sumcoefs),suminfos,obs_superposition);
+}
+
+
+    //  two observables "a" and "b" and the parameter "p"
+
+static void doFunctionOfTwo(MCObsHandler& moh, const string& expression,
+                            const MCObsInfo& a, const MCObsInfo& b, double p,
+                            const MCObsInfo& obs_out)
+{
+ vector<string> vars(2);
+ vars[0]="a"; vars[1]="b";
+ map<string,double> params;
+ params["p"]=p;
+ vector<MCObsInfo> args(2);
+ args[0]=a; args[1]=b;
+ doExpressionBySamplings(moh,ObsExpression(expression,vars,params),args,obs_out);
 }
 
 
@@ -2910,22 +2975,14 @@ void doAnisoDispersionBySamplings(MCObsHandler& moh, const MCObsInfo& anisotropy
                              const MCObsInfo& restmasssquared_key, double psqfactor,
                              const MCObsInfo& Esqinfo)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double m0sq=moh.getCurrentSamplingValue(restmasssquared_key);
-    double xi=moh.getCurrentSamplingValue(anisotropy_key);
-    double Esq=m0sq+psqfactor/(xi*xi);
-    moh.putCurrentSamplingValue(Esqinfo,Esq);}
+ doFunctionOfTwo(moh,"a+p/(b*b)",restmasssquared_key,anisotropy_key,psqfactor,Esqinfo);
 }
 
 void doCoeffDispersionBySamplings(MCObsHandler& moh, const MCObsInfo& coeff_key,
                              const MCObsInfo& restmasssquared_key, double psqfactor,
                              const MCObsInfo& Esqinfo)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double m0sq=moh.getCurrentSamplingValue(restmasssquared_key);
-    double c=moh.getCurrentSamplingValue(coeff_key);
-    double Esq=m0sq+c*psqfactor;
-    moh.putCurrentSamplingValue(Esqinfo,Esq);}
+ doFunctionOfTwo(moh,"a+b*p",restmasssquared_key,coeff_key,psqfactor,Esqinfo);
 }
 
 
@@ -2933,21 +2990,17 @@ void doBoostBySamplings(MCObsHandler& moh, const MCObsInfo& restmass_key,
 			const MCObsInfo& anisotropy_key, double psqfactor,
 			const MCObsInfo& Eboosted)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double m0=moh.getCurrentSamplingValue(restmass_key);
-    double xi=moh.getCurrentSamplingValue(anisotropy_key);
-    double Esq=m0*m0+psqfactor/(xi*xi);
-    moh.putCurrentSamplingValue(Eboosted,sqrt(Esq));}
+ doFunctionOfTwo(moh,"sqrt(a*a+p/(b*b))",restmass_key,anisotropy_key,psqfactor,Eboosted);
 }
 
 
 void doBoostBySamplings(MCObsHandler& moh, const MCObsInfo& restmass_key,
 			double psqfactor, const MCObsInfo& Eboosted)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double m0=moh.getCurrentSamplingValue(restmass_key);
-    double Esq=m0*m0+psqfactor;
-    moh.putCurrentSamplingValue(Eboosted,sqrt(Esq));}
+ map<string,double> params;
+ params["p"]=psqfactor;
+ doExpressionBySamplings(moh,ObsExpression("sqrt(x*x+p)",vector<string>(1,"x"),params),
+                         vector<MCObsInfo>(1,restmass_key),Eboosted);
 }
 
 
@@ -3239,20 +3292,41 @@ void doCorrelatorNormalzation(MCObsHandler& moh, CorrelatorInfo orig_corr,
  }
 }
 
+    //  Energy "E" plus (sign '+') or minus (sign '-') the energies
+    //  sqrt(m_k*m_k+p_k/(xi*xi)) of the scattering particles, where the
+    //  division by xi*xi is omitted if "anisotropy_key" is null.
+
+static void doEnergySum(MCObsHandler& moh, const MCObsInfo& energy_key,
+                        const MCObsInfo *anisotropy_key,
+                        const list<pair<MCObsInfo,double> >& scattering_particles,
+                        char sign, const MCObsInfo& energy_res)
+{
+ vector<string> vars(1,"E");
+ vector<MCObsInfo> args(1,energy_key);
+ if (anisotropy_key!=0){
+    vars.push_back("xi");
+    args.push_back(*anisotropy_key);}
+ map<string,double> params;
+ string expression("E");
+ uint k=0;
+ for (list<pair<MCObsInfo,double> >::const_iterator it=scattering_particles.begin();
+      it!=scattering_particles.end();it++,k++){
+    string m("m"+make_string(k)), p("p"+make_string(k));
+    vars.push_back(m);
+    args.push_back(it->first);
+    params[p]=it->second;
+    expression+=sign+string("sqrt(")+m+"*"+m+"+"+p
+               +((anisotropy_key!=0) ? "/(xi*xi))" : ")");}
+ doExpressionBySamplings(moh,ObsExpression(expression,vars,params),args,energy_res);
+}
+
+
 void doReconstructEnergyBySamplings(MCObsHandler& moh, const MCObsInfo& energy_diff_key,
 			            const MCObsInfo& anisotropy_key, 
                                     const list<pair<MCObsInfo,double> >& scattering_particles,
 			            const MCObsInfo& energy_res)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double xi=moh.getCurrentSamplingValue(anisotropy_key);
-    double e_diff=moh.getCurrentSamplingValue(energy_diff_key);
-    double energy = e_diff;
-    for (list<pair<MCObsInfo,double> >::const_iterator it=scattering_particles.begin();
-         it!=scattering_particles.end();it++){
-      double scat_mass=moh.getCurrentSamplingValue(it->first);
-      energy += sqrt(scat_mass*scat_mass + it->second/(xi*xi));}
-    moh.putCurrentSamplingValue(energy_res,energy);}
+ doEnergySum(moh,energy_diff_key,&anisotropy_key,scattering_particles,'+',energy_res);
 }
 
 
@@ -3260,27 +3334,23 @@ void doReconstructEnergyBySamplings(MCObsHandler& moh, const MCObsInfo& energy_d
                                     const list<pair<MCObsInfo,double> >& scattering_particles, 
                                     const MCObsInfo& energy_res)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double e_diff=moh.getCurrentSamplingValue(energy_diff_key);
-    double energy = e_diff;
-    for (list<pair<MCObsInfo,double> >::const_iterator it=scattering_particles.begin();
-         it!=scattering_particles.end();it++){
-      double scat_mass=moh.getCurrentSamplingValue(it->first);
-      energy += sqrt(scat_mass*scat_mass + it->second);}
-    moh.putCurrentSamplingValue(energy_res,energy);}
+ doEnergySum(moh,energy_diff_key,0,scattering_particles,'+',energy_res);
 }
 
 void doReconstructAmplitudeBySamplings(MCObsHandler& moh, const MCObsInfo& energy_diff_amp_key,
                                        const std::list<MCObsInfo>& scattering_particles_amps, 
                                        const MCObsInfo& amp_res)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double e_diff_amp=moh.getCurrentSamplingValue(energy_diff_amp_key);
-    double amplitude = e_diff_amp;
-    for (list<MCObsInfo>::const_iterator it=scattering_particles_amps.begin();it!=scattering_particles_amps.end();it++){
-      double scat_amp=moh.getCurrentSamplingValue(*it);
-      amplitude *= scat_amp;}
-    moh.putCurrentSamplingValue(amp_res,amplitude);}
+ vector<string> vars(1,"A");
+ vector<MCObsInfo> args(1,energy_diff_amp_key);
+ string expression("A");
+ uint k=0;
+ for (list<MCObsInfo>::const_iterator it=scattering_particles_amps.begin();
+      it!=scattering_particles_amps.end();it++,k++){
+    vars.push_back("a"+make_string(k));
+    args.push_back(*it);
+    expression+="*"+vars.back();}
+ doExpressionBySamplings(moh,ObsExpression(expression,vars),args,amp_res);
 }
 
 void doEnergyDifferenceBySamplings(MCObsHandler& moh, const MCObsInfo& energy_key,
@@ -3288,15 +3358,7 @@ void doEnergyDifferenceBySamplings(MCObsHandler& moh, const MCObsInfo& energy_ke
                                     const list<pair<MCObsInfo,double> >& scattering_particles,
 			            const MCObsInfo& energy_diff_res)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double xi=moh.getCurrentSamplingValue(anisotropy_key);
-    double energy=moh.getCurrentSamplingValue(energy_key);
-    double e_diff = energy;
-    for (list<pair<MCObsInfo,double> >::const_iterator it=scattering_particles.begin();
-         it!=scattering_particles.end();it++){
-      double scat_mass=moh.getCurrentSamplingValue(it->first);
-      e_diff -= sqrt(scat_mass*scat_mass + it->second/(xi*xi));}
-    moh.putCurrentSamplingValue(energy_diff_res,e_diff);}
+ doEnergySum(moh,energy_key,&anisotropy_key,scattering_particles,'-',energy_diff_res);
 }
 
 
@@ -3304,23 +3366,13 @@ void doEnergyDifferenceBySamplings(MCObsHandler& moh, const MCObsInfo& energy_ke
                                     const list<pair<MCObsInfo,double> >& scattering_particles, 
                                     const MCObsInfo& energy_diff_res)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double energy=moh.getCurrentSamplingValue(energy_key);
-    double e_diff = energy;
-    for (list<pair<MCObsInfo,double> >::const_iterator it=scattering_particles.begin();
-         it!=scattering_particles.end();it++){
-      double scat_mass=moh.getCurrentSamplingValue(it->first);
-      e_diff -= sqrt(scat_mass*scat_mass + it->second);}
-    moh.putCurrentSamplingValue(energy_diff_res,e_diff);}
+ doEnergySum(moh,energy_key,0,scattering_particles,'-',energy_diff_res);
 }
 
 void doCorrelatedDifferenceBySamplings(MCObsHandler& moh, const MCObsInfo& obs1,
                                        const MCObsInfo& obs2, const MCObsInfo& diff)
 {
- for (moh.setSamplingBegin();!moh.isSamplingEnd();moh.setSamplingNext()){
-    double obs1_samp_val=moh.getCurrentSamplingValue(obs1);
-    double obs2_samp_val=moh.getCurrentSamplingValue(obs2);
-    moh.putCurrentSamplingValue(diff,obs1_samp_val-obs2_samp_val);}
+ doFunctionOfTwo(moh,"a-b",obs1,obs2,0.0,diff);
 }
 
    //  Given a list of CorrelatorInfo objects, this returns a list of index pairs
@@ -13,6 +13,7 @@
 #include "correlator_matrix_info.h"
 #include "array.h"
 #include "log_helper.h"
+#include "obs_expression.h"
 
 // *******************************************************************
 // *                                                                 *
@@ -315,13 +316,47 @@ void getEffectiveEnergy(MCObsHandler *moh, const CorrelatorInfo& corr,
 
 // ***************************************************************************************
 
+   //  Workspace for the LAPACK divide-and-conquer eigensolvers "dsyevd"
+   //  and "zheevd".  The optimal workspace sizes are obtained from a
+   //  LAPACK query the first time a matrix size is used, and the arrays
+   //  are kept, so repeated diagonalizations of matrices of the same size
+   //  do not allocate.  On input, "a" contains the upper triangle of the
+   //  n x n matrix in Fortran (column major) order, complex numbers
+   //  stored as real,imag pairs; on output, it contains the orthonormal
+   //  eigenvectors in its columns if "jobz" is 'V'.  The eigenvalues are
+   //  returned in ascending order in "w".  The LAPACK "info" code is
+   //  returned.
+
+class EigenSolverWorkspace
+{
+    std::vector<double> work, rwork;
+    std::vector<int> iwork;
+    int qsize;
+    char qjobz, qtype;
+
+ public:
+
+    EigenSolverWorkspace() : qsize(-1), qjobz(' '), qtype(' ') {}
+    ~EigenSolverWorkspace(){}
+
+    int solveRealSymmetric(char jobz, int n, double *a, double *w);
+    int solveComplexHermitian(char jobz, int n, double *a, double *w);
+
+};
+
+
    //  Takes a Hermitian matrix "H" and returns the eigenvalues in
    //  ascending order in "eigvals" and the associated eigenvectors
    //  in the columns of "eigvecs".  Throws an exception if fails.
-   //  Versions for only the eigenvalues are also available.
+   //  Versions for only the eigenvalues are also available.  The
+   //  LAPACK workspace is kept between calls, so reuse one object
+   //  for many matrices of the same size.
 
 class Diagonalizer
 {
+    EigenSolverWorkspace ws;
+    std::vector<double> matf;
+
  public:
 
     Diagonalizer(){}
@@ -432,7 +467,8 @@ class HermDiagonalizerWithMetric
 {
     double mininvcondnum;
     double invcondnum = -1.0;
-    std::vector<double> matb, matg;
+    std::vector<double> matb, matg, matt;
+    EigenSolverWorkspace ws;
     RVector Beigvals, Geigvals;
     int n, n0, np;
     bool xon, Bset, Aset, nullB_in_nullA;
@@ -517,7 +553,9 @@ class HermDiagonalizerWithMetric
 class RealSymDiagonalizerWithMetric
 {
     double mininvcondnum;
-    std::vector<double> matb, matg;
+    double invcondnum = -1.0;
+    std::vector<double> matb, matg, matt;
+    EigenSolverWorkspace ws;
     RVector Beigvals, Geigvals;
     int n, n0, np;
     bool xon, Bset, Aset, nullB_in_nullA;
@@ -543,6 +581,7 @@ class RealSymDiagonalizerWithMetric
     void setNegativeEigenvalueAlarm(double negative_eigval_alarm);
 
     double getMinInvCondNum() const {return mininvcondnum;}
+    double getInvCondNum() const {return invcondnum;}
 
     double getNegativeEigenvalueAlarm() const {return negeigalarm;}
 
@@ -1063,6 +1102,17 @@ std::vector<uint> form_tvalues(uint tmin, uint tmax,
 
 // ********************************************************************
 //
+    //  Evaluates "expr" over all bins, or all samplings (including the full
+    //  sample) in the current sampling mode, of the observables "args"
+    //  (one per variable of the expression, in order) and puts the results
+    //  into "obs_result".  The functions below are done this way.
+
+void doExpressionByBins(MCObsHandler& moh, const ObsExpression& expr,
+                        const std::vector<MCObsInfo>& args, const MCObsInfo& obs_result);
+
+void doExpressionBySamplings(MCObsHandler& moh, const ObsExpression& expr,
+                             const std::vector<MCObsInfo>& args, const MCObsInfo& obs_result);
+
 void doCopyByBins(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out);
 
 void doCopyBySamplings(MCObsHandler& moh, const MCObsInfo& obs_in, const MCObsInfo& obs_out);
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 using namespace std;
 
 
@@ -49,18 +50,18 @@ XMLDoc::XMLDoc(XMLNode* top, const string& indecl) : declaration(indecl)
 
       //  Actual routines that do the memory allocation
 
-XMLDoc::XMLNode* XMLDoc::create_by_parsing(const string& xmlstr, 
+XMLDoc::XMLNode* XMLDoc::create_by_parsing(string_view xmlstr, 
                                            size_t start, size_t stop)
 {
  XMLNode *top=0;
  try{
-    stack<XMLDoc::XMLNode*> ancestors;
-    stack<XMLDoc::XMLNode*> lastchildren;
+    vector<XMLDoc::XMLNode*> ancestors;
+    string textpassed;
     XMLEvent lastevent;
     size_t curr;
-    top=parse_root_tag(xmlstr,start,stop,lastevent,curr,ancestors,lastchildren);
+    top=parse_root_tag(xmlstr,start,stop,lastevent,curr,ancestors);
     while (lastevent!=none)
-        parse_to_next_event(xmlstr,curr,stop,lastevent,ancestors,lastchildren);
+        parse_to_next_event(xmlstr,curr,stop,lastevent,ancestors,textpassed);
     if (!ancestors.empty()) throw(std::invalid_argument("Invalid XML"));
     return top;}
  catch(const std::exception& xp){
@@ -75,10 +76,10 @@ XMLDoc::XMLNode* XMLDoc::create_simple_tag(const string& tagname,
 {
  XMLNode *top=0;
  string tag(get_tag_name(tagname,0,tagname.length()));
- top=new XMLNode(tag,parent);
  string text(trim(in_text));
+ top=new_node(std::move(tag),parent);
  if (!text.empty())
-    top->firstchild=new XMLNode(text,top,true);
+    append_child(top,new_node(std::move(text),top,true));
  return top;
 }
 
@@ -90,33 +91,35 @@ XMLDoc::XMLNode* XMLDoc::create_text_node(const string& in_text,
  string text(trim(in_text));
  XMLNode *top=0;
  if (!text.empty())
-    top=new XMLNode(text,parent,true);
+    top=new_node(std::move(text),parent,true);
  return top;
 }
 
 
-          // copies top and its descendents
+          // copies top and its descendents; the copy has no parent
+          // until it is connected
 
 XMLDoc::XMLNode* XMLDoc::create_copy(XMLDoc::XMLNode* top)
 {
  if (top==0){
     throw(std::invalid_argument("XMLDoc create copy failed: nothing to copy"));}
  XMLNode *curr=top;
- XMLNode *newtop=0;
- newtop=new XMLNode(top->name,top->parent,top->text);
+ XMLNode *newtop=new_node(top->name,0,top->text);
  XMLNode *nodecopy=newtop;
  bool ascending=false;
  bool done=(top->firstchild==0);  // if empty root, done
  while (!done){
     if ((curr->firstchild!=0)&&(!ascending)){
        curr=curr->firstchild;
-       nodecopy->firstchild=new XMLNode(curr->name,nodecopy,curr->text);
-       nodecopy=nodecopy->firstchild;}
+       XMLNode *child=new_node(curr->name,nodecopy,curr->text);
+       append_child(nodecopy,child);
+       nodecopy=child;}
     else if (curr->nextsibling!=0){
        ascending=false;
        curr=curr->nextsibling;
-       nodecopy->nextsibling=new XMLNode(curr->name,nodecopy->parent,curr->text);
-       nodecopy=nodecopy->nextsibling;}
+       XMLNode *sibling=new_node(curr->name,nodecopy->parent,curr->text);
+       append_child(nodecopy->parent,sibling);
+       nodecopy=sibling;}
     else{
        curr=curr->parent;
        nodecopy=nodecopy->parent; 
@@ -157,26 +160,30 @@ void XMLDoc::destroy(XMLNode*& top)
 
   // This deletes a single node, updating the "current" pointers
   // of any XMLHandlers that point to this node.  This is only meant
-  // to be used by the "destroy" member.
+  // to be used by the "destroy" member.  The node is kept for reuse
+  // by "new_node".
 
 void XMLDoc::delete_node(XMLNode*& node)
 {
+ XMLNode *released=node;  // "node" may be the "current" member of a handler
     // before removing node, find all XMLHandlers that point to this
     // document, nullify all "current" pointers that point to this node.
     // If the root pointer of an XMLHander points to this node, then
     // that entire XMLHandler must be nullified and removed from "refset".
  set<XMLHandler*> eraseset;  // keeps track of XMLHandler to remove from "refset"
  for (set< XMLHandler* >::iterator it=refset.begin();it!=refset.end();++it){
-    if ((*it)->current==node){
+    if ((*it)->current==released){
        (*it)->current=0;}
-    if ((*it)->root==node){
+    if ((*it)->root==released){
        (*it)->root=0; (*it)->content=0;
        eraseset.insert(*it);}}
    // now remove elements from "refset"
  for (set<XMLHandler*>::iterator it=eraseset.begin();it!=eraseset.end();++it)
     refset.erase(*it);
-   // finally it is safe to delete the node
- delete node;
+   // finally it is safe to release the node
+ string().swap(released->name);
+ released->index.reset();
+ freenodes.push_back(released);
  node=0;
 }
 
@@ -192,6 +199,56 @@ XMLDoc::~XMLDoc()
  clear();
 }
 
+
+XMLDoc::XMLNode* XMLDoc::new_node(string name, XMLNode *parent, bool text)
+{
+ if (freenodes.empty()){
+    nodes.emplace_back(std::move(name),parent,text);
+    return &nodes.back();}
+ XMLNode *node=freenodes.back();
+ freenodes.pop_back();
+ node->name=std::move(name);
+ node->text=text;
+ node->parent=parent;
+ node->firstchild=node->lastchild=node->nextsibling=0;
+ node->nelements=0;
+ return node;
+}
+
+     //  "add" below must have no siblings (but children are okay)
+
+void XMLDoc::append_child(XMLNode *into, XMLNode* add)
+{
+ if (into->lastchild==0) into->firstchild=add;
+ else into->lastchild->nextsibling=add;
+ into->lastchild=add;
+ add->parent=into;
+ if (add->text) return;
+ into->nelements++;
+ if (into->index) (*into->index)[add->name].push_back(add);
+ else if (into->nelements>=index_threshold) build_index(into);
+}
+
+
+void XMLDoc::build_index(XMLNode *node)
+{
+ node->index.reset(new XMLNode::ChildIndex);
+ for (XMLNode *child=node->firstchild;child!=0;child=child->nextsibling)
+    if (!(child->text)) (*node->index)[child->name].push_back(child);
+}
+
+     //  next node after "node" in document order among the
+     //  descendents of "top" (null if none)
+
+XMLDoc::XMLNode* XMLDoc::next_node(XMLNode *node, const XMLNode *top)
+{
+ if (node->firstchild!=0) return node->firstchild;
+ while (node!=top){
+    if (node->nextsibling!=0) return node->nextsibling;
+    node=node->parent;}
+ return 0;
+}
+
      //  "add" below must have no siblings (but children are okay)
 
 void XMLDoc::connect_as_lastchild(XMLNode *into, XMLNode* add)
@@ -199,13 +256,7 @@ void XMLDoc::connect_as_lastchild(XMLNode *into, XMLNode* add)
  if (add==0) return;
  if ((into==0)||(add->nextsibling!=0))
     throw(std::invalid_argument("connection cannot be made in XMLDoc"));
- if (into->firstchild==0){
-    into->firstchild=add;}
- else{
-    XMLNode *x=into->firstchild; 
-    while (x->nextsibling!=0) x=x->nextsibling;
-    x->nextsibling=add;}
- add->parent=into;
+ append_child(into,add);
 }
 
      //  "add" below must have no siblings (but children are okay)
@@ -219,6 +270,12 @@ void XMLDoc::connect_as_nextsibling(XMLNode *into, XMLNode* add)
  into->nextsibling=add;
  add->nextsibling=nxsb;
  add->parent=into->parent;
+ XMLNode *parent=into->parent;
+ if (parent==0) return;
+ if (parent->lastchild==into) parent->lastchild=add;
+ if (!(add->text)){
+    parent->nelements++;
+    parent->index.reset();}   // rebuilt on the next append
 }
 
 
@@ -226,17 +283,32 @@ void XMLDoc::disconnect(XMLNode *top)
 {
  if ((top==0)||(top->parent==0)) return;
  XMLNode *parent=top->parent;
+ XMLNode *prev=0;
  if (parent->firstchild==top){
     parent->firstchild=top->nextsibling;}
  else{
-    XMLNode *x=parent->firstchild;
-    while (x->nextsibling!=top) x=x->nextsibling;
-    x->nextsibling=top->nextsibling;}
+    prev=parent->firstchild;
+    while (prev->nextsibling!=top) prev=prev->nextsibling;
+    prev->nextsibling=top->nextsibling;}
+ if (parent->lastchild==top) parent->lastchild=prev;
+ if (!(top->text)){
+    parent->nelements--;
+    if (parent->index){
+       XMLNode::ChildIndex::iterator it=parent->index->find(top->name);
+       it->second.erase(std::find(it->second.begin(),it->second.end(),top));
+       if (it->second.empty()) parent->index->erase(it);}}
  top->parent=0;
  top->nextsibling=0;
 }
 
 
+void XMLDoc::rename(XMLNode *node, const string& newname)
+{
+ node->name=newname;
+ if (node->parent) node->parent->index.reset();  // rebuilt on the next append
+}
+
+
     // This routine takes the characters in "instr", starting at
     // position "charstart" and stopping at "charstop" (does not
     // include this last character) and returns the XML tag name.
@@ -244,21 +316,21 @@ void XMLDoc::disconnect(XMLNode *top)
     // can be NO leading blanks, but trailing blanks are allowed,
     // but removed.
 
-string XMLDoc::get_tag_name(const string& instr, size_t charstart, 
+string XMLDoc::get_tag_name(string_view instr, size_t charstart, 
                             size_t charstop) 
 {
  if (charstart>=charstop) 
     throw(std::invalid_argument("Invalid XML tag name"));
- string tagName(instr,charstart,charstop-charstart);
+ string_view tagName(instr.substr(charstart,charstop-charstart));
     // remove any trailing blanks
- size_t pos=tagName.find_last_not_of(" ");
- if (pos<(tagName.length()-1))
-    tagName.erase(pos+1,tagName.length()-pos-1);
+ size_t pos=tagName.find_last_not_of(' ');
+ if ((pos!=string_view::npos)&&(pos<(tagName.length()-1)))
+    tagName.remove_suffix(tagName.length()-pos-1);
    // check valid XML tag name
    // no other blanks allowed
- pos=tagName.find_first_of(" ");
+ pos=tagName.find(' ');
  bool success=true;
- if ((pos!=string::npos)||(tagName.empty()))
+ if ((pos!=string_view::npos)||(tagName.empty()))
     success=false;
    // first 3 characters cannot be xml (case insensitive)
  if ((success)&&(tagName.length()>=3)){
@@ -281,17 +353,22 @@ string XMLDoc::get_tag_name(const string& instr, size_t charstart,
           success=false;
        k++;}}
  if (!success)
-    throw(std::invalid_argument(string("Invalid XML tag name: <")+tagName+string(">")));
- return tagName;
+    throw(std::invalid_argument(string("Invalid XML tag name: <")+string(tagName)+string(">")));
+ return string(tagName);
 }
 
 
   // removes tabs, newline, linefeed characters, then trims
   // leading and trailing blanks.
 
-string XMLDoc::trim(const string& str)   
+string XMLDoc::trim(string_view str)   
 {
+ if (str.find_first_of("\n\t\r")==string_view::npos){
+    size_t start=str.find_first_not_of(' ');
+    if (start==string_view::npos) return "";
+    return string(str.substr(start,str.find_last_not_of(' ')-start+1));}
  string tmp;
+ tmp.reserve(str.length());
  for (size_t i=0;i<str.length();i++)
     if ((str[i]!='\n')&&(str[i]!='\t')&&(str[i]!='\r'))
        tmp.push_back(str[i]);
@@ -306,7 +383,7 @@ string XMLDoc::trim(const string& str)
    // "true" if any of them are NOT "white space" (blanks, line feeds, 
    // tabs, new line, etc.)
 
-bool XMLDoc::nonwhitespace(const string& instr, size_t charstart, size_t charstop)
+bool XMLDoc::nonwhitespace(string_view instr, size_t charstart, size_t charstop)
 {
  bool nonwhite=false;
  size_t stop=(charstop<instr.length())?charstop:instr.length();
@@ -326,7 +403,7 @@ bool XMLDoc::nonwhitespace(const string& instr, size_t charstart, size_t charsto
     // set to "in_stop".  Note that if invalid XML is encountered, a string
     // exception will be thrown.
 
-void XMLDoc::find_next_xml_event(const string& xmlstr, size_t start, size_t in_stop,
+void XMLDoc::find_next_xml_event(string_view xmlstr, size_t start, size_t in_stop,
                                  XMLDoc::XMLEvent& type, size_t& pos, bool incomment)
 {
  size_t stop=min(in_stop,xmlstr.length());
@@ -335,33 +412,36 @@ void XMLDoc::find_next_xml_event(const string& xmlstr, size_t start, size_t in_s
  
  if (incomment){
     pos=xmlstr.find("--",start);
-    if ((pos==string::npos)||(pos>(in_stop-3))) throw(std::invalid_argument("Invalid XML"));
+    if ((pos==string_view::npos)||(pos>(in_stop-3))) throw(std::invalid_argument("Invalid XML"));
     pos+=2; 
     if (xmlstr[pos]!='>') throw(std::invalid_argument("Invalid XML"));
     type=endcom;
     return;
     }
+ const char *s=xmlstr.data();
  for (pos=start;pos<stop;pos++){
-    if (xmlstr[pos]=='<'){
-       char next=(pos<(stop-1))?xmlstr[pos+1]:' ';
+    char c=s[pos];
+    if ((c!='<')&&(c!='>')) continue;
+    if (c=='<'){
+       char next=(pos<(stop-1))?s[pos+1]:' ';
        if (next=='/'){
           type=startclose; return;}
        else if (next=='?'){
           type=startdecl; return;}
        else if (next=='!'){
-          if (((pos+3)<stop)&&(xmlstr[pos+2]=='-')&&(xmlstr[pos+3]=='-')){
+          if (((pos+3)<stop)&&(s[pos+2]=='-')&&(s[pos+3]=='-')){
              type=startcom; return;}
           else
              throw(std::invalid_argument("Invalid XML"));}
        type=starttag; return;}
-    else if (xmlstr[pos]=='>'){
-       char prev=(pos>start)?xmlstr[pos-1]:' ';
+    else{
+       char prev=(pos>start)?s[pos-1]:' ';
        if (prev=='/'){
           type=endempty; return;}
        else if (prev=='?'){
           type=enddecl; return;}
        else if (prev=='-'){
-          if (((pos-2)>=start)&&(xmlstr[pos-2]=='-')){
+          if (((pos-2)>=start)&&(s[pos-2]=='-')){
              type=endcom; return;}
           else
              throw(std::invalid_argument("Invalid XML"));}
@@ -378,12 +458,15 @@ void XMLDoc::find_next_xml_event(const string& xmlstr, size_t start, size_t in_s
     // "<" or ">").  If no event is found, the type "none" is returned and pos 
     // will be set to "in_stop".  Throws an exception if a start declaration 
     // or end declaration is encountered, or if invalid comment events are found.
+    // The text is only copied when comments split it into several pieces.
 
-void XMLDoc::find_next_xml_tag_event(const string& xmlstr, size_t start, size_t in_stop,
+void XMLDoc::find_next_xml_tag_event(string_view xmlstr, size_t start, size_t in_stop,
                                      XMLDoc::XMLEvent& type, size_t& pos, 
                                      string& textpassed)
 {
  textpassed.clear();
+ string_view firstpiece;
+ unsigned int npieces=0;
  size_t curr=start;
  bool incomment=false;
  bool notdone=true;
@@ -396,12 +479,18 @@ void XMLDoc::find_next_xml_tag_event(const string& xmlstr, size_t start, size_t
        curr=pos+1;}
     else{
        if ((pos>curr)&&(type!=endtag)&&(type!=endempty)){
-          textpassed.append(xmlstr,curr,pos-curr);}
+          string_view piece(xmlstr.substr(curr,pos-curr));
+          if (npieces==0) firstpiece=piece;
+          else{
+             if (npieces==1) textpassed.assign(firstpiece);
+             textpassed.append(piece);}
+          ++npieces;}
        if (type==startcom){
           incomment=true; curr=pos+4;}
        else
           notdone=false;}}
- textpassed=trim(textpassed);
+ if (npieces==1) textpassed=trim(firstpiece);
+ else if (npieces>1) textpassed=trim(textpassed);
 }
 
     // Searches the string in "xmlstr" starting at character location "start"
@@ -411,7 +500,7 @@ void XMLDoc::find_next_xml_tag_event(const string& xmlstr, size_t start, size_t
     // is encountered, if invalid comment events are found, or any event other
     // than comments or a start tag are found.
 
-void XMLDoc::find_root_start_tag(const string& xmlstr, size_t start, size_t in_stop,
+void XMLDoc::find_root_start_tag(string_view xmlstr, size_t start, size_t in_stop,
                                  size_t& pos)
 {
  size_t curr=start;
@@ -438,10 +527,9 @@ void XMLDoc::find_root_start_tag(const string& xmlstr, size_t start, size_t in_s
    //  This routine finds the root tag and starts filling the
    //  "ancestors" stack if the root tag is not an empty tag.
 
-XMLDoc::XMLNode* XMLDoc::parse_root_tag(const string& xmlstr, size_t& start, size_t stop, 
+XMLDoc::XMLNode* XMLDoc::parse_root_tag(string_view xmlstr, size_t& start, size_t stop, 
                                         XMLDoc::XMLEvent& type, size_t& pos, 
-                                        std::stack<XMLDoc::XMLNode*>& ancestors,
-                                        std::stack<XMLDoc::XMLNode*>& lastchildren)
+                                        vector<XMLDoc::XMLNode*>& ancestors)
 {
  size_t pos1;
  find_root_start_tag(xmlstr,start,stop,pos1);
@@ -454,10 +542,9 @@ XMLDoc::XMLNode* XMLDoc::parse_root_tag(const string& xmlstr, size_t& start, siz
  else
     throw(std::invalid_argument("Invalid XML"));
  pos++;
- XMLDoc::XMLNode* top=new XMLNode(roottag,0);
- if (type==endtag){
-    ancestors.push(top);
-    lastchildren.push(0);}
+ XMLDoc::XMLNode* top=new_node(std::move(roottag),0);
+ if (type==endtag)
+    ancestors.push_back(top);
  return top;
 }
 
@@ -471,15 +558,14 @@ XMLDoc::XMLNode* XMLDoc::parse_root_tag(const string& xmlstr, size_t& start, siz
   //    lastevent  ->  type of the last XML event (must be one of
   //                      starttag, endtag, startclose, endempty)
   //  The routine updates "curr", "lastevent", and "ancestors" while building
-  //  up the XMLDoc nodes.
+  //  up the XMLDoc nodes.  "textpassed" is just workspace.
 
-void XMLDoc::parse_to_next_event(const string& xmlstr, size_t& curr, size_t stop, 
-                                 XMLEvent& lastevent, stack<XMLNode*>& ancestors,
-                                 stack<XMLNode*>& lastchildren)
+void XMLDoc::parse_to_next_event(string_view xmlstr, size_t& curr, size_t stop, 
+                                 XMLEvent& lastevent, vector<XMLNode*>& ancestors,
+                                 string& textpassed)
 {
  XMLEvent nextevent;
  size_t pos;
- string textpassed;
  find_next_xml_tag_event(xmlstr,curr,stop,nextevent,pos,textpassed);
 
  if (ancestors.empty()){
@@ -490,41 +576,30 @@ void XMLDoc::parse_to_next_event(const string& xmlstr, size_t& curr, size_t stop
 
  if (lastevent==starttag){
     if (nextevent==endempty){
-        string tagname=get_tag_name(xmlstr,curr,pos-1);
-        XMLNode *newtag=new XMLNode(tagname,ancestors.top(),false);
-        if (lastchildren.top()==0) ancestors.top()->firstchild=newtag;
-        else lastchildren.top()->nextsibling=newtag;
-        lastchildren.top()=newtag;
+        XMLNode *newtag=new_node(get_tag_name(xmlstr,curr,pos-1),ancestors.back(),false);
+        append_child(ancestors.back(),newtag);
         lastevent=endempty;
         curr=pos+1; return;
         }
     else if (nextevent==endtag){
-        string tagname=get_tag_name(xmlstr,curr,pos);
-        XMLNode *newtag=new XMLNode(tagname,ancestors.top(),false);
-        if (lastchildren.top()==0) ancestors.top()->firstchild=newtag;
-        else lastchildren.top()->nextsibling=newtag;
-        lastchildren.top()=newtag;
+        XMLNode *newtag=new_node(get_tag_name(xmlstr,curr,pos),ancestors.back(),false);
+        append_child(ancestors.back(),newtag);
         lastevent=endtag;
         curr=pos+1; 
-        ancestors.push(newtag);
-        lastchildren.push(0);
+        ancestors.push_back(newtag);
         return;}
     throw(std::invalid_argument("Invalid XML"));}
  if (lastevent==startclose){
     if (nextevent==endtag){
        string tagname=get_tag_name(xmlstr,curr,pos);
-       if (tagname!=ancestors.top()->name) throw(std::invalid_argument("Invalid XML"));
-       ancestors.pop();
-       lastchildren.pop();
+       if (tagname!=ancestors.back()->name) throw(std::invalid_argument("Invalid XML"));
+       ancestors.pop_back();
        lastevent=endtag;
        curr=pos+1;
        return;}
     throw(std::invalid_argument("Invalid XML"));}
- if (!textpassed.empty()){
-    XMLNode *textnode=new XMLNode(textpassed,ancestors.top(),true);
-    if (lastchildren.top()==0) ancestors.top()->firstchild=textnode;
-    else lastchildren.top()->nextsibling=textnode;
-    lastchildren.top()=textnode;}
+ if (!textpassed.empty())
+    append_child(ancestors.back(),new_node(std::move(textpassed),ancestors.back(),true));
  if (nextevent==starttag){
     curr=pos+1; lastevent=nextevent;
     return;}
@@ -699,6 +774,13 @@ XMLHandler::XMLHandler(const char* roottagname)
 }
 
 
+XMLHandler::XMLHandler(XMLDoc *doc, XMLDoc::XMLNode *node, bool excpts)
+      : content(doc), root(node), current(node), exceptions(excpts)
+{
+ content->add_reference(this);
+}
+
+
      // Copy constructor. If "mode" has value "subtree_pointer" or
      // "subtree_copy", the current location of "xmlin" becomes the root 
      // element of this handler (cannot access ancestor nodes).  Otherwise,
@@ -834,13 +916,13 @@ XMLHandler& XMLHandler::set_from_file(const std::string& filename)
     ifstream fin(filename.c_str());
     if (!fin)
        throw(std::invalid_argument(string("Could not open file ")+filename));
-    string line;
-    while ((!fin.eof())&&(fin.good())){
-       getline(fin,line);
-       xmlstr+=line;}
-    if (!fin.eof())
+    ostringstream oss;
+    if (fin.peek()!=ifstream::traits_type::eof()) oss << fin.rdbuf();
+    if (fin.bad())
        throw(std::invalid_argument(string("Problem occurred while reading file ")+filename));
-    fin.close();}
+    fin.close();
+    xmlstr=oss.str();
+    xmlstr.erase(std::remove(xmlstr.begin(),xmlstr.end(),'\n'),xmlstr.end());}
  catch(const std::exception& err){
     cout << "XML document file error: "<<err.what()<<endl;
     current=0;
@@ -990,14 +1072,10 @@ void XMLHandler::seek_child(const string& tagname)
 {
  int ncount=0;
  if (current){
-    XMLHandler tagfinder(*this,XMLHandler::subtree_pointer);
-    tagfinder.seek_first_child();
-    tagfinder.set_exceptions_off();
-    while ((tagfinder.good())&&(ncount<2)){
-       if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-          current=tagfinder.current;
-          ncount++;}
-       tagfinder.seek_next_sibling();}}
+    XMLDoc::XMLNode *found=0;
+    XMLDoc::for_each_child(current,tagname,[&](XMLDoc::XMLNode *child){
+                             found=child; return (++ncount<2);});
+    current=found;}
  if (ncount!=1){
     current=0;
     if (exceptions) 
@@ -1017,7 +1095,9 @@ void XMLHandler::seek_next_node()
  if (current){
     if (current->firstchild!=0){
        current=current->firstchild;}
-    else if ((current->nextsibling!=0)&&(current!=root)){
+    else if (current==root){
+       current=0;}
+    else if (current->nextsibling!=0){
        current=current->nextsibling;}
     else{
        current=current->parent;
@@ -1055,14 +1135,12 @@ void XMLHandler::seek_next(const std::string& tagname)
 void XMLHandler::seek_unique(const string& tagname)
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- while ((tagfinder.good())&&(ncount<2)){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       current=tagfinder.current;
+ XMLDoc::XMLNode *found=0;
+ for (XMLDoc::XMLNode *node=root;(node!=0)&&(ncount<2);node=XMLDoc::next_node(node,root))
+    if ((!(node->text))&&(node->name==tagname)){
+       found=node;
        ncount++;}
-    tagfinder.seek_next_node();}
+ current=found;
  if (ncount!=1){
     current=0;
     if (exceptions) 
@@ -1073,16 +1151,13 @@ void XMLHandler::seek_unique(const string& tagname)
 void XMLHandler::seek_unique_to_child(const string& tagname)
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- bool ischild=false;
- while ((tagfinder.good())&&(ncount<2)){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       current=tagfinder.current;
-       ncount++;}
-    if (ischild) tagfinder.seek_next_sibling();
-    else{ tagfinder.seek_first_child(); ischild=true;}}
+ XMLDoc::XMLNode *found=0;
+ if (root){
+    if ((!(root->text))&&(root->name==tagname)){
+       found=root; ncount++;}
+    XMLDoc::for_each_child(root,tagname,[&](XMLDoc::XMLNode *child){
+                             found=child; return (++ncount<2);});}
+ current=found;
  if (ncount!=1){
     current=0;
     if (exceptions) 
@@ -1093,15 +1168,11 @@ void XMLHandler::seek_unique_to_child(const string& tagname)
 void XMLHandler::seek_unique_child(const string& tagname)
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- tagfinder.seek_first_child(); 
- while ((tagfinder.good())&&(ncount<2)){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       current=tagfinder.current;
-       ncount++;}
-    tagfinder.seek_next_sibling();}
+ XMLDoc::XMLNode *found=0;
+ if (root)
+    XMLDoc::for_each_child(root,tagname,[&](XMLDoc::XMLNode *child){
+                             found=child; return (++ncount<2);});
+ current=found;
  if (ncount!=1){
     current=0;
     if (exceptions) 
@@ -1109,33 +1180,26 @@ void XMLHandler::seek_unique_child(const string& tagname)
             +string(" failed: none or plural")));}
 }
 
+     //  The handlers returned by the "find" members have
+     //  exceptions turned off.
+
 list<XMLHandler> XMLHandler::find(const string& tagname) const
 {
  list<XMLHandler> found;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       XMLHandler xmlt(tagfinder);
-       found.push_back(xmlt);}
-    tagfinder.seek_next_node();}
+ for (XMLDoc::XMLNode *node=root;node!=0;node=XMLDoc::next_node(node,root))
+    if ((!(node->text))&&(node->name==tagname))
+       found.push_back(XMLHandler(content,node,false));
  return found;
 }
 
 list<XMLHandler> XMLHandler::find(const list<string>& tagnames) const
 {
  list<XMLHandler> found;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- while (tagfinder.good()){
-    if (!(tagfinder.current->text)){
+ for (XMLDoc::XMLNode *node=root;node!=0;node=XMLDoc::next_node(node,root)){
+    if (!(node->text)){
        for (list<string>::const_iterator it=tagnames.begin();it!=tagnames.end();it++){
-          if (tagfinder.current->name==*it){
-             XMLHandler xmlt(tagfinder);
-             found.push_back(xmlt); break;}}}
-    tagfinder.seek_next_node();}
+          if (node->name==*it){
+             found.push_back(XMLHandler(content,node,false)); break;}}}}
  return found;
 }
 
@@ -1143,13 +1207,9 @@ list<XMLHandler> XMLHandler::find(const list<string>& tagnames) const
 int XMLHandler::count(const string& tagname) const
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       ncount++;}
-    tagfinder.seek_next_node();}
+ for (XMLDoc::XMLNode *node=root;node!=0;node=XMLDoc::next_node(node,root))
+    if ((!(node->text))&&(node->name==tagname))
+       ncount++;
  return ncount;
 }
 
@@ -1157,14 +1217,9 @@ int XMLHandler::count(const string& tagname) const
 list<XMLHandler> XMLHandler::find_among_children(const string& tagname) const
 {
  list<XMLHandler> found;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.set_exceptions_off();
- tagfinder.seek_first_child();
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       XMLHandler xmlt(tagfinder);
-       found.push_back(xmlt);}
-    tagfinder.seek_next_sibling();}
+ if (current)
+    XMLDoc::for_each_child(current,tagname,[&](XMLDoc::XMLNode *child){
+                             found.push_back(XMLHandler(content,child,false)); return true;});
  return found;
 }
 
@@ -1172,16 +1227,12 @@ list<XMLHandler> XMLHandler::find_among_children(const string& tagname) const
 list<XMLHandler> XMLHandler::find_among_children(const list<string>& tagnames) const
 {
  list<XMLHandler> found;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.set_exceptions_off();
- tagfinder.seek_first_child();
- while (tagfinder.good()){
-    if (!(tagfinder.current->text)){
+ if (current==0) return found;
+ for (XMLDoc::XMLNode *child=current->firstchild;child!=0;child=child->nextsibling){
+    if (!(child->text)){
        for (list<string>::const_iterator it=tagnames.begin();it!=tagnames.end();it++){
-          if (tagfinder.current->name==*it){
-             XMLHandler xmlt(tagfinder);
-             found.push_back(xmlt); break;}}}
-    tagfinder.seek_next_sibling();}
+          if (child->name==*it){
+             found.push_back(XMLHandler(content,child,false)); break;}}}}
  return found;
 }
 
@@ -1189,58 +1240,34 @@ list<XMLHandler> XMLHandler::find_among_children(const list<string>& tagnames) c
 int XMLHandler::count_among_children(const string& tagname) const
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.set_exceptions_off();
- tagfinder.seek_first_child();
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       ncount++;}
-    tagfinder.seek_next_sibling();}
+ if (current)
+    XMLDoc::for_each_child(current,tagname,[&](XMLDoc::XMLNode*){
+                             ++ncount; return true;});
  return ncount;
 }
 
 int XMLHandler::count_to_among_children(const string& tagname) const
 {
- int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
-// tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- bool ischild=false;
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       ncount++;}
-    if (ischild) tagfinder.seek_next_sibling();
-    else{ tagfinder.seek_first_child(); ischild=true;}}
- return ncount;
+ if (current==0) return 0;
+ int ncount=((!(current->text))&&(current->name==tagname)) ? 1 : 0;
+ return ncount+count_among_children(tagname);
 }
 
 bool XMLHandler::query_unique_to_among_children(const string& tagname) const
 {
- int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
-// tagfinder.seek_root();
- tagfinder.set_exceptions_off();
- bool ischild=false;
- while (tagfinder.good()){
-    if ((!(tagfinder.current->text))&&(tagfinder.current->name==tagname)){
-       ncount++;}
-    if (ncount>1)
-       throw(std::invalid_argument(std::string("Multiple occurrences of ")
-            +tagname+std::string(" when one or none required")));
-    if (ischild) tagfinder.seek_next_sibling();
-    else{ tagfinder.seek_first_child(); ischild=true;}}
+ int ncount=count_to_among_children(tagname);
+ if (ncount>1)
+    throw(std::invalid_argument(std::string("Multiple occurrences of ")
+         +tagname+std::string(" when one or none required")));
  return ncount;
 }
 
 int XMLHandler::count_children() const
 {
  int ncount=0;
- XMLHandler tagfinder(*this,XMLHandler::pointer);
- tagfinder.seek_first_child();
- tagfinder.set_exceptions_off();
- while (tagfinder.good()){
-    ncount++;
-    tagfinder.seek_next_sibling();}
+ if (current)
+    for (XMLDoc::XMLNode *child=current->firstchild;child!=0;child=child->nextsibling)
+       ncount++;
  return ncount;
 }
 
@@ -1434,7 +1461,7 @@ void XMLHandler::rename_tag(const string& newtagname)
  try{
     if ((fail())||(current->text))
        throw(std::invalid_argument("Error"));
-    current->name=tag;}
+    content->rename(current,tag);}
  catch(const std::exception& xp){
     clear(); throw(std::invalid_argument("rename tag failed"));}
 }
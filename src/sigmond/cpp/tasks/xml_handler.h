@@ -9,7 +9,10 @@
 #include <cstdlib>
 #include <vector>
 #include <complex>
-#include <stack>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 #ifdef XML
 #include <unistd.h>
 #endif
@@ -145,7 +148,8 @@
 // *  disallowed (the one exception is in the XML declaration tag).  *
 // *  XMLHandler is not meant to be a full-fledged XML document      *
 // *  object module.  It is programmed with simplicity in mind,      *
-// *  not efficiency.                                                *
+// *  although parsing and lookups of children by tag name remain    *
+// *  fast for task inputs with many thousands of tags.              *
 // *                                                                 *
 // *  An XMLHandler maintains a pointer to the actual data, which    *
 // *  is an object of the class XMLDoc.  XMLDoc objects cannot be    *
@@ -256,6 +260,15 @@ class XMLHandler;   // forward declaration
    // any siblings.  A node without a child is either a text node
    // or an empty tag. Comments in the XML string are ignored.
    // Any declaration tag is kept.
+   //
+   // The nodes are allocated in blocks owned by the XMLDoc, and
+   // erased nodes are reused.  Each node also points to its last
+   // child so that appending is fast.  A node with many element
+   // children (such as a <TaskSequence> with thousands of <Task>
+   // tags) keeps an index of its children by tag name, which the
+   // child lookups of XMLHandler use.  The index is only built or
+   // changed by members that modify the document, so concurrent
+   // reads of a document remain safe.
 
 
 class XMLDoc
@@ -265,12 +278,15 @@ class XMLDoc
 
    struct XMLNode
    {
+      typedef std::unordered_map<std::string,std::vector<XMLNode*> > ChildIndex;
       std::string name;
       bool text;
-      XMLNode *parent, *firstchild, *nextsibling;
-      XMLNode(const std::string& inname, XMLNode *inparent, bool is_text=false)
-                  : name(inname), text(is_text), parent(inparent),
-                    firstchild(0), nextsibling(0) {}
+      XMLNode *parent, *firstchild, *lastchild, *nextsibling;
+      unsigned int nelements;            // number of non-text children
+      std::unique_ptr<ChildIndex> index; // non-text children by name
+      XMLNode(std::string inname, XMLNode *inparent, bool is_text=false)
+                  : name(std::move(inname)), text(is_text), parent(inparent),
+                    firstchild(0), lastchild(0), nextsibling(0), nelements(0) {}
       ~XMLNode(){}
     private:
       XMLNode(const XMLNode&);  // disable copying
@@ -301,7 +317,7 @@ class XMLDoc
 
        //  creation members
 
-   XMLNode* create_by_parsing(const std::string& xmlstr, size_t start,
+   XMLNode* create_by_parsing(std::string_view xmlstr, size_t start,
                               size_t stop);
    XMLNode* create_simple_tag(const std::string& tagname, const std::string& text,
                               XMLNode* parent);
@@ -318,28 +334,44 @@ class XMLDoc
    void connect_as_lastchild(XMLNode *into, XMLNode* add);
    void connect_as_nextsibling(XMLNode *into, XMLNode* add);
    void disconnect(XMLNode *top);
+   void rename(XMLNode *node, const std::string& newname);
+
+       //  node allocation and child index
+
+   static const unsigned int index_threshold=16;
+
+   XMLNode* new_node(std::string name, XMLNode *parent, bool text=false);
+   void append_child(XMLNode *into, XMLNode* add);
+   void build_index(XMLNode *node);
+
+       //  calls f(child) for each non-text child of "node" named "tagname",
+       //  in document order, until f returns false
+
+   template <typename F>
+   static void for_each_child(XMLNode *node, const std::string& tagname, F f);
+
+   static XMLNode* next_node(XMLNode *node, const XMLNode *top);
 
 
        //  utility routines
 
-   std::string get_tag_name(const std::string& instr, size_t charstart,
+   std::string get_tag_name(std::string_view instr, size_t charstart,
                             size_t charstop);
-   std::string trim(const std::string& str);
-   bool nonwhitespace(const std::string& instr, size_t charstart, size_t charstop);
-   void find_next_xml_event(const std::string& xmlstr, size_t start,
+   std::string trim(std::string_view str);
+   bool nonwhitespace(std::string_view instr, size_t charstart, size_t charstop);
+   void find_next_xml_event(std::string_view xmlstr, size_t start,
                             size_t in_stop, XMLEvent& type,  size_t& pos,
                             bool incomment=false);
-   void find_next_xml_tag_event(const std::string& xmlstr, size_t start, size_t stop,
+   void find_next_xml_tag_event(std::string_view xmlstr, size_t start, size_t stop,
                                 XMLEvent& type, size_t& pos, std::string& textpassed);
-   void find_root_start_tag(const std::string& xmlstr, size_t start, size_t in_stop,
+   void find_root_start_tag(std::string_view xmlstr, size_t start, size_t in_stop,
                             size_t& pos);
-   XMLNode* parse_root_tag(const std::string& xmlstr, size_t& start, size_t stop,
+   XMLNode* parse_root_tag(std::string_view xmlstr, size_t& start, size_t stop,
                            XMLEvent& type, size_t& pos,
-                           std::stack<XMLDoc::XMLNode*>& ancestors,
-                           std::stack<XMLDoc::XMLNode*>& lastchildren);
-   void parse_to_next_event(const std::string& xmlstr, size_t& curr, size_t stop,
-                            XMLEvent& lastevent, std::stack<XMLNode*>& ancestors,
-                            std::stack<XMLNode*>& lastchildren);
+                           std::vector<XMLDoc::XMLNode*>& ancestors);
+   void parse_to_next_event(std::string_view xmlstr, size_t& curr, size_t stop,
+                            XMLEvent& lastevent, std::vector<XMLNode*>& ancestors,
+                            std::string& textpassed);
    size_t get_declaration(const std::string& instr);
    bool get_attribute(const std::string& instr, const std::string& attrkey,
                       std::string& attrvalue, size_t& start, size_t& stop);
@@ -356,10 +388,27 @@ class XMLDoc
    XMLNode *root;
    std::string declaration;
    std::set< XMLHandler* > refset; // the XMLHandler objects that point to this
+   std::deque<XMLNode> nodes;      // storage for all nodes
+   std::vector<XMLNode*> freenodes; // erased nodes available for reuse
 
 };
 
 
+template <typename F>
+void XMLDoc::for_each_child(XMLNode *node, const std::string& tagname, F f)
+{
+ if (node->index){
+    XMLNode::ChildIndex::const_iterator it=node->index->find(tagname);
+    if (it==node->index->end()) return;
+    for (std::vector<XMLNode*>::const_iterator ct=it->second.begin();ct!=it->second.end();++ct)
+       if (!f(*ct)) return;
+    return;}
+ for (XMLNode *child=node->firstchild;child!=0;child=child->nextsibling)
+    if ((!(child->text))&&(child->name==tagname))
+       if (!f(child)) return;
+}
+
+
 
 // *********************************************************
 
@@ -601,6 +650,7 @@ class XMLHandler
                bool makecopy=false);
    void do_set_from_string(const std::string& xmlin);
    bool seek_next_sib_or_parent();
+   XMLHandler(XMLDoc *doc, XMLDoc::XMLNode *node, bool excpts); // subtree pointer at "node"
    std::string empty_string() const;
 
    friend class XMLDoc;
@@ -1029,6 +1079,7 @@ bool xmlreadif(XMLHandler& xmlh, const std::string& tagname, T& val,
 template <typename T>
 bool xmlreadifchild(XMLHandler& xmlh, const std::string& tagname, T& val)
 {
+ if (xmlh.count_among_children(tagname)!=1) return false;
  try{
     xmlreadchild(xmlh,tagname,val);
     return true;}